@@ -0,0 +1,362 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmarks of the hot paths of the common code, built natively with the host port (`make bench`).
+ *
+ * The benchmarks are listed by the table of each module, in `bench_<module>.c`. Each one is calibrated by doubling the number of iterations until a sample lasts at least #BENCH_MIN_SAMPLE_NS. Then #BENCH_SAMPLES rounds are run, and every round takes a sample of every benchmark, after its setup, so that a slow spell of the machine spreads over all of them instead of shifting the ones that happened to run then. The median, mean and variance of the time per operation are reported, together with the number of calls to `malloc()` per operation and the noise of the samples: their median absolute deviation, in percent of the median.
+ *
+ * The results are written to the standard output as JSON, one benchmark per line. If a baseline file with the same format is given, the results are compared with it. They are scaled first by the speed of this machine against the one of the baseline, the median of the ratios of all the benchmarks to their baseline, so that a slower or busier machine does not fail them all. The program fails if any benchmark is slower than its baseline by more than the threshold plus #BENCH_NOISE_FACTOR times its noise, the largest of the one of this run and the one of the baseline, or allocates more. The baseline is the median of several runs (`make bench-baseline`, `tools/bench_baseline.py`), and its noise the spread between them.
+ *
+ * After the benchmarks, the reports of the modules that are not compared with the baseline are printed: the traffic scenarios of the clock governor in `scenarios`, the drift sweep of the NEC decoder in `drift_sweep` and the glitch filter replay in `glitch_filter`. Before the benchmarks, the frames, the LED strip, the warm restart and the learning log are checked, so that each benchmark measures the path it is named after.
+ *
+ * Usage: `bench [baseline.json [threshold_pct]]`
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Other includes */
+#include "bench.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define BENCH_MIN_SAMPLE_NS 5000000ULL   /*!< Minimum duration of a sample in nanoseconds */
+#define BENCH_SAMPLES 11                 /*!< Number of rounds, each one with a sample of every benchmark. Odd, to take the median */
+#define BENCH_DEFAULT_THRESHOLD_PCT 25.0 /*!< Default regression threshold in percent of the baseline */
+#define BENCH_NOISE_FACTOR 3.0           /*!< Times the noise of a benchmark added to its threshold */
+#define BENCH_MAX_BENCHES 64             /*!< Maximum number of benchmarks */
+#define BENCH_MAX_BASELINE 64            /*!< Maximum number of entries read from the baseline */
+#define BENCH_NAME_SIZE 48               /*!< Maximum length of the name of a benchmark */
+#define BENCH_ALLOCS_EPSILON 0.001       /*!< Tolerance when comparing allocations per operation */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Result of a benchmark as read from the baseline.
+ */
+typedef struct
+{
+  char name[BENCH_NAME_SIZE]; /*!< Name of the benchmark */
+  double ns_per_op;           /*!< Median time per operation in nanoseconds */
+  double noise_pct;           /*!< Noise of the time per operation between runs, in percent. 0 if not recorded */
+  double allocs_per_op;       /*!< Calls to `malloc()` per operation */
+} bench_baseline_t;
+
+/**
+ * @brief Samples of a benchmark.
+ */
+typedef struct
+{
+  const bench_t *p_bench;          /*!< Benchmark */
+  uint32_t iterations;             /*!< Iterations of a sample, from the calibration */
+  double ns_per_op[BENCH_SAMPLES]; /*!< Time per operation of each sample in nanoseconds. Sorted once summarized */
+  uint64_t allocs;                 /*!< Calls to `malloc()` during the samples */
+  double median_ns;                /*!< Median time per operation in nanoseconds */
+  double mean_ns;                  /*!< Mean time per operation in nanoseconds */
+  double variance_ns2;             /*!< Variance of the time per operation */
+  double noise_pct;                /*!< Median absolute deviation of the time per operation, in percent of the median */
+} bench_samples_t;
+
+/* Global variables ------------------------------------------------------------*/
+volatile uint32_t sink = 0;      /*!< Results of the operations, so that the compiler does not remove them */
+static uint64_t allocs = 0;      /*!< Number of calls to `malloc()` */
+
+static bench_baseline_t baseline_arr[BENCH_MAX_BASELINE]; /*!< Entries of the baseline */
+static uint32_t num_baseline = 0;
+static bench_samples_t samples_arr[BENCH_MAX_BENCHES];    /*!< Samples of every benchmark, in the order of the tables */
+static uint32_t num_samples = 0;
+
+/*Tables of benchmarks of the modules, in the order of the report.*/
+static const bench_t *const suite_arr[] = {
+    bench_retina_arr,
+    bench_nec_arr,
+    bench_dlog_arr,
+    bench_strip_arr,
+    bench_warm_state_arr,
+    bench_learn_log_arr,
+};
+
+/* Allocation counting ---------------------------------------------------------*/
+void *__real_malloc(size_t size);
+
+/*Count the calls to malloc(). The bench is linked with `-Wl,--wrap=malloc`.*/
+void *__wrap_malloc(size_t size)
+{
+  allocs++;
+  return __real_malloc(size);
+}
+
+/* Private functions */
+
+/*Compare two doubles for qsort().*/
+static int _cmp_double(const void *p_a, const void *p_b)
+{
+  double a = *(const double *)p_a;
+  double b = *(const double *)p_b;
+  return (a > b) - (a < b);
+}
+
+/*Median of a sorted array.*/
+static double _median(const double *p_sorted, uint32_t num)
+{
+  return (num & 1U) ? p_sorted[num / 2] : (p_sorted[num / 2 - 1] + p_sorted[num / 2]) / 2;
+}
+
+/*Read the baseline. Each benchmark is on its own line, as written by this program.*/
+static void _read_baseline(const char *p_path)
+{
+  char line[512];
+  FILE *p_file = fopen(p_path, "r");
+
+  if (p_file == NULL)
+  {
+    fprintf(stderr, "bench: cannot open the baseline %s\n", p_path);
+    exit(EXIT_FAILURE);
+  }
+  while (fgets(line, sizeof(line), p_file) && (num_baseline < BENCH_MAX_BASELINE))
+  {
+    bench_baseline_t *p_entry = &baseline_arr[num_baseline];
+    char *p_name = strstr(line, "\"name\": \"");
+    char *p_ns = strstr(line, "\"ns_per_op\": ");
+    char *p_allocs = strstr(line, "\"allocs_per_op\": ");
+    char *p_noise = strstr(line, "\"noise_pct\": ");
+
+    if ((p_name == NULL) || (p_ns == NULL) || (p_allocs == NULL))
+    {
+      continue;
+    }
+    if ((sscanf(p_name, "\"name\": \"%47[^\"]\"", p_entry->name) == 1) &&
+        (sscanf(p_ns, "\"ns_per_op\": %lf", &p_entry->ns_per_op) == 1) &&
+        (sscanf(p_allocs, "\"allocs_per_op\": %lf", &p_entry->allocs_per_op) == 1))
+    {
+      p_entry->noise_pct = 0;
+      if (p_noise != NULL)
+      {
+        sscanf(p_noise, "\"noise_pct\": %lf", &p_entry->noise_pct);
+      }
+      num_baseline++;
+    }
+  }
+  fclose(p_file);
+}
+
+/*Find a benchmark in the baseline.*/
+static const bench_baseline_t *_find_baseline(const char *p_name)
+{
+  for (uint32_t i = 0; i < num_baseline; i++)
+  {
+    if (strcmp(baseline_arr[i].name, p_name) == 0)
+    {
+      return &baseline_arr[i];
+    }
+  }
+  return NULL;
+}
+
+/*Prepare a benchmark and time a run of some iterations. Return the nanoseconds elapsed.*/
+static uint64_t _sample(const bench_t *p_bench, uint32_t iterations)
+{
+  uint64_t start;
+
+  if (p_bench->setup != NULL)
+  {
+    p_bench->setup();
+  }
+  start = bench_now_ns();
+  p_bench->run(iterations);
+  return bench_now_ns() - start;
+}
+
+/*List the benchmarks of the modules and calibrate the iterations of each one.*/
+static void _calibrate(void)
+{
+  for (uint32_t i = 0; i < sizeof(suite_arr) / sizeof(suite_arr[0]); i++)
+  {
+    for (const bench_t *p_bench = suite_arr[i]; p_bench->name != NULL; p_bench++)
+    {
+      bench_samples_t *p_samples;
+
+      if (num_samples == BENCH_MAX_BENCHES)
+      {
+        fprintf(stderr, "bench: more than %u benchmarks\n", BENCH_MAX_BENCHES);
+        exit(EXIT_FAILURE);
+      }
+      p_samples = &samples_arr[num_samples];
+      p_samples->p_bench = p_bench;
+      p_samples->iterations = 1;
+      while (_sample(p_bench, p_samples->iterations) < BENCH_MIN_SAMPLE_NS)
+      {
+        p_samples->iterations *= 2;
+      }
+      num_samples++;
+    }
+  }
+}
+
+/*Take a sample of every benchmark in each round. Every other round runs them backwards, so that each one runs as often early as late in a round.*/
+static void _run_rounds(void)
+{
+  for (uint32_t round = 0; round < BENCH_SAMPLES; round++)
+  {
+    for (uint32_t j = 0; j < num_samples; j++)
+    {
+      bench_samples_t *p_samples = &samples_arr[(round & 1U) ? num_samples - 1 - j : j];
+      uint64_t allocs_start;
+      uint64_t elapsed_ns;
+
+      if (p_samples->p_bench->setup != NULL)
+      {
+        p_samples->p_bench->setup();
+      }
+      allocs_start = allocs;
+      elapsed_ns = bench_now_ns();
+      p_samples->p_bench->run(p_samples->iterations);
+      elapsed_ns = bench_now_ns() - elapsed_ns;
+      p_samples->allocs += allocs - allocs_start;
+      p_samples->ns_per_op[round] = (double)elapsed_ns / p_samples->iterations;
+    }
+  }
+}
+
+/*Compute the median, mean, variance and noise of the samples of a benchmark.*/
+static void _summarize(bench_samples_t *p_samples)
+{
+  double deviations[BENCH_SAMPLES];
+
+  p_samples->mean_ns = 0;
+  p_samples->variance_ns2 = 0;
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    p_samples->mean_ns += p_samples->ns_per_op[i];
+  }
+  p_samples->mean_ns /= BENCH_SAMPLES;
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    p_samples->variance_ns2 += (p_samples->ns_per_op[i] - p_samples->mean_ns) * (p_samples->ns_per_op[i] - p_samples->mean_ns);
+  }
+  p_samples->variance_ns2 /= BENCH_SAMPLES - 1;
+  qsort(p_samples->ns_per_op, BENCH_SAMPLES, sizeof(double), _cmp_double);
+  p_samples->median_ns = _median(p_samples->ns_per_op, BENCH_SAMPLES);
+
+  /* Median absolute deviation: the samples of a slow spell of the machine do not count, as long as they are fewer than half */
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    deviations[i] = (p_samples->ns_per_op[i] > p_samples->median_ns) ? p_samples->ns_per_op[i] - p_samples->median_ns : p_samples->median_ns - p_samples->ns_per_op[i];
+  }
+  qsort(deviations, BENCH_SAMPLES, sizeof(double), _cmp_double);
+  p_samples->noise_pct = 100.0 * _median(deviations, BENCH_SAMPLES) / p_samples->median_ns;
+}
+
+/*Speed of this machine against the one of the baseline: the median of the ratios of the benchmarks to their baseline. A regression of a module moves few of them, a slower or busier machine moves them all. 1 without a baseline.*/
+static double _machine_scale(void)
+{
+  double ratios[BENCH_MAX_BENCHES];
+  uint32_t num_ratios = 0;
+
+  for (uint32_t i = 0; i < num_samples; i++)
+  {
+    const bench_baseline_t *p_base = _find_baseline(samples_arr[i].p_bench->name);
+
+    if (p_base != NULL)
+    {
+      ratios[num_ratios++] = samples_arr[i].median_ns / p_base->ns_per_op;
+    }
+  }
+  if (num_ratios == 0)
+  {
+    return 1.0;
+  }
+  qsort(ratios, num_ratios, sizeof(double), _cmp_double);
+  return _median(ratios, num_ratios);
+}
+
+/*Print the result of a benchmark and return true if it has regressed.*/
+static bool _report(const bench_samples_t *p_samples, double threshold_pct, double scale, bool last)
+{
+  const bench_t *p_bench = p_samples->p_bench;
+  const bench_baseline_t *p_base = _find_baseline(p_bench->name);
+  double allocs_per_op = (double)p_samples->allocs / ((double)p_samples->iterations * BENCH_SAMPLES);
+  bool regressed = false;
+
+  printf("    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"mean_ns\": %.2f, \"variance_ns2\": %.3f, \"noise_pct\": %.1f, \"allocs_per_op\": %.3f, \"iterations\": %u, \"samples\": %u",
+         p_bench->name, p_samples->median_ns, p_samples->mean_ns, p_samples->variance_ns2, p_samples->noise_pct, allocs_per_op, p_samples->iterations, BENCH_SAMPLES);
+
+  if (p_base != NULL)
+  {
+    double delta_pct = 100.0 * (p_samples->median_ns / scale - p_base->ns_per_op) / p_base->ns_per_op;
+    double noise_pct = (p_samples->noise_pct > p_base->noise_pct) ? p_samples->noise_pct : p_base->noise_pct;
+    double limit_pct = threshold_pct + BENCH_NOISE_FACTOR * noise_pct;
+
+    regressed = (delta_pct > limit_pct) || (allocs_per_op > p_base->allocs_per_op + BENCH_ALLOCS_EPSILON);
+    printf(", \"baseline_ns_per_op\": %.2f, \"delta_pct\": %.1f, \"limit_pct\": %.1f, \"regressed\": %s", p_base->ns_per_op, delta_pct, limit_pct, regressed ? "true" : "false");
+    if (regressed)
+    {
+      fprintf(stderr, "bench: %s regressed: %.2f ns/op, %.2f on the machine of the baseline (baseline %.2f, limit %+.1f %%), %.3f allocs/op (baseline %.3f)\n",
+              p_bench->name, p_samples->median_ns, p_samples->median_ns / scale, p_base->ns_per_op, limit_pct, allocs_per_op, p_base->allocs_per_op);
+    }
+  }
+  printf("}%s\n", last ? "" : ",");
+
+  return regressed;
+}
+
+/**
+ * @brief Run all the benchmarks and compare them with the baseline, if given. Then print the reports of the modules.
+ *
+ * @return `EXIT_FAILURE` if a benchmark has regressed
+ */
+int main(int argc, char *argv[])
+{
+  double threshold_pct = BENCH_DEFAULT_THRESHOLD_PCT;
+  double scale;
+  uint32_t regressions = 0;
+
+  if (argc > 1)
+  {
+    _read_baseline(argv[1]);
+  }
+  if (argc > 2)
+  {
+    threshold_pct = atof(argv[2]);
+  }
+  bench_app_init();
+  bench_strip_init();
+  bench_retina_check();
+  bench_wake_frame_check();
+  bench_macro_check();
+  bench_rx_drift_check();
+  bench_deferred_mask_check();
+  bench_learn_log_check();
+
+  _calibrate();
+  _run_rounds();
+  for (uint32_t i = 0; i < num_samples; i++)
+  {
+    _summarize(&samples_arr[i]);
+  }
+  scale = _machine_scale();
+
+  printf("{\n  \"version\": 1,\n  \"threshold_pct\": %.1f,\n  \"noise_factor\": %.1f,\n  \"machine_scale\": %.3f,\n  \"benchmarks\": [\n", threshold_pct, BENCH_NOISE_FACTOR, scale);
+  for (uint32_t i = 0; i < num_samples; i++)
+  {
+    regressions += _report(&samples_arr[i], threshold_pct, scale, i == num_samples - 1);
+  }
+  printf("  ],\n  \"scenarios\": [\n");
+  bench_clock_report();
+  printf("  ],\n  \"drift_sweep\": [\n");
+  bench_nec_report_drift();
+  printf("  ],\n  \"glitch_filter\": [\n");
+  bench_nec_report_glitch();
+  printf("  ]\n}\n");
+
+  if (regressions > 0)
+  {
+    fprintf(stderr, "bench: %u benchmark(s) regressed more than %.1f %% plus %.1f times their noise\n", regressions, threshold_pct, BENCH_NOISE_FACTOR);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+/**
+ * @file bench.h
+ * @brief Header shared by the benchmarks of the host port (`make bench`).
+ *
+ * The harness (`bench.c`) runs the benchmarks listed by the table of each module and compares them with the baseline. The application, the frames of the remote and the helpers to drive them in simulated time (`bench_app.c`) are shared by the modules.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Other includes */
+#include "fsm.h"
+#include "fsm_rx_nec.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define CHANGE_MODE_BUTTON_TIME 3000 /*!< Same long press as the application, in milliseconds */
+#define RX_FRAME_STEPS_MS 12         /*!< Iterations of the main loop, one per millisecond, to receive and execute a frame */
+#define RX_REPEAT_STEPS_MS 2         /*!< Iterations of the main loop to execute a repetition code recognised at its last edge */
+#define FOREIGN_BUTTON 0x20DF10EFU   /*!< Code of a remote of another NEC device in the room */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Benchmark: a setup run before each sample and an operation run in a loop. The tables of benchmarks end with an entry whose name is NULL.
+ */
+typedef struct
+{
+  const char *name;                  /*!< Name of the benchmark */
+  void (*setup)(void);               /*!< Prepare the state of the benchmark. May be NULL */
+  void (*run)(uint32_t iterations);  /*!< Run the operation a number of times */
+} bench_t;
+
+/**
+ * @brief Intervals between the edges of a frame, as stored by the receiver and read by the decoder.
+ */
+typedef struct
+{
+  rx_delta_t deltas[RX_DELTA_BUFFER_SIZE]; /*!< Intervals in the format of `rx_delta.h` */
+  uint32_t num_deltas;                     /*!< Number of intervals */
+} bench_deltas_t;
+
+/* Global variables ------------------------------------------------------------*/
+extern volatile uint32_t sink; /*!< Results of the operations, so that the compiler does not remove them */
+
+extern fsm_t *p_fsm_button; /*!< FSMs of the application, as created by `main()` */
+extern fsm_t *p_fsm_tx;
+extern fsm_t *p_fsm_macro;
+extern fsm_t *p_fsm_rx;
+extern fsm_t *p_fsm_retina;
+
+extern uint16_t valid_edges[RX_DELTA_MAX_EDGES];   /*!< Edges of a NEC frame with nominal timing */
+extern uint32_t num_valid_edges;
+extern uint16_t repeat_edges[RX_DELTA_MAX_EDGES];  /*!< Edges of a NEC repeat code */
+extern uint32_t num_repeat_edges;
+extern uint16_t other_edges[RX_DELTA_MAX_EDGES];   /*!< Edges of a second NEC frame, to alternate codes */
+extern uint32_t num_other_edges;
+extern bench_deltas_t valid_deltas;                /*!< Intervals of each frame, as parsed by the decoder */
+extern bench_deltas_t repeat_deltas;
+extern bench_deltas_t noisy_deltas;                /*!< A frame with a glitch before it and jitter within the tolerances */
+extern bench_deltas_t other_deltas;
+extern bench_deltas_t foreign_deltas;              /*!< A frame for another device */
+extern bench_deltas_t truncated_deltas;            /*!< The first half of the valid frame */
+extern const uint16_t own_addresses[1];            /*!< Address filter of the application */
+
+extern const bench_t bench_retina_arr[];     /*!< Benchmarks of each module, in `bench_<module>.c` */
+extern const bench_t bench_nec_arr[];
+extern const bench_t bench_dlog_arr[];
+extern const bench_t bench_strip_arr[];
+extern const bench_t bench_warm_state_arr[];
+extern const bench_t bench_learn_log_arr[];
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Monotonic time in nanoseconds.
+ *
+ * @return Nanoseconds since an arbitrary point
+ */
+uint64_t bench_now_ns(void);
+
+/**
+ * @brief Pseudo-random jitter in [-max, max] ticks. Deterministic, so that the runs are reproducible.
+ *
+ * @param p_seed Pointer to the state of the generator
+ * @param max Largest jitter
+ *
+ * @return Jitter in ticks
+ */
+int32_t bench_jitter(uint32_t *p_seed, int32_t max);
+
+/**
+ * @brief Build the edges of a NEC frame as captured by the receiver, from a remote whose clock is off by some percent.
+ *
+ * @param p_edges Pointer to the edges. Room for #RX_DELTA_MAX_EDGES
+ * @param code Code of the frame
+ * @param start Tick of the first edge. The 16-bit timer wraps, as in the receiver
+ * @param drift_pct Clock error of the remote in percent
+ * @param jitter Jitter of each interval in ticks
+ *
+ * @return Number of edges
+ */
+uint32_t bench_build_nec_frame(uint16_t *p_edges, uint32_t code, uint16_t start, int32_t drift_pct, int32_t jitter);
+
+/**
+ * @brief Store the intervals between the edges of a frame as the receiver does.
+ *
+ * @param p_edges Pointer to the edges
+ * @param num_edges Number of edges
+ * @param p_deltas Pointer to the intervals
+ */
+void bench_encode_deltas(const uint16_t *p_edges, uint32_t num_edges, bench_deltas_t *p_deltas);
+
+/**
+ * @brief Build the frames of the benchmarks and check that they decode as expected, so that each benchmark measures the path it is named after. Exit if they do not.
+ */
+void bench_app_init(void);
+
+/**
+ * @brief One iteration of the main loop of the application, then one millisecond passes.
+ */
+void bench_main_loop_step(void);
+
+/**
+ * @brief Run the main loop of the application for some milliseconds.
+ *
+ * @param ms Milliseconds
+ */
+void bench_main_loop_run(uint32_t ms);
+
+/**
+ * @brief Create the FSMs of the application, as `main()` does after a reset. The state saved in the backup SRAM is restored.
+ */
+void bench_boot_app(void);
+
+/**
+ * @brief Create the FSMs of the application after a power-up, so that the state saved by the previous one is not restored.
+ */
+void bench_create_app(void);
+
+/**
+ * @brief Hold the button to switch the application to reception mode and check that a frame is executed. Exit if it is not.
+ */
+void bench_enter_rx_mode(void);
+
+/**
+ * @brief Check that a reset restores the reception mode and the colour of the RGB LED, and that a power-up does not. Exit if it does not.
+ */
+void bench_retina_check(void);
+
+/**
+ * @brief Wake the receiver up with a frame and check that it is decoded and accounted to the low-power mode in the telemetry, and that the frames received awake are not. Exit if they are.
+ */
+void bench_wake_frame_check(void);
+
+/**
+ * @brief Play a macro while another one is being played and check that the new one replaces it. Exit if it does not.
+ */
+void bench_macro_check(void);
+
+/**
+ * @brief Learn the drift of a remote, turn the receiver off and on again and check that the drift is kept. Exit if it is not.
+ */
+void bench_rx_drift_check(void);
+
+/**
+ * @brief Flag the end of a frame while the deferred interrupt is held off and check that it is only decoded once the interrupt is no longer. Exit if it is not.
+ */
+void bench_deferred_mask_check(void);
+
+/**
+ * @brief Check the encoder of the LED strip against streams derived by hand, build the frame of the strip benchmarks and check that the strip of the host port decodes the streams of the encoder. Exit if it does not.
+ */
+void bench_strip_init(void);
+
+/**
+ * @brief Check that the learning log keeps learning once its index and its sector are full, and that the newest records survive a reboot. Exit if it does not.
+ */
+void bench_learn_log_check(void);
+
+/**
+ * @brief Receive the same representative traffic with each policy of the clock governor and print their energy/latency trade-off as JSON.
+ */
+void bench_clock_report(void);
+
+/**
+ * @brief Parse frames of remotes whose clock is off by some percent, with growing jitter, and print the rate of frames decoded with the fixed and the adaptive windows as JSON.
+ */
+void bench_nec_report_drift(void);
+
+/**
+ * @brief Replay captures of frames under ambient lights through the receiver with and without the glitch filter, and print the edges stored, the frames decoded and the time to parse a capture as JSON.
+ */
+void bench_nec_report_glitch(void);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,249 @@
+/**
+ * @file bench_app.c
+ * @brief The application and the frames of the remote shared by the benchmarks.
+ *
+ * The application is created and driven in simulated time as `main()` does on the board. The frames are built as the receiver captures them, and checked to decode as expected, so that each benchmark measures the path it is named after.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Other includes */
+#include "bench.h"
+#include "fsm_button.h"
+#include "fsm_tx.h"
+#include "fsm_macro.h"
+#include "fsm_rx.h"
+#include "fsm_rx_nec.h"
+#include "fsm_retina.h"
+#include "commands.h"
+#include "port_system.h"
+#include "port_button.h"
+#include "port_tx.h"
+#include "port_rx.h"
+#include "port_rgb.h"
+#include "port_backup.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define NS_PER_S 1000000000ULL /*!< Nanoseconds in a second */
+#define TICKS_MID(min, max) ((uint16_t)(((min) + (max)) / 2)) /*!< Nominal width in ticks of a NEC interval */
+
+/* Global variables ------------------------------------------------------------*/
+fsm_t *p_fsm_button;
+fsm_t *p_fsm_tx;
+fsm_t *p_fsm_macro;
+fsm_t *p_fsm_rx;
+fsm_t *p_fsm_retina;
+
+uint16_t valid_edges[RX_DELTA_MAX_EDGES];
+uint32_t num_valid_edges;
+uint16_t repeat_edges[RX_DELTA_MAX_EDGES];
+uint32_t num_repeat_edges;
+uint16_t other_edges[RX_DELTA_MAX_EDGES];
+uint32_t num_other_edges;
+bench_deltas_t valid_deltas;
+bench_deltas_t repeat_deltas;
+bench_deltas_t noisy_deltas;
+bench_deltas_t other_deltas;
+bench_deltas_t foreign_deltas;
+bench_deltas_t truncated_deltas;
+const uint16_t own_addresses[1] = {LIL_ADDRESS};
+
+static uint16_t noisy_edges[RX_DELTA_MAX_EDGES];   /*!< Edges of a NEC frame with a glitch before it and jitter within the tolerances */
+static uint32_t num_noisy_edges;
+static uint16_t foreign_edges[RX_DELTA_MAX_EDGES]; /*!< Edges of a NEC frame for another device */
+static uint32_t num_foreign_edges;
+
+/* Private functions */
+
+/*Append an edge after an interval of ticks. The 16-bit timer wraps, as in the receiver.*/
+static void _add_edge(uint16_t *p_edges, uint32_t *p_num, uint16_t interval)
+{
+  p_edges[*p_num] = (uint16_t)(p_edges[*p_num - 1] + interval);
+  (*p_num)++;
+}
+
+/*Width of an interval sent by a remote whose clock is off by some percent, with jitter.*/
+static uint16_t _interval(uint16_t nominal, int32_t drift_pct, uint32_t *p_seed, int32_t jitter)
+{
+  return (uint16_t)((int32_t)nominal * (100 + drift_pct) / 100 + bench_jitter(p_seed, jitter));
+}
+
+/*Build all the edge buffers used by the benchmarks.*/
+static void _build_edges(void)
+{
+  /* Valid frame that wraps the 16-bit timer */
+  num_valid_edges = bench_build_nec_frame(valid_edges, LIL_RED_BUTTON, 60000, 0, 0);
+  num_other_edges = bench_build_nec_frame(other_edges, LIL_GREEN_BUTTON, 1000, 0, 0);
+  num_foreign_edges = bench_build_nec_frame(foreign_edges, FOREIGN_BUTTON, 3000, 0, 4);
+
+  num_repeat_edges = 1;
+  repeat_edges[0] = 100;
+  _add_edge(repeat_edges, &num_repeat_edges, TICKS_MID(NEC_RX_PROLOGUE_TICKS_SILENCE_MIN, NEC_RX_PROLOGUE_TICKS_SILENCE_MAX));
+  _add_edge(repeat_edges, &num_repeat_edges, TICKS_MID(NEC_RX_REPETITION_TICKS_PULSE_MIN, NEC_RX_REPETITION_TICKS_PULSE_MAX));
+  _add_edge(repeat_edges, &num_repeat_edges, TICKS_MID(NEC_RX_SYMBOL_TICKS_SILENCE_MIN, NEC_RX_SYMBOL_TICKS_SILENCE_MAX));
+
+  /* A short glitch followed by a frame with jitter */
+  noisy_edges[0] = 500;
+  noisy_edges[1] = 503;
+  num_noisy_edges = 2 + bench_build_nec_frame(&noisy_edges[2], LIL_BLUE_BUTTON, 2000, 0, 8);
+
+  bench_encode_deltas(valid_edges, num_valid_edges, &valid_deltas);
+  bench_encode_deltas(repeat_edges, num_repeat_edges, &repeat_deltas);
+  bench_encode_deltas(noisy_edges, num_noisy_edges, &noisy_deltas);
+  bench_encode_deltas(other_edges, num_other_edges, &other_deltas);
+  bench_encode_deltas(foreign_edges, num_foreign_edges, &foreign_deltas);
+  bench_encode_deltas(valid_edges, num_valid_edges / 2, &truncated_deltas);
+}
+
+/*Check that the edge buffers decode as expected.*/
+static void _check_edges(void)
+{
+  fsm_t *p_fsm_nec = fsm_rx_NEC_new();
+  uint32_t code;
+  bool ok = true;
+
+  ok = ok && !fsm_rx_NEC_parse_code(p_fsm_nec, valid_deltas.deltas, valid_deltas.num_deltas, &code) && (code == LIL_RED_BUTTON);
+  ok = ok && !fsm_rx_NEC_parse_code(p_fsm_nec, other_deltas.deltas, other_deltas.num_deltas, &code) && (code == LIL_GREEN_BUTTON);
+  ok = ok && !fsm_rx_NEC_parse_code(p_fsm_nec, noisy_deltas.deltas, noisy_deltas.num_deltas, &code) && (code == LIL_BLUE_BUTTON);
+  ok = ok && fsm_rx_NEC_parse_code(p_fsm_nec, repeat_deltas.deltas, repeat_deltas.num_deltas, &code);
+  ok = ok && fsm_rx_NEC_check_repetition(p_fsm_nec, repeat_deltas.deltas, repeat_deltas.num_deltas);
+  ok = ok && !fsm_rx_NEC_check_repetition(p_fsm_nec, valid_deltas.deltas, NEC_REPETITION_EDGES - 1);
+  ok = ok && !fsm_rx_NEC_parse_code(p_fsm_nec, foreign_deltas.deltas, foreign_deltas.num_deltas, &code) && (code == FOREIGN_BUTTON);
+  fsm_rx_NEC_set_address_filter(p_fsm_nec, own_addresses, 1, 0xFFFF);
+  ok = ok && !fsm_rx_NEC_parse_code(p_fsm_nec, foreign_deltas.deltas, foreign_deltas.num_deltas, &code) && (code == 0) && fsm_rx_NEC_get_filtered(p_fsm_nec);
+  ok = ok && !fsm_rx_NEC_parse_code(p_fsm_nec, valid_deltas.deltas, valid_deltas.num_deltas, &code) && (code == LIL_RED_BUTTON);
+  fsm_destroy(p_fsm_nec);
+
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the edge buffers do not decode as expected\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Public functions */
+
+/*Monotonic time in nanoseconds.*/
+uint64_t bench_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+/*Pseudo-random jitter in [-max, max] ticks.*/
+int32_t bench_jitter(uint32_t *p_seed, int32_t max)
+{
+  *p_seed = *p_seed * 1664525U + 1013904223U;
+  return (int32_t)((*p_seed >> 16) % (uint32_t)(2 * max + 1)) - max;
+}
+
+/*Build the edges of a NEC frame as captured by the receiver, starting at a given tick.*/
+uint32_t bench_build_nec_frame(uint16_t *p_edges, uint32_t code, uint16_t start, int32_t drift_pct, int32_t jitter)
+{
+  uint32_t num = 1;
+  uint32_t seed = code;
+
+  p_edges[0] = start;
+  _add_edge(p_edges, &num, _interval(TICKS_MID(NEC_RX_PROLOGUE_TICKS_SILENCE_MIN, NEC_RX_PROLOGUE_TICKS_SILENCE_MAX), drift_pct, &seed, jitter));
+  _add_edge(p_edges, &num, _interval(TICKS_MID(NEC_RX_PROLOGUE_TICKS_PULSE_MIN, NEC_RX_PROLOGUE_TICKS_PULSE_MAX), drift_pct, &seed, jitter));
+  for (uint32_t mask = 0x80000000U; mask > 0; mask >>= 1)
+  {
+    _add_edge(p_edges, &num, _interval(TICKS_MID(NEC_RX_SYMBOL_TICKS_SILENCE_MIN, NEC_RX_SYMBOL_TICKS_SILENCE_MAX), drift_pct, &seed, jitter));
+    if (code & mask)
+    {
+      _add_edge(p_edges, &num, _interval(TICKS_MID(NEC_RX_SYMBOL_1_TICKS_PULSE_MIN, NEC_RX_SYMBOL_1_TICKS_PULSE_MAX), drift_pct, &seed, jitter));
+    }
+    else
+    {
+      _add_edge(p_edges, &num, _interval(TICKS_MID(NEC_RX_SYMBOL_0_TICKS_PULSE_MIN, NEC_RX_SYMBOL_0_TICKS_PULSE_MAX), drift_pct, &seed, jitter));
+    }
+  }
+  _add_edge(p_edges, &num, _interval(TICKS_MID(NEC_RX_SYMBOL_TICKS_SILENCE_MIN, NEC_RX_SYMBOL_TICKS_SILENCE_MAX), drift_pct, &seed, jitter));
+  return num;
+}
+
+/*Store the intervals between the edges of a frame as the receiver does.*/
+void bench_encode_deltas(const uint16_t *p_edges, uint32_t num_edges, bench_deltas_t *p_deltas)
+{
+  uint16_t num_entries = 0;
+
+  p_deltas->num_deltas = 0;
+  for (uint32_t i = 1; i < num_edges; i++)
+  {
+    if (rx_delta_write(p_deltas->deltas, &num_entries, RX_DELTA_BUFFER_SIZE, (uint16_t)(p_edges[i] - p_edges[i - 1])))
+    {
+      p_deltas->num_deltas++;
+    }
+  }
+}
+
+/*Build and check the frames of the benchmarks.*/
+void bench_app_init(void)
+{
+  _build_edges();
+  _check_edges();
+}
+
+/*One iteration of the main loop of the application, then one millisecond passes.*/
+void bench_main_loop_step(void)
+{
+  fsm_fire(p_fsm_button);
+  fsm_fire(p_fsm_macro);
+  fsm_fire(p_fsm_tx);
+  fsm_fire(p_fsm_rx);
+  fsm_fire(p_fsm_retina);
+  port_system_host_advance_ms(1);
+}
+
+/*Run the main loop for some milliseconds.*/
+void bench_main_loop_run(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; i++)
+  {
+    bench_main_loop_step();
+  }
+}
+
+/*Create the FSMs of the application, as main() does after a reset.*/
+void bench_boot_app(void)
+{
+  port_system_init();
+  p_fsm_button = fsm_button_new(BUTTON_0_DEBOUNCE_TIME_MS, BUTTON_0_ID);
+  p_fsm_tx = fsm_tx_new(IR_TX_0_ID);
+  p_fsm_macro = fsm_macro_new(p_fsm_tx);
+  p_fsm_rx = fsm_rx_new(IR_RX_0_ID);
+  p_fsm_retina = fsm_retina_new(p_fsm_button, CHANGE_MODE_BUTTON_TIME, p_fsm_tx, p_fsm_macro, p_fsm_rx, RGB_0_ID);
+}
+
+/*Create the FSMs of the application after a power-up.*/
+void bench_create_app(void)
+{
+  port_backup_host_power_loss(port_system_get_cycles());
+  bench_boot_app();
+}
+
+/*Hold the button to switch the application to reception mode and check that a frame is executed.*/
+void bench_enter_rx_mode(void)
+{
+  port_button_host_edge(BUTTON_0_ID, true);
+  bench_main_loop_run(CHANGE_MODE_BUTTON_TIME + 100);
+  port_button_host_edge(BUTTON_0_ID, false);
+  bench_main_loop_run(500);
+
+  port_rx_host_edges(IR_RX_0_ID, valid_edges, num_valid_edges);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  if (port_rgb_host_get_color(RGB_0_ID) != 0xFF0000U)
+  {
+    fprintf(stderr, "bench: the application did not execute the received frame\n");
+    exit(EXIT_FAILURE);
+  }
+}
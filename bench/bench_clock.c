@@ -0,0 +1,175 @@
+/**
+ * @file bench_clock.c
+ * @brief Traffic scenarios of the clock governor: the application receives the same representative traffic in simulated time with each policy, and the energy/latency trade-off of each one is reported. They are not compared with the baseline.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+
+/* Other includes */
+#include "bench.h"
+#include "fsm_rx.h"
+#include "fsm_rx_nec.h"
+#include "fsm_retina.h"
+#include "port_system.h"
+#include "port_rx.h"
+#include "energy.h"
+#include "clock_governor.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define SCENARIO_DURATION_MS 60000      /*!< Simulated time of each traffic scenario */
+#define SCENARIO_PRESS_PERIOD_MS 1000   /*!< A button of the remote is pressed every second */
+#define SCENARIO_REPEATS 3              /*!< Repetition codes after every other press, as when a button is held */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Traffic scenario: a policy of the clock governor.
+ */
+typedef struct
+{
+  const char *name; /*!< Name of the scenario */
+  uint8_t policy;   /*!< Policy of the clock governor */
+} bench_scenario_t;
+
+/* Global variables ------------------------------------------------------------*/
+/*List of traffic scenarios.*/
+static const bench_scenario_t scenario_arr[] = {
+    {"clock/always_low", CLOCK_GOVERNOR_ALWAYS_LOW},
+    {"clock/dynamic", CLOCK_GOVERNOR_DYNAMIC},
+    {"clock/always_boost", CLOCK_GOVERNOR_ALWAYS_BOOST},
+};
+
+/* Private functions */
+
+/*Deliver the edges of a frame that started at start_ms whose time has come, as the ISR of the receiver would. Return the index of the next edge.*/
+static uint32_t _deliver_edges(const uint16_t *p_edges, uint32_t num_edges, uint32_t next, uint32_t start_ms)
+{
+  uint32_t elapsed_us = (port_system_get_millis() - start_ms) * 1000U;
+
+  while (next < num_edges)
+  {
+    uint32_t offset_us = 0;
+    for (uint32_t i = 1; i <= next; i++)
+    {
+      offset_us += (uint16_t)(p_edges[i] - p_edges[i - 1]) * NEC_RX_TIMER_TICK_BASE_US;
+    }
+    if (offset_us > elapsed_us)
+    {
+      break;
+    }
+    port_rx_host_edges(IR_RX_0_ID, &p_edges[next], 1);
+    next++;
+  }
+  return next;
+}
+
+/*Receive the traffic of the scenario with a policy and print its consumption, boost residency and switch latency.*/
+static void _run_scenario(const bench_scenario_t *p_scenario, bool last)
+{
+  energy_report_t report;
+  uint32_t start_ms;
+  uint32_t capture_ms = 0;
+  uint32_t capture_boost_ms = 0;
+  uint32_t decodes = 0;
+  uint32_t boosts;
+  uint64_t loop_max_ns = 0;
+  const fsm_rx_decode_stats_t *p_decode_stats;
+  const uint16_t *p_edges = NULL;
+  uint32_t num_edges = 0;
+  uint32_t next_edge = 0;
+  uint32_t frame_ms = 0;
+
+  bench_create_app();
+  bench_enter_rx_mode();
+  fsm_retina_set_clock_policy(p_fsm_retina, p_scenario->policy);
+  start_ms = port_system_get_millis();
+  energy_reset(start_ms);
+
+  while ((port_system_get_millis() - start_ms) < SCENARIO_DURATION_MS)
+  {
+    uint32_t now_ms = port_system_get_millis();
+    uint32_t t_ms = now_ms - start_ms;
+    uint32_t press = t_ms / SCENARIO_PRESS_PERIOD_MS;
+    uint32_t in_press_ms = t_ms % SCENARIO_PRESS_PERIOD_MS;
+
+    /* A frame, alternating codes, followed by repetition codes every other press */
+    if ((in_press_ms == 0) || ((press & 1) && (in_press_ms % NEC_FRAME_PERIOD_MS == 0) && (in_press_ms / NEC_FRAME_PERIOD_MS <= SCENARIO_REPEATS)))
+    {
+      if (in_press_ms == 0)
+      {
+        p_edges = (press & 1) ? valid_edges : other_edges;
+        num_edges = (press & 1) ? num_valid_edges : num_other_edges;
+      }
+      else
+      {
+        p_edges = repeat_edges;
+        num_edges = num_repeat_edges;
+      }
+      next_edge = 0;
+      frame_ms = now_ms;
+    }
+    /* The repetition codes are decoded by the deferred interrupt at their last edge */
+    uint32_t decoded = fsm_rx_get_decode_stats(p_fsm_rx)->num_decoded;
+    if (p_edges != NULL)
+    {
+      next_edge = _deliver_edges(p_edges, num_edges, next_edge, frame_ms);
+    }
+
+    if (fsm_rx_check_frame_in_flight(p_fsm_rx))
+    {
+      capture_ms++;
+      capture_boost_ms += (port_system_clock_get() == PORT_SYSTEM_CLOCK_BOOST);
+    }
+
+    uint64_t loop_start_ns = bench_now_ns();
+    fsm_fire(p_fsm_button);
+    fsm_fire(p_fsm_macro);
+    fsm_fire(p_fsm_tx);
+    fsm_fire(p_fsm_rx);
+    fsm_fire(p_fsm_retina);
+
+    /* The simulated time only advances by itself when the system sleeps. Only the iterations without sleep measure the work of the loop */
+    if (port_system_get_millis() == now_ms)
+    {
+      uint64_t loop_ns = bench_now_ns() - loop_start_ns;
+      loop_max_ns = (loop_ns > loop_max_ns) ? loop_ns : loop_max_ns;
+      port_system_host_advance_ms(1);
+    }
+    /* The other frames are decoded when the simulated time reaches their end */
+    if (fsm_rx_get_decode_stats(p_fsm_rx)->num_decoded != decoded)
+    {
+      decodes++;
+    }
+  }
+
+  energy_get_report(&report, port_system_get_millis());
+  boosts = fsm_retina_get_clock_boosts(p_fsm_retina);
+  /* The lock of the PLL before every boost is shorter than the millisecond of the simulated time, so it is added to the consumption */
+  report.average_ua += (uint32_t)((uint64_t)boosts * PORT_SYSTEM_CLOCK_BOOST_SETTLE_US * ENERGY_CLOCK_BOOST_UA / report.elapsed_us);
+  report.uah_per_day = report.average_ua * 24U;
+  p_decode_stats = fsm_rx_get_decode_stats(p_fsm_rx);
+  printf("    {\"name\": \"%s\", \"average_ua\": %u, \"uah_per_day\": %u, \"boost_pct\": %.2f, \"capture_boost_pct\": %.1f, \"boosts\": %u, \"boost_wait_us\": %u, \"decodes\": %u, \"decode_clock_hz\": %u, \"decode_latency_max_ns\": %u, \"loop_max_ns\": %u}%s\n",
+         p_scenario->name, report.average_ua, report.uah_per_day,
+         100.0 * (double)report.periph_us[ENERGY_PERIPH_CLOCK_BOOST] / (double)report.elapsed_us,
+         capture_ms ? 100.0 * capture_boost_ms / capture_ms : 0.0, boosts, boosts * PORT_SYSTEM_CLOCK_BOOST_SETTLE_US, decodes,
+         port_system_clock_get_hz((p_decode_stats->num_boosted * 2 > p_decode_stats->num_decoded - p_decode_stats->num_fast_repetitions) ? PORT_SYSTEM_CLOCK_BOOST : PORT_SYSTEM_CLOCK_LOW),
+         p_decode_stats->latency_max_cycles, (uint32_t)loop_max_ns, last ? "" : ",");
+}
+
+/* Public functions */
+
+/*Print the traffic scenarios, one per policy of the clock governor.*/
+void bench_clock_report(void)
+{
+  uint32_t num_scenarios = sizeof(scenario_arr) / sizeof(scenario_arr[0]);
+
+  for (uint32_t i = 0; i < num_scenarios; i++)
+  {
+    _run_scenario(&scenario_arr[i], i == num_scenarios - 1);
+  }
+}
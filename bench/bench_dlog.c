@@ -0,0 +1,55 @@
+/**
+ * @file bench_dlog.c
+ * @brief Benchmarks of the deferred log: a message written in the ring against the same message formatted at the call site.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <inttypes.h>
+
+/* Other includes */
+#include "bench.h"
+#include "commands.h"
+#include "port_system.h"
+#include "dlog.h"
+
+/* Private functions */
+
+/*A message of the deferred log with two arguments. The ring is flushed to the simulated debug link when it is half full, as in idle time.*/
+static void run_dlog_write(uint32_t iterations)
+{
+  uint32_t len;
+
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    DLOG("rx frame 0x%08" PRIX32 " after %" PRIu32 " ms", LIL_RED_BUTTON, i);
+    if ((i % (DLOG_RING_SIZE / 2U)) == 0)
+    {
+      dlog_flush();
+      port_system_host_get_debug(PORT_SYSTEM_DEBUG_LOG, &len);
+    }
+  }
+}
+
+/*The same message formatted at the call site, as printf() did before the bytes were written on the link.*/
+static void run_dlog_format(uint32_t iterations)
+{
+  char text[48];
+
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    sink += (uint32_t)snprintf(text, sizeof(text), "rx frame 0x%08" PRIX32 " after %" PRIu32 " ms", LIL_RED_BUTTON, i);
+  }
+}
+
+/*List of benchmarks of the deferred log.*/
+const bench_t bench_dlog_arr[] = {
+    {"dlog/write", NULL, run_dlog_write},
+    {"dlog/format", NULL, run_dlog_format},
+    {NULL, NULL, NULL},
+};
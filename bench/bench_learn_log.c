@@ -0,0 +1,107 @@
+/**
+ * @file bench_learn_log.c
+ * @brief Benchmarks of the learning log: the rebuild of its index at boot and the append of a new code, on a log as full as it gets.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Other includes */
+#include "bench.h"
+#include "learn_log.h"
+#include "port_flash.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define LEARN_RAW_WORDS (2 + (LEARN_LOG_MAX_RAW_EDGES + 1) / 2) /*!< Words of a raw record of the longest frame in the learning log */
+
+/* Global variables ------------------------------------------------------------*/
+static uint32_t learn_code = 0; /*!< Last code appended to the learning log, so that every append is a new code */
+
+/* Private functions */
+
+/*A log as full as it gets before learn_log_idle() compacts it.*/
+static void setup_learn_log_full(void)
+{
+  learn_log_init();
+  learn_log_clear();
+  while (learn_log_get_num_entries() < LEARN_LOG_MAX_ENTRIES * LEARN_LOG_COMPACT_HIGH_PCT / 100)
+  {
+    learn_log_append_code(++learn_code, 0);
+  }
+  learn_log_flush();
+}
+
+/*Rebuild the index of the log from the flash, as the boot does.*/
+static void run_learn_log_rebuild(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    learn_log_init();
+  }
+  sink += learn_log_get_num_entries();
+}
+
+/*Learn a new code: the check for duplicates and the append, with the batches programmed and the compactions of the log amortised.*/
+static void run_learn_log_append(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    sink += learn_log_append_code(++learn_code, 0);
+  }
+}
+
+/* Public functions */
+
+/*Check that the learning log keeps learning once its index and its sector are full, and that the newest records survive a reboot.*/
+void bench_learn_log_check(void)
+{
+  uint16_t deltas[LEARN_LOG_MAX_RAW_EDGES] = {0};
+  uint16_t read[LEARN_LOG_MAX_RAW_EDGES];
+  uint32_t num_raw = 3 * FLASH_LOG_SECTOR_WORDS / LEARN_RAW_WORDS;
+  uint32_t num_entries;
+  bool ok = true;
+
+  learn_log_init();
+  learn_log_clear();
+
+  /* Three times the codes that the index holds */
+  for (uint32_t i = 0; ok && i < 3 * LEARN_LOG_MAX_ENTRIES; i++)
+  {
+    ok = learn_log_append_code(++learn_code, 0);
+  }
+  ok = ok && !learn_log_append_code(learn_code, 0) && (learn_log_get_code(learn_log_get_num_entries() - 1) == learn_code);
+
+  /* Three times the raw frames that the sector holds */
+  for (uint32_t i = 0; ok && i < num_raw; i++)
+  {
+    deltas[0] = (uint16_t)i;
+    ok = learn_log_append_raw(deltas, LEARN_LOG_MAX_RAW_EDGES, 0);
+  }
+
+  learn_log_flush();
+  num_entries = learn_log_get_num_entries();
+  learn_log_init();
+  ok = ok && (learn_log_get_num_entries() == num_entries) && (learn_log_get_num_codes() == 0);
+  ok = ok && (learn_log_get_raw(num_entries - 1, read, LEARN_LOG_MAX_RAW_EDGES) == LEARN_LOG_MAX_RAW_EDGES) && (read[0] == (uint16_t)(num_raw - 1));
+  ok = ok && learn_log_append_code(learn_code, 0) && !learn_log_append_code(learn_code, 0);
+
+  learn_log_clear();
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the learning log stops learning when it is full\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*List of benchmarks of the learning log.*/
+const bench_t bench_learn_log_arr[] = {
+    {"learn_log/rebuild", setup_learn_log_full, run_learn_log_rebuild},
+    {"learn_log/append", setup_learn_log_full, run_learn_log_append},
+    {NULL, NULL, NULL},
+};
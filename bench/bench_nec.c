@@ -0,0 +1,384 @@
+/**
+ * @file bench_nec.c
+ * @brief Benchmarks of the NEC codec: the decoder parsing the intervals of each kind of frame and the encoder driving the transmitters.
+ *
+ * The reports are not compared with the baseline. The drift sweep parses frames of remotes whose clock is off by up to #SWEEP_MAX_DRIFT_PCT with growing jitter, with the fixed and the adaptive windows. The glitch filter replay adds the spikes of ambient lights to the captures of frames, and runs them through the receiver of the host port with and without the filter.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Other includes */
+#include "bench.h"
+#include "fsm_tx.h"
+#include "fsm_rx.h"
+#include "fsm_rx_nec.h"
+#include "commands.h"
+#include "port_system.h"
+#include "port_tx.h"
+#include "port_rx.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define SWEEP_MAX_DRIFT_PCT 15          /*!< Clock error of the remotes of the drift sweep, in percent */
+#define SWEEP_DRIFT_STEP_PCT 5          /*!< Step of the clock error of the drift sweep */
+#define SWEEP_MAX_JITTER_TICKS 20       /*!< Jitter of the intervals of the drift sweep */
+#define SWEEP_JITTER_STEP_TICKS 5       /*!< Step of the jitter of the drift sweep */
+#define SWEEP_FRAMES 256                /*!< Frames parsed at every point of the drift sweep */
+#define GLITCH_FRAMES 64                /*!< Frames replayed with each ambient light and glitch filter */
+#define GLITCH_LEAD_TICKS 500           /*!< Ambient light captured before the first edge of a frame */
+#define GLITCH_MIN_WIDTH_TICKS 2        /*!< Shortest spike of ambient light */
+#define GLITCH_MAX_WIDTH_TICKS 8        /*!< Longest spike of ambient light */
+#define GLITCH_MAX_CAPTURE_EDGES (3 * RX_DELTA_MAX_EDGES) /*!< Edges of a noisy capture, frame and spikes */
+#define GLITCH_PARSE_REPEATS 16         /*!< Parses of each capture timed, to measure the decoding work */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Ambient light that adds spikes to the captures of the receiver.
+ */
+typedef struct
+{
+  const char *name;    /*!< Name of the light source */
+  uint16_t min_period; /*!< Shortest time between spikes in ticks */
+  uint16_t max_period; /*!< Longest time between spikes in ticks */
+} bench_light_t;
+
+/* Global variables ------------------------------------------------------------*/
+/*Codes sent at once by the four transmitters, one of them a repeat code.*/
+static const uint8_t tx4_ids[] = {IR_TX_0_ID, IR_TX_1_ID, IR_TX_2_ID, IR_TX_3_ID};
+static const uint32_t tx4_codes[] = {LIL_RED_BUTTON, LIL_GREEN_BUTTON, LIL_BLUE_BUTTON, 0x00};
+
+/*List of ambient lights of the glitch filter replay.*/
+static const bench_light_t light_arr[] = {
+    {"camera_flash", 7000, 9000},
+    {"incandescent", 3000, 5000},
+    {"fluorescent", 800, 1200},
+    {"sunlight", 200, 600},
+    {"led_driver", 80, 160},
+};
+
+/* Private functions */
+
+static void run_parse_traces(const bench_deltas_t *const *p_traces, uint32_t num_traces, bool filter, uint32_t iterations)
+{
+  fsm_t *p_fsm_nec = fsm_rx_NEC_new();
+  uint32_t code;
+
+  if (filter)
+  {
+    fsm_rx_NEC_set_address_filter(p_fsm_nec, own_addresses, 1, 0xFFFF);
+  }
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    for (uint32_t j = 0; j < num_traces; j++)
+    {
+      sink += fsm_rx_NEC_parse_code(p_fsm_nec, p_traces[j]->deltas, p_traces[j]->num_deltas, &code);
+      sink += code;
+    }
+  }
+  fsm_destroy(p_fsm_nec);
+}
+
+static void run_parse(const bench_deltas_t *p_deltas, uint32_t iterations)
+{
+  run_parse_traces(&p_deltas, 1, false, iterations);
+}
+
+static void run_parse_valid(uint32_t iterations)
+{
+  run_parse(&valid_deltas, iterations);
+}
+
+static void run_parse_repeat(uint32_t iterations)
+{
+  run_parse(&repeat_deltas, iterations);
+}
+
+/*Fast path of the repetition codes, that checks their intervals at once instead of firing the NEC FSM.*/
+static void run_check_repeat(uint32_t iterations)
+{
+  fsm_t *p_fsm_nec = fsm_rx_NEC_new();
+
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    sink += fsm_rx_NEC_check_repetition(p_fsm_nec, repeat_deltas.deltas, repeat_deltas.num_deltas);
+  }
+  fsm_destroy(p_fsm_nec);
+}
+
+static void run_parse_noisy(uint32_t iterations)
+{
+  run_parse(&noisy_deltas, iterations);
+}
+
+static void run_parse_foreign(uint32_t iterations)
+{
+  run_parse(&foreign_deltas, iterations);
+}
+
+static void run_parse_foreign_filtered(uint32_t iterations)
+{
+  const bench_deltas_t *p_deltas = &foreign_deltas;
+  run_parse_traces(&p_deltas, 1, true, iterations);
+}
+
+/*Room with as many frames for other devices as for this one. One operation parses the four frames.*/
+static void run_parse_mixed_traffic(bool filter, uint32_t iterations)
+{
+  const bench_deltas_t *traces[] = {&valid_deltas, &foreign_deltas, &other_deltas, &foreign_deltas};
+  run_parse_traces(traces, 4, filter, iterations);
+}
+
+static void run_parse_mixed(uint32_t iterations)
+{
+  run_parse_mixed_traffic(false, iterations);
+}
+
+static void run_parse_mixed_filtered(uint32_t iterations)
+{
+  run_parse_mixed_traffic(true, iterations);
+}
+
+static void run_parse_truncated(uint32_t iterations)
+{
+  run_parse(&truncated_deltas, iterations);
+}
+
+static void setup_app(void)
+{
+  bench_create_app();
+}
+
+static void run_encode_frame(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    port_tx_host_clear_trace(IR_TX_0_ID);
+    fsm_send_NEC_code(IR_TX_0_ID, LIL_RED_BUTTON);
+  }
+}
+
+static void run_encode_repeat(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    port_tx_host_clear_trace(IR_TX_0_ID);
+    fsm_send_NEC_repeat(IR_TX_0_ID);
+  }
+}
+
+/*Drive the four transmitters and check that concurrent frames take the time of the longest one: each trace is the one of its frame sent alone.*/
+static void setup_app_tx4(void)
+{
+  uint32_t alone_changes[PORT_TX_NUM_TRANSMITTERS];
+  uint32_t alone_ticks[PORT_TX_NUM_TRANSMITTERS];
+  const uint32_t *p_trace;
+  uint32_t num_changes;
+
+  bench_create_app();
+  fsm_tx_set_fanout(p_fsm_tx, (1U << PORT_TX_NUM_TRANSMITTERS) - 1U);
+  for (uint8_t i = 0; i < PORT_TX_NUM_TRANSMITTERS; i++)
+  {
+    port_tx_host_clear_trace(tx4_ids[i]);
+    fsm_send_NEC_codes(&tx4_ids[i], &tx4_codes[i], 1);
+    p_trace = port_tx_host_get_trace(tx4_ids[i], &alone_changes[i]);
+    alone_ticks[i] = p_trace[alone_changes[i] - 1];
+    port_tx_host_clear_trace(tx4_ids[i]);
+  }
+  fsm_send_NEC_codes(tx4_ids, tx4_codes, PORT_TX_NUM_TRANSMITTERS);
+  for (uint8_t i = 0; i < PORT_TX_NUM_TRANSMITTERS; i++)
+  {
+    p_trace = port_tx_host_get_trace(tx4_ids[i], &num_changes);
+    if (num_changes != alone_changes[i] || p_trace[num_changes - 1] != alone_ticks[i])
+    {
+      fprintf(stderr, "bench: the concurrent frames do not keep the timing of the frames sent alone\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/*The same frame on the four transmitters, switched by one schedule.*/
+static void run_encode_fanout4(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    for (uint8_t j = 0; j < PORT_TX_NUM_TRANSMITTERS; j++)
+    {
+      port_tx_host_clear_trace(tx4_ids[j]);
+    }
+    fsm_send_NEC_code_fanout((1U << PORT_TX_NUM_TRANSMITTERS) - 1U, LIL_RED_BUTTON);
+  }
+}
+
+/*A different frame on each of the four transmitters, with independent schedules.*/
+static void run_encode_concurrent4(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    for (uint8_t j = 0; j < PORT_TX_NUM_TRANSMITTERS; j++)
+    {
+      port_tx_host_clear_trace(tx4_ids[j]);
+    }
+    fsm_send_NEC_codes(tx4_ids, tx4_codes, PORT_TX_NUM_TRANSMITTERS);
+  }
+}
+
+/*Parse frames of two remotes whose clock is off by some percent, with jitter, and print the percentage of them decoded with the fixed and the adaptive windows.*/
+static void _run_drift_point(int32_t drift_pct, int32_t jitter, bool last)
+{
+  static const uint32_t address_arr[] = {0x00FF0000U, 0x20DF0000U}; /* Address fields of the remotes, in the position of the code */
+  fsm_t *p_fsm_fixed = fsm_rx_NEC_new();
+  fsm_t *p_fsm_adaptive = fsm_rx_NEC_new();
+  uint16_t edges[RX_DELTA_MAX_EDGES];
+  bench_deltas_t deltas;
+  uint32_t seed = (uint32_t)(drift_pct * 1000 + jitter);
+  uint32_t decoded_fixed = 0;
+  uint32_t decoded_adaptive = 0;
+
+  fsm_rx_NEC_set_adaptive(p_fsm_fixed, false);
+  for (uint32_t i = 0; i < SWEEP_FRAMES; i++)
+  {
+    uint8_t command = (uint8_t)(bench_jitter(&seed, 127) + 128);
+    uint32_t code = address_arr[i % 2] | ((uint32_t)command << 8) | (uint8_t)~command;
+    uint32_t decoded;
+
+    bench_encode_deltas(edges, bench_build_nec_frame(edges, code, (uint16_t)seed, drift_pct, jitter), &deltas);
+    decoded_fixed += !fsm_rx_NEC_parse_code(p_fsm_fixed, deltas.deltas, deltas.num_deltas, &decoded) && (decoded == code);
+    decoded_adaptive += !fsm_rx_NEC_parse_code(p_fsm_adaptive, deltas.deltas, deltas.num_deltas, &decoded) && (decoded == code);
+  }
+  printf("    {\"drift_pct\": %d, \"jitter_us\": %d, \"frames\": %u, \"fixed_pct\": %.1f, \"adaptive_pct\": %.1f}%s\n",
+         drift_pct, jitter * NEC_RX_TIMER_TICK_BASE_US, SWEEP_FRAMES, 100.0 * decoded_fixed / SWEEP_FRAMES,
+         100.0 * decoded_adaptive / SWEEP_FRAMES, last ? "" : ",");
+  fsm_destroy(p_fsm_fixed);
+  fsm_destroy(p_fsm_adaptive);
+}
+
+/*Build the capture of a NEC frame under some ambient light: spikes are added between its edges, as a receiver sees them. The spikes that would cross an edge of the frame are left out.*/
+static uint32_t _build_noisy_capture(uint16_t *p_capture, uint32_t code, const bench_light_t *p_light, uint32_t *p_seed)
+{
+  uint16_t frame[RX_DELTA_MAX_EDGES];
+  uint32_t num_frame = bench_build_nec_frame(frame, code, GLITCH_LEAD_TICKS, 0, 4);
+  uint32_t num = 0;
+  uint32_t spike = (uint32_t)(bench_jitter(p_seed, GLITCH_LEAD_TICKS / 2) + GLITCH_LEAD_TICKS / 2);
+  uint32_t i = 0;
+
+  while (i < num_frame && num + 2 <= GLITCH_MAX_CAPTURE_EDGES)
+  {
+    uint32_t width = (uint32_t)(bench_jitter(p_seed, (GLITCH_MAX_WIDTH_TICKS - GLITCH_MIN_WIDTH_TICKS) / 2) + (GLITCH_MAX_WIDTH_TICKS + GLITCH_MIN_WIDTH_TICKS) / 2);
+
+    if (frame[i] <= spike)
+    {
+      p_capture[num++] = frame[i++];
+      continue;
+    }
+    if (spike + width < frame[i])
+    {
+      p_capture[num++] = (uint16_t)spike;
+      p_capture[num++] = (uint16_t)(spike + width);
+    }
+    spike += (uint32_t)(bench_jitter(p_seed, (p_light->max_period - p_light->min_period) / 2) + (p_light->max_period + p_light->min_period) / 2);
+  }
+  return num;
+}
+
+/*Replay noisy captures through the receiver of the host port with a glitch filter and print the edges stored, the edges dropped, the frames decoded and the time to parse a capture.*/
+static void _run_glitch_point(const bench_light_t *p_light, uint32_t min_pulse_us, bool last)
+{
+  uint16_t capture[GLITCH_MAX_CAPTURE_EDGES];
+  uint32_t seed = p_light->min_period;
+  uint32_t captured = 0;
+  uint32_t stored = 0;
+  uint32_t decoded = 0;
+  uint64_t parse_ns = 0;
+  fsm_t *p_fsm_nec = fsm_rx_NEC_new();
+  fsm_t *p_fsm_glitch_rx;
+  fsm_rx_frame_t frame;
+
+  port_system_init();
+  p_fsm_glitch_rx = fsm_rx_new(IR_RX_0_ID);
+  fsm_rx_set_glitch_filter(p_fsm_glitch_rx, min_pulse_us);
+  fsm_fire(p_fsm_glitch_rx);
+  for (uint32_t i = 0; i < GLITCH_FRAMES; i++)
+  {
+    uint32_t code = (i & 1) ? LIL_RED_BUTTON : LIL_GREEN_BUTTON;
+    uint32_t num_capture = _build_noisy_capture(capture, code, p_light, &seed);
+    uint32_t num_edges;
+    uint32_t parsed;
+    uint64_t start_ns;
+
+    port_rx_host_edges(IR_RX_0_ID, capture, num_capture);
+    captured += num_capture;
+    num_edges = port_rx_get_num_edges(IR_RX_0_ID);
+    stored += num_edges;
+    start_ns = bench_now_ns();
+    for (uint32_t j = 0; j < GLITCH_PARSE_REPEATS; j++)
+    {
+      fsm_rx_NEC_parse_code(p_fsm_nec, port_rx_get_buffer_deltas(IR_RX_0_ID), (num_edges > 0) ? num_edges - 1 : 0, &parsed);
+    }
+    parse_ns += bench_now_ns() - start_ns;
+
+    for (uint32_t k = 0; k < RX_FRAME_STEPS_MS; k++)
+    {
+      fsm_fire(p_fsm_glitch_rx);
+      port_system_host_advance_ms(1);
+    }
+    while (fsm_rx_pop_frame(p_fsm_glitch_rx, &frame))
+    {
+      decoded += (frame.code == code);
+    }
+  }
+  printf("    {\"light\": \"%s\", \"filter_us\": %u, \"frames\": %u, \"captured_per_frame\": %.1f, \"stored_per_frame\": %.1f, \"glitches_per_frame\": %.1f, \"decoded_pct\": %.1f, \"parse_ns\": %u}%s\n",
+         p_light->name, min_pulse_us, GLITCH_FRAMES, (double)captured / GLITCH_FRAMES, (double)stored / GLITCH_FRAMES,
+         (double)fsm_rx_get_num_glitches(p_fsm_glitch_rx) / GLITCH_FRAMES, 100.0 * decoded / GLITCH_FRAMES,
+         (uint32_t)(parse_ns / (GLITCH_FRAMES * GLITCH_PARSE_REPEATS)), last ? "" : ",");
+  fsm_destroy(p_fsm_nec);
+}
+
+/* Public functions */
+
+/*Print the drift sweep, by jitter and by clock error of the remotes.*/
+void bench_nec_report_drift(void)
+{
+  for (int32_t jitter = 0; jitter <= SWEEP_MAX_JITTER_TICKS; jitter += SWEEP_JITTER_STEP_TICKS)
+  {
+    for (int32_t drift_pct = -SWEEP_MAX_DRIFT_PCT; drift_pct <= SWEEP_MAX_DRIFT_PCT; drift_pct += SWEEP_DRIFT_STEP_PCT)
+    {
+      _run_drift_point(drift_pct, jitter, (jitter == SWEEP_MAX_JITTER_TICKS) && (drift_pct == SWEEP_MAX_DRIFT_PCT));
+    }
+  }
+}
+
+/*Print the glitch filter replay, by ambient light, without and with the filter.*/
+void bench_nec_report_glitch(void)
+{
+  uint32_t num_lights = sizeof(light_arr) / sizeof(light_arr[0]);
+
+  for (uint32_t i = 0; i < num_lights; i++)
+  {
+    _run_glitch_point(&light_arr[i], 0, false);
+    _run_glitch_point(&light_arr[i], NEC_RX_GLITCH_MIN_PULSE_US, i == num_lights - 1);
+  }
+}
+
+/*List of benchmarks of the NEC codec.*/
+const bench_t bench_nec_arr[] = {
+    {"nec_parse/valid", NULL, run_parse_valid},
+    {"nec_parse/repeat", NULL, run_parse_repeat},
+    {"nec_parse/repeat_fast", NULL, run_check_repeat},
+    {"nec_parse/noisy", NULL, run_parse_noisy},
+    {"nec_parse/truncated", NULL, run_parse_truncated},
+    {"nec_parse/foreign", NULL, run_parse_foreign},
+    {"nec_parse/foreign_filtered", NULL, run_parse_foreign_filtered},
+    {"nec_parse/mixed", NULL, run_parse_mixed},
+    {"nec_parse/mixed_filtered", NULL, run_parse_mixed_filtered},
+    {"nec_encode/frame", setup_app, run_encode_frame},
+    {"nec_encode/repeat", setup_app, run_encode_repeat},
+    {"nec_encode/fanout4", setup_app_tx4, run_encode_fanout4},
+    {"nec_encode/concurrent4", setup_app_tx4, run_encode_concurrent4},
+    {NULL, NULL, NULL},
+};
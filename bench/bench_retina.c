@@ -0,0 +1,347 @@
+/**
+ * @file bench_retina.c
+ * @brief Benchmarks of the application: the FSMs fired while idle and the frames received from their edges to the colour of the RGB LED.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Other includes */
+#include "bench.h"
+#include "fsm_rx.h"
+#include "fsm_retina.h"
+#include "fsm_macro.h"
+#include "fsm_tx.h"
+#include "commands.h"
+#include "port_system.h"
+#include "port_rx.h"
+#include "port_rgb.h"
+#include "port_button.h"
+#include "port_tx.h"
+#include "telemetry.h"
+
+/* Private functions */
+
+static void setup_app(void)
+{
+  bench_create_app();
+}
+
+static void setup_app_rx(void)
+{
+  bench_create_app();
+  bench_enter_rx_mode();
+}
+
+static void run_fire_button(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    fsm_fire(p_fsm_button);
+  }
+}
+
+static void run_fire_tx(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    fsm_fire(p_fsm_tx);
+  }
+}
+
+static void run_fire_macro(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    fsm_fire(p_fsm_macro);
+  }
+}
+
+static void run_fire_rx(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    fsm_fire(p_fsm_rx);
+  }
+}
+
+static void run_fire_retina(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    fsm_fire(p_fsm_retina);
+  }
+}
+
+static void run_main_loop_idle(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    bench_main_loop_step();
+  }
+}
+
+static void run_rx_frame_to_rgb(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    if (i & 1)
+    {
+      port_rx_host_edges(IR_RX_0_ID, valid_edges, num_valid_edges);
+    }
+    else
+    {
+      port_rx_host_edges(IR_RX_0_ID, other_edges, num_other_edges);
+    }
+    bench_main_loop_run(RX_FRAME_STEPS_MS);
+  }
+}
+
+/*Hold the button of the frame executed, so that the repetition codes repeat it, and check that the first one is recognised at its last edge and executed.*/
+static void setup_app_rx_repeat(void)
+{
+  const fsm_rx_frame_t *p_frame;
+
+  bench_create_app();
+  bench_enter_rx_mode();
+  port_rx_host_edges(IR_RX_0_ID, repeat_edges, num_repeat_edges);
+  p_frame = fsm_rx_peek_frame(p_fsm_rx);
+  if (p_frame == NULL || !p_frame->is_repetition || p_frame->code != LIL_RED_BUTTON || p_frame->repeats != 1)
+  {
+    fprintf(stderr, "bench: the repetition code was not recognised at its last edge\n");
+    exit(EXIT_FAILURE);
+  }
+  bench_main_loop_run(RX_REPEAT_STEPS_MS);
+  if (fsm_rx_get_num_frames(p_fsm_rx) != 0)
+  {
+    fprintf(stderr, "bench: the application did not execute the repetition code\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Same, but the repetition codes are decoded at the end of the frame, as any other frame.*/
+static void setup_app_rx_repeat_at_gap(void)
+{
+  setup_app_rx_repeat();
+  port_rx_set_edge_notify(IR_RX_0_ID, 0);
+}
+
+/*One repetition code of a held button, from its edges to its execution.*/
+static void run_rx_repeat_to_rgb(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    port_rx_host_edges(IR_RX_0_ID, repeat_edges, num_repeat_edges);
+    bench_main_loop_run(RX_REPEAT_STEPS_MS);
+  }
+}
+
+static void run_rx_repeat_at_gap(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    port_rx_host_edges(IR_RX_0_ID, repeat_edges, num_repeat_edges);
+    bench_main_loop_run(RX_FRAME_STEPS_MS);
+  }
+}
+
+/*Receive a burst of frames while the application is busy, so that they wait in the FIFO of the receiver, then execute them all.*/
+static void run_rx_burst_to_rgb(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    for (uint32_t j = 0; j < FSM_RX_FIFO_SIZE; j++)
+    {
+      port_rx_host_edges(IR_RX_0_ID, (j & 1) ? valid_edges : other_edges, (j & 1) ? num_valid_edges : num_other_edges);
+      for (uint32_t k = 0; k < RX_FRAME_STEPS_MS; k++)
+      {
+        fsm_fire(p_fsm_rx);
+        port_system_host_advance_ms(1);
+      }
+    }
+    /* One iteration wakes the application up, then it executes a frame per iteration */
+    bench_main_loop_run(FSM_RX_FIFO_SIZE + 1);
+    if (fsm_rx_get_num_frames(p_fsm_rx) != 0 || fsm_rx_get_num_dropped(p_fsm_rx) != 0 || port_rgb_host_get_color(RGB_0_ID) != 0xFF0000U)
+    {
+      fprintf(stderr, "bench: a burst of frames was not executed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/* Public functions */
+
+/*Check that a reset restores the reception mode and the colour of the RGB LED, and that a power-up does not.*/
+void bench_retina_check(void)
+{
+  bool ok;
+
+  bench_create_app();
+  bench_enter_rx_mode();
+  bench_boot_app();
+  ok = (port_rgb_host_get_color(RGB_0_ID) == 0xFF0000U);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  port_rx_host_edges(IR_RX_0_ID, other_edges, num_other_edges);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  ok = ok && (port_rgb_host_get_color(RGB_0_ID) == 0x00FF00U);
+
+  bench_create_app();
+  ok = ok && (port_rgb_host_get_color(RGB_0_ID) == 0) && (fsm_retina_get_restore_us(p_fsm_retina) == 0);
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the state of the application is not restored after a reset\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Number of frames whose first edge woke the system up from any low-power mode, counted from the telemetry counter of the first mode.*/
+static uint32_t _wake_frames(uint8_t first_counter)
+{
+  uint32_t frames = 0;
+
+  for (uint8_t i = 0; i < PORT_SYSTEM_SLEEP_MODES; i++)
+  {
+    frames += telemetry_counters_arr[first_counter + i];
+  }
+  return frames;
+}
+
+/*Check that a frame that wakes the receiver up is decoded and accounted to the low-power mode it woke it up from, and that the frames received awake, after another frame or after a wake-up by the button, are not.*/
+void bench_wake_frame_check(void)
+{
+  uint32_t frames_ok;
+  uint32_t frames_err;
+  bool ok;
+
+  bench_create_app();
+  bench_enter_rx_mode();
+  bench_main_loop_run(1000);
+  frames_ok = _wake_frames(TELEMETRY_WAKE_FRAME_OK_WFI);
+  frames_err = _wake_frames(TELEMETRY_WAKE_FRAME_ERR_WFI);
+  port_rx_host_edges(IR_RX_0_ID, other_edges, num_other_edges);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  ok = (_wake_frames(TELEMETRY_WAKE_FRAME_OK_WFI) == frames_ok + 1);
+  port_rx_host_edges(IR_RX_0_ID, valid_edges, num_valid_edges);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  ok = ok && (_wake_frames(TELEMETRY_WAKE_FRAME_OK_WFI) == frames_ok + 1) && (port_rgb_host_get_color(RGB_0_ID) == 0xFF0000U);
+
+  /* A frame that starts after a wake-up by the button. The edges given to the receiver end at the current time */
+  bench_main_loop_run(1000);
+  port_button_host_edge(BUTTON_0_ID, true);
+  bench_main_loop_run(100);
+  port_rx_host_edges(IR_RX_0_ID, other_edges, num_other_edges);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  port_button_host_edge(BUTTON_0_ID, false);
+  bench_main_loop_run(100);
+  ok = ok && (_wake_frames(TELEMETRY_WAKE_FRAME_OK_WFI) == frames_ok + 1) && (_wake_frames(TELEMETRY_WAKE_FRAME_ERR_WFI) == frames_err) && (port_rgb_host_get_color(RGB_0_ID) == 0x00FF00U);
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the frames that wake the receiver up are not accounted to the low-power mode\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Check that a macro played while another one is being played replaces it: the new macro is still active after the old one has been dropped, and its frame is the one of its code sent alone.*/
+void bench_macro_check(void)
+{
+  static const macro_step_t macro_a[] = {{LIL_RED_BUTTON, 500, MACRO_PROTOCOL_NEC, 0}, {LIL_GREEN_BUTTON, 500, MACRO_PROTOCOL_NEC, 0}};
+  static const macro_step_t macro_b[] = {{LIL_BLUE_BUTTON, 0, MACRO_PROTOCOL_NEC, 0}};
+  uint32_t alone_trace[PORT_TX_HOST_TRACE_SIZE];
+  uint32_t alone_changes;
+  const uint32_t *p_trace;
+  uint32_t num_changes;
+  bool ok;
+
+  bench_create_app();
+  port_tx_host_clear_trace(IR_TX_0_ID);
+  fsm_send_NEC_code(IR_TX_0_ID, LIL_BLUE_BUTTON);
+  p_trace = port_tx_host_get_trace(IR_TX_0_ID, &alone_changes);
+  memcpy(alone_trace, p_trace, alone_changes * sizeof(uint32_t));
+
+  bench_create_app();
+  fsm_macro_play(p_fsm_macro, macro_a, 2);
+  bench_main_loop_run(3);
+  port_tx_host_clear_trace(IR_TX_0_ID);
+  fsm_macro_play(p_fsm_macro, macro_b, 1);
+  bench_main_loop_run(2);
+  ok = fsm_macro_check_activity(p_fsm_macro);
+  bench_main_loop_run(2 * NEC_TX_FRAME_PERIOD_MS);
+  p_trace = port_tx_host_get_trace(IR_TX_0_ID, &num_changes);
+  ok = ok && !fsm_macro_check_activity(p_fsm_macro) && (num_changes == alone_changes) && (memcmp(p_trace, alone_trace, num_changes * sizeof(uint32_t)) == 0);
+  if (!ok)
+  {
+    fprintf(stderr, "bench: a macro played while another one is being played does not replace it\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Check that the drift learnt for a remote is kept when the receiver is turned off and on again.*/
+void bench_rx_drift_check(void)
+{
+  uint16_t edges[RX_DELTA_MAX_EDGES];
+  uint32_t num_edges = bench_build_nec_frame(edges, LIL_RED_BUTTON, 1000, 5, 0);
+  uint16_t scale;
+  bool ok;
+
+  bench_create_app();
+  bench_enter_rx_mode();
+  port_rx_host_edges(IR_RX_0_ID, edges, num_edges);
+  bench_main_loop_run(RX_FRAME_STEPS_MS);
+  scale = fsm_rx_get_drift(p_fsm_rx, NEC_ADDRESS(LIL_RED_BUTTON));
+  ok = (scale != 0);
+  fsm_rx_set_rx_status(p_fsm_rx, false);
+  bench_main_loop_run(10);
+  fsm_rx_set_rx_status(p_fsm_rx, true);
+  bench_main_loop_run(10);
+  ok = ok && (fsm_rx_get_drift(p_fsm_rx, NEC_ADDRESS(LIL_RED_BUTTON)) == scale);
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the drift learnt for a remote is lost when the receiver is turned off\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Check that a frame whose end is flagged while the deferred interrupt is held off, as by an update of the address filter, is decoded once it is no longer.*/
+void bench_deferred_mask_check(void)
+{
+  uint32_t decoded;
+  uint32_t deferred;
+  bool ok;
+
+  bench_create_app();
+  bench_enter_rx_mode();
+  decoded = fsm_rx_get_decode_stats(p_fsm_rx)->num_decoded;
+  deferred = port_system_deferred_mask();
+  port_rx_host_edges(IR_RX_0_ID, valid_edges, num_valid_edges);
+  port_system_host_advance_ms(RX_FRAME_STEPS_MS);
+  ok = (fsm_rx_get_decode_stats(p_fsm_rx)->num_decoded == decoded);
+  port_system_deferred_unmask(deferred);
+  ok = ok && (fsm_rx_get_decode_stats(p_fsm_rx)->num_decoded == decoded + 1);
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the deferred interrupt is not held off, or its request is lost\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*List of benchmarks of the application.*/
+const bench_t bench_retina_arr[] = {
+    {"fsm_fire/button_idle", setup_app, run_fire_button},
+    {"fsm_fire/tx_idle", setup_app, run_fire_tx},
+    {"fsm_fire/macro_idle", setup_app, run_fire_macro},
+    {"fsm_fire/rx_idle", setup_app_rx, run_fire_rx},
+    {"fsm_fire/retina_sleep", setup_app_rx, run_fire_retina},
+    {"retina/main_loop_idle", setup_app_rx, run_main_loop_idle},
+    {"retina/rx_frame_to_rgb", setup_app_rx, run_rx_frame_to_rgb},
+    {"retina/rx_burst_to_rgb", setup_app_rx, run_rx_burst_to_rgb},
+    {"retina/rx_repeat_to_rgb", setup_app_rx_repeat, run_rx_repeat_to_rgb},
+    {"retina/rx_repeat_at_gap", setup_app_rx_repeat_at_gap, run_rx_repeat_at_gap},
+    {NULL, NULL, NULL},
+};
@@ -0,0 +1,161 @@
+/**
+ * @file bench_strip.c
+ * @brief Benchmarks of the LED strip: the encoder of the WS2812 stream and a frame of an effect, on the longest strip.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Other includes */
+#include "bench.h"
+#include "commands.h"
+#include "port_system.h"
+#include "port_rgb.h"
+#include "ws2812.h"
+#include "fsm_strip.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define STRIP_NUM_PIXELS PORT_RGB_STRIP_MAX_PIXELS /*!< Pixels of the strip of the benchmarks: the longest one, 300 at 60 fps */
+#define STRIP_FRAME_STEP_MS (1000U / FSM_STRIP_FPS + 1U) /*!< Simulated time between two fires of the strip FSM, so that every fire renders a frame */
+
+/* Global variables ------------------------------------------------------------*/
+static ws2812_pixel_t strip_pixels[STRIP_NUM_PIXELS];   /*!< Frame with every level in every channel */
+static uint16_t strip_stream[WS2812_STREAM_HALFWORDS(STRIP_NUM_PIXELS)]; /*!< Stream of the frame */
+static fsm_t *p_fsm_strip;                    /*!< Strip FSM of the benchmarks of the effects */
+
+/* Private functions */
+
+/*Build a frame in which every channel takes every level.*/
+static void _build_strip_pixels(void)
+{
+  for (uint32_t i = 0; i < STRIP_NUM_PIXELS; i++)
+  {
+    strip_pixels[i].r = (uint8_t)i;
+    strip_pixels[i].g = (uint8_t)(255U - i);
+    strip_pixels[i].b = (uint8_t)(i * 37U);
+  }
+}
+
+/*Check the encoder against streams derived by hand, halfword by halfword: one pixel, whose 72 bits end in the middle of a halfword padded with 0, and two pixels, that fill 9 halfwords. The green 0xFF of the first pixel is 110 eight times, its red 0x00 is 100 eight times and its blue 0x0F is 100 four times and 110 four times. The second pixel, red, continues in the lower byte of the fifth halfword. The reset follows at 0, and nothing is written after it.*/
+static void _check_strip_vectors(void)
+{
+  static const ws2812_pixel_t pixels[] = {{.r = 0x00, .g = 0xFF, .b = 0x0F}, {.r = 0xFF, .g = 0x00, .b = 0x00}};
+  static const uint16_t one_pixel[] = {0xDB6D, 0xB692, 0x4924, 0x924D, 0xB600};
+  static const uint16_t two_pixels[] = {0xDB6D, 0xB692, 0x4924, 0x924D, 0xB692, 0x4924, 0xDB6D, 0xB692, 0x4924};
+  static const struct
+  {
+    uint32_t num_pixels;
+    const uint16_t *p_data;
+    uint32_t num_data_halfwords;
+  } vectors[] = {{1, one_pixel, sizeof(one_pixel) / sizeof(one_pixel[0])}, {2, two_pixels, sizeof(two_pixels) / sizeof(two_pixels[0])}};
+  uint16_t stream[WS2812_STREAM_HALFWORDS(2) + 1];
+  bool ok = (WS2812_RESET_HALFWORDS == 38U);
+
+  for (uint32_t i = 0; ok && i < sizeof(vectors) / sizeof(vectors[0]); i++)
+  {
+    uint32_t num_halfwords = vectors[i].num_data_halfwords + WS2812_RESET_HALFWORDS;
+
+    for (uint32_t j = 0; j < sizeof(stream) / sizeof(stream[0]); j++)
+    {
+      stream[j] = 0xA5A5;
+    }
+    ok = (ws2812_encode(pixels, vectors[i].num_pixels, stream) == num_halfwords) && (WS2812_STREAM_HALFWORDS(vectors[i].num_pixels) == num_halfwords);
+    for (uint32_t j = 0; ok && j < num_halfwords; j++)
+    {
+      ok = stream[j] == ((j < vectors[i].num_data_halfwords) ? vectors[i].p_data[j] : 0U);
+    }
+    ok = ok && (stream[num_halfwords] == 0xA5A5);
+  }
+
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the encoder of the LED strip does not give the streams derived by hand\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Check that the streams of the encoder are decoded bit by bit by the strip of the host port into the frames encoded, for a whole and a half number of halfwords per frame.*/
+static void _check_strip(void)
+{
+  static const uint32_t lengths[] = {1, 2, 3, STRIP_NUM_PIXELS - 1, STRIP_NUM_PIXELS};
+  bool ok = true;
+
+  port_system_init();
+  port_rgb_strip_init(RGB_STRIP_0_ID);
+  for (uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+  {
+    uint32_t n = lengths[i];
+    const ws2812_pixel_t *p_pixels = &strip_pixels[STRIP_NUM_PIXELS - n];
+
+    while (port_rgb_strip_is_busy(RGB_STRIP_0_ID))
+    {
+      port_system_host_advance_ms(1);
+    }
+    ok = ok && ws2812_encode(p_pixels, n, port_rgb_strip_get_back_buffer(RGB_STRIP_0_ID)) == WS2812_STREAM_HALFWORDS(n);
+    ok = ok && port_rgb_strip_swap(RGB_STRIP_0_ID, WS2812_STREAM_HALFWORDS(n)) && !port_rgb_strip_swap(RGB_STRIP_0_ID, WS2812_STREAM_HALFWORDS(n));
+    ok = ok && port_rgb_host_check_strip_stream(RGB_STRIP_0_ID) && port_rgb_host_get_strip_num_pixels(RGB_STRIP_0_ID) == n;
+    for (uint32_t j = 0; ok && j < n; j++)
+    {
+      ok = port_rgb_host_get_strip_pixel(RGB_STRIP_0_ID, j) == (((uint32_t)p_pixels[j].r << 16) | ((uint32_t)p_pixels[j].g << 8) | p_pixels[j].b);
+    }
+  }
+
+  if (!ok)
+  {
+    fprintf(stderr, "bench: the LED strip does not decode the frames encoded\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*Encode a frame of the longest strip.*/
+static void run_ws2812_encode(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    sink += ws2812_encode(strip_pixels, STRIP_NUM_PIXELS, strip_stream);
+  }
+}
+
+/*The longest strip runs the chase, triggered by a code of the remote twice after another.*/
+static void setup_strip_chase(void)
+{
+  port_system_init();
+  p_fsm_strip = fsm_strip_new(RGB_STRIP_0_ID, STRIP_NUM_PIXELS);
+  fsm_strip_process_code(p_fsm_strip, LIL_RED_BUTTON);
+  fsm_strip_process_code(p_fsm_strip, LIL_RED_BUTTON);
+  fsm_strip_process_code(p_fsm_strip, LIL_RED_BUTTON);
+}
+
+/*A frame of the chase: render, encode and hand to the DMA of the port. The time passes until the next frame is due.*/
+static void run_strip_chase_frame(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    port_system_host_advance_ms(STRIP_FRAME_STEP_MS);
+    fsm_fire(p_fsm_strip);
+  }
+  sink += fsm_strip_get_num_frames(p_fsm_strip);
+}
+
+/* Public functions */
+
+/*Build the frame of the benchmarks and check that the strip decodes it.*/
+void bench_strip_init(void)
+{
+  _check_strip_vectors();
+  _build_strip_pixels();
+  _check_strip();
+}
+
+/*List of benchmarks of the LED strip.*/
+const bench_t bench_strip_arr[] = {
+    {"strip/encode_300", NULL, run_ws2812_encode},
+    {"strip/chase_frame_300", setup_strip_chase, run_strip_chase_frame},
+    {NULL, NULL, NULL},
+};
@@ -0,0 +1,58 @@
+/**
+ * @file bench_warm_state.c
+ * @brief Benchmarks of the state kept in the backup SRAM: a save on every change and the load of the boot.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Other includes */
+#include "bench.h"
+#include "commands.h"
+#include "warm_state.h"
+
+/* Global variables ------------------------------------------------------------*/
+/*States that differ in the code received, so that each one is written.*/
+static const warm_state_t warm_states[] = {
+    {.rx_code = LIL_RED_BUTTON, .mode = WARM_STATE_MODE_RX},
+    {.rx_code = LIL_GREEN_BUTTON, .mode = WARM_STATE_MODE_RX},
+};
+
+/* Private functions */
+
+/*A code received in reception mode saves the state in the backup SRAM.*/
+static void run_warm_state_save(uint32_t iterations)
+{
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    warm_state_save(&warm_states[i & 1U]);
+  }
+  sink += warm_state_get_num_saves();
+}
+
+/*Both slots of the backup SRAM hold a valid state.*/
+static void setup_warm_state(void)
+{
+  warm_state_save(&warm_states[0]);
+  warm_state_save(&warm_states[1]);
+}
+
+/*Search and check the newest slot of the backup SRAM, as the boot after a reset does.*/
+static void run_warm_state_load(uint32_t iterations)
+{
+  warm_state_t state;
+
+  for (uint32_t i = 0; i < iterations; i++)
+  {
+    sink += warm_state_load(&state);
+  }
+}
+
+/*List of benchmarks of the backup SRAM.*/
+const bench_t bench_warm_state_arr[] = {
+    {"warm_state/save", NULL, run_warm_state_save},
+    {"warm_state/load", setup_warm_state, run_warm_state_load},
+    {NULL, NULL, NULL},
+};
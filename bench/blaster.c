@@ -0,0 +1,186 @@
+/**
+ * @file blaster.c
+ * @brief Stand-in of the infrared blaster on the host port (`make blaster`): the bridge FSM of `fsm_bridge.h` served on a pseudo-terminal, so that a host program is developed and checked without the board.
+ *
+ * The FSMs are fired as in the main loop of the application: bridge, macro, transmitter and receiver. What the transmitters emit is looped back to the receiver, as by `loopback.c` with an ideal channel: the PWM changes of the first transmitter that sent a frame are turned into the edges of the receiver. The frames decoded are streamed to the host by the bridge. The simulated time follows the wall time of the host one millisecond at a time, so that the frame period of the transmitter and the gaps of the receiver keep their real length on the link.
+ *
+ * The path of the pseudo-terminal is printed on the first line of the standard output, and linked from `-L path` if given. The program runs until it gets SIGINT or SIGTERM.
+ *
+ * Usage: `blaster [-L path]`
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+
+/* Other includes */
+#include "fsm.h"
+#include "fsm_tx.h"
+#include "fsm_rx.h"
+#include "fsm_rx_nec.h"
+#include "fsm_macro.h"
+#include "fsm_bridge.h"
+#include "port_system.h"
+#include "port_tx.h"
+#include "port_rx.h"
+#include "port_uart.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define BLASTER_POLL_MS 1           /*!< Time waited for the host when the simulated time has caught up with the wall time */
+#define NS_PER_MS 1000000ULL        /*!< Nanoseconds in a millisecond */
+
+/* Global variables ------------------------------------------------------------*/
+static volatile sig_atomic_t stop = 0; /*!< Flag to indicate that the program has been asked to end */
+static const uint8_t tx_ids[PORT_TX_NUM_TRANSMITTERS] = {IR_TX_0_ID, IR_TX_1_ID, IR_TX_2_ID, IR_TX_3_ID}; /*!< Transmitters of the masks of the host */
+
+/* Private functions -----------------------------------------------------------*/
+
+/*Monotonic time of the host in milliseconds.*/
+static uint64_t _now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) / NS_PER_MS;
+}
+
+/*Ask the main loop to end.*/
+static void _on_signal(int signum)
+{
+  stop = 1;
+}
+
+/*Turn the frame sent by the first transmitter that sent one into the edges of the receiver. The frames of the others are the same, and would collide on a single receiver.*/
+static void _loop_back(void)
+{
+  uint16_t edges[PORT_TX_HOST_TRACE_SIZE];
+  bool sent = false;
+
+  for (uint8_t i = 0; i < PORT_TX_NUM_TRANSMITTERS; i++)
+  {
+    uint32_t num_changes;
+    const uint32_t *p_trace = port_tx_host_get_trace(tx_ids[i], &num_changes);
+
+    if (num_changes > 0 && !sent)
+    {
+      for (uint32_t j = 0; j < num_changes; j++)
+      {
+        edges[j] = (uint16_t)((uint64_t)p_trace[j] * NEC_TX_TIMER_TICK_BASE_NS / NEC_RX_TIMER_TICK_BASE_NS);
+      }
+      port_rx_host_edges(IR_RX_0_ID, edges, num_changes);
+      sent = true;
+    }
+    port_tx_host_clear_trace(tx_ids[i]);
+  }
+}
+
+/*Fire the FSMs once, as a pass of the main loop of the application.*/
+static void _run_pass(fsm_t *p_fsm_bridge, fsm_t *p_fsm_macro, fsm_t *p_fsm_tx, fsm_t *p_fsm_rx)
+{
+  fsm_rx_frame_t frame;
+
+  fsm_fire(p_fsm_bridge);
+  fsm_fire(p_fsm_macro);
+  fsm_fire(p_fsm_tx);
+  _loop_back();
+  fsm_fire(p_fsm_rx);
+  while (fsm_rx_pop_frame(p_fsm_rx, &frame))
+  {
+    fsm_bridge_send_frame(p_fsm_bridge, &frame);
+  }
+}
+
+/*Print the usage of the program and exit.*/
+static void _usage(const char *p_name)
+{
+  fprintf(stderr, "usage: %s [-L path]\n", p_name);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Serve the bridge on a pseudo-terminal until SIGINT or SIGTERM.
+ *
+ * @return `EXIT_FAILURE` if the pseudo-terminal could not be opened
+ */
+int main(int argc, char *argv[])
+{
+  const char *p_link = NULL;
+  fsm_t *p_fsm_tx, *p_fsm_macro, *p_fsm_rx, *p_fsm_bridge;
+  uint64_t start_ms;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "L:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'L':
+      p_link = optarg;
+      break;
+    default:
+      _usage(argv[0]);
+    }
+  }
+
+  port_system_init();
+  p_fsm_tx = fsm_tx_new(IR_TX_0_ID);
+  p_fsm_macro = fsm_macro_new(p_fsm_tx);
+  p_fsm_rx = fsm_rx_new(IR_RX_0_ID);
+  fsm_rx_set_rx_status(p_fsm_rx, true);
+  p_fsm_bridge = fsm_bridge_new(UART_0_ID, p_fsm_tx, p_fsm_macro);
+  if (port_uart_host_get_fd(UART_0_ID) < 0)
+  {
+    perror("blaster");
+    return EXIT_FAILURE;
+  }
+  if (p_link != NULL)
+  {
+    unlink(p_link);
+    if (symlink(port_uart_host_get_name(UART_0_ID), p_link) != 0)
+    {
+      perror("blaster");
+      return EXIT_FAILURE;
+    }
+  }
+  printf("%s\n", port_uart_host_get_name(UART_0_ID));
+  fflush(stdout);
+
+  signal(SIGINT, _on_signal);
+  signal(SIGTERM, _on_signal);
+
+  start_ms = _now_ms();
+  while (!stop)
+  {
+    uint64_t wall_ms = _now_ms() - start_ms;
+
+    _run_pass(p_fsm_bridge, p_fsm_macro, p_fsm_tx, p_fsm_rx);
+    if (port_system_get_millis() < wall_ms)
+    {
+      port_system_host_advance_ms(1);
+    }
+    else
+    {
+      struct pollfd pfd = {.fd = port_uart_host_get_fd(UART_0_ID), .events = POLLIN};
+      poll(&pfd, 1, BLASTER_POLL_MS);
+    }
+  }
+
+  if (p_link != NULL)
+  {
+    unlink(p_link);
+  }
+  fsm_destroy(p_fsm_bridge);
+  fsm_destroy(p_fsm_rx);
+  fsm_destroy(p_fsm_macro);
+  fsm_destroy(p_fsm_tx);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,366 @@
+/**
+ * @file loopback.c
+ * @brief Closed-loop check of the NEC codec on the host port (`make loopback`): what the transmitters emit is what the receiver decodes.
+ *
+ * The codes are sent four at a time, one per transmitter, with fsm_send_NEC_codes(). The PWM changes recorded by the host port are turned into the edges of the receiver. The edges are delayed by a random jitter of up to `-j` microseconds, counted by the receiver timer from a start count that makes the 16-bit count wrap (`-o`, random by default) and rounded down to `-q` ticks of #NEC_RX_TIMER_TICK_BASE_US. They are injected with port_rx_host_edges(). Then the gap that ends the frame passes in simulated time, and the frame is decoded by the deferred interrupt and read from the FIFO of fsm_rx, as in the application.
+ *
+ * The codes are a sample of `-n` codes spread over the 32-bit code space by a bijective hash, or the whole space with `-a`. The code 0x00000000 is skipped, as the receiver reports it as an error. The codes are split among `-w` worker processes, one per core by default, each with its own simulated port.
+ *
+ * The result is written to the standard output as JSON: the frames checked per second of wall time, the time spent in the transmitter and in the receiver per frame, and the mismatches, with the first ones found. The program fails if any frame is not decoded as sent.
+ *
+ * Usage: `loopback [-n codes | -a] [-j jitter_us] [-o start_tick] [-q quantum_ticks] [-w workers]`
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+
+/* Other includes */
+#include "fsm.h"
+#include "fsm_tx.h"
+#include "fsm_rx.h"
+#include "fsm_rx_nec.h"
+#include "port_system.h"
+#include "port_tx.h"
+#include "port_rx.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define LOOPBACK_DEFAULT_CODES (1U << 20)  /*!< Codes of the default sample */
+#define LOOPBACK_DEFAULT_JITTER_US 50      /*!< Default jitter of the edges. Each interval moves up to twice as much, within the windows of the receiver */
+#define LOOPBACK_MAX_WORKERS 64            /*!< Maximum number of worker processes */
+#define LOOPBACK_MAX_MISMATCHES 8          /*!< Mismatches reported by each worker */
+#define LOOPBACK_GAP_MS (NEC_RX_END_OF_FRAME_GAP_US / 1000U + 1U) /*!< Simulated time after the last edge of a frame for its end to be flagged */
+#define LOOPBACK_RANDOM_OFFSET UINT32_MAX  /*!< Start count of the receiver timer drawn at random for every frame */
+#define NS_PER_S 1000000000ULL             /*!< Nanoseconds in a second */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Conditions of the channel between the transmitters and the receiver.
+ */
+typedef struct
+{
+  uint32_t jitter_us;     /*!< Maximum delay or advance of each edge */
+  uint32_t offset_ticks;  /*!< Count of the receiver timer at the first edge of a frame, or #LOOPBACK_RANDOM_OFFSET */
+  uint32_t quantum_ticks; /*!< Edges are rounded down to multiples of these ticks of the receiver timer */
+} loopback_channel_t;
+
+/**
+ * @brief A frame not decoded as sent.
+ */
+typedef struct
+{
+  uint32_t sent;     /*!< Code sent */
+  uint32_t received; /*!< Code decoded. 0 for errors */
+  bool lost;         /*!< Flag to indicate that no frame was decoded */
+} loopback_mismatch_t;
+
+/**
+ * @brief Result of a worker, sent to the parent through a pipe.
+ */
+typedef struct
+{
+  uint64_t frames;        /*!< Frames sent and checked */
+  uint64_t skipped;       /*!< Codes not sent */
+  uint64_t mismatches;    /*!< Frames not decoded as sent, lost ones included */
+  uint64_t lost;          /*!< Frames with no record in the FIFO */
+  uint64_t tx_ns;         /*!< Wall time in the transmitters */
+  uint64_t rx_ns;         /*!< Wall time in the receiver, from the edges to the record read */
+  uint32_t num_samples;   /*!< Mismatches in samples */
+  loopback_mismatch_t samples[LOOPBACK_MAX_MISMATCHES]; /*!< First mismatches found */
+} loopback_result_t;
+
+/* Global variables ------------------------------------------------------------*/
+static const uint8_t tx_ids[PORT_TX_NUM_TRANSMITTERS] = {IR_TX_0_ID, IR_TX_1_ID, IR_TX_2_ID, IR_TX_3_ID}; /*!< Transmitters that send the codes at once */
+
+/* Private functions -----------------------------------------------------------*/
+
+/*Monotonic time of the host in nanoseconds.*/
+static uint64_t _now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+/*Pseudo-random number generator (xorshift32).*/
+static uint32_t _rand(uint32_t *p_seed)
+{
+  *p_seed ^= *p_seed << 13;
+  *p_seed ^= *p_seed >> 17;
+  *p_seed ^= *p_seed << 5;
+  return *p_seed;
+}
+
+/*Bijective hash of a 32-bit index (finalizer of MurmurHash3), so that a sample of consecutive indexes is spread over the code space without repeating codes.*/
+static uint32_t _spread(uint32_t index)
+{
+  index ^= index >> 16;
+  index *= 0x85EBCA6BU;
+  index ^= index >> 13;
+  index *= 0xC2B2AE35U;
+  index ^= index >> 16;
+  return index;
+}
+
+/*Turn the PWM changes of a transmitter into the edges seen by the receiver, through the channel.*/
+static uint32_t _trace_to_edges(const uint32_t *p_trace, uint32_t num_changes, uint16_t *p_edges, const loopback_channel_t *p_channel, uint32_t *p_seed)
+{
+  uint16_t start = (p_channel->offset_ticks == LOOPBACK_RANDOM_OFFSET) ? (uint16_t)_rand(p_seed) : (uint16_t)p_channel->offset_ticks;
+  /* The edges are delayed by the maximum jitter, so that the first one can be advanced */
+  int64_t bias_ns = (int64_t)p_channel->jitter_us * 1000;
+
+  for (uint32_t i = 0; i < num_changes; i++)
+  {
+    int64_t jitter_ns = 0;
+    if (p_channel->jitter_us > 0)
+    {
+      jitter_ns = (int64_t)(_rand(p_seed) % (2U * p_channel->jitter_us + 1U)) * 1000 - bias_ns;
+    }
+    uint64_t ticks = (uint64_t)((int64_t)p_trace[i] * NEC_TX_TIMER_TICK_BASE_NS + bias_ns + jitter_ns) / NEC_RX_TIMER_TICK_BASE_NS;
+    ticks -= ticks % p_channel->quantum_ticks;
+    p_edges[i] = (uint16_t)(start + ticks);
+  }
+  return num_changes;
+}
+
+/*Record a frame not decoded as sent.*/
+static void _add_mismatch(loopback_result_t *p_result, uint32_t sent, uint32_t received, bool lost)
+{
+  p_result->mismatches++;
+  p_result->lost += lost;
+  if (p_result->num_samples < LOOPBACK_MAX_MISMATCHES)
+  {
+    p_result->samples[p_result->num_samples++] = (loopback_mismatch_t){.sent = sent, .received = received, .lost = lost};
+  }
+}
+
+/*Send a batch of codes at once and check the frame received from every transmitter.*/
+static void _check_batch(fsm_t *p_fsm_rx, const uint32_t *p_codes, uint8_t num_codes, const loopback_channel_t *p_channel, uint32_t *p_seed, loopback_result_t *p_result)
+{
+  uint16_t edges[PORT_TX_HOST_TRACE_SIZE];
+  uint64_t start_ns = _now_ns();
+
+  for (uint8_t i = 0; i < num_codes; i++)
+  {
+    port_tx_host_clear_trace(tx_ids[i]);
+  }
+  fsm_send_NEC_codes(tx_ids, p_codes, num_codes);
+  p_result->tx_ns += _now_ns() - start_ns;
+
+  start_ns = _now_ns();
+  for (uint8_t i = 0; i < num_codes; i++)
+  {
+    uint32_t num_changes;
+    const uint32_t *p_trace = port_tx_host_get_trace(tx_ids[i], &num_changes);
+    uint32_t num_edges = _trace_to_edges(p_trace, num_changes, edges, p_channel, p_seed);
+    fsm_rx_frame_t frame;
+
+    port_rx_host_edges(IR_RX_0_ID, edges, num_edges);
+    fsm_fire(p_fsm_rx);
+    port_system_host_advance_ms(LOOPBACK_GAP_MS);
+    fsm_fire(p_fsm_rx);
+
+    if (!fsm_rx_pop_frame(p_fsm_rx, &frame))
+    {
+      _add_mismatch(p_result, p_codes[i], 0, true);
+    }
+    else if (frame.is_error || frame.is_repetition || frame.code != p_codes[i])
+    {
+      _add_mismatch(p_result, p_codes[i], frame.code, false);
+    }
+    /* A frame left in the FIFO would be taken for the next one */
+    while (fsm_rx_pop_frame(p_fsm_rx, NULL))
+    {
+    }
+    p_result->frames++;
+  }
+  p_result->rx_ns += _now_ns() - start_ns;
+}
+
+/*Check the codes of the indexes [first, last) in a process of its own.*/
+static void _run_worker(uint64_t first, uint64_t last, bool all, const loopback_channel_t *p_channel, uint32_t seed, loopback_result_t *p_result)
+{
+  uint32_t codes[PORT_TX_NUM_TRANSMITTERS];
+  uint8_t num_codes = 0;
+  fsm_t *p_fsm_rx;
+
+  memset(p_result, 0, sizeof(*p_result));
+  port_system_init();
+  for (uint8_t i = 0; i < PORT_TX_NUM_TRANSMITTERS; i++)
+  {
+    port_tx_init(tx_ids[i], false);
+  }
+  p_fsm_rx = fsm_rx_new(IR_RX_0_ID);
+  fsm_fire(p_fsm_rx);
+
+  for (uint64_t index = first; index < last; index++)
+  {
+    uint32_t code = all ? (uint32_t)index : _spread((uint32_t)index);
+
+    if (code == 0x00)
+    {
+      p_result->skipped++;
+      continue;
+    }
+    codes[num_codes++] = code;
+    if (num_codes == PORT_TX_NUM_TRANSMITTERS)
+    {
+      _check_batch(p_fsm_rx, codes, num_codes, p_channel, &seed, p_result);
+      num_codes = 0;
+    }
+  }
+  if (num_codes > 0)
+  {
+    _check_batch(p_fsm_rx, codes, num_codes, p_channel, &seed, p_result);
+  }
+}
+
+/*Print the usage of the program and exit.*/
+static void _usage(const char *p_name)
+{
+  fprintf(stderr, "usage: %s [-n codes | -a] [-j jitter_us] [-o start_tick] [-q quantum_ticks] [-w workers]\n", p_name);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Check the codes in worker processes and print the merged result.
+ *
+ * @return `EXIT_FAILURE` if any frame was not decoded as sent
+ */
+int main(int argc, char *argv[])
+{
+  loopback_channel_t channel = {.jitter_us = LOOPBACK_DEFAULT_JITTER_US, .offset_ticks = LOOPBACK_RANDOM_OFFSET, .quantum_ticks = 1};
+  uint64_t num_codes = LOOPBACK_DEFAULT_CODES;
+  bool all = false;
+  long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+  pid_t pids[LOOPBACK_MAX_WORKERS];
+  int fds[LOOPBACK_MAX_WORKERS];
+  loopback_result_t total = {0};
+  uint64_t start_ns;
+  double seconds;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:aj:o:q:w:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      num_codes = strtoull(optarg, NULL, 0);
+      break;
+    case 'a':
+      all = true;
+      break;
+    case 'j':
+      channel.jitter_us = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'o':
+      channel.offset_ticks = (uint32_t)strtoul(optarg, NULL, 0) & 0xFFFFU;
+      break;
+    case 'q':
+      channel.quantum_ticks = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      num_workers = strtol(optarg, NULL, 0);
+      break;
+    default:
+      _usage(argv[0]);
+    }
+  }
+  if (all)
+  {
+    num_codes = 1ULL << 32;
+  }
+  if (num_codes == 0 || num_codes > (1ULL << 32) || channel.quantum_ticks == 0)
+  {
+    _usage(argv[0]);
+  }
+  num_workers = (num_workers < 1) ? 1 : (num_workers > LOOPBACK_MAX_WORKERS ? LOOPBACK_MAX_WORKERS : num_workers);
+
+  /* Every worker has its own copy of the simulated port, so they do not share any state */
+  start_ns = _now_ns();
+  for (long w = 0; w < num_workers; w++)
+  {
+    int pipe_fds[2];
+
+    if (pipe(pipe_fds) != 0 || (pids[w] = fork()) < 0)
+    {
+      perror("loopback");
+      return EXIT_FAILURE;
+    }
+    if (pids[w] == 0)
+    {
+      loopback_result_t result;
+      close(pipe_fds[0]);
+      _run_worker(num_codes * (uint64_t)w / (uint64_t)num_workers, num_codes * (uint64_t)(w + 1) / (uint64_t)num_workers, all, &channel, 0x9E3779B9U + (uint32_t)w, &result);
+      _exit(write(pipe_fds[1], &result, sizeof(result)) == (ssize_t)sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(pipe_fds[1]);
+    fds[w] = pipe_fds[0];
+  }
+
+  for (long w = 0; w < num_workers; w++)
+  {
+    loopback_result_t result;
+    int status;
+    bool ok = read(fds[w], &result, sizeof(result)) == (ssize_t)sizeof(result);
+
+    close(fds[w]);
+    waitpid(pids[w], &status, 0);
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "loopback: worker %ld failed\n", w);
+      return EXIT_FAILURE;
+    }
+    total.frames += result.frames;
+    total.skipped += result.skipped;
+    total.mismatches += result.mismatches;
+    total.lost += result.lost;
+    total.tx_ns += result.tx_ns;
+    total.rx_ns += result.rx_ns;
+    for (uint32_t i = 0; i < result.num_samples && total.num_samples < LOOPBACK_MAX_MISMATCHES; i++)
+    {
+      total.samples[total.num_samples++] = result.samples[i];
+    }
+  }
+  seconds = (double)(_now_ns() - start_ns) / NS_PER_S;
+
+  printf("{\n  \"loopback\": {\"codes\": %llu, \"all\": %s, \"workers\": %ld, \"jitter_us\": %u, \"start_tick\": ",
+         (unsigned long long)num_codes, all ? "true" : "false", num_workers, channel.jitter_us);
+  if (channel.offset_ticks == LOOPBACK_RANDOM_OFFSET)
+  {
+    printf("\"random\"");
+  }
+  else
+  {
+    printf("%u", channel.offset_ticks);
+  }
+  printf(", \"quantum_ticks\": %u, \"frames\": %llu, \"skipped\": %llu, \"mismatches\": %llu, \"lost\": %llu, \"seconds\": %.3f, \"frames_per_s\": %.0f, \"tx_ns_per_frame\": %.1f, \"rx_ns_per_frame\": %.1f},\n",
+         channel.quantum_ticks, (unsigned long long)total.frames, (unsigned long long)total.skipped, (unsigned long long)total.mismatches,
+         (unsigned long long)total.lost, seconds, (double)total.frames / seconds,
+         total.frames ? (double)total.tx_ns / total.frames : 0.0, total.frames ? (double)total.rx_ns / total.frames : 0.0);
+  printf("  \"first_mismatches\": [\n");
+  for (uint32_t i = 0; i < total.num_samples; i++)
+  {
+    printf("    {\"sent\": \"0x%08X\", \"received\": \"0x%08X\", \"lost\": %s}%s\n", total.samples[i].sent, total.samples[i].received,
+           total.samples[i].lost ? "true" : "false", (i + 1 < total.num_samples) ? "," : "");
+  }
+  printf("  ]\n}\n");
+
+  if (total.mismatches > 0)
+  {
+    fprintf(stderr, "loopback: %llu of %llu frames were not decoded as sent\n", (unsigned long long)total.mismatches, (unsigned long long)total.frames);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
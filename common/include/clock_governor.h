@@ -0,0 +1,79 @@
+/**
+ * @file clock_governor.h
+ * @brief Header for clock_governor.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef CLOCK_GOVERNOR_H_
+#define CLOCK_GOVERNOR_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "port_system.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define CLOCK_GOVERNOR_DYNAMIC 0       /*!< Policy: boost while frames are modulated and decoded, and drop to the low clock otherwise */
+#define CLOCK_GOVERNOR_ALWAYS_LOW 1    /*!< Policy: never boost */
+#define CLOCK_GOVERNOR_ALWAYS_BOOST 2  /*!< Policy: boost whenever there is activity and never drop. The port still drops to the low clock in STOP mode */
+#define CLOCK_GOVERNOR_HOLD_MS 10      /*!< Idle time in milliseconds before dropping to the low clock, so that the clock does not bounce between close events */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Structure of the clock governor.
+ *
+ * The governor switches the system clock to #PORT_SYSTEM_CLOCK_BOOST while frames are being modulated, and back to #PORT_SYSTEM_CLOCK_LOW after #CLOCK_GOVERNOR_HOLD_MS without activity. The capture of a frame runs at the low clock: only its decoding is boosted, by the deferred interrupt of the receiver, with clock_governor_burst_start() and clock_governor_burst_end(), which may preempt the main loop. The current profile is always read from the port, because the port drops to the low clock by itself before a STOP mode.
+ */
+typedef struct
+{
+  uint8_t policy;          /*!< One of #CLOCK_GOVERNOR_DYNAMIC, #CLOCK_GOVERNOR_ALWAYS_LOW or #CLOCK_GOVERNOR_ALWAYS_BOOST */
+  bool is_idle;            /*!< Flag to indicate that an idle period is in progress */
+  uint32_t idle_start_ms;  /*!< System time when the current idle period started */
+  uint32_t boosts;         /*!< Number of switches to the boost clock */
+  volatile bool burst_boosted; /*!< Flag to indicate that the current burst switched to the boost clock, so it drops it at its end */
+} clock_governor_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize the clock governor and set the clock of the policy while idle.
+ *
+ * @param p_gov Pointer to the governor
+ * @param policy One of #CLOCK_GOVERNOR_DYNAMIC, #CLOCK_GOVERNOR_ALWAYS_LOW or #CLOCK_GOVERNOR_ALWAYS_BOOST
+ */
+void clock_governor_init(clock_governor_t *p_gov, uint8_t policy);
+
+/**
+ * @brief Boost the clock, if the policy allows it, because there is activity in the system.
+ *
+ * @param p_gov Pointer to the governor
+ */
+void clock_governor_busy(clock_governor_t *p_gov);
+
+/**
+ * @brief Drop to the low clock, if the policy allows it and the system has been idle for #CLOCK_GOVERNOR_HOLD_MS. It is called before every sleep.
+ *
+ * @param p_gov Pointer to the governor
+ */
+void clock_governor_idle(clock_governor_t *p_gov);
+
+/**
+ * @brief Boost the clock, if the policy allows it, for a short burst of work in an interrupt, such as the decoding of a frame.
+ *
+ * @param p_gov Pointer to the governor
+ */
+void clock_governor_burst_start(clock_governor_t *p_gov);
+
+/**
+ * @brief End a burst of work: drop to the low clock right away under #CLOCK_GOVERNOR_DYNAMIC if the burst boosted it. A clock already boosted by the main loop is kept.
+ *
+ * @param p_gov Pointer to the governor
+ */
+void clock_governor_burst_end(clock_governor_t *p_gov);
+
+#endif /* CLOCK_GOVERNOR_H_ */
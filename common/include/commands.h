@@ -13,6 +13,7 @@
 /* Defines */
 /* Device: Liluco IR remote */
 /* The Liluco IR remote and receiver work on NEC protocol */
+#define LIL_ADDRESS 0x00F7          /*!< Address field shared by all the commands of the Liluco IR remote */
 #define LIL_ON_BUTTON
 #define LIL_OFF_BUTTON 16203967
 #define LIL_RED_BUTTON 0x00F720DF   /*!< Liluco IR remote command for button RED */
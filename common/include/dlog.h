@@ -0,0 +1,113 @@
+/**
+ * @file dlog.h
+ * @brief Header for dlog.c file.
+ *
+ * Deferred log: a call to DLOG() does not format its message. It records the ID of its format string and its raw arguments in a lock-free ring, from the main loop or from any ISR, in a few tens of cycles. The ring is drained in idle time by dlog_flush() to the channel #PORT_SYSTEM_DEBUG_LOG of the debug link, and the messages are rendered on the host by `tools/dlog.py` from the format strings of the ELF file.
+ *
+ * The format strings are placed in the section `dlog_fmt`, that the linker script of the board does not load in the flash, and the ID of a string is its offset in that section. The arguments are integers of up to 32 bits, at most #DLOG_MAX_ARGS; the formats `%s` and `%f` are not supported. They are checked against the format string at compile time, as those of printf().
+ *
+ * Every record on the link is made of little-endian words: a header (#DLOG_SYNC in the most significant byte, the number of arguments in the next 4 bits and the ID in the 20 least significant bits), the system time in milliseconds and the arguments. The records dropped because the ring was full are reported by a record with the ID #DLOG_ID_DROPPED and their number as argument.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define DLOG_MAX_ARGS 4U            /*!< Maximum number of arguments of a message */
+#define DLOG_RING_SIZE 32U          /*!< Records kept until they are flushed. A power of 2 */
+#define DLOG_SYNC 0xD1U             /*!< Most significant byte of the header of a record */
+#define DLOG_ID_BITS 20U            /*!< Bits of the ID of the format string in the header */
+#define DLOG_ID_DROPPED 0xFFFFFU    /*!< ID of the record of the messages dropped */
+
+/*Header of a record.*/
+#define DLOG_HEADER(id, num_args) ((DLOG_SYNC << 24) | ((uint32_t)(num_args) << DLOG_ID_BITS) | ((uint32_t)(id) & DLOG_ID_DROPPED))
+
+/*Number of arguments of a message. Counted up to 8, so that the messages with too many are rejected at compile time.*/
+#define DLOG_NUM_ARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define DLOG_NUM_ARGS(...) DLOG_NUM_ARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+/*Arguments of a message as 4 words, the missing ones as 0.*/
+#define DLOG_ARGS_(_0, a0, a1, a2, a3, ...) (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3)
+#define DLOG_ARGS(...) DLOG_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0)
+
+/**
+ * @brief Log a message. The format string is kept in the ELF file only, and the message is rendered on the host.
+ *
+ * @param fmt Format string literal, as that of printf()
+ * @param ... Integer arguments, at most #DLOG_MAX_ARGS
+ */
+#define DLOG(fmt, ...)                                                                          \
+  do                                                                                            \
+  {                                                                                             \
+    static const char dlog_fmt_[] __attribute__((section("dlog_fmt"), used)) = fmt;            \
+    _Static_assert(DLOG_NUM_ARGS(__VA_ARGS__) <= DLOG_MAX_ARGS, "Too many arguments for DLOG"); \
+    (void)sizeof(dlog_check_format(fmt, ##__VA_ARGS__), 0);                                     \
+    dlog_write(DLOG_HEADER(dlog_id(dlog_fmt_), DLOG_NUM_ARGS(__VA_ARGS__)), DLOG_ARGS(__VA_ARGS__)); \
+  } while (0)
+
+/* Global variables ------------------------------------------------------------*/
+extern const char __start_dlog_fmt[]; /*!< Start of the section of the format strings, defined by the linker */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Get the ID of a format string: its offset in the section `dlog_fmt`.
+ *
+ * @param p_fmt Pointer to the format string in the section
+ *
+ * @return ID of the format string
+ */
+static inline uint32_t dlog_id(const char *p_fmt)
+{
+  return (uint32_t)(p_fmt - __start_dlog_fmt);
+}
+
+/**
+ * @brief Check the arguments of a message against its format string at compile time. DLOG() only names it in the operand of `sizeof`, so it is never called and the format string is not emitted in flash, whatever the optimization level.
+ *
+ * @param p_fmt Format string
+ */
+static inline __attribute__((format(printf, 1, 2))) void dlog_check_format(const char *p_fmt, ...)
+{
+}
+
+/**
+ * @brief Store a record in the ring. It is safe to call from the main loop and from any ISR, as a slot of the ring is reserved with an atomic compare-and-swap. If the ring is full, the record is dropped and counted.
+ *
+ * @param header Header of the record, as built by DLOG_HEADER()
+ * @param arg0 First argument
+ * @param arg1 Second argument
+ * @param arg2 Third argument
+ * @param arg3 Fourth argument
+ */
+void dlog_write(uint32_t header, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+/**
+ * @brief Send the records of the ring to the debug link, in the order they were stored. To be called from the main loop when the system is idle.
+ */
+void dlog_flush(void);
+
+/**
+ * @brief Check if there are records in the ring.
+ *
+ * @return `true` if there are records to flush
+ */
+bool dlog_check_pending(void);
+
+/**
+ * @brief Return the number of records dropped because the ring was full, since the system started.
+ *
+ * @return Number of records dropped
+ */
+uint32_t dlog_get_num_dropped(void);
+
+#endif /* DLOG_H_ */
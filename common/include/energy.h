@@ -0,0 +1,140 @@
+/**
+ * @file energy.h
+ * @brief Header for energy.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Enums */
+/**
+ * @brief Power states of the system. The low-power states follow the order of the `PORT_SYSTEM_SLEEP_*` modes of the port.
+ */
+enum ENERGY_STATE
+{
+  ENERGY_STATE_WFI = 0,   /*!< Core stopped, clocks running */
+  ENERGY_STATE_STOP_FAST, /*!< STOP mode with the main regulator on */
+  ENERGY_STATE_STOP,      /*!< STOP mode with the regulator in low-power mode */
+  ENERGY_STATE_RUN,       /*!< Core running. Its residency is the time not spent in the other states */
+  ENERGY_STATES           /*!< Number of power states */
+};
+
+/**
+ * @brief Peripherals whose consumption is accounted while they are active.
+ */
+enum ENERGY_PERIPH
+{
+  ENERGY_PERIPH_TX_PWM = 0, /*!< Infrared LED modulated by the PWM */
+  ENERGY_PERIPH_RGB_R,      /*!< Red LED of the RGB */
+  ENERGY_PERIPH_RGB_G,      /*!< Green LED of the RGB */
+  ENERGY_PERIPH_RGB_B,      /*!< Blue LED of the RGB */
+  ENERGY_PERIPH_CLOCK_BOOST, /*!< Core and buses clocked by the PLL at full speed instead of the HSI */
+  ENERGY_PERIPHS            /*!< Number of peripherals */
+};
+
+/* Defines */
+/* Typical currents of the STM32F446RE at 16 MHz (HSI) and of the LEDs of the board. They must be calibrated for each board */
+#define ENERGY_RUN_UA 4000        /*!< Current in run mode in microamperes */
+#define ENERGY_WFI_UA 1500        /*!< Current in sleep mode (WFI) in microamperes */
+#define ENERGY_STOP_FAST_UA 300   /*!< Current in STOP mode with the main regulator on in microamperes */
+#define ENERGY_STOP_UA 200        /*!< Current in STOP mode with the low-power regulator in microamperes */
+#define ENERGY_TX_PWM_UA 35000    /*!< Average current of the infrared LED while the PWM is on (35 % duty cycle) in microamperes */
+#define ENERGY_RGB_UA 10000       /*!< Current of each LED of the RGB in microamperes */
+#define ENERGY_CLOCK_BOOST_UA 33000 /*!< Current added to the run mode while the core is clocked at 180 MHz with over-drive, in microamperes */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Current model of the system: the current drawn in each power state plus the current of each active peripheral.
+ */
+typedef struct
+{
+  uint32_t state_ua[ENERGY_STATES];   /*!< Current of each power state in microamperes */
+  uint32_t periph_ua[ENERGY_PERIPHS]; /*!< Current of each peripheral while active in microamperes */
+} energy_model_t;
+
+/**
+ * @brief Snapshot of the energy accounting.
+ */
+typedef struct
+{
+  uint64_t elapsed_us;                    /*!< Time since the accounting started in microseconds */
+  uint64_t state_us[ENERGY_STATES];       /*!< Residency in each power state in microseconds */
+  uint64_t periph_us[ENERGY_PERIPHS];     /*!< Time each peripheral has been active in microseconds */
+  uint32_t wakeups;                       /*!< Number of wake-ups by an ISR */
+  uint32_t wakeups_per_kilosecond;        /*!< Rate of wake-ups per 1000 seconds */
+  uint32_t average_ua;                    /*!< Average current in microamperes */
+  uint32_t uah_per_day;                   /*!< Estimated charge drawn in a day in microampere-hours */
+} energy_report_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Restart the accounting.
+ *
+ * The accounting starts at time 0 by default, so it is only needed to call this function to start a new measurement.
+ *
+ * @param now_ms Current system time in milliseconds
+ */
+void energy_reset(uint32_t now_ms);
+
+/**
+ * @brief Set the current model used to estimate the consumption.
+ *
+ * @param p_model Pointer to the model. It is copied.
+ */
+void energy_set_model(const energy_model_t *p_model);
+
+/**
+ * @brief Account the time spent in a low-power state.
+ *
+ * @param state Power state (not #ENERGY_STATE_RUN)
+ * @param duration_us Time spent in the state in microseconds
+ */
+void energy_add_state_time(uint8_t state, uint32_t duration_us);
+
+/**
+ * @brief Account the time a peripheral has been active, for peripherals that are switched for short known periods.
+ *
+ * @param periph Peripheral
+ * @param duration_us Time active in microseconds
+ */
+void energy_add_periph_time(uint8_t periph, uint32_t duration_us);
+
+/**
+ * @brief Switch a peripheral on or off, for peripherals that stay active for long periods.
+ *
+ * @param periph Peripheral
+ * @param on `true` if the peripheral is active
+ * @param now_ms Current system time in milliseconds
+ */
+void energy_set_periph(uint8_t periph, bool on, uint32_t now_ms);
+
+/**
+ * @brief Count a wake-up of the system by an ISR.
+ */
+void energy_count_wakeup(void);
+
+/**
+ * @brief Return the number of wake-ups of the system by an ISR since the accounting started.
+ *
+ * @return Number of wake-ups
+ */
+uint32_t energy_get_wakeups(void);
+
+/**
+ * @brief Get a snapshot of the accounting and the estimated consumption.
+ *
+ * @param p_report Pointer to the report to fill in
+ * @param now_ms Current system time in milliseconds
+ */
+void energy_get_report(energy_report_t *p_report, uint32_t now_ms);
+
+#endif /* ENERGY_H_ */
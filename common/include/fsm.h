@@ -11,6 +11,7 @@
 /* Includes ------------------------------------------------------------------*/
 /* Standard C includes */
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Typedefs --------------------------------------------------------------------*/
 
@@ -19,6 +20,13 @@
  */
 typedef struct fsm_t fsm_t;
 
+/**
+ * @brief Alias to refer to a state of a state machine.
+ *
+ * States are 8-bit so the transition rows and the FSMs are compact. Valid states go from 0 to 127; -1 marks the end of a transition table.
+ */
+typedef int8_t fsm_state_t;
+
 /**
  * @brief Alias to refer to a pointer to an input condition function.
  */
@@ -31,13 +39,15 @@ typedef void (*fsm_output_func_t)(fsm_t *);
 
 /**
  * @brief Structure to define a state machine transition table.
+ *
+ * The rows are packed (10 bytes instead of 16 on a 32-bit MCU): the Cortex-M4 loads the unaligned function pointers with a single instruction. Declare the tables `static const` so they stay in flash and take no RAM.
  */
-typedef struct fsm_trans_t
+typedef struct __attribute__((packed)) fsm_trans_t
 {
-  int orig_state;        /*!< Origin state  */
-  fsm_input_func_t in;   /*!< Input condition function */
-  int dest_state;        /*!< Output state */
-  fsm_output_func_t out; /*!< Output modification function */
+  fsm_state_t orig_state; /*!< Origin state  */
+  fsm_input_func_t in;    /*!< Input condition function */
+  fsm_state_t dest_state; /*!< Output state */
+  fsm_output_func_t out;  /*!< Output modification function */
 } fsm_trans_t;
 
 /**
@@ -45,8 +55,8 @@ typedef struct fsm_trans_t
  */
 struct fsm_t
 {
-  int current_state; /*!< Current state of the FSM */
-  fsm_trans_t *p_tt; /*!< Pointer to the  state machine transition table */
+  fsm_state_t current_state; /*!< Current state of the FSM */
+  const fsm_trans_t *p_tt;   /*!< Pointer to the  state machine transition table */
 };
 
 /* Function prototypes -----------------------------------------------------------------*/
@@ -58,7 +68,7 @@ struct fsm_t
  * @param p_tt Pointer to the  state machine transition table
  * @return fsm_t* Pointer to the memory address where the new state machine is located
  */
-fsm_t *fsm_new(fsm_trans_t *p_tt);
+fsm_t *fsm_new(const fsm_trans_t *p_tt);
 
 /**
  * @brief Create a new state machine from a table of transitions.
@@ -68,7 +78,7 @@ fsm_t *fsm_new(fsm_trans_t *p_tt);
  * @param p_fsm Pointer to the memory address where the new state machine is located
  * @param p_tt Pointer to the  state machine transition table
  */
-void fsm_init(fsm_t *p_fsm, fsm_trans_t *p_tt);
+void fsm_init(fsm_t *p_fsm, const fsm_trans_t *p_tt);
 
 /**
  * @brief Check the full transition table.
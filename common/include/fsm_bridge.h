@@ -0,0 +1,158 @@
+/**
+ * @file fsm_bridge.h
+ * @brief Header for fsm_bridge.c file.
+ *
+ * The bridge FSM turns the board into an infrared blaster driven by a host over a serial link of the port (`port_uart.h`). Both directions carry packets:
+ *
+ *     SYNC 0xA5 (u8), type (u8), sequence (u8), length of the payload (u8), payload, checksum (u8)
+ *
+ * The checksum makes the sum of the bytes from the type to the checksum 0 modulo 256. The fields of the payloads are little endian. Every command is answered with a response of type `0x80 | command` and the same sequence, whose payload starts with a status of FSM_BRIDGE_STATUS. A packet with a wrong checksum or length is dropped without response: the host sends it again, with the same sequence, when the response does not arrive. A command sent again within #FSM_BRIDGE_RETRY_WINDOW_MS is answered with the status of the first one and not executed twice. The events are sent with a sequence of their own, so that the host tells the ones dropped because the link was full.
+ *
+ * The USART does not run in the STOP modes: the first falling edge on the line wakes the system up, and the bytes received until its clock is back are lost. So the host sends #FSM_BRIDGE_WAKE_BYTES bytes #FSM_BRIDGE_WAKE before every packet, which the parser skips as any byte out of a packet.
+ *
+ * The commands that transmit take a mask of transmitters (bit n for the ID n), added to the transmitter of the FSM as by fsm_tx_set_fanout(). They are queued and handed to the transmitter FSM as soon as it is ready, in the same pass of the main loop, so that back-to-back commands are sent one per #NEC_TX_FRAME_PERIOD_MS, the maximum rate of the protocol.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef FSM_BRIDGE_H_
+#define FSM_BRIDGE_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "fsm.h"
+#include "fsm_rx.h"
+#include "fsm_tx.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_BRIDGE_SYNC 0xA5U                 /*!< First byte of a packet */
+#define FSM_BRIDGE_RESPONSE 0x80U             /*!< Bit of the type of the responses */
+#define FSM_BRIDGE_MAX_PAYLOAD (1U + 2U * NEC_TX_SCHEDULE_SIZE) /*!< Longest payload: a raw waveform of the longest schedule of the transmitter */
+#define FSM_BRIDGE_QUEUE_SIZE 16U             /*!< Commands that wait for the transmitter */
+#define FSM_BRIDGE_MACRO_MAX_STEPS 16U        /*!< Steps of a macro queued by the host */
+#define FSM_BRIDGE_LINK_TIMEOUT_MS 5000U      /*!< Time since the last byte received after which the host is taken as gone, and the system may enter the STOP modes */
+#define FSM_BRIDGE_WAKE 0xFFU                 /*!< Byte of the preamble of the packets of the host: only its start bit is low, so the USART resynchronizes on the next one */
+#define FSM_BRIDGE_WAKE_BYTES 8U              /*!< Bytes of the preamble: 0.7 ms at 115200 baud, longer than the wake-up from STOP with the regulator in low-power mode */
+#define FSM_BRIDGE_RETRY_WINDOW_MS 5000U      /*!< Time within which a command with the sequence and type of the last one is taken as sent again */
+
+/* Enums */
+/**
+ * @brief Types of the commands sent by the host.
+ */
+enum FSM_BRIDGE_COMMAND
+{
+  FSM_BRIDGE_CMD_SEND_CODE = 0x01,       /*!< Send a NEC code. Payload: mask of transmitters (u8), code (u32) */
+  FSM_BRIDGE_CMD_SEND_RAW = 0x02,        /*!< Send a raw waveform with the carrier of NEC. Payload: mask of transmitters (u8), durations of the bursts and silences in microseconds, alternately and starting with a burst (u16 each, up to #NEC_TX_SCHEDULE_SIZE) */
+  FSM_BRIDGE_CMD_HOLD_START = 0x03,      /*!< Send a NEC code and repeat codes after it, as if the button of a remote was held. Payload: mask of transmitters (u8), code (u32), time to hold in milliseconds (u16), 0 until #FSM_BRIDGE_CMD_HOLD_STOP. The hold also ends when the next command queued is started */
+  FSM_BRIDGE_CMD_HOLD_STOP = 0x04,       /*!< End the hold, after the commands queued before. No payload */
+  FSM_BRIDGE_CMD_QUEUE_MACRO = 0x05,     /*!< Play a macro of `fsm_macro.h`. Payload: mask of transmitters (u8), steps of 8 bytes (code u32, delay_ms u16, protocol u8, repeats u8), up to #FSM_BRIDGE_MACRO_MAX_STEPS. Only one macro is queued or played at a time */
+  FSM_BRIDGE_CMD_QUERY_TELEMETRY = 0x06, /*!< Read the telemetry. No payload. The response carries a `telemetry_snapshot_t` after the status */
+};
+
+/**
+ * @brief Types of the events sent by the bridge.
+ */
+enum FSM_BRIDGE_EVENT
+{
+  FSM_BRIDGE_EVT_FRAME = 0x40,    /*!< Frame received. Payload: code (u32), first_edge_ms (u32), held_ms (u32), repeats (u16), num_edges (u16), protocol (u8), error (u8), flags (u8): bit 0 repetition, bit 1 error. As in `fsm_rx_frame_t` */
+  FSM_BRIDGE_EVT_TX_START = 0x41, /*!< Command handed to the transmitter. Payload: sequence of the command (u8), system time in milliseconds (u32) */
+};
+
+/**
+ * @brief Status of the responses.
+ */
+enum FSM_BRIDGE_STATUS
+{
+  FSM_BRIDGE_STATUS_OK = 0,        /*!< Command executed or queued */
+  FSM_BRIDGE_STATUS_BAD_LENGTH,    /*!< The length of the payload does not match the command */
+  FSM_BRIDGE_STATUS_BAD_ARGUMENT,  /*!< A field of the payload is out of range */
+  FSM_BRIDGE_STATUS_BUSY,          /*!< The queue, or the slot of the raw waveforms or of the macros, is full. The host sends the command again later */
+  FSM_BRIDGE_STATUS_UNKNOWN,       /*!< Unknown type of command */
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Counters of the serial link of the bridge.
+ */
+typedef struct
+{
+  uint32_t num_commands;        /*!< Commands received with a valid checksum */
+  uint32_t num_rejected;        /*!< Commands answered with a status other than #FSM_BRIDGE_STATUS_OK */
+  uint32_t num_bad_packets;     /*!< Packets dropped by their checksum or length */
+  uint32_t num_tx_dropped;      /*!< Responses and events dropped because the ring of the transmission was full */
+} fsm_bridge_stats_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Create a new bridge FSM between a serial link and the infrared transmitter.
+ *
+ * The commands are read from the link at every fire of the FSM, without blocking, so a stream of commands never stalls the main loop. The FSM must be fired before the transmitter FSM, so that a command queued is sent in the same pass of the loop in which the transmitter becomes ready.
+ *
+ * @param uart_id Serial link ID of the port
+ * @param p_fsm_tx Pointer to the infrared transmitter FSM
+ * @param p_fsm_macro Pointer to the macro FSM that plays the macros through the same transmitter
+ *
+ * @return A pointer to the bridge FSM
+ */
+fsm_t *fsm_bridge_new(uint8_t uart_id, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro);
+
+/**
+ * @brief Initialize a bridge FSM.
+ *
+ * @param p_this Pointer to the bridge FSM
+ * @param uart_id Serial link ID of the port
+ * @param p_fsm_tx Pointer to the infrared transmitter FSM
+ * @param p_fsm_macro Pointer to the macro FSM
+ */
+void fsm_bridge_init(fsm_t *p_this, uint8_t uart_id, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro);
+
+/**
+ * @brief Stream a frame received to the host as a #FSM_BRIDGE_EVT_FRAME event. To be called by the consumer of the FIFO of the receiver for every frame it pops.
+ *
+ * @param p_this Pointer to the bridge FSM
+ * @param p_frame Pointer to the frame
+ */
+void fsm_bridge_send_frame(fsm_t *p_this, const fsm_rx_frame_t *p_frame);
+
+/**
+ * @brief Check if the bridge is active: there are bytes to read, commands queued or a hold in progress.
+ *
+ * @param p_this Pointer to the bridge FSM
+ *
+ * @return `true` if the bridge is active
+ */
+bool fsm_bridge_check_activity(fsm_t *p_this);
+
+/**
+ * @brief Check if a host has used the link in the last #FSM_BRIDGE_LINK_TIMEOUT_MS. The USART does not run in the STOP modes, so the system only sleeps in sleep mode while the link is open. A wake-up by the line counts as a byte received, so that the system stays awake for the packet behind the preamble.
+ *
+ * @param p_this Pointer to the bridge FSM
+ *
+ * @return `true` if the link is open
+ */
+bool fsm_bridge_check_link(fsm_t *p_this);
+
+/**
+ * @brief Arm the line of the link as a wake-up source of the STOP modes. To be called before every sleep, so that a packet of the host wakes the system up even after the link is closed.
+ *
+ * @param p_this Pointer to the bridge FSM
+ */
+void fsm_bridge_arm_wakeup(fsm_t *p_this);
+
+/**
+ * @brief Return the counters of the serial link of the bridge.
+ *
+ * @param p_this Pointer to the bridge FSM
+ *
+ * @return Pointer to the counters
+ */
+const fsm_bridge_stats_t *fsm_bridge_get_stats(fsm_t *p_this);
+
+#endif /* FSM_BRIDGE_H_ */
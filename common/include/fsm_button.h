@@ -17,21 +17,51 @@
 /* Other includes */
 #include "fsm.h"
 
-/* Function prototypes and explanation -------------------------------------------------*/
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define BUTTON_LONG_PRESS_MS 1000    /*Default time the button must be held to start a long press*/
+#define BUTTON_HOLD_REPEAT_MS 200    /*Default period of the hold-repeat events while a long press lasts*/
+#define BUTTON_DOUBLE_CLICK_MS 0     /*Default maximum time between two clicks to make a double-click. 0 disables double-clicks and reports clicks without delay*/
+#define BUTTON_EVENTS_QUEUE_SIZE 8   /*Number of gesture events that can be queued. Must be a power of 2*/
+
+/* Enums */
+/*Gestures recognized by the button FSM.*/
+enum FSM_BUTTON_EVENT {
+  BUTTON_EVENT_CLICK = 0,        /*Short press and release, not followed by a second one within the double-click time*/
+  BUTTON_EVENT_DOUBLE_CLICK,     /*Two short presses within the double-click time*/
+  BUTTON_EVENT_LONG_PRESS_START, /*The button has been held for the long press time*/
+  BUTTON_EVENT_HOLD_REPEAT,      /*Periodic event while a long press lasts*/
+  BUTTON_EVENT_RELEASE,          /*The button has been released. The duration is the time it was pressed*/
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/*Gesture event.*/
+typedef struct
+{
+  uint8_t type;       /*Gesture, one of FSM_BUTTON_EVENT*/
+  uint32_t button_id; /*Button that generated the event*/
+  uint32_t tick;      /*System tick in ms of the edge or timeout that generated the event*/
+  uint32_t duration;  /*Time in ms the button has been pressed until the event*/
+} fsm_button_event_t;
 
-/*	Return the duration of the last button press.*/
-uint32_t fsm_button_get_duration(fsm_t* p_this);
+/* Function prototypes and explanation -------------------------------------------------*/
 
 /*Initialize a button FSM.*/
 void fsm_button_init(fsm_t* p_this, uint32_t debounce_time, uint32_t button_id);
 
 /*Create a new button FSM. */
-fsm_t* fsm_button_new(uint32_t debounce_time, uint32_t button_id); 
+fsm_t* fsm_button_new(uint32_t debounce_time, uint32_t button_id);
+
+/*Configure the times of the gestures: long press, period of the hold-repeat events and double-click (0 to disable double-clicks).*/
+void fsm_button_set_gestures(fsm_t *p_this, uint32_t long_press_ms, uint32_t hold_repeat_ms, uint32_t double_click_ms);
+
+/*Pop the oldest gesture event. Return false if there are no events queued.*/
+bool fsm_button_pop_event(fsm_t *p_this, fsm_button_event_t *p_event);
 
-/*	Return the duration of the last button press.*/
-void fsm_button_reset_duration(fsm_t* p_this);
+/*Return the number of gesture events lost because the queue was full.*/
+uint32_t fsm_button_get_dropped_events(fsm_t *p_this);
 
-bool fsm_button_check_activity(fsm_t *p_this);	
+bool fsm_button_check_activity(fsm_t *p_this);
 
 
 #endif
@@ -0,0 +1,54 @@
+/**
+ * @file fsm_macro.h
+ * @brief Header for fsm_macro.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef FSM_MACRO_H_
+#define FSM_MACRO_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "fsm.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Enums */
+/*Protocols of the steps of a macro.*/
+enum MACRO_PROTOCOL {
+  MACRO_PROTOCOL_NEC = 0, /*NEC frame followed by NEC repeat codes*/
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/*Step of a macro. It takes 8 bytes, so the macros can be kept as constant arrays in flash.*/
+typedef struct
+{
+  uint32_t code;     /*Code to send*/
+  uint16_t delay_ms; /*Time from the start of the last frame of the step to the next step. It is never shorter than the frame period*/
+  uint8_t protocol;  /*Protocol of the code, one of MACRO_PROTOCOL*/
+  uint8_t repeats;   /*Number of repeat codes sent after the frame, one per frame period, as if the button of the remote was held*/
+} macro_step_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+
+/*Create a new macro FSM that plays the macros through an infrared transmitter FSM.*/
+fsm_t *fsm_macro_new(fsm_t *p_fsm_tx);
+
+/*Initialize a macro FSM.*/
+void fsm_macro_init(fsm_t *p_this, fsm_t *p_fsm_tx);
+
+/*Start playing a macro. The steps are not copied, so they must stay valid until the macro ends. A macro being played is replaced.*/
+void fsm_macro_play(fsm_t *p_this, const macro_step_t *p_steps, uint16_t num_steps);
+
+/*Stop the macro being played. The frame in progress, if any, is completed.*/
+void fsm_macro_cancel(fsm_t *p_this);
+
+/*Check if a macro is being played. The FSM is active while playing, so the system does not sleep and the frames start on time.*/
+bool fsm_macro_check_activity(fsm_t *p_this);
+
+#endif
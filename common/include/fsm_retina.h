@@ -22,12 +22,26 @@
 /* TO-DO alumnos: documentation*/
 
 /*	Create a new RETINA FSM*/
-fsm_t *fsm_retina_new(fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_rx, uint8_t rgb_id);
+fsm_t *fsm_retina_new(fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro, fsm_t *p_fsm_rx, uint8_t rgb_id);
 
 /* TO-DO alumnos: documentation*/
 
 /*	Initialize the infrared transmitter FSM*/
-void fsm_retina_init(fsm_t *p_this, fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_rx, uint8_t rgb_id);
+void fsm_retina_init(fsm_t *p_this, fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro, fsm_t *p_fsm_rx, uint8_t rgb_id);
+
+/*	Set the policy of the clock governor: one of the CLOCK_GOVERNOR_* policies of clock_governor.h. #CLOCK_GOVERNOR_DYNAMIC by default: only the decoding of the frames and their modulation are boosted, which costs less than 0.1 % over #CLOCK_GOVERNOR_ALWAYS_LOW*/
+void fsm_retina_set_clock_policy(fsm_t *p_this, uint8_t policy);
+
+/*	Get the number of switches to the boost clock since the policy was set*/
+uint32_t fsm_retina_get_clock_boosts(fsm_t *p_this);
+
+/*	Set the bridge FSM to a host that the frames received are streamed to, as the FIFO of the receiver has a single consumer. The activity of the bridge keeps the system awake, and an open link keeps it out of the STOP modes. NULL for none, by default*/
+void fsm_retina_set_bridge(fsm_t *p_this, fsm_t *p_fsm_bridge);
+/*	Set the FSM of the LED strip that shows the effects of the colour codes received, as the RGB LED does. It is switched off in transmission mode. The frames of the strip keep the system awake, and a stream being sent keeps it out of the STOP modes. NULL for none, by default*/
+void fsm_retina_set_strip(fsm_t *p_this, fsm_t *p_fsm_strip);
+
+/*	Get the microseconds from the initialization of the system to the output restored from the backup SRAM after a reset: the mode, the colour of the RGB LED, the learning mode and the position in the playlist. 0 after a cold boot, when there is no valid state to restore*/
+uint32_t fsm_retina_get_restore_us(fsm_t *p_this);
 
 #endif
 
@@ -17,15 +17,65 @@
 /* Other includes */
 #include "fsm.h"
 
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_RX_FIFO_SIZE 8 /*!< Maximum number of decoded frames waiting to be read */
+#define FSM_RX_PROTOCOL_NEC 0 /*!< Frame decoded as NEC */
+#define FSM_RX_PROTOCOL_UNKNOWN 1 /*!< Frame that could not be decoded */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Record of a frame received, as stored in the FIFO of the receiver.
+ */
+typedef struct
+{
+  uint32_t code;           /*!< Code decoded. For repetition codes, the code they repeat, or 0 if it was not received. 0 for errors */
+  uint32_t first_edge_ms;  /*!< System time of the first edge of the frame */
+  uint32_t last_edge_ms;   /*!< System time of the last edge of the frame */
+  uint32_t held_ms;        /*!< For repetition codes, time from the first edge of the code they repeat to their last edge */
+  uint16_t num_edges;      /*!< Number of edges captured */
+  uint16_t duration_ticks; /*!< Time from the first to the last edge, in ticks of the receiver timer */
+  uint16_t repeats;        /*!< For repetition codes, number of repetitions of the code received so far, this one included */
+  uint8_t protocol;        /*!< Protocol of the frame: `FSM_RX_PROTOCOL_NEC` or `FSM_RX_PROTOCOL_UNKNOWN` */
+  uint8_t error;           /*!< For errors, the reason why the frame could not be parsed as NEC, one of NEC_RX_ERROR. #NEC_RX_ERROR_NONE for a frame parsed as the code 0x00000000 */
+  bool is_repetition;      /*!< Flag to indicate that the frame is a repetition code */
+  bool is_error;           /*!< Flag to indicate that the frame could not be decoded */
+  bool has_raw;            /*!< Flag to indicate that the intervals of the frame can be read with `fsm_rx_get_raw()` while it is the oldest frame */
+} fsm_rx_frame_t;
+
+/**
+ * @brief Instrumentation of the decoding of the frames in the deferred interrupt.
+ */
+typedef struct
+{
+  uint32_t num_decoded;        /*!< Number of frames decoded, including the ones filtered or dropped */
+  uint32_t latency_cycles;     /*!< Cycles from the end of the last frame to its record in the FIFO, as given by port_system_get_cycles() */
+  uint32_t latency_max_cycles; /*!< Worst latency observed in cycles */
+  uint32_t num_fast_repetitions; /*!< Number of repetition codes recognised at their last edge, without waiting for the end of the frame */
+  uint32_t num_boosted;        /*!< Number of frames decoded with the core clocked at #PORT_SYSTEM_CLOCK_BOOST */
+} fsm_rx_decode_stats_t;
+
+/**
+ * @brief Function run by the deferred interrupt before and after decoding a frame at its end.
+ *
+ * @param p_arg Argument given to fsm_rx_set_decode_hook()
+ * @param decoding true before decoding the frame, false once it has been decoded
+ */
+typedef void (*fsm_rx_decode_hook_t)(void *p_arg, bool decoding);
+
 /* Function prototypes and explanation ----------------------------------------*/
 /**
  * @brief Create a new infrared receiver FSM
  *
  * The infrared reception module indeed manages 2 FSMs. (i) The first one (`fsm_trans_rx_nec`) controls the reception of infrared pulses and stores the times where the changes on the GPIO occur. (ii) The second one (`fsm_trans_rx_nec`) parses the data received (an array of timestamps) to extract the NEC command. This second FSM that decodes the NEC protocol. Refer to `fsm_rx_NEC_new()` for further information about this FSM.
  *
- * At start and reset, the code value must be '0x00'. A value of '0x00' means that it has not been received any new code. The Retina FSM is the one which stores and retains the last code until a new one is received.
+ * The frames are decoded by the deferred software interrupt of the port, that the receiver requests when it flags the end of a frame. It preempts the main loop, but not the capture and timing ISRs, so the decoding latency does not depend on the load of the loop.
+ *
+ * The repetition codes sent while a button is held take a fast path: the receiver also requests the deferred interrupt at their last edge, where they are recognised at once with `fsm_rx_NEC_check_repetition()`, and the gap after them is not waited for. Every repetition code is attached to the last code received, with the number of repetitions and the time the button has been held, so that held actions update at the rate of the repetition codes. A repetition code that does not pass the fast path is still decoded at the end of the frame.
  *
- * @attention The user is required to reset the code value once it has been read. Otherwise, this value may be misinterpreted by the Retina FSM. In such a case we would be interpreting the code constantly. The function `fsm_rx_reset_code()` resets the code when its called.
+ * The frames, repetition codes and errors by reason are counted in the telemetry block of `telemetry.h`.
+ *
+ * Every frame received is pushed as a `fsm_rx_frame_t` into a lock-free FIFO of `FSM_RX_FIFO_SIZE` records, so that a burst of frames is not lost if the consumer is late. The consumer reads them in order with `fsm_rx_peek_frame()` and `fsm_rx_pop_frame()`. When the FIFO is full, the new frames are dropped and counted. The Retina FSM is the one which stores and retains the last code until a new one is received.
  *
  * The FSM contains information of the receiver ID. This ID is a unique identifier that is managed by the user in the `port`. That is where the user provides identifiers and HW information for all the receivers on his system. The FSM does not have to know anything of the underlying HW.
  *
@@ -35,11 +85,162 @@
  */
 fsm_t *fsm_rx_new(uint8_t rx_id);
 void fsm_rx_init(fsm_t *p_this, uint8_t rx_id);
-uint32_t fsm_rx_get_code(fsm_t *p_this);
-bool fsm_rx_get_repetition(fsm_t *p_this);
-bool fsm_rx_get_error_code(fsm_t *p_this);
 void fsm_rx_set_rx_status(fsm_t *p_this, bool status);
-void fsm_rx_reset_code(fsm_t *p_this);
 bool fsm_rx_check_activity(fsm_t *p_this);
 
+/**
+ * @brief Return whether a frame is being captured, waiting for its end.
+ *
+ * A frame in flight is not activity: the system may sleep, but only in a mode where the timer of the receiver keeps running to flag the end of the frame.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return `true` if edges were received and the end of the frame has not been detected yet
+ */
+bool fsm_rx_check_frame_in_flight(fsm_t *p_this);
+
+/**
+ * @brief Set the time without edges that ends a frame. By default, #NEC_RX_END_OF_FRAME_GAP_US.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param gap_us Time in microseconds. It must be longer than the longest interval of the protocol
+ */
+void fsm_rx_set_end_of_frame_gap(fsm_t *p_this, uint32_t gap_us);
+
+/**
+ * @brief Set the threshold of the glitch filter of the receiver. By default, #NEC_RX_GLITCH_MIN_PULSE_US.
+ *
+ * The capture ISR drops the spikes shorter than the threshold with the edge before them, so that ambient light does not fill the buffer of the receiver nor make the decoder skip edges. A capture made only of glitches is not decoded.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param min_pulse_us Shortest pulse or silence kept, in microseconds. It must be shorter than the shortest interval of the protocol. 0 to disable the filter
+ */
+void fsm_rx_set_glitch_filter(fsm_t *p_this, uint32_t min_pulse_us);
+
+/**
+ * @brief Return the number of edges dropped by the glitch filter of the receiver.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return Number of edges dropped since the FSM was created
+ */
+uint32_t fsm_rx_get_num_glitches(fsm_t *p_this);
+
+/**
+ * @brief Set the function run by the deferred interrupt before and after decoding every frame at its end: a clock governor boosts the clock there for the decoding only. The repetition codes decoded at their last edge do not run it.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param hook Function to run. NULL to run none
+ * @param p_arg Argument of the function
+ */
+void fsm_rx_set_decode_hook(fsm_t *p_this, fsm_rx_decode_hook_t hook, void *p_arg);
+
+/**
+ * @brief Return the instrumentation of the decoding of the frames.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return Pointer to the statistics
+ */
+const fsm_rx_decode_stats_t *fsm_rx_get_decode_stats(fsm_t *p_this);
+
+/**
+ * @brief Return the oldest frame of the FIFO without removing it.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return Pointer to the frame, valid until it is popped. NULL if the FIFO is empty
+ */
+const fsm_rx_frame_t *fsm_rx_peek_frame(fsm_t *p_this);
+
+/**
+ * @brief Remove the oldest frame of the FIFO.
+ *
+ * If the frame holds the raw intervals, they are released for the next frame that cannot be decoded.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param p_frame Pointer where the frame is copied. May be NULL
+ *
+ * @return `true` if a frame was removed, `false` if the FIFO was empty
+ */
+bool fsm_rx_pop_frame(fsm_t *p_this, fsm_rx_frame_t *p_frame);
+
+/**
+ * @brief Return the number of frames waiting in the FIFO.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return Number of frames, up to `FSM_RX_FIFO_SIZE`
+ */
+uint32_t fsm_rx_get_num_frames(fsm_t *p_this);
+
+/**
+ * @brief Return the number of frames dropped because the FIFO was full.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return Number of frames dropped since the FSM was created
+ */
+uint32_t fsm_rx_get_num_dropped(fsm_t *p_this);
+
+/**
+ * @brief Return the system time of the last edge detected by the infrared receiver.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return System time in milliseconds
+ */
+uint32_t fsm_rx_get_last_edge_ms(fsm_t *p_this);
+
+/**
+ * @brief Enable or disable the capture of the frames that cannot be decoded.
+ *
+ * When enabled, the intervals between the edges of a frame that is not NEC are kept until its record is popped from the FIFO, so that it can be learned as a raw frame. Only one frame at a time holds them: the next frames that cannot be decoded are queued without them.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param enable `true` to capture the frames
+ */
+void fsm_rx_set_raw_capture(fsm_t *p_this, bool enable);
+
+/**
+ * @brief Return the intervals between the edges of the oldest frame of the FIFO, if it holds them.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param p_num_deltas Pointer where the number of intervals is returned. 0 if there is no frame captured
+ *
+ * @return Pointer to the intervals in ticks of the receiver timer
+ */
+const uint16_t *fsm_rx_get_raw(fsm_t *p_this, uint32_t *p_num_deltas);
+
+/**
+ * @brief Set the addresses of the frames for this receiver.
+ *
+ * The frames for other devices are abandoned as soon as their address has been parsed, and their repetition codes are dropped too. Neither of them is pushed into the FIFO.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param p_addresses Pointer to the accepted addresses, as given by #NEC_ADDRESS. They are copied. NULL to accept every frame
+ * @param num_addresses Number of accepted addresses, up to #NEC_ADDRESS_FILTER_MAX. 0 to accept every frame
+ * @param mask Bits of the address field that are compared. 0xFFFF to compare the whole field
+ */
+void fsm_rx_set_address_filter(fsm_t *p_this, const uint16_t *p_addresses, uint8_t num_addresses, uint16_t mask);
+
+/**
+ * @brief Return the number of frames and repetition codes dropped by the address filter.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ *
+ * @return Number of frames dropped since the FSM was created
+ */
+uint32_t fsm_rx_get_num_filtered(fsm_t *p_this);
+
+/**
+ * @brief Return the clock drift learnt by the decoder for the remote of an address. It is kept while the receiver is off.
+ *
+ * @param p_this Pointer to the infrared receiver FSM
+ * @param address Address field of the frames, as given by #NEC_ADDRESS
+ *
+ * @return Time scale of the remote, as given by fsm_rx_NEC_get_drift(). 0 if it has not been learnt
+ */
+uint16_t fsm_rx_get_drift(fsm_t *p_this, uint16_t address);
+
 #endif
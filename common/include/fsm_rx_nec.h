@@ -16,6 +16,7 @@
 
 /* Other includes */
 #include "fsm.h"
+#include "rx_delta.h"
 
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
@@ -26,7 +27,23 @@
 #define NEC_PROLOGUE_EDGES 3                                 /*!< Number of edges of the prologue of a NEC code */
 #define NEC_EPILOGUE_EDGES 1                                 /*!< Number of edges of the epilogue of a NEC code */
 #define NEC_SYMBOL_EDGES 2                                   /*!< Number of edges of the symbols of a NEC code */
-#define NEC_FRAME_EDGES 256                                  /*!< Array-size large enough to store all the edges received (the NEC code has much less edges) */
+#define NEC_FRAME_EDGES (NEC_PROLOGUE_EDGES + NEC_FRAME_BITS * NEC_SYMBOL_EDGES + NEC_EPILOGUE_EDGES) /*!< Number of edges of a NEC frame, the longest of the protocol: the repetition code has #NEC_PROLOGUE_EDGES + #NEC_EPILOGUE_EDGES */
+#define NEC_REPETITION_EDGES (NEC_PROLOGUE_EDGES + NEC_EPILOGUE_EDGES) /*!< Number of edges of a NEC repetition code */
+#define NEC_ADDRESS(code) ((uint16_t)((code) >> NEC_COMMAND_BITS)) /*!< Address field of a NEC code: the address and its inverse, or a 16-bit extended address */
+#define NEC_ADDRESS_FILTER_MAX 4                             /*!< Maximum number of addresses accepted by the address filter of a receiver */
+#define NEC_COMMAND_CHECK(code) (((((code) >> 8) ^ (code)) & 0xFFU) == 0xFFU) /*!< Check that the command of a NEC code is followed by its inverse. Extended codes may not follow it */
+
+/* Enums */
+/**
+ * @brief Reasons why a frame could not be parsed.
+ */
+enum NEC_RX_ERROR
+{
+  NEC_RX_ERROR_NONE = 0,  /*!< Frame parsed, or skipped by the address filter */
+  NEC_RX_ERROR_PROLOGUE,  /*!< No valid prologue of a command or a repetition code */
+  NEC_RX_ERROR_SYMBOL,    /*!< Interval out of the windows of the symbols */
+  NEC_RX_ERROR_TRUNCATED, /*!< The edges ended before the last symbol */
+};
 
 /* NEC pulses and silences times (minimum and maximum tolerances) */
 #define NEC_RX_PROLOGUE_SILENCE_MIN_US 8500
@@ -44,10 +61,19 @@
 #define NEC_RX_REPETITION_PULSE_MIN_US 1700 /*!< Minimum width of epilogue pulse at RX in microseconds */
 #define NEC_RX_REPETITION_PULSE_MAX_US 2700 /*!< Maximum width of epilogue pulse at RX in microseconds */
 
-#define NEC_MESSAGE_TIMEOUT_US 10000 /*!< Timeout to wait without receiving an edge in microseconds */
+#define NEC_RX_MAX_DRIFT_PCT 20             /*!< Clock error of the remotes accepted by the adaptive windows, in percent */
+#define NEC_RX_DRIFT_MAX_ADDRESSES 4        /*!< Number of addresses whose clock drift is learnt */
+#define NEC_RX_DRIFT_EWMA_SHIFT 2           /*!< Weight of a new frame in the drift learnt for its address: 1 / 2^shift */
+#define NEC_RX_SCALE_SHIFT 10               /*!< Fractional bits of a time scale */
+#define NEC_RX_SCALE_ONE (1U << NEC_RX_SCALE_SHIFT) /*!< Time scale of a remote with a nominal clock */
+
+#define NEC_RX_END_OF_FRAME_GAP_US (NEC_RX_PROLOGUE_SILENCE_MAX_US * (100 + NEC_RX_MAX_DRIFT_PCT) / 100 + NEC_RX_SYMBOL_SILENCE_MIN_US) /*!< Default time without edges that ends a frame in microseconds: just over the longest legal interval of a drifting remote */
+#define NEC_RX_GLITCH_MIN_PULSE_US (NEC_RX_SYMBOL_SILENCE_MIN_US * (100 - NEC_RX_MAX_DRIFT_PCT) / 100 / 2) /*!< Default threshold of the glitch filter of the receivers in microseconds: half the shortest legal interval of a drifting remote */
+#define NEC_FRAME_PERIOD_MS 108      /*!< Period of the frames and repetition codes sent while a button of the remote is held */
 
 /* NEC pulses and silences ticks (minimum and maximum tolerances) */
 #define NEC_RX_TIMER_TICK_BASE_US 10                                                                   /*!< Number of microseconds that represents a tick of the reference clock. */
+#define NEC_RX_TIMER_TICK_BASE_NS (NEC_RX_TIMER_TICK_BASE_US * 1000U)                                   /*!< #NEC_RX_TIMER_TICK_BASE_US in nanoseconds. The ports derive their timers from it */
 #define NEC_RX_PROLOGUE_TICKS_SILENCE_MIN (NEC_RX_PROLOGUE_SILENCE_MIN_US / NEC_RX_TIMER_TICK_BASE_US) /*!< #NEC_RX_PROLOGUE_SILENCE_MIN_US as ticks */
 #define NEC_RX_PROLOGUE_TICKS_SILENCE_MAX (NEC_RX_PROLOGUE_SILENCE_MAX_US / NEC_RX_TIMER_TICK_BASE_US) /*!< #NEC_RX_PROLOGUE_SILENCE_MAX_US as ticks */
 #define NEC_RX_PROLOGUE_TICKS_PULSE_MIN (NEC_RX_PROLOGUE_PULSE_MIN_US / NEC_RX_TIMER_TICK_BASE_US)     /*!< #NEC_RX_PROLOGUE_PULSE_MIN_US as ticks */
@@ -60,6 +86,8 @@
 #define NEC_RX_SYMBOL_0_TICKS_PULSE_MAX (NEC_RX_SYMBOL_0_PULSE_MAX_US / NEC_RX_TIMER_TICK_BASE_US)     /*!< #NEC_RX_SYMBOL_0_PULSE_MAX_US as ticks */
 #define NEC_RX_SYMBOL_1_TICKS_PULSE_MIN (NEC_RX_SYMBOL_1_PULSE_MIN_US / NEC_RX_TIMER_TICK_BASE_US)     /*!< #NEC_RX_SYMBOL_1_PULSE_MIN_US as ticks */
 #define NEC_RX_SYMBOL_1_TICKS_PULSE_MAX (NEC_RX_SYMBOL_1_PULSE_MAX_US / NEC_RX_TIMER_TICK_BASE_US)     /*!< #NEC_RX_SYMBOL_1_PULSE_MAX_US as ticks */
+#define NEC_RX_ADAPTIVE_PROLOGUE_TICKS_SILENCE_MIN (NEC_RX_PROLOGUE_TICKS_SILENCE_MIN * (100 - NEC_RX_MAX_DRIFT_PCT) / 100) /*!< Shortest prologue silence accepted by the adaptive windows */
+#define NEC_RX_ADAPTIVE_PROLOGUE_TICKS_SILENCE_MAX (NEC_RX_PROLOGUE_TICKS_SILENCE_MAX * (100 + NEC_RX_MAX_DRIFT_PCT) / 100) /*!< Longest prologue silence accepted by the adaptive windows */
 
 /* Function prototypes and explanation -------------------------------------------------*/
 /**
@@ -67,15 +95,17 @@
  *
  * This FSM is created when the main system (RETINA) works in reception mode and it is destroyed when the system works in transmission mode.
  *
- * This FSM parses a given array of time-ticks into a NEC code. Each time tick indicates that there was an edge (rising or falling edge) in the GPIO connected to the infrared receiver.
+ * This FSM parses the intervals between the edges (rising or falling edges) in the GPIO connected to the infrared receiver into a NEC code.
  *
- * @attention The GPIO of the infrared receiver works in input mode and it is always at high level, thus, **the first edge is always a falling edge**. Being this so, we can assert that: *all edges in even positions of the array are falling edges, and edges in odd positions of the array are rising edges*. This is useful information to debug the FSM.
+ * @attention The GPIO of the infrared receiver works in input mode and it is always at high level, thus, **the first edge is always a falling edge**. Being this so, we can assert that: *all intervals in even positions of the buffer start at a falling edge, and intervals in odd positions start at a rising edge*. This is useful information to debug the FSM.
  *
  * The FSM works with time tolerances (deviations in the pulse and silence widths). It is assumed that the timer used to control the time ticks has a resolution of #NEC_RX_TIMER_TICK_BASE_US microseconds.
  *
- * **The FSM goes through all the edges comparing the duration between the current and the following edge**. With this information, we can check if we are parsing (i) the prologue, (ii) a symbol 0, (iii) a symbol 1, (iv) the epilogue, (v) a repetition, or (vi) if the infrared data received was noise of a spurious event, or even a code of another protocol.
+ * The oscillators of cheap remotes drift, so by default the windows are adaptive: the time scale of each frame is estimated from its prologue, up to #NEC_RX_MAX_DRIFT_PCT off, and the rest of the intervals are classified against the windows rescaled to it. The drift of the last #NEC_RX_DRIFT_MAX_ADDRESSES addresses is learnt from the whole duration of their frames, and it replaces the estimate of the prologue once the address of a frame has been parsed. The windows are only rescaled for a frame that the fixed windows cannot parse: the jitter of a prologue is enough to misplace them, and the frames of a remote with a nominal clock would be lost. See fsm_rx_NEC_set_adaptive().
+ *
+ * **The FSM goes through the intervals between consecutive edges**, as stored by the receiver in the format of `rx_delta.h`, so that it does not compute the differences of the time ticks. With this information, we can check if we are parsing (i) the prologue, (ii) a symbol 0, (iii) a symbol 1, (iv) the epilogue, (v) a repetition, or (vi) if the infrared data received was noise of a spurious event, or even a code of another protocol.
  *
- * The FSM receives information of the time ticks of the edges and the number of edges detected. The FSM parses the code and returns it as a pointer. It also indicates if the code was a repetition code or not (it was a command). The FSM stores information on the number of bits remaining to read (expected to be #NEC_FRAME_BITS).
+ * The FSM receives the intervals between the edges and their number. The FSM parses the code and returns it as a pointer. It also indicates if the code was a repetition code or not (it was a command). The FSM stores information on the number of bits remaining to read (expected to be #NEC_FRAME_BITS).
  *
  * Check the transition table `fsm_trans_rx_nec` for further information.
  *
@@ -85,6 +115,84 @@ fsm_t *fsm_rx_NEC_new(void);
 
 void fsm_rx_NEC_init(fsm_t *p_this);
 
-bool fsm_rx_NEC_parse_code(fsm_t *p_this, uint16_t *p_edge_ticks, uint32_t num_edges, uint32_t *p_code);
+/**
+ * @brief Reset the state of the parse of a frame, as when the receiver starts. What the FSM learnt and its settings are kept: the drift of the remotes, the address filter and the adaptive windows.
+ *
+ * @param p_this Pointer to the NEC FSM
+ */
+void fsm_rx_NEC_reset(fsm_t *p_this);
+
+/**
+ * @brief Parse the intervals between the edges of a frame into a NEC code.
+ *
+ * @param p_this Pointer to the NEC FSM
+ * @param p_deltas Buffer of intervals between the edges, in the format of `rx_delta.h`
+ * @param num_deltas Number of intervals, one less than the number of edges
+ * @param p_code Pointer where the code is stored. 0 if the frame is not a NEC command. The reason is given by fsm_rx_NEC_get_error()
+ *
+ * @return `true` if the frame is a repetition code
+ */
+bool fsm_rx_NEC_parse_code(fsm_t *p_this, const rx_delta_t *p_deltas, uint32_t num_deltas, uint32_t *p_code);
+
+/**
+ * @brief Check if the intervals between the edges of a capture are a NEC repetition code.
+ *
+ * It is the fast path of the repetition codes, sent every #NEC_FRAME_PERIOD_MS while a button is held: their three intervals are checked against the windows at once, without the FSM, so that they can be recognised at their last edge instead of at the end of the frame. It is stricter than fsm_rx_NEC_parse_code(), which does not check the trailing burst.
+ *
+ * @param p_this Pointer to the NEC FSM
+ * @param p_deltas Buffer of intervals between the edges, in the format of `rx_delta.h`
+ * @param num_deltas Number of intervals, one less than the number of edges
+ *
+ * @return `true` if the capture is exactly a repetition code
+ */
+bool fsm_rx_NEC_check_repetition(fsm_t *p_this, const rx_delta_t *p_deltas, uint32_t num_deltas);
+
+/**
+ * @brief Set the addresses of the frames that are decoded.
+ *
+ * The address field is checked as soon as its 16 bits have been parsed. If it does not match any of the addresses under the mask, the rest of the frame is skipped and the code is 0. Repetition codes have no address and are always decoded.
+ *
+ * @param p_this Pointer to the NEC FSM
+ * @param p_addresses Pointer to the accepted addresses. It is not copied, so it must outlive the FSM. NULL to decode every frame
+ * @param num_addresses Number of accepted addresses. 0 to decode every frame
+ * @param mask Bits of the address field that are compared. 0xFFFF to compare the whole field
+ */
+void fsm_rx_NEC_set_address_filter(fsm_t *p_this, const uint16_t *p_addresses, uint8_t num_addresses, uint16_t mask);
+
+/**
+ * @brief Enable or disable the adaptive windows. When disabled, the intervals are classified against the fixed windows of the protocol.
+ *
+ * @param p_this Pointer to the NEC FSM
+ * @param enable `true` to rescale the windows to the clock of each remote
+ */
+void fsm_rx_NEC_set_adaptive(fsm_t *p_this, bool enable);
+
+/**
+ * @brief Get the clock drift learnt for an address.
+ *
+ * @param p_this Pointer to the NEC FSM
+ * @param address Address field of the frames, as given by NEC_ADDRESS()
+ *
+ * @return Time scale of the remote, #NEC_RX_SCALE_ONE for a nominal clock. 0 if no frame of the address has been decoded with the adaptive windows enabled
+ */
+uint16_t fsm_rx_NEC_get_drift(fsm_t *p_this, uint16_t address);
+
+/**
+ * @brief Check if the last frame parsed was skipped by the address filter.
+ *
+ * @param p_this Pointer to the NEC FSM
+ *
+ * @return `true` if the address of the frame was not accepted
+ */
+bool fsm_rx_NEC_get_filtered(fsm_t *p_this);
+
+/**
+ * @brief Return why the last frame parsed could not be parsed.
+ *
+ * @param p_this Pointer to the NEC FSM
+ *
+ * @return Reason, one of NEC_RX_ERROR. #NEC_RX_ERROR_NONE if it was parsed
+ */
+uint8_t fsm_rx_NEC_get_error(fsm_t *p_this);
 
 #endif
\ No newline at end of file
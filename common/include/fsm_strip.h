@@ -0,0 +1,148 @@
+/**
+ * @file fsm_strip.h
+ * @brief Header for fsm_strip.c file.
+ *
+ * The strip FSM renders effects on an LED strip of the WS2812 class of the port (`port_rgb.h`). The CPU only writes the array of pixels and encodes it into the back buffer of the port (`ws2812.h`), that is sent by DMA while the next frame is rendered. A static effect is sent once; an animated one is rendered at #FSM_STRIP_FPS frames per second, each frame in the first pass of the main loop after its time in which the previous stream has been sent.
+ *
+ * The effects are triggered by the colour codes of the Liluco remote (`commands.h`): a colour code fills the strip with that colour, and the same code again moves to the next effect, from #FSM_STRIP_EFFECT_FILL to #FSM_STRIP_EFFECT_CHASE and back. The code of the OFF button switches the strip off.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef FSM_STRIP_H_
+#define FSM_STRIP_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "fsm.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_STRIP_FPS 60U            /*!< Frames per second of the animated effects */
+#define FSM_STRIP_CHASE_LENGTH 8U    /*!< Pixels of the segment of #FSM_STRIP_EFFECT_CHASE, fading from its head */
+#define FSM_STRIP_COLOR_LEVEL 64U    /*!< Level of the channels of the colours of the remote: a quarter of the full scale keeps a strip of 300 LEDs in white under 5 A */
+
+/* Enums */
+/**
+ * @brief Effects of the strip.
+ */
+enum FSM_STRIP_EFFECT
+{
+  FSM_STRIP_EFFECT_FILL = 0,   /*!< All the pixels of the colour */
+  FSM_STRIP_EFFECT_GRADIENT,   /*!< From the colour on the first pixel to its complement on the last one */
+  FSM_STRIP_EFFECT_CHASE,      /*!< A segment of the colour that runs along the strip, one pixel per frame */
+  FSM_STRIP_NUM_EFFECTS,       /*!< Number of effects */
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief State of the strip that selects what it shows, to restore it after a reset.
+ */
+typedef struct
+{
+  uint32_t last_code; /*!< Last code of the remote that triggered an effect */
+  uint8_t effect;     /*!< Effect, one of FSM_STRIP_EFFECT */
+  uint8_t r;          /*!< Red of the colour of the effect */
+  uint8_t g;          /*!< Green of the colour of the effect */
+  uint8_t b;          /*!< Blue of the colour of the effect */
+} fsm_strip_state_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Create a new strip FSM. The strip is configured and switched off.
+ *
+ * @param strip_id LED strip ID of the port
+ * @param num_pixels Number of pixels of the strip, up to #PORT_RGB_STRIP_MAX_PIXELS of the port
+ *
+ * @return A pointer to the strip FSM
+ */
+fsm_t *fsm_strip_new(uint8_t strip_id, uint16_t num_pixels);
+
+/**
+ * @brief Initialize a strip FSM.
+ *
+ * @param p_this Pointer to the strip FSM
+ * @param strip_id LED strip ID of the port
+ * @param num_pixels Number of pixels of the strip
+ */
+void fsm_strip_init(fsm_t *p_this, uint8_t strip_id, uint16_t num_pixels);
+
+/**
+ * @brief Set the effect of the strip. It is rendered in the next fire of the FSM.
+ *
+ * @param p_this Pointer to the strip FSM
+ * @param effect Effect, one of FSM_STRIP_EFFECT
+ * @param r Red of the colour of the effect
+ * @param g Green of the colour of the effect
+ * @param b Blue of the colour of the effect
+ */
+void fsm_strip_set_effect(fsm_t *p_this, uint8_t effect, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * @brief Trigger the effect of a code received from the remote.
+ *
+ * @param p_this Pointer to the strip FSM
+ * @param code NEC code
+ *
+ * @return `true` if the code is one of the colours or the OFF button of the remote, `false` if it has no effect on the strip
+ */
+bool fsm_strip_process_code(fsm_t *p_this, uint32_t code);
+
+/**
+ * @brief Switch the strip on or off. The effect is kept while it is off, and rendered again when it is switched on.
+ *
+ * @param p_this Pointer to the strip FSM
+ * @param enabled `true` to switch the strip on
+ */
+void fsm_strip_set_enabled(fsm_t *p_this, bool enabled);
+
+/**
+ * @brief Get the state that selects what the strip shows.
+ *
+ * @param p_this Pointer to the strip FSM
+ * @param p_state Pointer where the state is copied
+ */
+void fsm_strip_get_state(fsm_t *p_this, fsm_strip_state_t *p_state);
+
+/**
+ * @brief Restore a state got by fsm_strip_get_state(). It is rendered in the next fire of the FSM.
+ *
+ * @param p_this Pointer to the strip FSM
+ * @param p_state Pointer to the state
+ */
+void fsm_strip_set_state(fsm_t *p_this, const fsm_strip_state_t *p_state);
+
+/**
+ * @brief Check if a frame has to be rendered now and the port can take it.
+ *
+ * @param p_this Pointer to the strip FSM
+ *
+ * @return `true` if the FSM is active
+ */
+bool fsm_strip_check_activity(fsm_t *p_this);
+
+/**
+ * @brief Get the system time by which the system has to be awake for the strip. The DMA and the serial peripheral of the stream only run while the core waits for an interrupt, so the time is now while a stream is being sent. Otherwise it is the time of the next frame of an animated effect.
+ *
+ * @param p_this Pointer to the strip FSM
+ *
+ * @return System time in milliseconds, or #IDLE_GOVERNOR_NO_DEADLINE if there is nothing to render
+ */
+uint32_t fsm_strip_get_deadline(fsm_t *p_this);
+
+/**
+ * @brief Return the number of frames sent to the strip since the FSM was initialized.
+ *
+ * @param p_this Pointer to the strip FSM
+ *
+ * @return Number of frames
+ */
+uint32_t fsm_strip_get_num_frames(fsm_t *p_this);
+
+#endif /* FSM_STRIP_H_ */
@@ -20,7 +20,8 @@
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
 /* NEC transmission macros */
-#define NEC_TX_TIMER_TICK_BASE_US 56.25 /*!< Time base in microseconds to create the ticks for the timer of symbols */
+#define NEC_TX_TIMER_TICK_BASE_NS 56250U /*!< Time base in nanoseconds to create the ticks for the timer of symbols. The ports derive their timers from it */
+#define NEC_TX_TIMER_TICK_BASE_US (NEC_TX_TIMER_TICK_BASE_NS / 1000.0) /*!< Time base in microseconds to create the ticks for the timer of symbols */
 #define NEC_TX_PROLOGUE_TICKS_ON    160    /*!< Number of time base ticks for prologue ON in transmission  */
 #define NEC_TX_PROLOGUE_TICKS_OFF  80     /*!< Number of time base ticks for prologue OFF in transmission  */
 #define NEC_TX_SYM_0_TICKS_ON       10    /*!< Number of time base ticks for symbol 0 ON in transmission  */
@@ -28,9 +29,14 @@
 #define NEC_TX_SYM_1_TICKS_ON       10    /*!< Number of time base ticks for symbol 1 ON in transmission  */
 #define NEC_TX_SYM_1_TICKS_OFF      30    /*!< Number of time base ticks for symbol 1 OFF in transmission  */
 #define NEC_TX_EPILOGUE_TICKS_ON     10   /*!< Number of time base ticks for epilogue ON in transmission  */
-#define NEC_TX_EPILOGUE_TICKS_OFF 3560  /*!< Number of time base ticks for epilogue OFF in transmission ~200 miliseconds */
-#define NEC_PWM_FREQ_HZ        38000         /*!< PWM timer frequency in Hz */
-#define NEC_PWM_DC         0.35             /*!< PWM duty cycle 0-1  */
+#define NEC_TX_REPEAT_TICKS_ON 160      /*!< Number of time base ticks for the burst ON of a repeat code  */
+#define NEC_TX_REPEAT_TICKS_OFF 40      /*!< Number of time base ticks for the silence OFF of a repeat code  */
+#define NEC_TX_FRAME_PERIOD_MS 108      /*!< Minimum time in milliseconds between the start of two frames. The silence after a frame is waited without blocking */
+#define NEC_TX_FRAME_BITS 32            /*!< Number of bits of a NEC frame */
+#define NEC_TX_SCHEDULE_SIZE (2 * (NEC_TX_FRAME_BITS + 2)) /*!< Bursts and silences of the longest schedule, a NEC frame: the prologue, every bit and the epilogue */
+#define NEC_PWM_FREQ_HZ        38000U        /*!< PWM timer frequency in Hz */
+#define NEC_PWM_DC_PERCENT 35U              /*!< PWM duty cycle in percent. The ports derive their timers from it */
+#define NEC_PWM_DC         (NEC_PWM_DC_PERCENT / 100.0) /*!< PWM duty cycle 0-1  */
 
 /* Function prototypes and explanation ----------------------------------------*/
 
@@ -43,10 +49,31 @@ void fsm_tx_init (fsm_t *p_this, uint8_t tx_id);
 /*	Set the code given*/
 void fsm_tx_set_code (fsm_t *p_this, uint32_t code);
 
+/*	Request a NEC repeat code, as sent while a button of a remote is held*/
+void fsm_tx_set_repeat (fsm_t *p_this);
+
+/*	Set a raw waveform: the symbol ticks of its bursts and silences, alternately and starting with a burst, up to NEC_TX_SCHEDULE_SIZE. They are copied. It is sent in the frame period after any code or repeat code pending, with the carrier of NEC*/
+void fsm_tx_set_raw (fsm_t *p_this, const uint8_t *p_ticks, uint8_t num_steps);
+
+/*	Check if a new code, repeat code or raw waveform can be set: there is none pending and the frame period since the last frame has elapsed*/
+bool fsm_tx_is_ready (fsm_t *p_this);
+
+/*	Set the transmitters that send the frames of the FSM at once, switched by the same schedule. Its own transmitter is always included*/
+void fsm_tx_set_fanout (fsm_t *p_this, uint32_t tx_mask);
+
 /*	Start the process to transmit the code stored*/
 void fsm_send_NEC_code (uint8_t tx_id, uint32_t code);
 
-/*Check if the transmitter FSM is active, or not. As the system is the one controlling the output (PWM and symbol timer), this FSM will always be inactive and will wake up at each interruption of the symbol timer or PWM timer*/
+/*	Transmit the same NEC code on the transmitters of a mask (bit n for the ID n) at once, switched by one shared schedule*/
+void fsm_send_NEC_code_fanout (uint32_t tx_mask, uint32_t code);
+
+/*	Transmit a different NEC code on each transmitter at once, each with its own schedule, so that they take the time of one frame. A code 0x00 sends a repeat code. Up to PORT_TX_NUM_TRANSMITTERS transmitters*/
+void fsm_send_NEC_codes (const uint8_t *p_tx_ids, const uint32_t *p_codes, uint8_t num_tx);
+
+/*	Transmit a NEC repeat code*/
+void fsm_send_NEC_repeat (uint8_t tx_id);
+
+/*Check if the transmitter FSM is active, or not. The frames are sent while the FSM fires, so it is only active while a code, repeat code or raw waveform waits for the end of the frame period*/
 bool fsm_tx_check_activity (fsm_t *p_this);
 
 #endif
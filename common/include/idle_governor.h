@@ -0,0 +1,98 @@
+/**
+ * @file idle_governor.h
+ * @brief Header for idle_governor.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef IDLE_GOVERNOR_H_
+#define IDLE_GOVERNOR_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "port_system.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define IDLE_GOVERNOR_NO_DEADLINE 0xFFFFFFFFU  /*!< Value to indicate that there is no pending deadline */
+#define IDLE_GOVERNOR_STOP_MIN_IDLE_MS 20      /*!< Minimum predicted idle time in milliseconds that pays off entering STOP mode */
+#define IDLE_GOVERNOR_RECENT_ACTIVITY_MS 50    /*!< Time in milliseconds after an activity in which more activity is expected */
+#define IDLE_GOVERNOR_INITIAL_IDLE_MS 1000     /*!< Initial prediction of the idle time in milliseconds */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Structure of the idle governor.
+ *
+ * The governor predicts how long the system is going to be idle and selects the low-power mode accordingly. The prediction is an exponential moving average of the previous idle periods, bounded by the pending deadlines.
+ */
+typedef struct
+{
+  uint32_t predicted_idle_ms;                               /*!< Moving average of the duration of the last idle periods */
+  uint32_t idle_start_ms;                                   /*!< System time when the current idle period started */
+  uint32_t last_activity_ms;                                /*!< System time when the last idle period finished */
+  bool is_idle;                                             /*!< Flag to indicate that an idle period is in progress */
+  uint8_t last_mode;                                        /*!< Low-power mode used in the last sleep */
+  bool first_frame_pending;                                 /*!< Flag to indicate that no frame has been received since the last wake-up */
+  uint32_t first_frame_ok[PORT_SYSTEM_SLEEP_MODES];         /*!< Number of frames whose first edge woke the system up from each mode, decoded correctly */
+  uint32_t first_frame_err[PORT_SYSTEM_SLEEP_MODES];        /*!< Number of frames whose first edge woke the system up from each mode, with errors */
+} idle_governor_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize the idle governor.
+ *
+ * @param p_gov Pointer to the governor
+ */
+void idle_governor_init(idle_governor_t *p_gov);
+
+/**
+ * @brief Select the low-power mode for the predicted idle time.
+ *
+ * - If there was activity recently or the predicted idle time is too short to pay off the STOP mode, the core only waits for an interrupt.
+ * - Otherwise, if the infrared receiver is armed, the STOP mode keeps the main regulator on to wake up fast enough not to lose the first edges of a frame.
+ * - Otherwise, the STOP mode with the regulator in low-power mode is selected.
+ *
+ * @param p_gov Pointer to the governor
+ * @param now_ms Current system time in milliseconds
+ * @param deadline_ms System time of the next expected event, or #IDLE_GOVERNOR_NO_DEADLINE
+ * @param rx_armed `true` if the infrared receiver is waiting for frames
+ *
+ * @return Low-power mode to enter
+ */
+uint8_t idle_governor_select(idle_governor_t *p_gov, uint32_t now_ms, uint32_t deadline_ms, bool rx_armed);
+
+/**
+ * @brief Select a low-power mode and sleep until an interrupt wakes the system up.
+ *
+ * @param p_gov Pointer to the governor
+ * @param deadline_ms System time of the next expected event, or #IDLE_GOVERNOR_NO_DEADLINE
+ * @param rx_armed `true` if the infrared receiver is waiting for frames
+ */
+void idle_governor_sleep(idle_governor_t *p_gov, uint32_t deadline_ms, bool rx_armed);
+
+/**
+ * @brief Finish the current idle period because there is activity in the system.
+ *
+ * The duration of the idle period updates the prediction.
+ *
+ * @param p_gov Pointer to the governor
+ */
+void idle_governor_wake(idle_governor_t *p_gov);
+
+/**
+ * @brief Report the result of the reception of a frame.
+ *
+ * Only the first frame after a wake-up is accounted, and only if its first edge arrived during the idle period, that is, if the edge woke the system up. The edge is timestamped once the system is awake, so the frame is decoded correctly only if the wake-up latency of the mode does not eat into its leading burst beyond the tolerance of the decoder. The counts of each mode are added to the telemetry next to its residency, as the measure of the wake-up latency that matters to the receiver.
+ *
+ * @param p_gov Pointer to the governor
+ * @param ok `true` if the frame was decoded correctly
+ * @param first_edge_ms System time of the first edge of the frame
+ */
+void idle_governor_report_frame(idle_governor_t *p_gov, bool ok, uint32_t first_edge_ms);
+
+#endif /* IDLE_GOVERNOR_H_ */
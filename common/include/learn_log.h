@@ -0,0 +1,130 @@
+/**
+ * @file learn_log.h
+ * @brief Header for learn_log.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef LEARN_LOG_H_
+#define LEARN_LOG_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define LEARN_LOG_MAX_ENTRIES 2048     /*!< Maximum number of entries of the RAM index */
+#define LEARN_LOG_BUFFER_WORDS 128     /*!< Size in 32-bit words of the RAM buffer where the records wait to be programmed in a batch */
+#define LEARN_LOG_FLUSH_DELAY_MS 1000  /*!< Minimum age in milliseconds of the buffered records to program them when the system goes idle */
+#define LEARN_LOG_MAX_RAW_EDGES 128    /*!< Maximum number of edge intervals of a raw record */
+#define LEARN_LOG_COMPACT_KEEP_PCT 50  /*!< Percentage of the sector and of the index that the newest records keep when the log is compacted */
+#define LEARN_LOG_COMPACT_HIGH_PCT 90  /*!< Percentage of the sector or of the index above which learn_log_idle() compacts the log, before an append has to */
+
+/* Enums */
+/**
+ * @brief Types of record of the log.
+ */
+enum LEARN_LOG_TYPE
+{
+  LEARN_LOG_PAD = 0, /*!< Padding over a partially programmed area */
+  LEARN_LOG_NEC,     /*!< Code decoded with the NEC protocol */
+  LEARN_LOG_RAW,     /*!< Intervals between the edges of a frame of an unknown protocol, in ticks of the receiver timer */
+};
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Find the active sector of the log and rebuild the RAM index from it.
+ *
+ * The log lives in two flash sectors used alternately. Each sector starts with a header with a sequence number; the active sector is the valid one with the highest sequence. The records are appended one after the other until an erased word is found, so rebuilding the index is a single pass that reads one header word per record.
+ *
+ * When the active sector or the index is full, the log is compacted: the newest records, up to #LEARN_LOG_COMPACT_KEEP_PCT of the sector and of the index, are copied to the other sector, that becomes the active one, and the oldest records are dropped. Learning never stops, but a compaction blocks for the erasure of a sector.
+ */
+void learn_log_init(void);
+
+/**
+ * @brief Append a NEC code to the log, unless it is already there. The codes of the log are found by hash, so the check does not depend on the size of the log.
+ *
+ * The record is buffered in RAM. It is programmed when the buffer is full, when learn_log_flush() is called, or by learn_log_idle().
+ *
+ * @param code NEC code
+ * @param now_ms Current system time in milliseconds
+ *
+ * @return `true` if the code has been added. `false` if it was already there, or if the flash could not be programmed
+ */
+bool learn_log_append_code(uint32_t code, uint32_t now_ms);
+
+/**
+ * @brief Append a raw frame to the log.
+ *
+ * @param p_deltas Intervals between consecutive edges in ticks of the receiver timer
+ * @param num_deltas Number of intervals, up to #LEARN_LOG_MAX_RAW_EDGES
+ * @param now_ms Current system time in milliseconds
+ *
+ * @return `true` if the frame has been added
+ */
+bool learn_log_append_raw(const uint16_t *p_deltas, uint32_t num_deltas, uint32_t now_ms);
+
+/**
+ * @brief Program the buffered records in the flash.
+ */
+void learn_log_flush(void);
+
+/**
+ * @brief Program the buffered records if they have waited for at least #LEARN_LOG_FLUSH_DELAY_MS, and compact the log if it fills more than #LEARN_LOG_COMPACT_HIGH_PCT of the sector or of the index. To be called when the system is idle.
+ *
+ * @param now_ms Current system time in milliseconds
+ */
+void learn_log_idle(uint32_t now_ms);
+
+/**
+ * @brief Erase the log. The other sector becomes the active one, so that the erasures are spread over both sectors.
+ */
+void learn_log_clear(void);
+
+/**
+ * @brief Return the number of entries of the log.
+ *
+ * @return Number of entries
+ */
+uint32_t learn_log_get_num_entries(void);
+
+/**
+ * @brief Return the number of NEC codes of the log.
+ *
+ * @return Number of NEC codes
+ */
+uint32_t learn_log_get_num_codes(void);
+
+/**
+ * @brief Return the type of an entry.
+ *
+ * @param idx Index of the entry
+ *
+ * @return Type of the record, one of LEARN_LOG_TYPE
+ */
+uint8_t learn_log_get_type(uint32_t idx);
+
+/**
+ * @brief Return the code of a NEC entry.
+ *
+ * @param idx Index of the entry
+ *
+ * @return NEC code, or 0x00 if the entry is not a NEC code
+ */
+uint32_t learn_log_get_code(uint32_t idx);
+
+/**
+ * @brief Copy the intervals of a raw entry.
+ *
+ * @param idx Index of the entry
+ * @param p_deltas Pointer to the array where the intervals are copied
+ * @param max_deltas Size of the array
+ *
+ * @return Number of intervals copied, 0 if the entry is not raw
+ */
+uint32_t learn_log_get_raw(uint32_t idx, uint16_t *p_deltas, uint32_t max_deltas);
+
+#endif /* LEARN_LOG_H_ */
@@ -0,0 +1,226 @@
+/**
+ * @file rx_delta.h
+ * @brief Storage of the intervals between the edges captured by the infrared receivers.
+ *
+ * The ports store the interval from the previous edge in ticks of #NEC_RX_TIMER_TICK_BASE_US instead of the value of the timer, so that the decoders read it directly. The format is chosen at compile time with #RX_DELTA_BITS:
+ * - 16 (default): every interval is stored as is.
+ * - 8: every interval is rounded to #RX_DELTA_QUANTUM_TICKS and stored in a byte. Intervals that do not fit are stored as #RX_DELTA_ESCAPE followed by their exact ticks in two bytes, LSB first. The rounding widens the tolerances of the decoders by half a quantum.
+ *
+ * The capture of the edges, with its glitch filter, is shared by the ports too (rx_delta_store_edge()): they only read their timer and check the level of the pin.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef RX_DELTA_H_
+#define RX_DELTA_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "telemetry.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#ifndef RX_DELTA_BITS
+#define RX_DELTA_BITS 16 /*!< Bits of an entry of the buffers of intervals: 16 or 8 */
+#endif
+
+#define RX_DELTA_MAX_FRAME_EDGES NEC_FRAME_EDGES /*!< Edges of the longest frame of the protocols decoded, defined by their headers. Only NEC so far */
+#define RX_DELTA_NOISE_EDGES 4                   /*!< Edges of noise before a frame that still leave room for the whole frame */
+#define RX_DELTA_MAX_EDGES (RX_DELTA_MAX_FRAME_EDGES + RX_DELTA_NOISE_EDGES) /*!< Maximum number of edges stored by a receiver */
+
+#if RX_DELTA_BITS == 8
+#define RX_DELTA_QUANTUM_TICKS 5U  /*!< Ticks of an 8-bit entry */
+#define RX_DELTA_ESCAPE 0xFFU      /*!< Entry followed by the exact ticks of an interval too long for a byte */
+#define RX_DELTA_ESCAPE_ROOM 2U    /*!< Long intervals that the buffer has room for. The gap that ends a frame keeps the legal ones in a byte */
+#define RX_DELTA_BUFFER_SIZE ((RX_DELTA_MAX_EDGES - 1U) + 2U * RX_DELTA_ESCAPE_ROOM) /*!< Entries of the buffer of a receiver */
+typedef uint8_t rx_delta_t;        /*!< Entry of a buffer of intervals */
+#elif RX_DELTA_BITS == 16
+#define RX_DELTA_BUFFER_SIZE (RX_DELTA_MAX_EDGES - 1U) /*!< Entries of the buffer of a receiver */
+typedef uint16_t rx_delta_t;       /*!< Entry of a buffer of intervals */
+#else
+#error "RX_DELTA_BITS must be 8 or 16"
+#endif
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Edges of a frame being captured by a receiver and the state of its glitch filter. The intervals are stored in a buffer of the receiver, given to rx_delta_store_edge().
+ */
+typedef struct
+{
+  uint16_t num_delta_entries;              /*!< Entries of the buffer of intervals in use */
+  uint16_t edge_idx;                       /*!< Number of edges stored */
+  uint16_t first_tick;                     /*!< Tick of the first edge */
+  uint16_t last_tick;                      /*!< Tick of the last edge kept */
+  uint16_t prev_tick;                      /*!< Tick of the edge before last_tick */
+  uint16_t prev_delta_entries;             /*!< Value of num_delta_entries before last_tick was stored */
+  bool glitch_pending;                     /*!< Flag to indicate that the last edge stored is closer than glitch_ticks to last_tick. It is kept until the next edge tells which pair of edges is the glitch */
+  uint16_t pending_tick;                   /*!< Tick of the edge pending */
+  uint16_t pending_delta_entries;          /*!< Value of num_delta_entries before the edge pending was stored */
+  uint16_t glitch_ticks;                   /*!< Ticks under which an edge ends a glitch. 0 to store every edge */
+  volatile uint32_t num_glitches;          /*!< Number of edges dropped as glitches */
+} rx_delta_capture_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Append an interval to a buffer. It is called by the capture ISRs.
+ *
+ * @param p_deltas Buffer of intervals
+ * @param p_num_entries Entries used in the buffer. It is updated if the interval is stored
+ * @param size Entries of the buffer, usually #RX_DELTA_BUFFER_SIZE
+ * @param ticks Interval from the previous edge in ticks
+ * @return `true` if there was room for the interval
+ */
+static inline bool rx_delta_write(rx_delta_t *p_deltas, uint16_t *p_num_entries, uint16_t size, uint16_t ticks)
+{
+#if RX_DELTA_BITS == 8
+  uint32_t quanta = (ticks + RX_DELTA_QUANTUM_TICKS / 2U) / RX_DELTA_QUANTUM_TICKS;
+
+  if (quanta < RX_DELTA_ESCAPE)
+  {
+    if (*p_num_entries >= size)
+    {
+      return false;
+    }
+    p_deltas[(*p_num_entries)++] = (rx_delta_t)quanta;
+    return true;
+  }
+  if (*p_num_entries + 3U > size)
+  {
+    return false;
+  }
+  p_deltas[(*p_num_entries)++] = RX_DELTA_ESCAPE;
+  p_deltas[(*p_num_entries)++] = (rx_delta_t)(ticks & 0xFFU);
+  p_deltas[(*p_num_entries)++] = (rx_delta_t)(ticks >> 8);
+  return true;
+#else
+  if (*p_num_entries >= size)
+  {
+    return false;
+  }
+  p_deltas[(*p_num_entries)++] = ticks;
+  return true;
+#endif
+}
+
+/**
+ * @brief Read the next interval of a buffer.
+ *
+ * @param pp_delta Pointer to the next entry to read. It is moved past the interval
+ * @return Interval in ticks
+ */
+static inline uint16_t rx_delta_read(const rx_delta_t **pp_delta)
+{
+  const rx_delta_t *p_delta = *pp_delta;
+
+#if RX_DELTA_BITS == 8
+  if (p_delta[0] == RX_DELTA_ESCAPE)
+  {
+    *pp_delta = p_delta + 3;
+    return (uint16_t)(p_delta[1] | (p_delta[2] << 8));
+  }
+  *pp_delta = p_delta + 1;
+  return (uint16_t)(p_delta[0] * RX_DELTA_QUANTUM_TICKS);
+#else
+  *pp_delta = p_delta + 1;
+  return p_delta[0];
+#endif
+}
+
+/**
+ * @brief Clear the edges of a capture, to start the next one. The glitch filter keeps its threshold and its count.
+ *
+ * @param p_cap Capture
+ */
+static inline void rx_delta_capture_reset(rx_delta_capture_t *p_cap)
+{
+  p_cap->num_delta_entries = 0;
+  p_cap->edge_idx = 0;
+  p_cap->glitch_pending = false;
+}
+
+/**
+ * @brief Store an edge of a capture as the interval from the previous one. It is called by the capture ISRs with the tick of the edge, once its level has been checked.
+ *
+ * Two edges closer than the threshold bound a glitch. When the edge after them is close too, the pair of the shortest interval is the glitch, so that the edge kept is the one of the frame: the intervals are rolled back to the edge before the glitch.
+ *
+ * @param p_cap Capture
+ * @param p_deltas Buffer of intervals of the capture
+ * @param size Entries of the buffer, usually #RX_DELTA_BUFFER_SIZE
+ * @param tick Tick of the edge. The timer wraps, so the 16-bit difference with the previous edge is still valid
+ * @return `false` if the edge ended a glitch and was dropped. An edge lost because the buffer is full is counted as stored
+ */
+static inline bool rx_delta_store_edge(rx_delta_capture_t *p_cap, rx_delta_t *p_deltas, uint16_t size, uint16_t tick)
+{
+  uint16_t num_entries;
+
+  telemetry_add(TELEMETRY_RX_EDGES, 1);
+  if (p_cap->glitch_pending)
+  {
+    uint16_t glitch_ticks = (uint16_t)(p_cap->pending_tick - p_cap->last_tick);
+    uint16_t next_ticks = (uint16_t)(tick - p_cap->pending_tick);
+
+    p_cap->glitch_pending = false;
+    p_cap->num_glitches += 2;
+    telemetry_add(TELEMETRY_RX_EDGES_GLITCH, 2);
+    if (next_ticks < p_cap->glitch_ticks && next_ticks <= glitch_ticks)
+    {
+      p_cap->num_delta_entries = p_cap->pending_delta_entries;
+      p_cap->edge_idx--;
+      return false;
+    }
+    p_cap->num_delta_entries = p_cap->prev_delta_entries;
+    p_cap->last_tick = p_cap->prev_tick;
+    p_cap->edge_idx -= 2;
+  }
+  num_entries = p_cap->num_delta_entries;
+
+  if (p_cap->edge_idx == 0)
+  {
+    p_cap->first_tick = tick;
+    p_cap->prev_tick = tick;
+    p_cap->prev_delta_entries = 0;
+    p_cap->last_tick = tick;
+    p_cap->edge_idx++;
+  }
+  else if (rx_delta_write(p_deltas, &p_cap->num_delta_entries, size, (uint16_t)(tick - p_cap->last_tick)))
+  {
+    if ((uint16_t)(tick - p_cap->last_tick) < p_cap->glitch_ticks)
+    {
+      p_cap->pending_tick = tick;
+      p_cap->pending_delta_entries = num_entries;
+      p_cap->glitch_pending = true;
+    }
+    else
+    {
+      p_cap->prev_tick = p_cap->last_tick;
+      p_cap->prev_delta_entries = num_entries;
+      p_cap->last_tick = tick;
+    }
+    p_cap->edge_idx++;
+  }
+  else
+  {
+    /* The buffer is full: the edge is lost */
+    telemetry_add(TELEMETRY_RX_EDGES_OVERFLOW, 1);
+  }
+  return true;
+}
+
+/**
+ * @brief Get the time from the first to the last edge stored of a capture, the one of a glitch pending included.
+ *
+ * @param p_cap Capture
+ * @return Duration in ticks
+ */
+static inline uint16_t rx_delta_capture_duration(const rx_delta_capture_t *p_cap)
+{
+  return (uint16_t)((p_cap->glitch_pending ? p_cap->pending_tick : p_cap->last_tick) - p_cap->first_tick);
+}
+
+#endif
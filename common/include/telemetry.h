@@ -0,0 +1,116 @@
+/**
+ * @file telemetry.h
+ * @brief Header for telemetry.c file.
+ *
+ * The counters of the infrared pipeline are 32-bit words of a fixed block, incremented in the hot paths with telemetry_add(). Every counter is written from a single context (the capture ISR, the deferred interrupt or the main loop), so the increments need no lock. The block is read as one versioned snapshot, that is sent over the debug link and decoded on the host by `tools/telemetry.py`.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Enums */
+/**
+ * @brief Counters of the telemetry block. New counters are appended before #TELEMETRY_COUNTERS and increase #TELEMETRY_VERSION, so that the layout of a version never changes.
+ */
+enum TELEMETRY_COUNTER
+{
+  TELEMETRY_RX_EDGES = 0,          /*!< Edges seen by the capture ISRs of the receivers */
+  TELEMETRY_RX_EDGES_OVERFLOW,     /*!< Edges dropped because the buffer of the receiver was full */
+  TELEMETRY_RX_EDGES_GLITCH,       /*!< Edges dropped by the glitch filter of the receiver */
+  TELEMETRY_RX_FRAMES,             /*!< Frames decoded, filtered ones excluded */
+  TELEMETRY_RX_REPETITIONS,        /*!< Repetition codes decoded, filtered ones excluded */
+  TELEMETRY_RX_ERROR_PROLOGUE,     /*!< Captures without a valid prologue */
+  TELEMETRY_RX_ERROR_SYMBOL,       /*!< Frames with an interval out of the windows of the symbols */
+  TELEMETRY_RX_ERROR_TRUNCATED,    /*!< Frames whose edges ended before their last symbol */
+  TELEMETRY_RX_INVERSE_MISMATCH,   /*!< Frames whose command does not match its inverse. They are still delivered, as extended codes use the byte freely, except the code 0x00000000 */
+  TELEMETRY_RX_FILTERED,           /*!< Frames and repetition codes dropped by the address filter */
+  TELEMETRY_RX_FIFO_DROPPED,       /*!< Frames dropped because the FIFO of the receiver was full */
+  TELEMETRY_TX_FRAMES,             /*!< Frames sent, counted once per group of transmitters */
+  TELEMETRY_TX_REPETITIONS,        /*!< Repetition codes sent, counted once per group of transmitters */
+  TELEMETRY_TX_BUSY_US,            /*!< Time spent modulating, in microseconds */
+  TELEMETRY_WAKEUPS,               /*!< Wake-ups by an ISR. Sampled when the snapshot is taken */
+  TELEMETRY_SLEEP_WFI_MS,          /*!< Residency in sleep mode (WFI), in milliseconds. Sampled when the snapshot is taken */
+  TELEMETRY_SLEEP_STOP_FAST_MS,    /*!< Residency in STOP mode with the main regulator, in milliseconds. Sampled when the snapshot is taken */
+  TELEMETRY_SLEEP_STOP_MS,         /*!< Residency in STOP mode with the low-power regulator, in milliseconds. Sampled when the snapshot is taken */
+  TELEMETRY_WAKE_FRAME_OK_WFI,     /*!< Frames whose first edge woke the system up from sleep mode (WFI) and that were decoded */
+  TELEMETRY_WAKE_FRAME_OK_STOP_FAST, /*!< Frames whose first edge woke the system up from STOP mode with the main regulator and that were decoded */
+  TELEMETRY_WAKE_FRAME_OK_STOP,    /*!< Frames whose first edge woke the system up from STOP mode with the low-power regulator and that were decoded */
+  TELEMETRY_WAKE_FRAME_ERR_WFI,    /*!< Frames whose first edge woke the system up from sleep mode (WFI) and that could not be decoded */
+  TELEMETRY_WAKE_FRAME_ERR_STOP_FAST, /*!< Frames whose first edge woke the system up from STOP mode with the main regulator and that could not be decoded */
+  TELEMETRY_WAKE_FRAME_ERR_STOP,   /*!< Frames whose first edge woke the system up from STOP mode with the low-power regulator and that could not be decoded */
+  TELEMETRY_COUNTERS               /*!< Number of counters */
+};
+
+/* Defines */
+#define TELEMETRY_MAGIC 0x4D4C4554U      /*!< First word of a snapshot: "TELM" in little endian */
+#define TELEMETRY_VERSION 2U             /*!< Layout of the counters of the snapshot */
+#define TELEMETRY_PERIOD_MS 10000U       /*!< Minimum time between the snapshots sent by telemetry_idle() */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Snapshot of the telemetry block, as sent over the debug link: little-endian fields without padding.
+ */
+typedef struct
+{
+  uint32_t magic;                         /*!< #TELEMETRY_MAGIC */
+  uint16_t version;                       /*!< #TELEMETRY_VERSION */
+  uint16_t num_counters;                  /*!< Number of counters that follow the header */
+  uint32_t sequence;                      /*!< Number of the snapshot since the system started */
+  uint32_t uptime_ms;                     /*!< System time when the snapshot was taken */
+  uint32_t counters[TELEMETRY_COUNTERS];  /*!< Counters, indexed by TELEMETRY_COUNTER */
+  uint32_t checksum;                      /*!< Sum of the previous words, so that a snapshot cut by the link is detected */
+} telemetry_snapshot_t;
+
+/* Global variables ------------------------------------------------------------*/
+extern volatile uint32_t telemetry_counters_arr[TELEMETRY_COUNTERS]; /*!< Telemetry block. Only written through telemetry_add() */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Add a value to a counter. It is inlined in the hot paths.
+ *
+ * @param counter Counter, one of TELEMETRY_COUNTER
+ * @param value Value added. The counter wraps
+ */
+static inline void telemetry_add(uint8_t counter, uint32_t value)
+{
+  telemetry_counters_arr[counter] += value;
+}
+
+/**
+ * @brief Clear the counters.
+ */
+void telemetry_reset(void);
+
+/**
+ * @brief Take a snapshot of the telemetry block. The counters sampled from other modules are read at this moment.
+ *
+ * @param p_snapshot Pointer to the snapshot to fill in
+ * @param now_ms Current system time in milliseconds
+ */
+void telemetry_get_snapshot(telemetry_snapshot_t *p_snapshot, uint32_t now_ms);
+
+/**
+ * @brief Take a snapshot and send it over the debug link of the port.
+ *
+ * @param now_ms Current system time in milliseconds
+ */
+void telemetry_send(uint32_t now_ms);
+
+/**
+ * @brief Send a snapshot if #TELEMETRY_PERIOD_MS have passed since the last one. To be called when the system is idle.
+ *
+ * @param now_ms Current system time in milliseconds
+ */
+void telemetry_idle(uint32_t now_ms);
+
+#endif /* TELEMETRY_H_ */
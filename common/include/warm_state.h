@@ -0,0 +1,75 @@
+/**
+ * @file warm_state.h
+ * @brief Header for warm_state.c file.
+ *
+ * The state that the user sees of the system (the mode, the colour of the receiver, the learning mode, the position in the playlist and the effect of the strip) is kept in the backup SRAM of the port (`port_backup.h`), that survives the system resets, so that a reset by the watchdog or a brown-out does not switch the lights off. The state is written on every change with a CRC-32, in one of two slots used alternately, so that a reset in the middle of a write leaves the previous state valid.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef WARM_STATE_H_
+#define WARM_STATE_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "fsm_strip.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define WARM_STATE_MAGIC 0x4D524157U /*!< First word of a record: "WARM" in little endian. To be changed with the layout of #warm_state_t, so that the state of another firmware is not restored */
+
+/* Enums */
+/**
+ * @brief Modes of the system.
+ */
+enum WARM_STATE_MODE
+{
+  WARM_STATE_MODE_TX = 0, /*!< Transmission mode */
+  WARM_STATE_MODE_RX,     /*!< Reception mode */
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief State restored after a system reset. It has no padding, so that two states are compared and checked byte by byte.
+ */
+typedef struct
+{
+  uint32_t rx_code;          /*!< Last code received, shown by the RGB LED in reception mode */
+  uint32_t tx_codes_index;   /*!< Index of the next code of the playlist to send */
+  uint8_t mode;              /*!< Mode, one of WARM_STATE_MODE */
+  uint8_t learning;          /*!< 1 if the received frames are stored in the learning log */
+  uint16_t reserved;         /*!< Always 0 */
+  fsm_strip_state_t strip;   /*!< Effect of the strip. All 0 if there is no strip */
+} warm_state_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize the backup SRAM and load the last state saved, if any.
+ *
+ * @param p_state Pointer where the state is copied
+ *
+ * @return `true` if a valid state has been found: the system is restarting after a reset. `false` after a loss of the supply, or in the first boot; @p p_state is not modified
+ */
+bool warm_state_load(warm_state_t *p_state);
+
+/**
+ * @brief Save a state in the backup SRAM, unless it is the same as the last one saved or loaded. To be called after every change of the state.
+ *
+ * @param p_state Pointer to the state
+ */
+void warm_state_save(const warm_state_t *p_state);
+
+/**
+ * @brief Return the number of states written in the backup SRAM since warm_state_load().
+ *
+ * @return Number of writes
+ */
+uint32_t warm_state_get_num_saves(void);
+
+#endif /* WARM_STATE_H_ */
@@ -0,0 +1,53 @@
+/**
+ * @file ws2812.h
+ * @brief Header for ws2812.c file.
+ *
+ * Encoder of the frames of the addressable LEDs of the WS2812 class into the bitstream of a serial peripheral. Each bit of the LEDs is sent as #WS2812_SUBBITS_PER_BIT bits of the stream: `100` for a 0 and `110` for a 1, so that the high time is 1/3 or 2/3 of the period of the bit. The LEDs take the colours in the order green, red and blue, most significant bit first. The stream is made of 16-bit halfwords, most significant bit first, and ends with #WS2812_RESET_HALFWORDS halfwords at 0 that latch the frame.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef WS2812_H_
+#define WS2812_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define WS2812_SUBBITS_PER_BIT 3U      /*!< Bits of the stream per bit of the LEDs */
+#define WS2812_BITS_PER_PIXEL 24U      /*!< Bits of the LEDs per pixel: 8 per colour */
+#define WS2812_BIT_RATE_HZ 2400000U    /*!< Bit rate of the stream: 1.25 us per bit of the LEDs */
+#define WS2812_RESET_US 300U           /*!< Low time that latches a frame. Longer than the 280 us of the newest LEDs */
+#define WS2812_RESET_HALFWORDS ((WS2812_RESET_US * (WS2812_BIT_RATE_HZ / 1000000U) + 15U) / 16U) /*!< Halfwords at 0 at the end of the stream */
+
+/*Halfwords of the stream of a frame of a number of pixels: 9 per 2 pixels, the last one padded with 0, and the reset.*/
+#define WS2812_STREAM_HALFWORDS(num_pixels) (((num_pixels) * WS2812_BITS_PER_PIXEL * WS2812_SUBBITS_PER_BIT + 15U) / 16U + WS2812_RESET_HALFWORDS)
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Colour of a pixel.
+ */
+typedef struct
+{
+  uint8_t r; /*!< Red */
+  uint8_t g; /*!< Green */
+  uint8_t b; /*!< Blue */
+} ws2812_pixel_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Encode a frame into the stream of the serial peripheral, including the reset.
+ *
+ * @param p_pixels Pointer to the colours of the pixels, from the first LED of the strip
+ * @param num_pixels Number of pixels
+ * @param p_stream Pointer to the stream, of at least WS2812_STREAM_HALFWORDS(num_pixels) halfwords
+ *
+ * @return Number of halfwords of the stream: WS2812_STREAM_HALFWORDS(num_pixels)
+ */
+uint32_t ws2812_encode(const ws2812_pixel_t *p_pixels, uint32_t num_pixels, uint16_t *p_stream);
+
+#endif /* WS2812_H_ */
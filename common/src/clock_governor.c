@@ -0,0 +1,74 @@
+/**
+ * @file clock_governor.c
+ * @brief Clock governor to scale the frequency of the system with its activity.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+
+/* Other includes */
+#include "clock_governor.h"
+
+/* Public functions */
+
+/*Initialize the clock governor and set the clock of the policy while idle.*/
+void clock_governor_init(clock_governor_t *p_gov, uint8_t policy)
+{
+  memset(p_gov, 0, sizeof(clock_governor_t));
+  p_gov->policy = policy;
+  p_gov->is_idle = true;
+  port_system_clock_set(PORT_SYSTEM_CLOCK_LOW);
+}
+
+/*Boost the clock because there is activity in the system.*/
+void clock_governor_busy(clock_governor_t *p_gov)
+{
+  p_gov->is_idle = false;
+  if ((p_gov->policy != CLOCK_GOVERNOR_ALWAYS_LOW) && (port_system_clock_get() != PORT_SYSTEM_CLOCK_BOOST))
+  {
+    port_system_clock_set(PORT_SYSTEM_CLOCK_BOOST);
+    p_gov->boosts++;
+  }
+}
+
+/*Drop to the low clock if the system has been idle long enough.*/
+void clock_governor_idle(clock_governor_t *p_gov)
+{
+  uint32_t now_ms = port_system_get_millis();
+
+  if (!p_gov->is_idle)
+  {
+    p_gov->is_idle = true;
+    p_gov->idle_start_ms = now_ms;
+  }
+  if ((p_gov->policy == CLOCK_GOVERNOR_DYNAMIC) && ((now_ms - p_gov->idle_start_ms) >= CLOCK_GOVERNOR_HOLD_MS))
+  {
+    port_system_clock_set(PORT_SYSTEM_CLOCK_LOW);
+  }
+}
+
+/*Boost the clock for a burst of work in an interrupt.*/
+void clock_governor_burst_start(clock_governor_t *p_gov)
+{
+  p_gov->burst_boosted = false;
+  if ((p_gov->policy != CLOCK_GOVERNOR_ALWAYS_LOW) && (port_system_clock_get() != PORT_SYSTEM_CLOCK_BOOST))
+  {
+    port_system_clock_set(PORT_SYSTEM_CLOCK_BOOST);
+    p_gov->boosts++;
+    p_gov->burst_boosted = true;
+  }
+}
+
+/*Drop the clock boosted by the burst.*/
+void clock_governor_burst_end(clock_governor_t *p_gov)
+{
+  if (p_gov->burst_boosted && (p_gov->policy == CLOCK_GOVERNOR_DYNAMIC))
+  {
+    port_system_clock_set(PORT_SYSTEM_CLOCK_LOW);
+  }
+  p_gov->burst_boosted = false;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file dlog.c
+ * @brief Deferred log: ring of the records of the messages and its flush to the debug link.
+ *
+ * The ring has several producers, the main loop and the ISRs, and a single consumer, the main loop in idle time. A producer reserves a slot by advancing the head with a compare-and-swap, that preempting producers retry, and then fills it in. The header is written last, so the consumer stops at a slot reserved by a producer that has been preempted before completing it.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dlog.h"
+#include "port_system.h"
+#include <stdatomic.h>
+
+/* Defines --------------------------------------------------------------------*/
+#define DLOG_RECORD_WORDS (2U + DLOG_MAX_ARGS) /*!< Words of the longest record: header, time and arguments */
+
+_Static_assert((DLOG_RING_SIZE & (DLOG_RING_SIZE - 1U)) == 0, "The indexes of the ring are free-running, so its size must be a power of 2");
+_Static_assert(DLOG_MAX_ARGS < 16U, "The number of arguments must fit in 4 bits of the header");
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Slot of the ring.
+ */
+typedef struct
+{
+  _Atomic uint32_t header;       /*!< Header of the record. 0 while the slot is free or being written */
+  uint32_t ms;                   /*!< System time when the record was stored */
+  uint32_t args[DLOG_MAX_ARGS];  /*!< Arguments */
+} dlog_slot_t;
+
+/* Global variables ------------------------------------------------------------*/
+static dlog_slot_t ring_arr[DLOG_RING_SIZE]; /*!< Records not flushed yet */
+static _Atomic uint32_t head = 0;             /*!< Free-running index of the next slot to reserve */
+static _Atomic uint32_t tail = 0;             /*!< Free-running index of the next slot to flush */
+static _Atomic uint32_t num_dropped = 0;      /*!< Records dropped because the ring was full */
+static uint32_t num_dropped_sent = 0;         /*!< Records dropped already reported on the link */
+
+/* Public functions */
+
+/*Store a record in the ring.*/
+void dlog_write(uint32_t header, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+  uint32_t index = atomic_load_explicit(&head, memory_order_relaxed);
+  dlog_slot_t *p_slot;
+
+  do
+  {
+    /* The slot is reused only after the consumer has cleared it */
+    if (index - atomic_load_explicit(&tail, memory_order_acquire) >= DLOG_RING_SIZE)
+    {
+      atomic_fetch_add_explicit(&num_dropped, 1, memory_order_relaxed);
+      return;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&head, &index, index + 1U, memory_order_relaxed, memory_order_relaxed));
+
+  p_slot = &ring_arr[index % DLOG_RING_SIZE];
+  p_slot->ms = port_system_get_millis();
+  p_slot->args[0] = arg0;
+  p_slot->args[1] = arg1;
+  p_slot->args[2] = arg2;
+  p_slot->args[3] = arg3;
+  atomic_store_explicit(&p_slot->header, header, memory_order_release);
+}
+
+/*Send the records of the ring to the debug link.*/
+void dlog_flush(void)
+{
+  uint32_t index = atomic_load_explicit(&tail, memory_order_relaxed);
+  uint32_t dropped = atomic_load_explicit(&num_dropped, memory_order_relaxed);
+
+  while (index != atomic_load_explicit(&head, memory_order_relaxed))
+  {
+    dlog_slot_t *p_slot = &ring_arr[index % DLOG_RING_SIZE];
+    uint32_t record[DLOG_RECORD_WORDS];
+    uint32_t header = atomic_load_explicit(&p_slot->header, memory_order_acquire);
+    uint32_t num_args;
+
+    /* Reserved by a producer that has not completed it yet */
+    if (header == 0)
+    {
+      break;
+    }
+    num_args = (header >> DLOG_ID_BITS) & 0x0FU;
+    record[0] = header;
+    record[1] = p_slot->ms;
+    for (uint32_t i = 0; i < num_args; i++)
+    {
+      record[2U + i] = p_slot->args[i];
+    }
+    atomic_store_explicit(&p_slot->header, 0, memory_order_relaxed);
+    atomic_store_explicit(&tail, ++index, memory_order_release);
+    port_system_debug_write(PORT_SYSTEM_DEBUG_LOG, (const uint8_t *)record, (2U + num_args) * sizeof(uint32_t));
+  }
+
+  if (dropped != num_dropped_sent)
+  {
+    uint32_t record[3] = {DLOG_HEADER(DLOG_ID_DROPPED, 1), port_system_get_millis(), dropped - num_dropped_sent};
+
+    num_dropped_sent = dropped;
+    port_system_debug_write(PORT_SYSTEM_DEBUG_LOG, (const uint8_t *)record, sizeof(record));
+  }
+}
+
+/*Check if there are records in the ring.*/
+bool dlog_check_pending(void)
+{
+  return atomic_load_explicit(&tail, memory_order_relaxed) != atomic_load_explicit(&head, memory_order_relaxed);
+}
+
+/*Return the number of records dropped.*/
+uint32_t dlog_get_num_dropped(void)
+{
+  return atomic_load_explicit(&num_dropped, memory_order_relaxed);
+}
@@ -0,0 +1,137 @@
+/**
+ * @file energy.c
+ * @brief Accounting of the time spent in each power state and with each peripheral active, and estimation of the consumption.
+ *
+ * This module does not depend on the HW: the port reports the durations and the system time, so the same figures can be reproduced on any platform.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+
+/* Other includes */
+#include "energy.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define US_PER_MS 1000ULL                /*!< Microseconds in a millisecond */
+#define US_PER_KILOSECOND 1000000000ULL  /*!< Microseconds in 1000 seconds */
+#define HOURS_PER_DAY 24U                /*!< Hours in a day */
+
+/* Global variables ------------------------------------------------------------*/
+static energy_model_t model = {
+    .state_ua = {[ENERGY_STATE_WFI] = ENERGY_WFI_UA, [ENERGY_STATE_STOP_FAST] = ENERGY_STOP_FAST_UA, [ENERGY_STATE_STOP] = ENERGY_STOP_UA, [ENERGY_STATE_RUN] = ENERGY_RUN_UA},
+    .periph_ua = {[ENERGY_PERIPH_TX_PWM] = ENERGY_TX_PWM_UA, [ENERGY_PERIPH_RGB_R] = ENERGY_RGB_UA, [ENERGY_PERIPH_RGB_G] = ENERGY_RGB_UA, [ENERGY_PERIPH_RGB_B] = ENERGY_RGB_UA, [ENERGY_PERIPH_CLOCK_BOOST] = ENERGY_CLOCK_BOOST_UA},
+}; /*!< Current model used for the estimation */
+
+static uint32_t start_ms = 0;                    /*!< System time when the accounting started */
+static uint64_t state_us[ENERGY_STATES];         /*!< Residency in each low-power state */
+static uint64_t periph_us[ENERGY_PERIPHS];       /*!< Time each peripheral has been active, not counting the current activation */
+static bool periph_on[ENERGY_PERIPHS];           /*!< Flag to indicate that a peripheral is active */
+static uint32_t periph_on_ms[ENERGY_PERIPHS];    /*!< System time when each active peripheral was switched on */
+static volatile uint32_t wakeups = 0;            /*!< Number of wake-ups by an ISR */
+
+/* Public functions */
+
+/*Restart the accounting.*/
+void energy_reset(uint32_t now_ms)
+{
+  start_ms = now_ms;
+  memset(state_us, 0, sizeof(state_us));
+  memset(periph_us, 0, sizeof(periph_us));
+  for (uint8_t i = 0; i < ENERGY_PERIPHS; i++)
+  {
+    periph_on_ms[i] = now_ms;
+  }
+  wakeups = 0;
+}
+
+/*Set the current model used to estimate the consumption.*/
+void energy_set_model(const energy_model_t *p_model)
+{
+  model = *p_model;
+}
+
+/*Account the time spent in a low-power state.*/
+void energy_add_state_time(uint8_t state, uint32_t duration_us)
+{
+  state_us[state] += duration_us;
+}
+
+/*Account the time a peripheral has been active.*/
+void energy_add_periph_time(uint8_t periph, uint32_t duration_us)
+{
+  periph_us[periph] += duration_us;
+}
+
+/*Switch a peripheral on or off.*/
+void energy_set_periph(uint8_t periph, bool on, uint32_t now_ms)
+{
+  if (on && !periph_on[periph])
+  {
+    periph_on_ms[periph] = now_ms;
+  }
+  else if (!on && periph_on[periph])
+  {
+    periph_us[periph] += (now_ms - periph_on_ms[periph]) * US_PER_MS;
+  }
+  periph_on[periph] = on;
+}
+
+/*Count a wake-up of the system by an ISR.*/
+void energy_count_wakeup(void)
+{
+  wakeups++;
+}
+
+/*Return the number of wake-ups by an ISR.*/
+uint32_t energy_get_wakeups(void)
+{
+  return wakeups;
+}
+
+/*Get a snapshot of the accounting and the estimated consumption.*/
+void energy_get_report(energy_report_t *p_report, uint32_t now_ms)
+{
+  uint64_t sleep_us = 0;
+  uint64_t charge = 0; /* Microamperes times microseconds */
+
+  memset(p_report, 0, sizeof(energy_report_t));
+  p_report->elapsed_us = (now_ms - start_ms) * US_PER_MS;
+  p_report->wakeups = wakeups;
+
+  for (uint8_t i = 0; i < ENERGY_STATES; i++)
+  {
+    if (i != ENERGY_STATE_RUN)
+    {
+      p_report->state_us[i] = state_us[i];
+      sleep_us += state_us[i];
+    }
+  }
+  /* The millisecond counter and the residencies are measured with different clocks: do not let the run time go negative */
+  p_report->state_us[ENERGY_STATE_RUN] = (p_report->elapsed_us > sleep_us) ? (p_report->elapsed_us - sleep_us) : 0;
+
+  for (uint8_t i = 0; i < ENERGY_PERIPHS; i++)
+  {
+    p_report->periph_us[i] = periph_us[i];
+    if (periph_on[i])
+    {
+      p_report->periph_us[i] += (now_ms - periph_on_ms[i]) * US_PER_MS;
+    }
+    charge += p_report->periph_us[i] * model.periph_ua[i];
+  }
+  for (uint8_t i = 0; i < ENERGY_STATES; i++)
+  {
+    charge += p_report->state_us[i] * model.state_ua[i];
+  }
+
+  if (p_report->elapsed_us > 0)
+  {
+    p_report->average_ua = (uint32_t)(charge / p_report->elapsed_us);
+    p_report->wakeups_per_kilosecond = (uint32_t)((p_report->wakeups * US_PER_KILOSECOND) / p_report->elapsed_us);
+  }
+  p_report->uah_per_day = p_report->average_ua * HOURS_PER_DAY;
+}
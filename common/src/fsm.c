@@ -14,7 +14,7 @@
 /* Other includes */
 #include "fsm.h"
 
-fsm_t *fsm_new(fsm_trans_t *p_tt)
+fsm_t *fsm_new(const fsm_trans_t *p_tt)
 {
   if (p_tt == NULL)
   {
@@ -32,7 +32,7 @@ fsm_t *fsm_new(fsm_trans_t *p_tt)
   return p_fsm;
 }
 
-void fsm_init(fsm_t *p_fsm, fsm_trans_t *p_tt)
+void fsm_init(fsm_t *p_fsm, const fsm_trans_t *p_tt)
 {
   if (p_tt != NULL)
   {
@@ -48,7 +48,7 @@ void fsm_destroy(fsm_t *p_fsm)
 
 void fsm_fire(fsm_t *p_fsm)
 {
-  fsm_trans_t *p_t;
+  const fsm_trans_t *p_t;
   for (p_t = p_fsm->p_tt; p_t->orig_state >= 0; ++p_t)
   {
     if ((p_fsm->current_state == p_t->orig_state) && p_t->in(p_fsm))
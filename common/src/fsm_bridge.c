@@ -0,0 +1,589 @@
+/**
+ * @file fsm_bridge.c
+ * @brief Bridge FSM main file. It executes the commands of a host received over a serial link, and streams back the frames received.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_bridge.h"
+#include "fsm_macro.h"
+#include "port_uart.h"
+#include "port_tx.h"
+#include "port_system.h"
+#include "telemetry.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_BRIDGE_RX_CHUNK 64U /*Bytes read from the link at once*/
+#define FSM_BRIDGE_HEADER_SIZE 4U /*Bytes of a packet before the payload: sync, type, sequence and length*/
+#define FSM_BRIDGE_FRAME_EVENT_SIZE 19U /*Bytes of the payload of a FSM_BRIDGE_EVT_FRAME event*/
+#define FSM_BRIDGE_STEP_SIZE 8U /*Bytes of a step of a macro in the payload of FSM_BRIDGE_CMD_QUEUE_MACRO*/
+
+_Static_assert(FSM_BRIDGE_MAX_PAYLOAD <= 0xFFU, "The length of a payload does not fit in a byte");
+_Static_assert(1U + sizeof(telemetry_snapshot_t) <= FSM_BRIDGE_MAX_PAYLOAD, "The response of the telemetry does not fit in a payload");
+_Static_assert(1U + FSM_BRIDGE_STEP_SIZE * FSM_BRIDGE_MACRO_MAX_STEPS <= FSM_BRIDGE_MAX_PAYLOAD, "The longest macro does not fit in a payload");
+
+/* Enums */
+enum FSM_BRIDGE{
+    WAIT_BRIDGE /*Unique state of the FSM waiting for commands and for the transmitter*/
+};
+
+/*Fields of a packet expected by the parser.*/
+enum FSM_BRIDGE_PARSE{
+    PARSE_SYNC = 0,
+    PARSE_TYPE,
+    PARSE_SEQUENCE,
+    PARSE_LENGTH,
+    PARSE_PAYLOAD,
+    PARSE_CHECKSUM
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t code; /*Code of FSM_BRIDGE_CMD_SEND_CODE and FSM_BRIDGE_CMD_HOLD_START*/
+    uint16_t hold_ms; /*Time to hold of FSM_BRIDGE_CMD_HOLD_START. 0 until FSM_BRIDGE_CMD_HOLD_STOP*/
+    uint8_t type; /*Type of the command*/
+    uint8_t seq; /*Sequence of the command, reported when it is started*/
+    uint8_t tx_mask; /*Transmitters of the command*/
+}fsm_bridge_job_t;
+
+typedef struct
+{
+    fsm_t f; /*Bridge FSM*/
+    fsm_t *p_fsm_tx; /*Pointer to the FSM of the infrared transmitter*/
+    fsm_t *p_fsm_macro; /*Pointer to the FSM that plays the macros through the transmitter*/
+    uint8_t uart_id; /*Serial link ID*/
+    uint8_t rx_chunk[FSM_BRIDGE_RX_CHUNK]; /*Bytes read from the link and not parsed yet*/
+    uint8_t chunk_len; /*Bytes in rx_chunk*/
+    uint8_t chunk_pos; /*Next byte of rx_chunk to parse*/
+    uint8_t parse_state; /*Field expected by the parser, one of FSM_BRIDGE_PARSE*/
+    uint8_t type; /*Type of the packet being parsed*/
+    uint8_t seq; /*Sequence of the packet being parsed*/
+    uint8_t len; /*Length of the payload of the packet being parsed*/
+    uint8_t num_payload; /*Bytes of the payload parsed*/
+    uint8_t sum; /*Sum of the bytes of the packet parsed*/
+    uint8_t payload[FSM_BRIDGE_MAX_PAYLOAD]; /*Payload of the packet being parsed*/
+    bool has_command; /*Flag to indicate that a command has been parsed and not executed yet*/
+    bool link_open; /*Flag to indicate that a byte has been received since the FSM was created*/
+    uint32_t last_rx_ms; /*System time of the last byte received*/
+    bool has_last; /*Flag to indicate that a command has been answered with a status*/
+    uint8_t last_type; /*Type of the last command answered with a status*/
+    uint8_t last_seq; /*Sequence of the last command answered with a status*/
+    uint8_t last_status; /*Status of the last command, to answer it again if the host sends it again*/
+    uint32_t last_cmd_ms; /*System time of the last command answered with a status*/
+    fsm_bridge_job_t queue[FSM_BRIDGE_QUEUE_SIZE]; /*Commands that wait for the transmitter*/
+    uint8_t queue_head; /*Index of the oldest command of the queue*/
+    uint8_t queue_count; /*Number of commands in the queue*/
+    uint8_t raw_ticks[NEC_TX_SCHEDULE_SIZE]; /*Symbol ticks of the raw waveform queued*/
+    uint8_t raw_num_steps; /*Bursts and silences of the raw waveform queued*/
+    bool raw_queued; /*Flag to indicate that the raw waveform is in the queue*/
+    macro_step_t macro_steps[FSM_BRIDGE_MACRO_MAX_STEPS]; /*Steps of the macro queued or played*/
+    uint16_t macro_num_steps; /*Number of steps of the macro*/
+    bool macro_queued; /*Flag to indicate that the macro is in the queue*/
+    bool holding; /*Flag to indicate that repeat codes are sent after the last code*/
+    uint16_t hold_ms; /*Time to hold, 0 until FSM_BRIDGE_CMD_HOLD_STOP*/
+    uint32_t hold_start_ms; /*System time when the code held was handed to the transmitter*/
+    uint8_t tx_mask; /*Mask of transmitters set in the transmitter FSM*/
+    uint8_t event_seq; /*Sequence of the next event*/
+    fsm_bridge_stats_t stats; /*Counters of the link*/
+}fsm_bridge_t;
+
+/* Private functions */
+
+/*Read a little-endian field of a payload.*/
+static uint16_t _get_u16(const uint8_t *p_data){
+
+    return (uint16_t)(p_data[0] | (p_data[1] << 8));
+}
+
+static uint32_t _get_u32(const uint8_t *p_data){
+
+    return (uint32_t)p_data[0] | ((uint32_t)p_data[1] << 8) | ((uint32_t)p_data[2] << 16) | ((uint32_t)p_data[3] << 24);
+}
+
+/*Write a little-endian field of a payload.*/
+static void _put_u16(uint8_t *p_data, uint16_t value){
+
+    p_data[0] = (uint8_t)value;
+    p_data[1] = (uint8_t)(value >> 8);
+}
+
+static void _put_u32(uint8_t *p_data, uint32_t value){
+
+    _put_u16(p_data, (uint16_t)value);
+    _put_u16(p_data + 2, (uint16_t)(value >> 16));
+}
+
+/*Queue a packet in the link. It is dropped and counted if the link has no room for the whole of it, so that the host never gets a packet cut.*/
+static void _send_packet(fsm_bridge_t *p_fsm, uint8_t type, uint8_t seq, const uint8_t *p_payload, uint8_t len){
+
+    uint8_t packet[FSM_BRIDGE_HEADER_SIZE + FSM_BRIDGE_MAX_PAYLOAD + 1U];
+    uint8_t sum = type + seq + len;
+
+    packet[0] = FSM_BRIDGE_SYNC;
+    packet[1] = type;
+    packet[2] = seq;
+    packet[3] = len;
+    for(uint8_t i = 0; i < len; i++){
+        packet[FSM_BRIDGE_HEADER_SIZE + i] = p_payload[i];
+        sum += p_payload[i];
+    }
+    packet[FSM_BRIDGE_HEADER_SIZE + len] = (uint8_t)(0x100U - sum);
+
+    if(!port_uart_write(p_fsm->uart_id, packet, FSM_BRIDGE_HEADER_SIZE + len + 1U)){
+        p_fsm->stats.num_tx_dropped++;
+    }
+}
+
+/*Answer the command parsed with a status and no data.*/
+static void _respond(fsm_bridge_t *p_fsm, uint8_t status){
+
+    if(status != FSM_BRIDGE_STATUS_OK){
+        p_fsm->stats.num_rejected++;
+    }
+    p_fsm->has_last = true;
+    p_fsm->last_type = p_fsm->type;
+    p_fsm->last_seq = p_fsm->seq;
+    p_fsm->last_status = status;
+    p_fsm->last_cmd_ms = port_system_get_millis();
+    _send_packet(p_fsm, FSM_BRIDGE_RESPONSE | p_fsm->type, p_fsm->seq, &status, 1);
+}
+
+/*Parse a byte received. The packets with a wrong length or checksum are dropped, and the parser looks for the next sync byte.*/
+static bool _parse_byte(fsm_bridge_t *p_fsm, uint8_t byte){
+
+    switch(p_fsm->parse_state){
+    case PARSE_SYNC:
+        if(byte == FSM_BRIDGE_SYNC){
+            p_fsm->parse_state = PARSE_TYPE;
+        }
+        break;
+    case PARSE_TYPE:
+        p_fsm->type = byte;
+        p_fsm->sum = byte;
+        p_fsm->parse_state = PARSE_SEQUENCE;
+        break;
+    case PARSE_SEQUENCE:
+        p_fsm->seq = byte;
+        p_fsm->sum += byte;
+        p_fsm->parse_state = PARSE_LENGTH;
+        break;
+    case PARSE_LENGTH:
+        p_fsm->len = byte;
+        p_fsm->sum += byte;
+        p_fsm->num_payload = 0;
+        if(byte > FSM_BRIDGE_MAX_PAYLOAD){
+            p_fsm->stats.num_bad_packets++;
+            p_fsm->parse_state = PARSE_SYNC;
+        }
+        else{
+            p_fsm->parse_state = (byte > 0) ? PARSE_PAYLOAD : PARSE_CHECKSUM;
+        }
+        break;
+    case PARSE_PAYLOAD:
+        p_fsm->payload[p_fsm->num_payload++] = byte;
+        p_fsm->sum += byte;
+        if(p_fsm->num_payload == p_fsm->len){
+            p_fsm->parse_state = PARSE_CHECKSUM;
+        }
+        break;
+    default:
+        p_fsm->parse_state = PARSE_SYNC;
+        if((uint8_t)(p_fsm->sum + byte) == 0){
+            p_fsm->stats.num_commands++;
+            return true;
+        }
+        p_fsm->stats.num_bad_packets++;
+        break;
+    }
+    return false;
+}
+
+/*Parse the bytes received until a command is complete. The bytes are read from the link in chunks, and the ones after the command are kept for the next call.*/
+static bool _parse_command(fsm_bridge_t *p_fsm){
+
+    while(!p_fsm->has_command){
+        if(p_fsm->chunk_pos == p_fsm->chunk_len){
+            p_fsm->chunk_len = port_uart_read(p_fsm->uart_id, p_fsm->rx_chunk, FSM_BRIDGE_RX_CHUNK);
+            p_fsm->chunk_pos = 0;
+            if(p_fsm->chunk_len == 0){
+                return false;
+            }
+            p_fsm->link_open = true;
+            p_fsm->last_rx_ms = port_system_get_millis();
+        }
+        p_fsm->has_command = _parse_byte(p_fsm, p_fsm->rx_chunk[p_fsm->chunk_pos++]);
+    }
+    return true;
+}
+
+/*Add the command parsed to the queue of the transmitter.*/
+static uint8_t _enqueue(fsm_bridge_t *p_fsm, uint8_t tx_mask, uint32_t code, uint16_t hold_ms){
+
+    fsm_bridge_job_t *p_job;
+
+    if(p_fsm->queue_count == FSM_BRIDGE_QUEUE_SIZE){
+        return FSM_BRIDGE_STATUS_BUSY;
+    }
+    p_job = &p_fsm->queue[(p_fsm->queue_head + p_fsm->queue_count) % FSM_BRIDGE_QUEUE_SIZE];
+    p_job->type = p_fsm->type;
+    p_job->seq = p_fsm->seq;
+    p_job->tx_mask = tx_mask;
+    p_job->code = code;
+    p_job->hold_ms = hold_ms;
+    p_fsm->queue_count++;
+    return FSM_BRIDGE_STATUS_OK;
+}
+
+/*Check the mask of transmitters that starts the payload of the commands that transmit.*/
+static bool _check_tx_mask(fsm_bridge_t *p_fsm){
+
+    return (p_fsm->payload[0] >> PORT_TX_NUM_TRANSMITTERS) == 0;
+}
+
+/*Queue a raw waveform. The durations are rounded to symbol ticks, that must fit in the schedule of the transmitter.*/
+static uint8_t _queue_raw(fsm_bridge_t *p_fsm){
+
+    uint8_t num_steps = (p_fsm->len - 1U) / 2U;
+    uint8_t status;
+
+    if(p_fsm->len < 3U || (p_fsm->len % 2U) == 0 || num_steps > NEC_TX_SCHEDULE_SIZE){
+        return FSM_BRIDGE_STATUS_BAD_LENGTH;
+    }
+    if(!_check_tx_mask(p_fsm)){
+        return FSM_BRIDGE_STATUS_BAD_ARGUMENT;
+    }
+    if(p_fsm->raw_queued){
+        return FSM_BRIDGE_STATUS_BUSY;
+    }
+    for(uint8_t i = 0; i < num_steps; i++){
+        uint32_t ticks = ((uint32_t)_get_u16(&p_fsm->payload[1U + 2U * i]) * 1000U + NEC_TX_TIMER_TICK_BASE_NS / 2U) / NEC_TX_TIMER_TICK_BASE_NS;
+        if(ticks > 0xFFU){
+            return FSM_BRIDGE_STATUS_BAD_ARGUMENT;
+        }
+        p_fsm->raw_ticks[i] = (uint8_t)ticks;
+    }
+    status = _enqueue(p_fsm, p_fsm->payload[0], 0, 0);
+    if(status == FSM_BRIDGE_STATUS_OK){
+        p_fsm->raw_num_steps = num_steps;
+        p_fsm->raw_queued = true;
+    }
+    return status;
+}
+
+/*Queue a macro. Its steps are copied, as the macro FSM does not copy them.*/
+static uint8_t _queue_macro(fsm_bridge_t *p_fsm){
+
+    uint8_t num_steps = (p_fsm->len - 1U) / FSM_BRIDGE_STEP_SIZE;
+    uint8_t status;
+
+    if(p_fsm->len < 1U + FSM_BRIDGE_STEP_SIZE || ((p_fsm->len - 1U) % FSM_BRIDGE_STEP_SIZE) != 0 || num_steps > FSM_BRIDGE_MACRO_MAX_STEPS){
+        return FSM_BRIDGE_STATUS_BAD_LENGTH;
+    }
+    if(!_check_tx_mask(p_fsm)){
+        return FSM_BRIDGE_STATUS_BAD_ARGUMENT;
+    }
+    /*The steps are in use until the macro played ends*/
+    if(p_fsm->macro_queued || fsm_macro_check_activity(p_fsm->p_fsm_macro)){
+        return FSM_BRIDGE_STATUS_BUSY;
+    }
+    status = _enqueue(p_fsm, p_fsm->payload[0], 0, 0);
+    if(status == FSM_BRIDGE_STATUS_OK){
+        for(uint8_t i = 0; i < num_steps; i++){
+            const uint8_t *p_step = &p_fsm->payload[1U + FSM_BRIDGE_STEP_SIZE * i];
+            p_fsm->macro_steps[i].code = _get_u32(p_step);
+            p_fsm->macro_steps[i].delay_ms = _get_u16(p_step + 4);
+            p_fsm->macro_steps[i].protocol = p_step[6];
+            p_fsm->macro_steps[i].repeats = p_step[7];
+        }
+        p_fsm->macro_num_steps = num_steps;
+        p_fsm->macro_queued = true;
+    }
+    return status;
+}
+
+/*Answer the query of the telemetry with a snapshot.*/
+static void _respond_telemetry(fsm_bridge_t *p_fsm){
+
+    uint8_t payload[1U + sizeof(telemetry_snapshot_t)];
+    telemetry_snapshot_t snapshot;
+
+    telemetry_get_snapshot(&snapshot, port_system_get_millis());
+    payload[0] = FSM_BRIDGE_STATUS_OK;
+    memcpy(&payload[1], &snapshot, sizeof(snapshot));
+    _send_packet(p_fsm, FSM_BRIDGE_RESPONSE | p_fsm->type, p_fsm->seq, payload, sizeof(payload));
+}
+
+/*Execute the command parsed: queue it for the transmitter or answer it at once.*/
+static void _execute_command(fsm_bridge_t *p_fsm){
+
+    uint8_t status;
+
+    p_fsm->has_command = false;
+    /*The response to the last command was lost: it is answered again, without queuing it twice*/
+    if(p_fsm->has_last && p_fsm->type == p_fsm->last_type && p_fsm->seq == p_fsm->last_seq && (port_system_get_millis() - p_fsm->last_cmd_ms) < FSM_BRIDGE_RETRY_WINDOW_MS){
+        _send_packet(p_fsm, FSM_BRIDGE_RESPONSE | p_fsm->type, p_fsm->seq, &p_fsm->last_status, 1);
+        return;
+    }
+    switch(p_fsm->type){
+    case FSM_BRIDGE_CMD_SEND_CODE:
+        if(p_fsm->len != 5U){
+            status = FSM_BRIDGE_STATUS_BAD_LENGTH;
+        }
+        else if(!_check_tx_mask(p_fsm) || _get_u32(&p_fsm->payload[1]) == 0x00){
+            status = FSM_BRIDGE_STATUS_BAD_ARGUMENT;
+        }
+        else{
+            status = _enqueue(p_fsm, p_fsm->payload[0], _get_u32(&p_fsm->payload[1]), 0);
+        }
+        break;
+    case FSM_BRIDGE_CMD_SEND_RAW:
+        status = _queue_raw(p_fsm);
+        break;
+    case FSM_BRIDGE_CMD_HOLD_START:
+        if(p_fsm->len != 7U){
+            status = FSM_BRIDGE_STATUS_BAD_LENGTH;
+        }
+        else if(!_check_tx_mask(p_fsm) || _get_u32(&p_fsm->payload[1]) == 0x00){
+            status = FSM_BRIDGE_STATUS_BAD_ARGUMENT;
+        }
+        else{
+            status = _enqueue(p_fsm, p_fsm->payload[0], _get_u32(&p_fsm->payload[1]), _get_u16(&p_fsm->payload[5]));
+        }
+        break;
+    case FSM_BRIDGE_CMD_HOLD_STOP:
+        status = (p_fsm->len == 0) ? _enqueue(p_fsm, p_fsm->tx_mask, 0, 0) : FSM_BRIDGE_STATUS_BAD_LENGTH;
+        break;
+    case FSM_BRIDGE_CMD_QUEUE_MACRO:
+        status = _queue_macro(p_fsm);
+        break;
+    case FSM_BRIDGE_CMD_QUERY_TELEMETRY:
+        if(p_fsm->len == 0){
+            _respond_telemetry(p_fsm);
+            return;
+        }
+        status = FSM_BRIDGE_STATUS_BAD_LENGTH;
+        break;
+    default:
+        status = FSM_BRIDGE_STATUS_UNKNOWN;
+        break;
+    }
+    _respond(p_fsm, status);
+}
+
+/*Set the transmitters of the next frame. The transmitter FSM is only reconfigured when they change.*/
+static void _set_tx_mask(fsm_bridge_t *p_fsm, uint8_t tx_mask){
+
+    if(tx_mask != p_fsm->tx_mask){
+        fsm_tx_set_fanout(p_fsm->p_fsm_tx, tx_mask);
+        p_fsm->tx_mask = tx_mask;
+    }
+}
+
+/* State machine input or transition functions */
+
+/*Check if the oldest command of the queue can be started: the transmitter is ready and no macro is being played. The end of a hold does not wait for them.*/
+static bool check_job_ready(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+
+    if(p_fsm->queue_count == 0){
+        return false;
+    }
+    if(p_fsm->queue[p_fsm->queue_head].type == FSM_BRIDGE_CMD_HOLD_STOP){
+        return true;
+    }
+    return fsm_tx_is_ready(p_fsm->p_fsm_tx) && !fsm_macro_check_activity(p_fsm->p_fsm_macro);
+}
+
+/*Check if a command has been received.*/
+static bool check_command(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    return _parse_command(p_fsm);
+}
+
+/*Check if the time to hold has passed.*/
+static bool check_hold_timeout(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    return p_fsm->holding && p_fsm->hold_ms != 0 && (port_system_get_millis() - p_fsm->hold_start_ms) >= p_fsm->hold_ms;
+}
+
+/*Check if the next repeat code of the hold can be sent. A command queued takes precedence and ends the hold.*/
+static bool check_hold_repeat(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    return p_fsm->holding && p_fsm->queue_count == 0 && fsm_tx_is_ready(p_fsm->p_fsm_tx) && !fsm_macro_check_activity(p_fsm->p_fsm_macro);
+}
+
+/* State machine output or action functions */
+
+/*Hand the oldest command of the queue to the transmitter, and report it to the host with the time it starts.*/
+static void do_start_job(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    fsm_bridge_job_t job = p_fsm->queue[p_fsm->queue_head];
+    uint8_t payload[5];
+
+    p_fsm->queue_head = (p_fsm->queue_head + 1U) % FSM_BRIDGE_QUEUE_SIZE;
+    p_fsm->queue_count--;
+    p_fsm->holding = false;
+
+    switch(job.type){
+    case FSM_BRIDGE_CMD_SEND_CODE:
+        _set_tx_mask(p_fsm, job.tx_mask);
+        fsm_tx_set_code(p_fsm->p_fsm_tx, job.code);
+        break;
+    case FSM_BRIDGE_CMD_SEND_RAW:
+        _set_tx_mask(p_fsm, job.tx_mask);
+        fsm_tx_set_raw(p_fsm->p_fsm_tx, p_fsm->raw_ticks, p_fsm->raw_num_steps);
+        p_fsm->raw_queued = false;
+        break;
+    case FSM_BRIDGE_CMD_HOLD_START:
+        _set_tx_mask(p_fsm, job.tx_mask);
+        fsm_tx_set_code(p_fsm->p_fsm_tx, job.code);
+        p_fsm->holding = true;
+        p_fsm->hold_ms = job.hold_ms;
+        p_fsm->hold_start_ms = port_system_get_millis();
+        break;
+    case FSM_BRIDGE_CMD_QUEUE_MACRO:
+        _set_tx_mask(p_fsm, job.tx_mask);
+        fsm_macro_play(p_fsm->p_fsm_macro, p_fsm->macro_steps, p_fsm->macro_num_steps);
+        p_fsm->macro_queued = false;
+        break;
+    default:
+        /*The end of a hold sends nothing*/
+        return;
+    }
+
+    payload[0] = job.seq;
+    _put_u32(&payload[1], port_system_get_millis());
+    _send_packet(p_fsm, FSM_BRIDGE_EVT_TX_START, p_fsm->event_seq++, payload, sizeof(payload));
+}
+
+/*Execute the command received and the ones complete after it.*/
+static void do_execute_commands(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+
+    do{
+        _execute_command(p_fsm);
+    } while(_parse_command(p_fsm));
+}
+
+/*End the hold.*/
+static void do_stop_hold(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    p_fsm->holding = false;
+}
+
+/*Send the next repeat code of the hold.*/
+static void do_send_repeat(fsm_t *p_this){
+
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    fsm_tx_set_repeat(p_fsm->p_fsm_tx);
+}
+
+/*Array representing the transitions table of the bridge FSM. The queue goes first, so that a frame is never delayed by the commands that arrive.*/
+static const fsm_trans_t fsm_trans_bridge[] = {
+
+    {WAIT_BRIDGE, check_job_ready, WAIT_BRIDGE, do_start_job},
+    {WAIT_BRIDGE, check_command, WAIT_BRIDGE, do_execute_commands},
+    {WAIT_BRIDGE, check_hold_timeout, WAIT_BRIDGE, do_stop_hold},
+    {WAIT_BRIDGE, check_hold_repeat, WAIT_BRIDGE, do_send_repeat},
+    { -1 , NULL , -1, NULL },
+
+};
+
+/* Other auxiliary functions */
+
+/*Stream a frame received to the host.*/
+void fsm_bridge_send_frame(fsm_t *p_this, const fsm_rx_frame_t *p_frame)
+{
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    uint8_t payload[FSM_BRIDGE_FRAME_EVENT_SIZE];
+
+    _put_u32(&payload[0], p_frame->code);
+    _put_u32(&payload[4], p_frame->first_edge_ms);
+    _put_u32(&payload[8], p_frame->held_ms);
+    _put_u16(&payload[12], p_frame->repeats);
+    _put_u16(&payload[14], p_frame->num_edges);
+    payload[16] = p_frame->protocol;
+    payload[17] = p_frame->error;
+    payload[18] = (p_frame->is_repetition ? 0x01U : 0x00U) | (p_frame->is_error ? 0x02U : 0x00U);
+    _send_packet(p_fsm, FSM_BRIDGE_EVT_FRAME, p_fsm->event_seq++, payload, sizeof(payload));
+}
+
+/*Check if the bridge is active.*/
+bool fsm_bridge_check_activity(fsm_t *p_this)
+{
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    return p_fsm->queue_count > 0 || p_fsm->holding || p_fsm->chunk_pos < p_fsm->chunk_len || port_uart_get_rx_count(p_fsm->uart_id) > 0;
+}
+
+/*Check if a host has used the link recently.*/
+bool fsm_bridge_check_link(fsm_t *p_this)
+{
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    if(port_uart_check_wakeup(p_fsm->uart_id)){
+        p_fsm->link_open = true;
+        p_fsm->last_rx_ms = port_system_get_millis();
+    }
+    return p_fsm->link_open && (port_system_get_millis() - p_fsm->last_rx_ms) < FSM_BRIDGE_LINK_TIMEOUT_MS;
+}
+
+/*Arm the line of the link as a wake-up source of the STOP modes.*/
+void fsm_bridge_arm_wakeup(fsm_t *p_this)
+{
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    port_uart_arm_wakeup(p_fsm->uart_id);
+}
+
+/*Return the counters of the link.*/
+const fsm_bridge_stats_t *fsm_bridge_get_stats(fsm_t *p_this)
+{
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    return &p_fsm->stats;
+}
+
+/*Create a new bridge FSM.*/
+fsm_t *fsm_bridge_new(uint8_t uart_id, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro)
+{
+    fsm_t *p_fsm = malloc(sizeof(fsm_bridge_t)); /* Do malloc to reserve memory of all other FSM elements, although it is interpreted as fsm_t (the first element of the structure) */
+    fsm_bridge_init(p_fsm, uart_id, p_fsm_tx, p_fsm_macro);
+    return p_fsm;
+}
+
+/*Initialize a bridge FSM.*/
+void fsm_bridge_init(fsm_t *p_this, uint8_t uart_id, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro)
+{
+    fsm_bridge_t *p_fsm = (fsm_bridge_t *)(p_this);
+    fsm_init(p_this, fsm_trans_bridge);
+
+    p_fsm->p_fsm_tx = p_fsm_tx;
+    p_fsm->p_fsm_macro = p_fsm_macro;
+    p_fsm->uart_id = uart_id;
+    p_fsm->chunk_len = 0;
+    p_fsm->chunk_pos = 0;
+    p_fsm->parse_state = PARSE_SYNC;
+    p_fsm->has_command = false;
+    p_fsm->link_open = false;
+    p_fsm->last_rx_ms = 0;
+    p_fsm->has_last = false;
+    p_fsm->queue_head = 0;
+    p_fsm->queue_count = 0;
+    p_fsm->raw_queued = false;
+    p_fsm->macro_queued = false;
+    p_fsm->holding = false;
+    p_fsm->tx_mask = 0;
+    p_fsm->event_seq = 0;
+    memset(&p_fsm->stats, 0, sizeof(p_fsm->stats));
+    port_uart_init(uart_id);
+}
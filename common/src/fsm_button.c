@@ -7,6 +7,7 @@
  */
 
 /* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
 #include "fsm_button.h"
 #include "port_button.h"
 
@@ -15,11 +16,24 @@ typedef struct
 {
     fsm_t f; /*Button FSM*/
     uint32_t debounce_time; /*Button debounce time in ms*/
-    uint32_t next_timeout; /*Next timeout for the anti-debounce in ms*/
-    uint32_t tick_pressed; /*Number of ticks when the button was pressed*/
-    uint32_t duration; /*How much time the button has been pressed*/
     uint32_t button_id; /*Button ID. Must be unique.*/
-} fsm_button_t; 
+    bool level_pressed; /*Debounced level of the button*/
+    uint32_t level_tick; /*Tick of the last accepted change of the debounced level*/
+    bool raw_pressed; /*Level of the button after the last raw edge*/
+    uint32_t raw_tick; /*Tick of the last raw edge*/
+    uint32_t tick_pressed; /*Tick when the button was pressed*/
+    uint32_t long_press_ms; /*Time the button must be held to start a long press*/
+    uint32_t hold_repeat_ms; /*Period of the hold-repeat events*/
+    uint32_t double_click_ms; /*Maximum time between two clicks to make a double-click*/
+    uint32_t next_repeat; /*Tick of the next hold-repeat event*/
+    bool click_pending; /*Flag to indicate that a click is waiting to know if it is a double-click*/
+    uint32_t click_tick; /*Tick when the pending click was released*/
+    uint32_t click_duration; /*Duration of the pending click*/
+    fsm_button_event_t events[BUTTON_EVENTS_QUEUE_SIZE]; /*Queue of gesture events*/
+    uint8_t event_head; /*Index where the next event is written*/
+    uint8_t event_tail; /*Index where the next event is read*/
+    uint32_t dropped_events; /*Number of events lost because the queue was full*/
+} fsm_button_t;
 
 /* Defines and enums ----------------------------------------------------------*/
 
@@ -27,77 +41,192 @@ typedef struct
 enum
 {
   BUTTON_RELEASED = 0, /*Starting state. Also comes here when the button has been released*/
-  BUTTON_RELEASED_WAIT, /*State to perform the anti-debounce mechanism for a falling edge*/
-  BUTTON_PRESSED, /*State while the button is being pressed*/
-  BUTTON_PRESSED_WAIT, /*State to perform the anti-debounce mechanism for a rising edge*/
-};   
+  BUTTON_PRESSED, /*State while the button is being pressed, before the long press time*/
+  BUTTON_HELD, /*State while the button is being held after the long press time*/
+};
+
+/* Private functions */
+
+/*Queue a gesture event.*/
+static void _push_event(fsm_button_t *p_fsm, uint8_t type, uint32_t tick, uint32_t duration)
+{
+    uint8_t next = (p_fsm->event_head + 1) & (BUTTON_EVENTS_QUEUE_SIZE - 1);
+
+    if (next == p_fsm->event_tail)
+    {
+        p_fsm->dropped_events++;
+        return;
+    }
+    p_fsm->events[p_fsm->event_head].type = type;
+    p_fsm->events[p_fsm->event_head].button_id = p_fsm->button_id;
+    p_fsm->events[p_fsm->event_head].tick = tick;
+    p_fsm->events[p_fsm->event_head].duration = duration;
+    p_fsm->event_head = next;
+}
+
+/*Update the debounced level from the raw edges timestamped by the ISR.
+
+A change of level is accepted if it happens at least debounce_time ms after the last accepted change. The edges in between are bounces, but if the last one leaves the button in a different level, that level is accepted once the debounce time is over. At most one change is accepted per call, so that the FSM sees every press and release.
+
+While the button is stable and no edges are queued, this costs a comparison.*/
+static void _update_level(fsm_button_t *p_fsm)
+{
+    uint32_t tick;
+    bool pressed;
+
+    while (port_button_pop_edge(p_fsm->button_id, &tick, &pressed))
+    {
+        p_fsm->raw_pressed = pressed;
+        p_fsm->raw_tick = tick;
+        if ((pressed != p_fsm->level_pressed) && ((tick - p_fsm->level_tick) >= p_fsm->debounce_time))
+        {
+            p_fsm->level_pressed = pressed;
+            p_fsm->level_tick = tick;
+            return;
+        }
+    }
+
+    if ((p_fsm->raw_pressed != p_fsm->level_pressed) && ((port_button_get_tick() - p_fsm->level_tick) >= p_fsm->debounce_time))
+    {
+        p_fsm->level_pressed = p_fsm->raw_pressed;
+        p_fsm->level_tick = p_fsm->raw_tick;
+    }
+}
+
 /* State machine input or transition functions */
 
 /*Check if the button has been pressed.*/
 static bool check_button_pressed (fsm_t * p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    return port_button_is_pressed(p_fsm->button_id);
-}	
+    _update_level(p_fsm);
+    return p_fsm->level_pressed;
+}
 
 /*Check if the button has been released.*/
 static bool check_button_released (fsm_t * p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    return !port_button_is_pressed(p_fsm->button_id);
-}	
+    _update_level(p_fsm);
+    return !p_fsm->level_pressed;
+}
+
+/*Check if the double-click time of a pending click is over.*/
+static bool check_click_timeout (fsm_t * p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    return p_fsm->click_pending && ((port_button_get_tick() - p_fsm->click_tick) > p_fsm->double_click_ms);
+}
+
+/*Check if the button has been pressed for the long press time.*/
+static bool check_long_press (fsm_t * p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    return (port_button_get_tick() - p_fsm->tick_pressed) >= p_fsm->long_press_ms;
+}
+
+/*Check if it is time for the next hold-repeat event.*/
+static bool check_hold_repeat (fsm_t * p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    return (p_fsm->hold_repeat_ms > 0) && ((int32_t)(port_button_get_tick() - p_fsm->next_repeat) >= 0);
+}
+
+/* State machine output or action functions */
 
-/*Check if the debounce-time has passed.*/
-static bool check_timeout (fsm_t * p_this)
+/*Store the system tick when the button was pressed.*/
+static void do_store_tick_pressed (fsm_t * p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    if(port_button_get_tick() > p_fsm->next_timeout)
+    p_fsm->tick_pressed = p_fsm->level_tick;
+}
+
+/*Report the pending click once the double-click time is over.*/
+static void do_click (fsm_t * p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    p_fsm->click_pending = false;
+    _push_event(p_fsm, BUTTON_EVENT_CLICK, p_fsm->click_tick, p_fsm->click_duration);
+}
+
+/*Report the release of a short press, which is a click or the second click of a double-click.*/
+static void do_short_release (fsm_t * p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    uint32_t duration = p_fsm->level_tick - p_fsm->tick_pressed;
+
+    _push_event(p_fsm, BUTTON_EVENT_RELEASE, p_fsm->level_tick, duration);
+
+    if (p_fsm->click_pending && ((p_fsm->level_tick - p_fsm->click_tick) <= p_fsm->double_click_ms))
     {
-        return true;
-    }	
+        p_fsm->click_pending = false;
+        _push_event(p_fsm, BUTTON_EVENT_DOUBLE_CLICK, p_fsm->level_tick, duration);
+        return;
+    }
+    if (p_fsm->click_pending)
+    {
+        /* The previous click timed out while the button was being pressed again */
+        do_click(p_this);
+    }
+
+    if (p_fsm->double_click_ms == 0)
+    {
+        _push_event(p_fsm, BUTTON_EVENT_CLICK, p_fsm->level_tick, duration);
+    }
     else
     {
-        return false;
+        p_fsm->click_pending = true;
+        p_fsm->click_tick = p_fsm->level_tick;
+        p_fsm->click_duration = duration;
     }
-}	
+}
 
-/* State machine output or action functions */
+/*Report the start of a long press.*/
+static void do_long_press_start (fsm_t * p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    if (p_fsm->click_pending)
+    {
+        do_click(p_this);
+    }
+    _push_event(p_fsm, BUTTON_EVENT_LONG_PRESS_START, p_fsm->tick_pressed + p_fsm->long_press_ms, p_fsm->long_press_ms);
+    p_fsm->next_repeat = p_fsm->tick_pressed + p_fsm->long_press_ms + p_fsm->hold_repeat_ms;
+}
 
-/*Store the system tick when the button was pressed.*/
-static void do_store_tick_pressed (fsm_t * p_this)	
+/*Report a hold-repeat event.*/
+static void do_hold_repeat (fsm_t * p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    p_fsm->tick_pressed = port_button_get_tick();
-    p_fsm->next_timeout = port_button_get_tick() + p_fsm->debounce_time;
+    _push_event(p_fsm, BUTTON_EVENT_HOLD_REPEAT, p_fsm->next_repeat, p_fsm->next_repeat - p_fsm->tick_pressed);
+    p_fsm->next_repeat += p_fsm->hold_repeat_ms;
 }
 
-/*Store the duration of the button press.*/
-static void do_set_duration	(fsm_t * p_this)	
+/*Report the release of a long press.*/
+static void do_release (fsm_t * p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    p_fsm->duration = port_button_get_tick() - p_fsm->tick_pressed;
-    p_fsm->next_timeout = port_button_get_tick() + p_fsm->debounce_time;
+    _push_event(p_fsm, BUTTON_EVENT_RELEASE, p_fsm->level_tick, p_fsm->level_tick - p_fsm->tick_pressed);
 }
 
 /*Array representing the transitions table of the FSM button.*/
-static fsm_trans_t fsm_trans_button[] = {
+static const fsm_trans_t fsm_trans_button[] = {
 
-    {BUTTON_RELEASED, check_button_pressed, BUTTON_RELEASED_WAIT, do_store_tick_pressed},
-    {BUTTON_RELEASED_WAIT, check_timeout, BUTTON_PRESSED, NULL},
-    {BUTTON_PRESSED, check_button_released, BUTTON_PRESSED_WAIT, do_set_duration},
-    {BUTTON_PRESSED_WAIT, check_timeout, BUTTON_RELEASED, NULL}, 
+    {BUTTON_RELEASED, check_button_pressed, BUTTON_PRESSED, do_store_tick_pressed},
+    {BUTTON_RELEASED, check_click_timeout, BUTTON_RELEASED, do_click},
+    {BUTTON_PRESSED, check_button_released, BUTTON_RELEASED, do_short_release},
+    {BUTTON_PRESSED, check_long_press, BUTTON_HELD, do_long_press_start},
+    {BUTTON_HELD, check_button_released, BUTTON_RELEASED, do_release},
+    {BUTTON_HELD, check_hold_repeat, BUTTON_HELD, do_hold_repeat},
     { -1 , NULL , -1, NULL },
-    
+
 };
 /* Other auxiliary functions */
 
 /*Create a new button FSM.
 
-This FSM implements an anti-debounce mechanism. Debounces (or very fast button presses) lasting less than the debounce_time are filtered out.
-
-The FSM stores the duration of the last button press. The user should ask for it using the function fsm_button_get_duration().
+This FSM recognizes gestures from the raw edges that the ISR of the button timestamps. The debounce is done on the timestamps: changes of level closer than debounce_time to the previous one are filtered out.
 
-At start and reset, the duration value must be 0 ms. A value of 0 ms means that there has not been a new button press.*/
+The gestures are queued as events that the user pops with fsm_button_pop_event().*/
 fsm_t *fsm_button_new(uint32_t debounce_time, uint32_t button_id)
 {
     fsm_t *p_fsm = malloc(sizeof(fsm_button_t)); /* Do malloc to reserve memory of all other FSM elements, although it is interpreted as fsm_t (the first element of the structure) */
@@ -105,31 +234,48 @@ fsm_t *fsm_button_new(uint32_t debounce_time, uint32_t button_id)
     return p_fsm;
 }
 
-/*Return the duration of the last button press.*/
-uint32_t fsm_button_get_duration (fsm_t * p_this)	
+/*Configure the times of the gestures.*/
+void fsm_button_set_gestures(fsm_t *p_this, uint32_t long_press_ms, uint32_t hold_repeat_ms, uint32_t double_click_ms)
 {
-     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-     return p_fsm->duration;
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    p_fsm->long_press_ms = long_press_ms;
+    p_fsm->hold_repeat_ms = hold_repeat_ms;
+    p_fsm->double_click_ms = double_click_ms;
 }
 
-/*Reset the duration of the last button press.*/
-void fsm_button_reset_duration (fsm_t * p_this)
+/*Pop the oldest gesture event.*/
+bool fsm_button_pop_event(fsm_t *p_this, fsm_button_event_t *p_event)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    p_fsm->duration = 0;
+
+    if (p_fsm->event_tail == p_fsm->event_head)
+    {
+        return false;
+    }
+    *p_event = p_fsm->events[p_fsm->event_tail];
+    p_fsm->event_tail = (p_fsm->event_tail + 1) & (BUTTON_EVENTS_QUEUE_SIZE - 1);
+    return true;
 }
 
+/*Return the number of gesture events lost because the queue was full.*/
+uint32_t fsm_button_get_dropped_events(fsm_t *p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    return p_fsm->dropped_events;
+}
+
+/*Check if the button FSM needs to keep running: the button is pressed, a bounce or a click is waiting for a timeout, or there are events not read yet.*/
 bool fsm_button_check_activity(fsm_t *p_this){
 
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
 
-    if(p_fsm->f.current_state == BUTTON_RELEASED){
-        return false;
+    if(p_fsm->f.current_state != BUTTON_RELEASED || p_fsm->click_pending || p_fsm->raw_pressed != p_fsm->level_pressed || p_fsm->event_tail != p_fsm->event_head){
+        return true;
     }
     else{
-        return true;
+        return false;
     }
-}	
+}
 
 
 /*Initialize a button FSM.
@@ -142,7 +288,18 @@ void fsm_button_init(fsm_t *p_this, uint32_t debounce_time, uint32_t button_id)
 
     p_fsm->debounce_time = debounce_time;
     p_fsm->button_id = button_id;
+    p_fsm->level_pressed = false;
+    p_fsm->level_tick = 0;
+    p_fsm->raw_pressed = false;
+    p_fsm->raw_tick = 0;
     p_fsm->tick_pressed = 0;
-    p_fsm->duration = 0;
+    p_fsm->long_press_ms = BUTTON_LONG_PRESS_MS;
+    p_fsm->hold_repeat_ms = BUTTON_HOLD_REPEAT_MS;
+    p_fsm->double_click_ms = BUTTON_DOUBLE_CLICK_MS;
+    p_fsm->next_repeat = 0;
+    p_fsm->click_pending = false;
+    p_fsm->event_head = 0;
+    p_fsm->event_tail = 0;
+    p_fsm->dropped_events = 0;
     port_button_init(button_id);
 }
@@ -0,0 +1,175 @@
+/**
+ * @file fsm_macro.c
+ * @brief Macro FSM main file. It plays sequences of codes through the infrared transmitter FSM with the timing of each step.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_macro.h"
+#include "fsm_tx.h"
+#include "port_system.h"
+#include <stdlib.h>
+
+/* Typedefs --------------------------------------------------------------------*/
+typedef struct
+{
+    fsm_t f; /*Macro FSM*/
+    fsm_t *p_fsm_tx; /*Pointer to the FSM of the infrared transmitter*/
+    const macro_step_t *p_steps; /*Steps of the macro being played*/
+    uint16_t num_steps; /*Number of steps of the macro*/
+    uint16_t step_idx; /*Index of the current step*/
+    uint8_t frames_sent; /*Frames of the current step already sent: the frame and its repeat codes*/
+    uint32_t next_frame_ms; /*Scheduled system time of the next frame*/
+    bool start; /*Flag to indicate that a macro has to start*/
+    bool cancel; /*Flag to indicate that the macro has to stop*/
+}fsm_macro_t;
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Enums */
+enum FSM_MACRO{
+    IDLE_MACRO = 0, /*No macro is being played*/
+    PLAY_MACRO      /*Playing the steps of a macro*/
+};
+
+/* State machine input or transition functions */
+
+/*Check if a macro has to start.*/
+static bool check_start(fsm_t *p_this){
+
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    return p_fsm->start;
+}
+
+/*Check if the macro has been cancelled or all the steps have been played.*/
+static bool check_end(fsm_t *p_this){
+
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    return p_fsm->cancel || (p_fsm->step_idx >= p_fsm->num_steps);
+}
+
+/*Check if the next frame is due and the transmitter can take it.*/
+static bool check_frame_due(fsm_t *p_this){
+
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    return ((int32_t)(port_system_get_millis() - p_fsm->next_frame_ms) >= 0) && fsm_tx_is_ready(p_fsm->p_fsm_tx);
+}
+
+/* State machine output or action functions */
+
+/*Start the macro with its first step right away.*/
+static void do_start(fsm_t *p_this){
+
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    p_fsm->start = false;
+    p_fsm->cancel = false;
+    p_fsm->step_idx = 0;
+    p_fsm->frames_sent = 0;
+    p_fsm->next_frame_ms = port_system_get_millis();
+}
+
+/*Stop playing the macro.*/
+static void do_stop(fsm_t *p_this){
+
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    p_fsm->cancel = false;
+    p_fsm->num_steps = 0;
+    p_fsm->step_idx = 0;
+}
+
+/*Hand the next frame of the step to the transmitter and schedule the following one. The schedule advances from the previous scheduled time, not from the time the frame was sent, so the delays do not accumulate errors.*/
+static void do_send_frame(fsm_t *p_this){
+
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    const macro_step_t *p_step = &p_fsm->p_steps[p_fsm->step_idx];
+    uint32_t delay_ms = NEC_TX_FRAME_PERIOD_MS;
+
+    if(p_step->protocol != MACRO_PROTOCOL_NEC){
+        /*Unknown protocol: skip the step*/
+        p_fsm->step_idx++;
+        p_fsm->frames_sent = 0;
+        return;
+    }
+
+    if(p_fsm->frames_sent == 0){
+        fsm_tx_set_code(p_fsm->p_fsm_tx, p_step->code);
+    }
+    else{
+        fsm_tx_set_repeat(p_fsm->p_fsm_tx);
+    }
+    p_fsm->frames_sent++;
+
+    if(p_fsm->frames_sent > p_step->repeats){
+        if(p_step->delay_ms > delay_ms){
+            delay_ms = p_step->delay_ms;
+        }
+        p_fsm->step_idx++;
+        p_fsm->frames_sent = 0;
+    }
+    p_fsm->next_frame_ms += delay_ms;
+}
+
+/*Array representing the transitions table of the macro FSM.*/
+static const fsm_trans_t fsm_trans_macro[] = {
+
+    {IDLE_MACRO, check_start, PLAY_MACRO, do_start},
+    {PLAY_MACRO, check_start, PLAY_MACRO, do_start},
+    {PLAY_MACRO, check_end, IDLE_MACRO, do_stop},
+    {PLAY_MACRO, check_frame_due, PLAY_MACRO, do_send_frame},
+    { -1 , NULL , -1, NULL },
+
+};
+
+/* Other auxiliary functions */
+
+/*Start playing a macro.*/
+void fsm_macro_play(fsm_t *p_this, const macro_step_t *p_steps, uint16_t num_steps)
+{
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+
+    if(num_steps > 0){
+        p_fsm->p_steps = p_steps;
+        p_fsm->num_steps = num_steps;
+        p_fsm->start = true;
+    }
+}
+
+/*Stop the macro being played.*/
+void fsm_macro_cancel(fsm_t *p_this)
+{
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    p_fsm->cancel = true;
+    p_fsm->start = false;
+}
+
+/*Check if a macro is being played.*/
+bool fsm_macro_check_activity(fsm_t *p_this)
+{
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    return p_fsm->start || p_fsm->f.current_state == PLAY_MACRO;
+}
+
+/*Create a new macro FSM.*/
+fsm_t *fsm_macro_new(fsm_t *p_fsm_tx)
+{
+    fsm_t *p_fsm = malloc(sizeof(fsm_macro_t)); /* Do malloc to reserve memory of all other FSM elements, although it is interpreted as fsm_t (the first element of the structure) */
+    fsm_macro_init(p_fsm, p_fsm_tx);
+    return p_fsm;
+}
+
+/*Initialize a macro FSM.*/
+void fsm_macro_init(fsm_t *p_this, fsm_t *p_fsm_tx)
+{
+    fsm_macro_t *p_fsm = (fsm_macro_t *)(p_this);
+    fsm_init(p_this, fsm_trans_macro);
+
+    p_fsm->p_fsm_tx = p_fsm_tx;
+    p_fsm->p_steps = NULL;
+    p_fsm->num_steps = 0;
+    p_fsm->step_idx = 0;
+    p_fsm->frames_sent = 0;
+    p_fsm->next_frame_ms = 0;
+    p_fsm->start = false;
+    p_fsm->cancel = false;
+}
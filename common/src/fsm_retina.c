@@ -10,16 +10,27 @@
 #include "fsm_retina.h"
 #include "fsm_button.h"
 #include "fsm_tx.h"
+#include "fsm_macro.h"
 #include "commands.h"
-#include <stdio.h>
+#include <inttypes.h>
 #include "fsm_rx.h"
 #include "port_rgb.h"
 #include "port_system.h"
+#include "fsm_rx_nec.h"
+#include "idle_governor.h"
+#include "clock_governor.h"
+#include "learn_log.h"
+#include "telemetry.h"
+#include "fsm_bridge.h"
+#include "fsm_strip.h"
+#include "warm_state.h"
+#include "dlog.h"
 
 
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
-#define COMMANDS_MEMORY_SIZE 3 /*!< Number of NEC commands stored in the memory of the system Retina */
+#define COMMANDS_MEMORY_SIZE 3 /*!< Number of default NEC commands sent when no code has been learned */
+#define RETINA_MACRO_PRESS_MS 1000 /*!< Minimum duration of a press, released before the long press, to play the macro. Clicks are reported at once, as no gesture waits for a second click */
 
 /* Enums */
 enum
@@ -39,15 +50,34 @@ typedef struct
     fsm_t f; /*!< Retina FSM  */
     fsm_t *p_fsm_button; /*Pointer to the FSM of the user button*/
     uint32_t long_button_press_ms; /*Duration of the button press to change between transmitter and receiver modes*/
+    fsm_button_event_t button_event; /*Last gesture event popped from the button FSM and not processed yet*/
+    bool has_button_event; /*Flag to indicate that button_event has not been processed yet*/
     fsm_t *p_fsm_tx; /*Pointer to the FSM of the infrared transmitter*/
-    uint32_t tx_codes_arr[COMMANDS_MEMORY_SIZE]; /*Array to store in the memory of the system a number of codes to send in a loop*/
-    uint8_t tx_codes_index; /*Index to go though the elements of the tx_codes_arr*/
+    fsm_t *p_fsm_macro; /*Pointer to the FSM that plays the macros through the transmitter*/
+    uint32_t tx_codes_arr[COMMANDS_MEMORY_SIZE]; /*Default codes to send in a loop when the learning log has no NEC codes*/
+    uint32_t tx_codes_index; /*Index of the next code to send, in the learning log or in tx_codes_arr*/
+    bool learning; /*Flag to indicate that the received frames are stored in the learning log*/
     fsm_t *p_fsm_rx;
     uint32_t rx_code;
     uint8_t rgb_id;
+    idle_governor_t idle_gov; /*Idle governor that selects the low-power mode when there is no activity*/
+    clock_governor_t clock_gov; /*Clock governor that boosts the system clock while there is activity*/
+    fsm_t *p_fsm_bridge; /*Pointer to the FSM of the bridge to a host that the frames received are streamed to. NULL if there is none*/
+    fsm_t *p_fsm_strip; /*Pointer to the FSM of the LED strip that shows the effects of the codes received. NULL if there is none*/
+    bool warm_restart; /*Flag to indicate that the state has been restored from the backup SRAM after a reset*/
+    fsm_strip_state_t restored_strip; /*Effect of the strip restored, applied when the strip is set*/
+    uint32_t restore_us; /*Microseconds from the initialization of the system to the output restored. 0 after a cold boot*/
 
 } fsm_retina_t;
 
+/*Macro played after a press of at least RETINA_MACRO_PRESS_MS in transmission mode: cycle the colours of the receiver, holding the last one.*/
+static const macro_step_t retina_macro[] = {
+    {.code = LIL_RED_BUTTON, .delay_ms = 500, .protocol = MACRO_PROTOCOL_NEC, .repeats = 0},
+    {.code = LIL_GREEN_BUTTON, .delay_ms = 500, .protocol = MACRO_PROTOCOL_NEC, .repeats = 0},
+    {.code = LIL_BLUE_BUTTON, .delay_ms = 500, .protocol = MACRO_PROTOCOL_NEC, .repeats = 0},
+    {.code = LIL_WHITE_BUTTON, .delay_ms = 0, .protocol = MACRO_PROTOCOL_NEC, .repeats = 5},
+};
+
 void _process_rgb_code(uint8_t rgb_id, uint32_t code){
 
     if(code == LIL_RED_BUTTON){
@@ -83,43 +113,168 @@ void _process_rgb_code(uint8_t rgb_id, uint32_t code){
     }
 }	
 
-/* State machine input or transition functions */
+/*Get the next code of the playlist: the NEC codes of the learning log in the order they were learned, or the default codes if none has been learned.*/
+static uint32_t _next_playlist_code(fsm_retina_t *p_fsm){
 
-/*Check if the button has been pressed fast to send a new command.*/
-static bool check_short_pressed	(fsm_t *p_this){
+    uint32_t num_entries = learn_log_get_num_entries();
+    uint32_t code;
 
-    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
-    uint32_t duration = fsm_button_get_duration(p_fsm -> p_fsm_button);
+    if(learn_log_get_num_codes() == 0){
+        if(p_fsm->tx_codes_index >= COMMANDS_MEMORY_SIZE){
+            p_fsm->tx_codes_index = 0;
+        }
+        code = p_fsm->tx_codes_arr[p_fsm->tx_codes_index];
+        p_fsm->tx_codes_index++;
+        return code;
+    }
 
-   if((duration > 0)  &&  (duration < p_fsm->long_button_press_ms)){
-        return true;
+    /*Raw entries cannot be sent by the NEC transmitter: skip them*/
+    do{
+        if(p_fsm->tx_codes_index >= num_entries){
+            p_fsm->tx_codes_index = 0;
+        }
+        code = learn_log_get_code(p_fsm->tx_codes_index);
+        p_fsm->tx_codes_index++;
+    } while(code == 0x00);
+
+    return code;
+}
+
+/*Boost the clock for the decoding of a frame only, from the deferred interrupt of the receiver. Its capture runs at the low clock.*/
+static void _boost_for_decode(void *p_arg, bool decoding){
+
+    if(decoding){
+        clock_governor_burst_start((clock_governor_t *)p_arg);
     }
+    else{
+        clock_governor_burst_end((clock_governor_t *)p_arg);
+    }
+}
 
+/*Only the frames of the Liluco remote are decoded, except in learning mode, where any remote can be learned.*/
+static void _set_address_filter(fsm_retina_t *p_fsm){
+
+    static const uint16_t retina_addresses[] = {LIL_ADDRESS};
+
+    if(p_fsm->learning){
+        fsm_rx_set_address_filter(p_fsm->p_fsm_rx, NULL, 0, 0);
+    }
     else{
-        return false;
+        fsm_rx_set_address_filter(p_fsm->p_fsm_rx, retina_addresses, sizeof(retina_addresses) / sizeof(retina_addresses[0]), 0xFFFF);
     }
 }
 
-static bool check_long_pressed(fsm_t *p_this){
+/*Leave the learning mode. The learned codes are programmed in flash right away.*/
+static void _stop_learning(fsm_retina_t *p_fsm){
 
-    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
-    uint32_t duration = fsm_button_get_duration(p_fsm -> p_fsm_button);
+    if(p_fsm->learning){
+        p_fsm->learning = false;
+        fsm_rx_set_raw_capture(p_fsm->p_fsm_rx, false);
+        _set_address_filter(p_fsm);
+        learn_log_flush();
+    }
+}
 
-    if((duration != 0)  &&  (duration >= p_fsm->long_button_press_ms)){
-        return true;
+/*Return the earlier of two deadlines of the idle governor.*/
+static uint32_t _earlier_deadline(uint32_t deadline, uint32_t other){
+
+    if(deadline == IDLE_GOVERNOR_NO_DEADLINE){
+        return other;
+    }
+    if(other == IDLE_GOVERNOR_NO_DEADLINE){
+        return deadline;
     }
+    return ((int32_t)(other - deadline) < 0) ? other : deadline;
+}
 
-    else{
-        return false;
+/*Check if the FSM is in reception mode.*/
+static bool _is_rx_mode(fsm_retina_t *p_fsm){
+
+    return p_fsm->f.current_state == WAIT_RX || p_fsm->f.current_state == SLEEP_RX;
+}
+
+/*Save the state that the user sees in the backup SRAM, to restore it after a reset. Nothing is written if it has not changed.*/
+static void _save_warm_state(fsm_retina_t *p_fsm){
+
+    warm_state_t state = {0};
+
+    state.rx_code = p_fsm->rx_code;
+    state.tx_codes_index = p_fsm->tx_codes_index;
+    state.mode = _is_rx_mode(p_fsm) ? WARM_STATE_MODE_RX : WARM_STATE_MODE_TX;
+    state.learning = p_fsm->learning ? 1U : 0U;
+    if(p_fsm->p_fsm_strip != NULL){
+        fsm_strip_get_state(p_fsm->p_fsm_strip, &state.strip);
+    }
+    warm_state_save(&state);
+}
+
+/*Stream a frame popped from the FIFO of the receiver to the host, if there is a bridge.*/
+static void _forward_frame(fsm_retina_t *p_fsm, const fsm_rx_frame_t *p_frame){
+
+    if(p_fsm->p_fsm_bridge != NULL){
+        fsm_bridge_send_frame(p_fsm->p_fsm_bridge, p_frame);
     }
 }
 
+/* State machine input or transition functions */
+
+/*Get the next gesture event of the button, if any. The event is kept until an output function processes it.*/
+static bool _peek_button_event(fsm_retina_t *p_fsm){
+
+    if(!p_fsm->has_button_event){
+        p_fsm->has_button_event = fsm_button_pop_event(p_fsm->p_fsm_button, &p_fsm->button_event);
+    }
+    return p_fsm->has_button_event;
+}
+
+/*Check if the button has been clicked, whatever the duration of the press.*/
+static bool check_clicked(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return _peek_button_event(p_fsm) && (p_fsm->button_event.type == BUTTON_EVENT_CLICK);
+}
+
+/*Check if the button has been clicked to send a new command.*/
+static bool check_short_pressed	(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return check_clicked(p_this) && (p_fsm->button_event.duration < RETINA_MACRO_PRESS_MS);
+}
+
+/*Check if the button has been held long enough to change between transmitter and receiver modes.*/
+static bool check_long_pressed(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return _peek_button_event(p_fsm) && (p_fsm->button_event.type == BUTTON_EVENT_LONG_PRESS_START);
+}
+
+/*Check if the button has been held for the macro and released before the long press.*/
+static bool check_macro_pressed(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return check_clicked(p_this) && (p_fsm->button_event.duration >= RETINA_MACRO_PRESS_MS);
+}
+
+/*Check if the button has been pressed while a macro is being played.*/
+static bool check_macro_cancel(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return fsm_macro_check_activity(p_fsm->p_fsm_macro) && _peek_button_event(p_fsm);
+}
+
+/*Check if there is a button event that has no effect in the current mode.*/
+static bool check_other_button_event(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return _peek_button_event(p_fsm);
+}
+
 static bool check_code(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    const fsm_rx_frame_t *p_frame = fsm_rx_peek_frame(p_fsm->p_fsm_rx);
 
-    if(fsm_rx_get_code(p_fsm->p_fsm_rx) != 0x00){
-        p_fsm->rx_code = fsm_rx_get_code(p_fsm->p_fsm_rx);
+    if(p_frame != NULL && p_frame->is_error == false && p_frame->is_repetition == false){
         return true;
     }
     else{
@@ -130,14 +285,16 @@ static bool check_code(fsm_t *p_this){
 static bool check_repetition(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
-    return fsm_rx_get_repetition(p_fsm->p_fsm_rx);
+    const fsm_rx_frame_t *p_frame = fsm_rx_peek_frame(p_fsm->p_fsm_rx);
+    return (p_frame != NULL) && p_frame->is_repetition;
 
 }
 
 static bool check_error(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
-    return fsm_rx_get_error_code(p_fsm->p_fsm_rx);
+    const fsm_rx_frame_t *p_frame = fsm_rx_peek_frame(p_fsm->p_fsm_rx);
+    return (p_frame != NULL) && p_frame->is_error;
 
 }
 
@@ -146,7 +303,7 @@ static bool check_activity(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
 
-    if(fsm_button_check_activity(p_fsm->p_fsm_button) == true || fsm_tx_check_activity(p_fsm->p_fsm_tx) == true || fsm_rx_check_activity(p_fsm->p_fsm_rx) == true){
+    if(fsm_button_check_activity(p_fsm->p_fsm_button) == true || fsm_tx_check_activity(p_fsm->p_fsm_tx) == true || fsm_macro_check_activity(p_fsm->p_fsm_macro) == true || fsm_rx_check_activity(p_fsm->p_fsm_rx) == true || (p_fsm->p_fsm_bridge != NULL && fsm_bridge_check_activity(p_fsm->p_fsm_bridge) == true) || (p_fsm->p_fsm_strip != NULL && fsm_strip_check_activity(p_fsm->p_fsm_strip) == true)){
         return true;
     }
     else{
@@ -168,26 +325,49 @@ static bool check_no_activity(fsm_t *p_this){
 static void do_send_next_msg (fsm_t *p_this){ 
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    uint32_t code = _next_playlist_code(p_fsm);
+
+    fsm_tx_set_code(p_fsm->p_fsm_tx, code);
+    p_fsm->has_button_event = false;
+    _save_warm_state(p_fsm);
 
-    fsm_tx_set_code(p_fsm->p_fsm_tx, p_fsm->tx_codes_arr[p_fsm->tx_codes_index]);
-    fsm_button_reset_duration (p_fsm->p_fsm_button);
+    DLOG("tx code 0x%08" PRIX32, code);
+}
 
-    printf("%ld\n",p_fsm->tx_codes_arr[p_fsm->tx_codes_index]); 
+/*Start playing the macro.*/
+static void do_play_macro(fsm_t *p_this){
 
-    if(p_fsm->tx_codes_index < 2){
-    p_fsm->tx_codes_index ++;
-    }
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    fsm_macro_play(p_fsm->p_fsm_macro, retina_macro, sizeof(retina_macro) / sizeof(retina_macro[0]));
+    p_fsm->has_button_event = false;
+}
 
-    else{
-        p_fsm->tx_codes_index = 0;
-    }
+/*Stop the macro being played. The button event that cancels it is consumed.*/
+static void do_cancel_macro(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    fsm_macro_cancel(p_fsm->p_fsm_macro);
+    p_fsm->has_button_event = false;
 }
 
 static void do_execute_code(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    fsm_rx_frame_t frame;
+
+    fsm_rx_pop_frame(p_fsm->p_fsm_rx, &frame);
+    _forward_frame(p_fsm, &frame);
+    p_fsm->rx_code = frame.code;
     _process_rgb_code(p_fsm->rgb_id, p_fsm->rx_code);
-    fsm_rx_reset_code(p_fsm->p_fsm_rx);
+    if(p_fsm->p_fsm_strip != NULL){
+        fsm_strip_process_code(p_fsm->p_fsm_strip, p_fsm->rx_code);
+    }
+    /*The frame is logged with the time it was received, not the time it is read from the FIFO*/
+    if(p_fsm->learning){
+        learn_log_append_code(p_fsm->rx_code, frame.first_edge_ms);
+    }
+    idle_governor_report_frame(&p_fsm->idle_gov, true, frame.first_edge_ms);
+    _save_warm_state(p_fsm);
 }
 
 
@@ -196,51 +376,151 @@ static void do_tx_off_rx_on(fsm_t *p_this){
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
     fsm_rx_set_rx_status(p_fsm->p_fsm_rx, true);
     _process_rgb_code(p_fsm->rgb_id, p_fsm->rx_code);
-    fsm_button_reset_duration(p_fsm->p_fsm_button);
+    if(p_fsm->p_fsm_strip != NULL){
+        fsm_strip_set_enabled(p_fsm->p_fsm_strip, true);
+    }
+    p_fsm->has_button_event = false;
+    _save_warm_state(p_fsm);
 }
 
 static void do_rx_off_tx_on(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    _stop_learning(p_fsm);
     fsm_rx_set_rx_status(p_fsm->p_fsm_rx, false);
     port_rgb_set_color(p_fsm->rgb_id, 0, 0, 0);
-    fsm_button_reset_duration(p_fsm->p_fsm_button);
+    if(p_fsm->p_fsm_strip != NULL){
+        fsm_strip_set_enabled(p_fsm->p_fsm_strip, false);
+    }
+    p_fsm->has_button_event = false;
+    _save_warm_state(p_fsm);
 }	
 
 static void do_execute_repetition(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
-    fsm_rx_reset_code(p_fsm->p_fsm_rx);
+    fsm_rx_frame_t frame;
+
+    fsm_rx_pop_frame(p_fsm->p_fsm_rx, &frame);
+    _forward_frame(p_fsm, &frame);
+    idle_governor_report_frame(&p_fsm->idle_gov, true, frame.first_edge_ms);
 }
 
 static void do_discard_rx_and_reset(fsm_t *p_this){
 
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
-    fsm_rx_reset_code(p_fsm->p_fsm_rx);
+    uint32_t num_deltas;
+    const uint16_t *p_deltas = fsm_rx_get_raw(p_fsm->p_fsm_rx, &num_deltas);
+    const fsm_rx_frame_t *p_frame = fsm_rx_peek_frame(p_fsm->p_fsm_rx);
+
+    /*A frame of an unknown protocol is learned as raw edges. The intervals are released when the frame is popped*/
+    if(p_fsm->learning && num_deltas > 0){
+        learn_log_append_raw(p_deltas, num_deltas, p_frame->first_edge_ms);
+    }
+    _forward_frame(p_fsm, p_frame);
+    idle_governor_report_frame(&p_fsm->idle_gov, false, p_frame->first_edge_ms);
+    fsm_rx_pop_frame(p_fsm->p_fsm_rx, NULL);
 
 }	
 
+/*Start or stop the learning mode after a click in reception mode.*/
+static void do_toggle_learning(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+
+    if(p_fsm->learning){
+        _stop_learning(p_fsm);
+    }
+    else{
+        p_fsm->learning = true;
+        fsm_rx_set_raw_capture(p_fsm->p_fsm_rx, true);
+        _set_address_filter(p_fsm);
+    }
+    p_fsm->has_button_event = false;
+    _save_warm_state(p_fsm);
+}
+
+/*Discard a button event that has no effect in the current mode.*/
+static void do_discard_button_event(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    p_fsm->has_button_event = false;
+}
+
+/*Sleep in the low-power mode selected by the idle governor. In reception mode a new frame or repetition code is expected one frame period after the last edge while a button of the remote is held.*/
 static void do_sleep(fsm_t *p_this){
 
-    port_system_sleep();
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    bool rx_armed = (p_fsm->f.current_state == SLEEP_RX);
+    uint32_t deadline = IDLE_GOVERNOR_NO_DEADLINE;
+
+    bool in_flight = fsm_rx_check_frame_in_flight(p_fsm->p_fsm_rx);
+
+    /*The end of a frame in flight is flagged by the timer of the receiver, and the bytes of a host by its USART, that only run while the core waits for an interrupt*/
+    if(in_flight || (p_fsm->p_fsm_bridge != NULL && fsm_bridge_check_link(p_fsm->p_fsm_bridge))){
+        deadline = port_system_get_millis();
+    }
+    else if(rx_armed){
+        uint32_t last_edge = fsm_rx_get_last_edge_ms(p_fsm->p_fsm_rx);
+        if((port_system_get_millis() - last_edge) < NEC_FRAME_PERIOD_MS){
+            deadline = last_edge + NEC_FRAME_PERIOD_MS;
+        }
+    }
+    /*The next frame of an animation of the strip is rendered on time, and a stream is sent by a DMA that only runs while the core waits for an interrupt*/
+    if(p_fsm->p_fsm_strip != NULL){
+        deadline = _earlier_deadline(deadline, fsm_strip_get_deadline(p_fsm->p_fsm_strip));
+    }
+
+    /*The flash is programmed, and the telemetry and the log sent, while there is no frame in flight*/
+    if(!in_flight){
+        learn_log_idle(port_system_get_millis());
+        telemetry_idle(port_system_get_millis());
+        dlog_flush();
+    }
+    clock_governor_idle(&p_fsm->clock_gov);
+    /*The next packet of a host wakes the system up from STOP by its preamble, once the link is closed*/
+    if(p_fsm->p_fsm_bridge != NULL){
+        fsm_bridge_arm_wakeup(p_fsm->p_fsm_bridge);
+    }
+    idle_governor_sleep(&p_fsm->idle_gov, deadline, rx_armed);
+}	
+
+/*Finish the idle period of the governors when any FSM becomes active in transmission mode: the clock is boosted to modulate.*/
+static void do_wake_up_tx(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    idle_governor_wake(&p_fsm->idle_gov);
+    clock_governor_busy(&p_fsm->clock_gov);
+}	
+
+/*Finish the idle period when any FSM becomes active in reception mode. The clock is not boosted: the frames have already been decoded, at the boost clock, by the deferred interrupt of the receiver.*/
+static void do_wake_up_rx(fsm_t *p_this){
+
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    idle_governor_wake(&p_fsm->idle_gov);
 }	
 
 
 /*Array representing the transitions table of the FSM Retina.*/
-fsm_trans_t fsm_trans_retina[] = {
+static const fsm_trans_t fsm_trans_retina[] = {
 
+    {WAIT_TX, check_macro_cancel, WAIT_TX, do_cancel_macro},
     {WAIT_TX, check_short_pressed, WAIT_TX, do_send_next_msg},
+    {WAIT_TX, check_macro_pressed, WAIT_TX, do_play_macro},
     {WAIT_TX, check_long_pressed, WAIT_RX, do_tx_off_rx_on},
+    {WAIT_TX, check_other_button_event, WAIT_TX, do_discard_button_event},
     {WAIT_TX, check_no_activity, SLEEP_TX, do_sleep},
     {SLEEP_TX, check_no_activity, SLEEP_TX, do_sleep},
-    {SLEEP_TX, check_activity, WAIT_TX, NULL},
+    {SLEEP_TX, check_activity, WAIT_TX, do_wake_up_tx},
     {WAIT_RX, check_code, WAIT_RX, do_execute_code},
     {WAIT_RX, check_repetition, WAIT_RX, do_execute_repetition},
     {WAIT_RX, check_error, WAIT_RX, do_discard_rx_and_reset},
     {WAIT_RX, check_long_pressed, WAIT_TX, do_rx_off_tx_on},
+    {WAIT_RX, check_clicked, WAIT_RX, do_toggle_learning},
+    {WAIT_RX, check_other_button_event, WAIT_RX, do_discard_button_event},
     {WAIT_RX, check_no_activity, SLEEP_RX, do_sleep},
     {SLEEP_RX, check_no_activity, SLEEP_RX, do_sleep},
-    {SLEEP_RX, check_activity, WAIT_RX, NULL},
+    {SLEEP_RX, check_activity, WAIT_RX, do_wake_up_rx},
     { -1 , NULL , -1, NULL },
     
 };
@@ -251,31 +531,105 @@ fsm_trans_t fsm_trans_retina[] = {
 /*Create a new RETINA FSM.
 
 This FSM is the main state machine of the Retina system that governs the interaction between the other state machines of the system: button, transmitter and receiver FSM.*/
-fsm_t *fsm_retina_new(fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_rx, uint8_t rgb_id)
+fsm_t *fsm_retina_new(fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro, fsm_t *p_fsm_rx, uint8_t rgb_id)
 {
     fsm_t *p_fsm = malloc(sizeof(fsm_retina_t)); /* Do malloc to reserve memory of all other FSM elements, although it is interpreted as fsm_t (the first element of the structure) */
-    fsm_retina_init(p_fsm, p_fsm_button, button_press_time, p_fsm_tx, p_fsm_rx, rgb_id);
+    fsm_retina_init(p_fsm, p_fsm_button, button_press_time, p_fsm_tx, p_fsm_macro, p_fsm_rx, rgb_id);
     return p_fsm;
 }
 
 /*Initialize the infrared transmitter FSM.*/
-void fsm_retina_init(fsm_t *p_this, fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_rx, uint8_t rgb_id)
+void fsm_retina_init(fsm_t *p_this, fsm_t *p_fsm_button, uint32_t button_press_time, fsm_t *p_fsm_tx, fsm_t *p_fsm_macro, fsm_t *p_fsm_rx, uint8_t rgb_id)
 {
     fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    warm_state_t state;
     fsm_init(p_this, fsm_trans_retina);
 
+    /*After a reset the output is restored first, before the scan of the learning log in flash and the rest of the initialization*/
+    port_rgb_init(rgb_id);
+    p_fsm->warm_restart = warm_state_load(&state);
+    p_fsm->restore_us = 0;
+    if(p_fsm->warm_restart){
+        if(state.mode == WARM_STATE_MODE_RX){
+            _process_rgb_code(rgb_id, state.rx_code);
+        }
+        p_fsm->restore_us = port_system_get_boot_us();
+    }
 
     p_fsm->p_fsm_button = p_fsm_button;
     p_fsm->p_fsm_tx = p_fsm_tx;
+    p_fsm->p_fsm_macro = p_fsm_macro;
     p_fsm->long_button_press_ms = button_press_time;
+    p_fsm->has_button_event = false;
+    fsm_button_set_gestures(p_fsm_button, button_press_time, BUTTON_HOLD_REPEAT_MS, 0);
     p_fsm->tx_codes_index = 0;
     p_fsm->tx_codes_arr[0] = LIL_RED_BUTTON;
     p_fsm->tx_codes_arr[1] = LIL_GREEN_BUTTON;
     p_fsm->tx_codes_arr[2] = LIL_BLUE_BUTTON;
+    p_fsm->learning = false;
+    learn_log_init();
 
     p_fsm->p_fsm_rx = p_fsm_rx;
     p_fsm->rx_code = 0x00;
     p_fsm->rgb_id = rgb_id;
-    port_rgb_init(rgb_id);
+    p_fsm->p_fsm_bridge = NULL;
+    p_fsm->p_fsm_strip = NULL;
+    if(p_fsm->warm_restart){
+        p_fsm->f.current_state = (state.mode == WARM_STATE_MODE_RX) ? WAIT_RX : WAIT_TX;
+        p_fsm->rx_code = state.rx_code;
+        p_fsm->tx_codes_index = state.tx_codes_index;
+        p_fsm->learning = (state.learning != 0U);
+        p_fsm->restored_strip = state.strip;
+        if(state.mode == WARM_STATE_MODE_RX){
+            fsm_rx_set_rx_status(p_fsm_rx, true);
+        }
+        fsm_rx_set_raw_capture(p_fsm_rx, p_fsm->learning);
+        DLOG("warm restart: output restored in %" PRIu32 " us", p_fsm->restore_us);
+    }
+    _set_address_filter(p_fsm);
+    idle_governor_init(&p_fsm->idle_gov);
+    clock_governor_init(&p_fsm->clock_gov, CLOCK_GOVERNOR_DYNAMIC);
+    fsm_rx_set_decode_hook(p_fsm_rx, _boost_for_decode, &p_fsm->clock_gov);
+}
+
+/*Set the policy of the clock governor.*/
+void fsm_retina_set_clock_policy(fsm_t *p_this, uint8_t policy)
+{
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    clock_governor_init(&p_fsm->clock_gov, policy);
 }
 
+/*Get the number of switches to the boost clock.*/
+uint32_t fsm_retina_get_clock_boosts(fsm_t *p_this)
+{
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return p_fsm->clock_gov.boosts;
+}
+
+
+/*Set the bridge to a host that the frames received are streamed to.*/
+void fsm_retina_set_bridge(fsm_t *p_this, fsm_t *p_fsm_bridge)
+{
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    p_fsm->p_fsm_bridge = p_fsm_bridge;
+}
+
+/*Set the LED strip that shows the effects of the codes received.*/
+void fsm_retina_set_strip(fsm_t *p_this, fsm_t *p_fsm_strip)
+{
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    p_fsm->p_fsm_strip = p_fsm_strip;
+    if(p_fsm_strip != NULL){
+        if(p_fsm->warm_restart){
+            fsm_strip_set_state(p_fsm_strip, &p_fsm->restored_strip);
+        }
+        fsm_strip_set_enabled(p_fsm_strip, _is_rx_mode(p_fsm));
+    }
+}
+
+/*Get the time taken to restore the output after a reset.*/
+uint32_t fsm_retina_get_restore_us(fsm_t *p_this)
+{
+    fsm_retina_t *p_fsm = (fsm_retina_t *)(p_this);
+    return p_fsm->restore_us;
+}
@@ -10,12 +10,17 @@
 /* Standard C includes */
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdatomic.h>
+#include <inttypes.h>
 
 /* Other includes */
 #include "fsm_rx.h"
 #include "fsm_rx_nec.h"
+#include "learn_log.h"
 #include "port_rx.h"
 #include "port_system.h"
+#include "telemetry.h"
+#include "dlog.h"
 
 
 /* Typedefs --------------------------------------------------------------------*/
@@ -23,17 +28,40 @@ typedef struct
 {
   fsm_t f;
   fsm_t *p_fsm_rx_nec;
-  uint32_t message_timeout_ms;
   uint32_t last_tick;
   uint32_t num_edges_detected;
-  uint32_t code;
-  bool is_repetition;
-  bool is_error;
+  uint32_t gap_us; /*Time without edges that ends a frame*/
+  fsm_rx_frame_t fifo[FSM_RX_FIFO_SIZE]; /*Decoded frames not read yet. Written by the deferred interrupt, read by the main loop*/
+  volatile uint8_t fifo_head; /*Free-running index of the oldest frame. Only written by the consumer*/
+  volatile uint8_t fifo_tail; /*Free-running index of the next free slot. Only written by the producer*/
+  uint32_t num_dropped; /*Number of frames lost because the FIFO was full*/
+  uint32_t num_decoded_seen; /*Value of decode_stats.num_decoded when the FSM last left WAIT_RX*/
+  fsm_rx_decode_stats_t decode_stats;
   bool status;
+  bool raw_capture;
+  uint16_t raw_deltas[LEARN_LOG_MAX_RAW_EDGES]; /*Intervals of the frame of the FIFO with has_raw set. Only one frame holds them at a time*/
+  volatile uint32_t num_raw_deltas; /*Only set by the producer while it is 0, and cleared by the consumer*/
+  uint16_t filter_addresses[NEC_ADDRESS_FILTER_MAX]; /*Addresses of the frames for this receiver*/
+  uint8_t num_filter_addresses; /*Number of accepted addresses. 0 to accept every frame*/
+  uint16_t filter_mask; /*Bits of the address field that are compared*/
+  bool last_filtered; /*Flag to indicate that the last frame was for another device, so its repetition codes are dropped too*/
+  uint32_t num_filtered; /*Number of frames and repetition codes dropped by the address filter*/
+  uint32_t held_code; /*Last code received, that the repetition codes repeat while its button is held. 0 if none*/
+  uint32_t held_first_ms; /*System time of the first edge of held_code*/
+  uint32_t held_last_ms; /*System time of the last edge of held_code or of its last repetition code*/
+  uint16_t held_repeats; /*Number of repetition codes of held_code received*/
+  fsm_rx_decode_hook_t decode_hook; /*Function run by the deferred interrupt before and after decoding a frame at its end, or NULL*/
+  void *p_decode_arg; /*Argument of decode_hook*/
   uint8_t rx_id;
 } fsm_rx_t;
 
 /* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_RX_MAX_RECEIVERS 2 /*Receivers that can be decoded by the deferred interrupt, indexed by their ID*/
+#define FSM_RX_HOLD_TIMEOUT_MS (2 * NEC_FRAME_PERIOD_MS) /*Time after the last code or repetition code from which a repetition code does not repeat it: the button was released or a frame was lost*/
+
+_Static_assert((FSM_RX_FIFO_SIZE & (FSM_RX_FIFO_SIZE - 1)) == 0 && FSM_RX_FIFO_SIZE <= 128, "The free-running indexes of the FIFO need a power of 2 size");
+
 /* Enums */
 enum FSM_RX {
   OFF_RX,
@@ -41,6 +69,15 @@ enum FSM_RX {
   WAIT_RX
 };
 
+/* Global variables ------------------------------------------------------------*/
+/*Telemetry counter of the errors of each reason. A frame parsed as the code 0x00000000 does not match the inverse of its command.*/
+static const uint8_t error_counters_arr[] = {
+  [NEC_RX_ERROR_NONE] = TELEMETRY_RX_INVERSE_MISMATCH,
+  [NEC_RX_ERROR_PROLOGUE] = TELEMETRY_RX_ERROR_PROLOGUE,
+  [NEC_RX_ERROR_SYMBOL] = TELEMETRY_RX_ERROR_SYMBOL,
+  [NEC_RX_ERROR_TRUNCATED] = TELEMETRY_RX_ERROR_TRUNCATED,
+};
+
 /* State machine input or transition functions */
 static bool check_on_rx(fsm_t *p_this){
 
@@ -67,26 +104,197 @@ static bool check_edge_detection(fsm_t *p_this){
   }
 }
 
-static bool check_timeout(fsm_t *p_this){
+/*The frame in flight has been decoded by the deferred interrupt.*/
+static bool check_frame_decoded(fsm_t *p_this){
 
   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-  uint32_t value = port_system_get_millis();
+  return p_fsm->decode_stats.num_decoded != p_fsm->num_decoded_seen;
+}	
 
-  if((value - p_fsm->last_tick) > p_fsm->message_timeout_ms){
-    return true;
+/* Other auxiliary functions */
+static void _capture_raw(fsm_rx_t *p_fsm){
+
+  const rx_delta_t *p_delta = port_rx_get_buffer_deltas(p_fsm->rx_id);
+  uint32_t num_edges = port_rx_get_num_edges(p_fsm->rx_id);
+
+  /*The receiver stores the intervals between consecutive edges, maybe quantised, and the record holds them in ticks*/
+  p_fsm->num_raw_deltas = 0;
+  for(uint32_t i = 1; (i < num_edges) && (p_fsm->num_raw_deltas < LEARN_LOG_MAX_RAW_EDGES); i++){
+    p_fsm->raw_deltas[p_fsm->num_raw_deltas++] = rx_delta_read(&p_delta);
+  }
+}
+
+/*Number of frames in the FIFO. The indexes are free-running, so their difference is valid when they wrap.*/
+static uint8_t _fifo_count(fsm_rx_t *p_fsm){
+
+  return (uint8_t)(p_fsm->fifo_tail - p_fsm->fifo_head);
+}
+
+/*Push a decoded frame into the FIFO. If it is full, the new frame is dropped, so that the frames are read in order.*/
+static void _push_frame(fsm_rx_t *p_fsm, const fsm_rx_frame_t *p_frame){
+
+  if(_fifo_count(p_fsm) >= FSM_RX_FIFO_SIZE){
+    p_fsm->num_dropped++;
+    telemetry_add(TELEMETRY_RX_FIFO_DROPPED, 1);
+    DLOG("rx fifo full: frame 0x%08" PRIX32 " dropped", p_frame->code);
+    return;
+  }
+  p_fsm->fifo[p_fsm->fifo_tail % FSM_RX_FIFO_SIZE] = *p_frame;
+  /*The frame is written before the consumer can see it*/
+  atomic_signal_fence(memory_order_release);
+  p_fsm->fifo_tail++;
+}
+
+/*Push a frame decoded into the FIFO, unless it is for another device. A repetition code is attached to the code it repeats.*/
+static void _record_frame(fsm_rx_t *p_fsm, fsm_rx_frame_t *p_frame, bool filtered){
+
+  /*A frame for another device and the repetition codes that follow it are dropped without an error*/
+  if(filtered || (p_frame->is_repetition && p_fsm->last_filtered)){
+    p_fsm->last_filtered = true;
+    p_fsm->num_filtered++;
+    telemetry_add(TELEMETRY_RX_FILTERED, 1);
+    return;
+  }
+  if(p_frame->is_repetition){
+    if(p_frame->last_edge_ms - p_fsm->held_last_ms > FSM_RX_HOLD_TIMEOUT_MS){
+      p_fsm->held_code = 0;
+    }
+    if(p_fsm->held_code != 0x00){
+      p_fsm->held_last_ms = p_frame->last_edge_ms;
+      p_fsm->held_repeats++;
+      p_frame->code = p_fsm->held_code;
+      p_frame->repeats = p_fsm->held_repeats;
+      p_frame->held_ms = p_frame->last_edge_ms - p_fsm->held_first_ms;
+    }
   }
   else{
-    return false;
+    p_fsm->last_filtered = false;
+    if(p_frame->code != 0x00){
+      p_fsm->held_code = p_frame->code;
+      p_fsm->held_first_ms = p_frame->first_edge_ms;
+      p_fsm->held_last_ms = p_frame->last_edge_ms;
+      p_fsm->held_repeats = 0;
+    }
   }
-}	
+  if(p_frame->code == 0x00 && p_frame->is_repetition == false){
+    p_frame->protocol = FSM_RX_PROTOCOL_UNKNOWN;
+    p_frame->is_error = true;
+    telemetry_add(error_counters_arr[p_frame->error], 1);
+    /*The raw buffer is only overwritten when no frame in the FIFO holds it*/
+    if(p_fsm->raw_capture && p_fsm->num_raw_deltas == 0 && _fifo_count(p_fsm) < FSM_RX_FIFO_SIZE){
+      _capture_raw(p_fsm);
+      p_frame->has_raw = (p_fsm->num_raw_deltas > 0);
+    }
+  }
+  else if(p_frame->is_repetition){
+    telemetry_add(TELEMETRY_RX_REPETITIONS, 1);
+  }
+  else{
+    telemetry_add(TELEMETRY_RX_FRAMES, 1);
+    if(!NEC_COMMAND_CHECK(p_frame->code)){
+      telemetry_add(TELEMETRY_RX_INVERSE_MISMATCH, 1);
+    }
+  }
+  _push_frame(p_fsm, p_frame);
+}
+
+/*Decode the frame captured by a receiver and push it into its FIFO. It runs in the deferred interrupt, once the end of the frame is flagged.*/
+static void _decode_frame(fsm_rx_t *p_fsm){
+
+  uint32_t num_edges = port_rx_get_num_edges(p_fsm->rx_id);
+  uint32_t now_ms = port_system_get_millis();
+  fsm_rx_frame_t frame = {
+    .protocol = FSM_RX_PROTOCOL_NEC,
+    .num_edges = (uint16_t)num_edges,
+    .duration_ticks = (num_edges > 0) ? port_rx_get_duration_ticks(p_fsm->rx_id) : 0,
+  };
+
+  /*The end of the frame is flagged exactly the gap after its last edge, so the timestamps do not depend on when the main loop saw the edges*/
+  frame.last_edge_ms = now_ms - p_fsm->gap_us / 1000;
+  frame.first_edge_ms = frame.last_edge_ms - (frame.duration_ticks * NEC_RX_TIMER_TICK_BASE_US) / 1000;
+
+  /*A capture whose edges were all dropped by the glitch filter is not a frame*/
+  if(num_edges == 0){
+    port_rx_clean_buffer(p_fsm->rx_id);
+    p_fsm->decode_stats.num_decoded++;
+    return;
+  }
+  frame.is_repetition = fsm_rx_NEC_parse_code(p_fsm->p_fsm_rx_nec, port_rx_get_buffer_deltas(p_fsm->rx_id), (num_edges > 0) ? num_edges - 1 : 0, &frame.code);
+  frame.error = fsm_rx_NEC_get_error(p_fsm->p_fsm_rx_nec);
+  _record_frame(p_fsm, &frame, fsm_rx_NEC_get_filtered(p_fsm->p_fsm_rx_nec));
+
+  port_rx_clean_buffer(p_fsm->rx_id);
+
+  p_fsm->decode_stats.num_boosted += (port_system_clock_get() == PORT_SYSTEM_CLOCK_BOOST);
+  uint32_t latency = port_system_get_cycles() - port_rx_get_end_of_frame_cycles(p_fsm->rx_id);
+  p_fsm->decode_stats.latency_cycles = latency;
+  if(latency > p_fsm->decode_stats.latency_max_cycles){
+    p_fsm->decode_stats.latency_max_cycles = latency;
+  }
+  p_fsm->decode_stats.num_decoded++;
+}
+
+/*Recognise a repetition code at its last edge, requested by the receiver, and push it into the FIFO. Any other capture is left to be decoded at the end of the frame.*/
+static void _decode_repetition(fsm_rx_t *p_fsm){
+
+  if(!fsm_rx_NEC_check_repetition(p_fsm->p_fsm_rx_nec, port_rx_get_buffer_deltas(p_fsm->rx_id), NEC_REPETITION_EDGES - 1)){
+    return;
+  }
+  fsm_rx_frame_t frame = {
+    .protocol = FSM_RX_PROTOCOL_NEC,
+    .num_edges = NEC_REPETITION_EDGES,
+    .duration_ticks = port_rx_get_duration_ticks(p_fsm->rx_id),
+    .is_repetition = true,
+  };
+
+  /*It runs right at the last edge*/
+  frame.last_edge_ms = port_system_get_millis();
+  frame.first_edge_ms = frame.last_edge_ms - (frame.duration_ticks * NEC_RX_TIMER_TICK_BASE_US) / 1000;
+  _record_frame(p_fsm, &frame, false);
+
+  port_rx_clean_buffer(p_fsm->rx_id);
+  p_fsm->decode_stats.num_fast_repetitions++;
+  p_fsm->decode_stats.num_decoded++;
+}
+
+/*Receivers decoded by the deferred interrupt, indexed by their ID.*/
+static fsm_rx_t *p_deferred_arr[FSM_RX_MAX_RECEIVERS];
+
+/*Handler of the deferred interrupt: decode the frames whose end has been flagged, running the hook of the receiver around the decoding, and the repetition codes at their last edge. The hook is read once, so that it is always run in pairs. Disabling the buffer clears the flag and the edges.*/
+static void _decode_deferred(void){
+
+  for(uint8_t i = 0; i < FSM_RX_MAX_RECEIVERS; i++){
+    fsm_rx_t *p_fsm = p_deferred_arr[i];
+    if(p_fsm != NULL && port_rx_get_end_of_frame(p_fsm->rx_id)){
+      fsm_rx_decode_hook_t hook = p_fsm->decode_hook;
+      void *p_arg = p_fsm->p_decode_arg;
+
+      if(hook != NULL){
+        hook(p_arg, true);
+      }
+      _decode_frame(p_fsm);
+      if(hook != NULL){
+        hook(p_arg, false);
+      }
+    }
+    else if(p_fsm != NULL && port_rx_get_num_edges(p_fsm->rx_id) == NEC_REPETITION_EDGES){
+      _decode_repetition(p_fsm);
+    }
+  }
+}
 
 /* State machine output or action functions */
 static void do_rx_start(fsm_t *p_this){
 
    fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-   p_fsm->p_fsm_rx_nec = fsm_rx_NEC_new();
+   /*The NEC FSM lives as long as the receiver, so that the drift learnt for the remotes is kept while it is off*/
+   fsm_rx_NEC_reset(p_fsm->p_fsm_rx_nec);
    port_rx_tmr_start();
    p_fsm->num_edges_detected = 0;
+   p_fsm->num_decoded_seen = p_fsm->decode_stats.num_decoded;
+   p_fsm->fifo_head = p_fsm->fifo_tail;
+   p_fsm->num_raw_deltas = 0;
+   p_fsm->held_code = 0;
    port_rx_clean_buffer(p_fsm->rx_id);
    port_rx_en(p_fsm->rx_id, true);		
 }	
@@ -96,21 +304,15 @@ static void do_rx_stop(fsm_t *p_this){
   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
   port_rx_tmr_stop();
   port_rx_en(p_fsm->rx_id, false);
-  fsm_destroy(p_fsm->p_fsm_rx_nec);
 }
 
-static void do_store_data(fsm_t *p_this){
+/*The edges of the next frame are counted from the empty buffer left by the decoder.*/
+static void do_frame_done(fsm_t *p_this){
 
   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-  p_fsm->is_repetition = fsm_rx_NEC_parse_code(p_fsm->p_fsm_rx_nec, port_rx_get_buffer_edges(p_fsm->rx_id), port_rx_get_num_edges(p_fsm->rx_id), &(p_fsm->code));
-
-  if(p_fsm->code == 0x00 && p_fsm->is_repetition == false){
-    p_fsm->is_error = true;
-  }
-  
+  p_fsm->num_decoded_seen = p_fsm->decode_stats.num_decoded;
   p_fsm->num_edges_detected = 0;
-  port_rx_clean_buffer(p_fsm->rx_id);	
-}	
+}
 
 static void do_update_len_and_timeout(fsm_t *p_this){
 
@@ -119,12 +321,12 @@ static void do_update_len_and_timeout(fsm_t *p_this){
   p_fsm->num_edges_detected = port_rx_get_num_edges(p_fsm->rx_id);
 }	
 
-static fsm_trans_t fsm_trans_rx[] = {
+static const fsm_trans_t fsm_trans_rx[] = {
 
   {OFF_RX, check_on_rx, IDLE_RX, do_rx_start},
   {IDLE_RX, check_off_rx, OFF_RX, do_rx_stop},
   {IDLE_RX, check_edge_detection, WAIT_RX, do_update_len_and_timeout},
-  {WAIT_RX, check_timeout, IDLE_RX, do_store_data},
+  {WAIT_RX, check_frame_decoded, IDLE_RX, do_frame_done},
   {WAIT_RX, check_edge_detection, WAIT_RX, do_update_len_and_timeout},
   { -1 , NULL , -1, NULL },
 };  
@@ -136,14 +338,38 @@ void fsm_rx_init(fsm_t *p_this, uint8_t rx_id)
   fsm_init(p_this, fsm_trans_rx);
 
   p_fsm->rx_id = rx_id;
-  p_fsm->code = 0;
   p_fsm->num_edges_detected = 0;
   p_fsm->last_tick = 0;
-  p_fsm->is_error = false;
-  p_fsm->is_repetition = false;
+  p_fsm->gap_us = NEC_RX_END_OF_FRAME_GAP_US;
+  p_fsm->fifo_head = 0;
+  p_fsm->fifo_tail = 0;
+  p_fsm->num_dropped = 0;
+  p_fsm->num_decoded_seen = 0;
+  p_fsm->decode_stats = (fsm_rx_decode_stats_t){0};
   p_fsm->status = true;
-  p_fsm->message_timeout_ms = NEC_MESSAGE_TIMEOUT_US/1000;
+  p_fsm->raw_capture = false;
+  p_fsm->num_raw_deltas = 0;
+  p_fsm->num_filter_addresses = 0;
+  p_fsm->filter_mask = 0xFFFF;
+  p_fsm->last_filtered = false;
+  p_fsm->num_filtered = 0;
+  p_fsm->held_code = 0;
+  p_fsm->held_first_ms = 0;
+  p_fsm->held_last_ms = 0;
+  p_fsm->held_repeats = 0;
+  p_fsm->decode_hook = NULL;
+  p_fsm->p_decode_arg = NULL;
+  p_fsm->p_fsm_rx_nec = fsm_rx_NEC_new();
+  fsm_rx_NEC_set_address_filter(p_fsm->p_fsm_rx_nec, p_fsm->filter_addresses, p_fsm->num_filter_addresses, p_fsm->filter_mask);
   port_rx_init(p_fsm->rx_id);	
+  port_rx_set_end_of_frame_gap(p_fsm->rx_id, p_fsm->gap_us);
+  port_rx_set_edge_notify(p_fsm->rx_id, NEC_REPETITION_EDGES);
+
+  /*A new FSM of a receiver replaces the previous one*/
+  if(rx_id < FSM_RX_MAX_RECEIVERS){
+    p_deferred_arr[rx_id] = p_fsm;
+    port_system_deferred_add_handler(_decode_deferred);
+  }
 }
 
 fsm_t *fsm_rx_new(uint8_t rx_id)
@@ -159,45 +385,154 @@ void fsm_rx_set_rx_status(fsm_t *p_this, bool status){
   p_fsm->status = status;
 }	
 
-uint32_t fsm_rx_get_code(fsm_t *p_this){
+const fsm_rx_frame_t *fsm_rx_peek_frame(fsm_t *p_this){
 
   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-  return p_fsm->code;
-}	
 
-bool fsm_rx_get_repetition(fsm_t *p_this){
+  if(_fifo_count(p_fsm) == 0){
+    return NULL;
+  }
+  /*The frame is read after the producer published it*/
+  atomic_signal_fence(memory_order_acquire);
+  return &p_fsm->fifo[p_fsm->fifo_head % FSM_RX_FIFO_SIZE];
+}
 
-   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-   return p_fsm->is_repetition;
-}	
+bool fsm_rx_pop_frame(fsm_t *p_this, fsm_rx_frame_t *p_frame){
 
-bool fsm_rx_get_error_code(fsm_t *p_this){
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  const fsm_rx_frame_t *p_oldest = fsm_rx_peek_frame(p_this);
+
+  if(p_oldest == NULL){
+    return false;
+  }
+  if(p_frame != NULL){
+    *p_frame = *p_oldest;
+  }
+  /*The raw intervals are released with the frame that holds them*/
+  if(p_oldest->has_raw){
+    p_fsm->num_raw_deltas = 0;
+  }
+  /*The slot is only released to the producer once it has been read*/
+  atomic_signal_fence(memory_order_release);
+  p_fsm->fifo_head++;
+  return true;
+}
+
+uint32_t fsm_rx_get_num_frames(fsm_t *p_this){
 
   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-   return p_fsm->is_error;
+  return _fifo_count(p_fsm);
 }
 
-void fsm_rx_reset_code(fsm_t *p_this){
+uint32_t fsm_rx_get_num_dropped(fsm_t *p_this){
 
-   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
-   p_fsm->code = 0;
-   p_fsm->is_error = false;
-   p_fsm->is_repetition = false;
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return p_fsm->num_dropped;
+}
+
+void fsm_rx_set_raw_capture(fsm_t *p_this, bool enable){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  p_fsm->raw_capture = enable;
+}
+
+const uint16_t *fsm_rx_get_raw(fsm_t *p_this, uint32_t *p_num_deltas){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  const fsm_rx_frame_t *p_oldest = fsm_rx_peek_frame(p_this);
+  *p_num_deltas = (p_oldest != NULL && p_oldest->has_raw) ? p_fsm->num_raw_deltas : 0;
+  return p_fsm->raw_deltas;
+}
+
+uint32_t fsm_rx_get_last_edge_ms(fsm_t *p_this){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return p_fsm->last_tick;
 }
 
 bool fsm_rx_check_activity(fsm_t *p_this){
 
   fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
 
-  if(p_fsm->f.current_state == WAIT_RX){
+  /*A frame in flight is not activity: the system sleeps until it has been decoded*/
+  if(_fifo_count(p_fsm) > 0 || (p_fsm->f.current_state == WAIT_RX && check_frame_decoded(p_this))){
     return true;
   }
   else{
     return false;
   }
 
-}	
+}
+
+void fsm_rx_set_address_filter(fsm_t *p_this, const uint16_t *p_addresses, uint8_t num_addresses, uint16_t mask){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  /*The decoder of the deferred interrupt reads the table, so it is held off while the table is rewritten*/
+  uint32_t deferred = port_system_deferred_mask();
+
+  if(p_addresses == NULL || num_addresses > NEC_ADDRESS_FILTER_MAX){
+    num_addresses = (p_addresses == NULL) ? 0 : NEC_ADDRESS_FILTER_MAX;
+  }
+  for(uint8_t i = 0; i < num_addresses; i++){
+    p_fsm->filter_addresses[i] = p_addresses[i];
+  }
+  p_fsm->num_filter_addresses = num_addresses;
+  p_fsm->filter_mask = mask;
+  p_fsm->last_filtered = false;
+
+  fsm_rx_NEC_set_address_filter(p_fsm->p_fsm_rx_nec, p_fsm->filter_addresses, p_fsm->num_filter_addresses, p_fsm->filter_mask);
+  port_system_deferred_unmask(deferred);
+}
+
+bool fsm_rx_check_frame_in_flight(fsm_t *p_this){
 
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return p_fsm->f.current_state == WAIT_RX;
+}
+
+void fsm_rx_set_end_of_frame_gap(fsm_t *p_this, uint32_t gap_us){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  p_fsm->gap_us = gap_us;
+  port_rx_set_end_of_frame_gap(p_fsm->rx_id, gap_us);
+}
+
+void fsm_rx_set_decode_hook(fsm_t *p_this, fsm_rx_decode_hook_t hook, void *p_arg){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+
+  /*The hook is cleared first, so that the deferred interrupt never runs it with the argument of another one*/
+  p_fsm->decode_hook = NULL;
+  p_fsm->p_decode_arg = p_arg;
+  p_fsm->decode_hook = hook;
+}
+
+const fsm_rx_decode_stats_t *fsm_rx_get_decode_stats(fsm_t *p_this){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return &p_fsm->decode_stats;
+}
+
+uint32_t fsm_rx_get_num_filtered(fsm_t *p_this){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return p_fsm->num_filtered;
+}
+
+uint16_t fsm_rx_get_drift(fsm_t *p_this, uint16_t address){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return fsm_rx_NEC_get_drift(p_fsm->p_fsm_rx_nec, address);
+}
 
+void fsm_rx_set_glitch_filter(fsm_t *p_this, uint32_t min_pulse_us){
 
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  port_rx_set_glitch_filter(p_fsm->rx_id, min_pulse_us);
+}
 
+uint32_t fsm_rx_get_num_glitches(fsm_t *p_this){
+
+  fsm_rx_t *p_fsm = (fsm_rx_t *)(p_this);
+  return port_rx_get_num_glitches(p_fsm->rx_id);
+}
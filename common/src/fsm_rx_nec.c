@@ -14,17 +14,58 @@
 #include "fsm_rx_nec.h"
 
 /* Typedefs --------------------------------------------------------------------*/
+typedef struct
+{
+  uint16_t min; /*Shortest interval accepted, in ticks*/
+  uint16_t max; /*Longest interval accepted, in ticks*/
+} nec_window_t;
+
+typedef struct
+{
+  uint16_t address; /*Address field of the frames*/
+  uint16_t scale; /*Time scale learnt for the remote*/
+} nec_drift_t;
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Enums */
+enum NEC_WINDOW {
+  NEC_WINDOW_PROLOGUE_PULSE,
+  NEC_WINDOW_REPETITION_PULSE,
+  NEC_WINDOW_SYMBOL_SILENCE,
+  NEC_WINDOW_SYMBOL_0_PULSE,
+  NEC_WINDOW_SYMBOL_1_PULSE,
+  NEC_WINDOWS
+};
+
 typedef struct
 {
   fsm_t f;
-  uint16_t *p_edge_ticks;
-  uint32_t num_edges_to_read;
+  const rx_delta_t *p_next_delta; /*Next interval of the buffer to read*/
+  uint16_t delta_ticks; /*Interval being parsed, in ticks*/
+  uint32_t num_deltas_to_read; /*Intervals left, including the one being parsed*/
   uint32_t bits_remaining_to_read;
   uint32_t code;
   bool is_repetition;
+  const uint16_t *p_filter_addresses; /*Accepted addresses, or NULL to decode every frame*/
+  uint8_t num_filter_addresses; /*Number of accepted addresses*/
+  uint16_t filter_mask; /*Bits of the address field that are compared*/
+  bool is_filtered; /*Flag to indicate that the last frame was skipped by the address filter*/
+  uint8_t error; /*Reason why the last frame could not be parsed, one of NEC_RX_ERROR*/
+  bool adaptive; /*Flag to indicate that the windows are rescaled to the clock of each remote*/
+  bool rescale; /*Flag to indicate that the windows of the frame being parsed are rescaled. Only set in the second pass over a frame that the fixed windows could not parse*/
+  uint32_t frame_ticks; /*Sum of the intervals of the frame since its prologue*/
+  bool address_rescaled; /*Flag to indicate that the windows of the frame have been rescaled to the drift of its address*/
+  nec_window_t windows_arr[NEC_WINDOWS]; /*Windows of the intervals after the prologue silence*/
+  nec_drift_t drifts_arr[NEC_RX_DRIFT_MAX_ADDRESSES]; /*Drift learnt for the last addresses*/
+  uint8_t num_drifts; /*Number of addresses in drifts_arr*/
+  uint8_t next_drift; /*Entry of drifts_arr replaced by the next new address*/
 } fsm_rx_nec_t;
 
-/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define NEC_CENTRE(min, max) (((uint32_t)(min) + (uint32_t)(max)) / 2) /*Width of an interval sent by a remote with a nominal clock: the centre of its window*/
+#define NEC_PROLOGUE_SILENCE_TICKS NEC_CENTRE(NEC_RX_PROLOGUE_TICKS_SILENCE_MIN, NEC_RX_PROLOGUE_TICKS_SILENCE_MAX) /*Nominal prologue silence in ticks*/
+#define NEC_PROLOGUE_TICKS (NEC_PROLOGUE_SILENCE_TICKS + NEC_CENTRE(NEC_RX_PROLOGUE_TICKS_PULSE_MIN, NEC_RX_PROLOGUE_TICKS_PULSE_MAX)) /*Nominal prologue of a command in ticks*/
+
 /* Enums */
 enum FSM_RX_NEC {
   NEC_IDLE,
@@ -33,16 +74,42 @@ enum FSM_RX_NEC {
   NEC_SYMBOL_PULSE
 };
 
+#if RX_DELTA_BITS == 8
+_Static_assert((NEC_RX_ADAPTIVE_PROLOGUE_TICKS_SILENCE_MAX + RX_DELTA_QUANTUM_TICKS / 2U) / RX_DELTA_QUANTUM_TICKS < RX_DELTA_ESCAPE, "The longest NEC interval does not fit in an 8-bit entry");
+#endif
+
+/* Global variables ------------------------------------------------------------*/
+/*Windows of the intervals for a remote with a nominal clock.*/
+static const nec_window_t nec_windows_arr[] = {
+  [NEC_WINDOW_PROLOGUE_PULSE] = {NEC_RX_PROLOGUE_TICKS_PULSE_MIN, NEC_RX_PROLOGUE_TICKS_PULSE_MAX},
+  [NEC_WINDOW_REPETITION_PULSE] = {NEC_RX_REPETITION_TICKS_PULSE_MIN, NEC_RX_REPETITION_TICKS_PULSE_MAX},
+  [NEC_WINDOW_SYMBOL_SILENCE] = {NEC_RX_SYMBOL_TICKS_SILENCE_MIN, NEC_RX_SYMBOL_TICKS_SILENCE_MAX},
+  [NEC_WINDOW_SYMBOL_0_PULSE] = {NEC_RX_SYMBOL_0_TICKS_PULSE_MIN, NEC_RX_SYMBOL_0_TICKS_PULSE_MAX},
+  [NEC_WINDOW_SYMBOL_1_PULSE] = {(uint16_t)NEC_RX_SYMBOL_1_TICKS_PULSE_MIN, (uint16_t)NEC_RX_SYMBOL_1_TICKS_PULSE_MAX},
+};
+
+/*Width of the intervals sent by a remote with a nominal clock: the centres of their windows.*/
+static const uint16_t nec_centres_arr[] = {
+  [NEC_WINDOW_PROLOGUE_PULSE] = NEC_CENTRE(NEC_RX_PROLOGUE_TICKS_PULSE_MIN, NEC_RX_PROLOGUE_TICKS_PULSE_MAX),
+  [NEC_WINDOW_REPETITION_PULSE] = NEC_CENTRE(NEC_RX_REPETITION_TICKS_PULSE_MIN, NEC_RX_REPETITION_TICKS_PULSE_MAX),
+  [NEC_WINDOW_SYMBOL_SILENCE] = NEC_CENTRE(NEC_RX_SYMBOL_TICKS_SILENCE_MIN, NEC_RX_SYMBOL_TICKS_SILENCE_MAX),
+  [NEC_WINDOW_SYMBOL_0_PULSE] = NEC_CENTRE(NEC_RX_SYMBOL_0_TICKS_PULSE_MIN, NEC_RX_SYMBOL_0_TICKS_PULSE_MAX),
+  [NEC_WINDOW_SYMBOL_1_PULSE] = NEC_CENTRE((uint16_t)NEC_RX_SYMBOL_1_TICKS_PULSE_MIN, (uint16_t)NEC_RX_SYMBOL_1_TICKS_PULSE_MAX),
+};
+
 /* Private functions */
 /**
- * @brief Auxiliary function to compute the time difference (in ticks) between the current and the next edge.
+ * @brief Auxiliary function to move to the next interval between edges, read as stored by the receiver.
  *
- * @param p_edge_ticks Pointer to the array containing the the time ticks of the edges detected by the infrared receiver
- * @return Time difference in ticks
+ * @param p_fsm Pointer to the NEC FSM. It must have an interval left to read
  */
-static uint16_t _get_diff_ticks(uint16_t *p_edge_ticks)
+static void _jump_to_next_delta(fsm_rx_nec_t *p_fsm)
 {
-  return *(p_edge_ticks + 1) - *(p_edge_ticks);
+  p_fsm->frame_ticks += p_fsm->delta_ticks;
+  p_fsm->num_deltas_to_read--;
+  if(p_fsm->num_deltas_to_read > 0){
+    p_fsm->delta_ticks = rx_delta_read(&p_fsm->p_next_delta);
+  }
 }
 
 /**
@@ -61,15 +128,81 @@ bool _value_in_range(uint16_t value, uint16_t min, uint16_t max)
   return ((value >= min) && (value <= max));
 }
 
+/**
+ * @brief Auxiliary function to rescale the windows of the intervals to the clock of a remote.
+ *
+ * The centre of every window is rescaled, but not its width: the jitter of the edges comes from the receiver, not from the clock of the remote.
+ *
+ * @param p_fsm Pointer to the NEC FSM
+ * @param first First window to rescale
+ * @param last Last window to rescale
+ * @param scale Time scale of the remote. #NEC_RX_SCALE_ONE for a nominal clock
+ */
+static void _scale_windows(fsm_rx_nec_t *p_fsm, uint8_t first, uint8_t last, uint32_t scale)
+{
+  for(uint8_t i = first; i <= last; i++){
+    int32_t centre = nec_centres_arr[i];
+    int32_t shift = ((centre * (int32_t)scale + (int32_t)(NEC_RX_SCALE_ONE / 2)) >> NEC_RX_SCALE_SHIFT) - centre;
+    p_fsm->windows_arr[i].min = (uint16_t)(nec_windows_arr[i].min + shift);
+    p_fsm->windows_arr[i].max = (uint16_t)(nec_windows_arr[i].max + shift);
+  }
+}
+
+/**
+ * @brief Auxiliary function to find the drift learnt for an address.
+ *
+ * @param p_fsm Pointer to the NEC FSM
+ * @param address Address field of a frame
+ * @return Pointer to the entry of the address, or NULL if it has not been learnt
+ */
+static nec_drift_t *_find_drift(fsm_rx_nec_t *p_fsm, uint16_t address)
+{
+  for(uint8_t i = 0; i < p_fsm->num_drifts; i++){
+    if(p_fsm->drifts_arr[i].address == address){
+      return &p_fsm->drifts_arr[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Auxiliary function to learn the drift of the remote of a command from the whole frame, that averages the jitter of all its intervals.
+ *
+ * @param p_fsm Pointer to the NEC FSM, at the end of a command
+ */
+static void _learn_drift(fsm_rx_nec_t *p_fsm)
+{
+  uint32_t ones = (uint32_t)__builtin_popcount(p_fsm->code);
+  uint32_t nominal_ticks = NEC_PROLOGUE_TICKS + (NEC_FRAME_BITS + 1) * nec_centres_arr[NEC_WINDOW_SYMBOL_SILENCE] + ones * nec_centres_arr[NEC_WINDOW_SYMBOL_1_PULSE] + (NEC_FRAME_BITS - ones) * nec_centres_arr[NEC_WINDOW_SYMBOL_0_PULSE];
+  int32_t scale = (int32_t)((p_fsm->frame_ticks * NEC_RX_SCALE_ONE) / nominal_ticks);
+  nec_drift_t *p_drift = _find_drift(p_fsm, NEC_ADDRESS(p_fsm->code));
+
+  if(scale < (int32_t)(NEC_RX_SCALE_ONE * (100 - NEC_RX_MAX_DRIFT_PCT) / 100) || scale > (int32_t)(NEC_RX_SCALE_ONE * (100 + NEC_RX_MAX_DRIFT_PCT) / 100)){
+    return;
+  }
+  if(p_drift == NULL){
+    p_drift = &p_fsm->drifts_arr[p_fsm->next_drift];
+    p_fsm->next_drift = (p_fsm->next_drift + 1) % NEC_RX_DRIFT_MAX_ADDRESSES;
+    if(p_fsm->num_drifts < NEC_RX_DRIFT_MAX_ADDRESSES){
+      p_fsm->num_drifts++;
+    }
+    p_drift->address = NEC_ADDRESS(p_fsm->code);
+    p_drift->scale = (uint16_t)scale;
+    return;
+  }
+  p_drift->scale = (uint16_t)(p_drift->scale + (scale - (int32_t)p_drift->scale) / (1 << NEC_RX_DRIFT_EWMA_SHIFT));
+}
+
 /* State machine input or transition functions */
 
 static bool check_is_init_silence (fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
-  uint16_t value = _get_diff_ticks(p_fsm->p_edge_ticks);
-  
-  return _value_in_range(value, NEC_RX_PROLOGUE_TICKS_SILENCE_MIN, NEC_RX_PROLOGUE_TICKS_SILENCE_MAX);
+  if(p_fsm->rescale){
+    return _value_in_range(p_fsm->delta_ticks, NEC_RX_ADAPTIVE_PROLOGUE_TICKS_SILENCE_MIN, NEC_RX_ADAPTIVE_PROLOGUE_TICKS_SILENCE_MAX);
+  }
+  return _value_in_range(p_fsm->delta_ticks, NEC_RX_PROLOGUE_TICKS_SILENCE_MIN, NEC_RX_PROLOGUE_TICKS_SILENCE_MAX);
 }	
 
 static bool check_is_init_noise	(fsm_t *p_this){
@@ -82,18 +215,14 @@ static bool check_is_prologue_pulse	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
-  uint16_t value = _get_diff_ticks(p_fsm->p_edge_ticks);
-  
-  return _value_in_range(value, NEC_RX_PROLOGUE_TICKS_PULSE_MIN, NEC_RX_PROLOGUE_TICKS_PULSE_MAX);
+  return _value_in_range(p_fsm->delta_ticks, p_fsm->windows_arr[NEC_WINDOW_PROLOGUE_PULSE].min, p_fsm->windows_arr[NEC_WINDOW_PROLOGUE_PULSE].max);
 }	
 
 static bool check_is_repetition_pulse	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
- 	uint16_t value = _get_diff_ticks(p_fsm->p_edge_ticks);
-  
-  return _value_in_range(value, NEC_RX_REPETITION_TICKS_PULSE_MIN, NEC_RX_REPETITION_TICKS_PULSE_MAX);
+  return _value_in_range(p_fsm->delta_ticks, p_fsm->windows_arr[NEC_WINDOW_REPETITION_PULSE].min, p_fsm->windows_arr[NEC_WINDOW_REPETITION_PULSE].max);
 
 }
 
@@ -119,6 +248,35 @@ static bool check_is_last_symbol(fsm_t *p_this){
   }
 }
 
+/*Check, right after the address field has been parsed, if the frame is for another device.*/
+static bool check_is_foreign_address(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+
+  if(p_fsm->num_filter_addresses == 0 || p_fsm->is_repetition || p_fsm->bits_remaining_to_read != NEC_COMMAND_BITS){
+    return false;
+  }
+
+  uint16_t address = (uint16_t)p_fsm->code & p_fsm->filter_mask;
+  for(uint8_t i = 0; i < p_fsm->num_filter_addresses; i++){
+    if((p_fsm->p_filter_addresses[i] & p_fsm->filter_mask) == address){
+      return false;
+    }
+  }
+  return true;
+}
+
+/*Check, right after the address field has been parsed, if the drift of its remote has been learnt.*/
+static bool check_is_known_address(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+
+  if(!p_fsm->rescale || p_fsm->address_rescaled || p_fsm->is_repetition || p_fsm->bits_remaining_to_read != NEC_COMMAND_BITS){
+    return false;
+  }
+  return _find_drift(p_fsm, (uint16_t)p_fsm->code) != NULL;
+}
+
 static bool check_is_symbol_silence	(fsm_t *p_this){
 
   if(check_is_last_symbol(p_this)){
@@ -127,9 +285,7 @@ static bool check_is_symbol_silence	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
- 	uint16_t value = _get_diff_ticks(p_fsm->p_edge_ticks);
-  
-  return _value_in_range(value, NEC_RX_SYMBOL_TICKS_SILENCE_MIN, NEC_RX_SYMBOL_TICKS_SILENCE_MAX);
+  return _value_in_range(p_fsm->delta_ticks, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_SILENCE].min, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_SILENCE].max);
 
 }
 
@@ -146,18 +302,14 @@ static bool check_is_symbol_0_pulse	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
- 	uint16_t value = _get_diff_ticks(p_fsm->p_edge_ticks);
-  
-  return _value_in_range(value, NEC_RX_SYMBOL_0_TICKS_PULSE_MIN, NEC_RX_SYMBOL_0_TICKS_PULSE_MAX);
+  return _value_in_range(p_fsm->delta_ticks, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_0_PULSE].min, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_0_PULSE].max);
 }	
 
 static bool check_is_symbol_1_pulse	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
- 	uint16_t value = _get_diff_ticks(p_fsm->p_edge_ticks);
-  
-  return _value_in_range(value, NEC_RX_SYMBOL_1_TICKS_PULSE_MIN, NEC_RX_SYMBOL_1_TICKS_PULSE_MAX);
+  return _value_in_range(p_fsm->delta_ticks, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_1_PULSE].min, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_1_PULSE].max);
 }	
 
 static bool check_is_symbol_pulse_noise	(fsm_t *p_this){
@@ -177,28 +329,33 @@ static void do_jump_to_next_edge (fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
-  p_fsm->p_edge_ticks++;
-  p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 1;
+  _jump_to_next_delta(p_fsm);
 }	
 
 static void do_repetition_starts (fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
-  p_fsm->p_edge_ticks++;
-  p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 1;
+  _jump_to_next_delta(p_fsm);
   p_fsm->bits_remaining_to_read = 0;
   p_fsm->is_repetition = true;
+  p_fsm->error = NEC_RX_ERROR_TRUNCATED;
 }
 
 static void do_command_starts	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
-  p_fsm->p_edge_ticks++;
-  p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 1;
+  _jump_to_next_delta(p_fsm);
   p_fsm->bits_remaining_to_read = NEC_FRAME_BITS;
   p_fsm->is_repetition = false;
+  p_fsm->address_rescaled = false;
+  p_fsm->error = NEC_RX_ERROR_TRUNCATED;
+
+  /*The whole prologue gives a better estimate of the time scale than its silence*/
+  if(p_fsm->rescale){
+    _scale_windows(p_fsm, NEC_WINDOW_SYMBOL_SILENCE, NEC_WINDOW_SYMBOL_1_PULSE, (p_fsm->frame_ticks * NEC_RX_SCALE_ONE) / NEC_PROLOGUE_TICKS);
+  }
 
 }
 
@@ -206,25 +363,38 @@ static void do_reset_and_jump_to_next_edge	(fsm_t *p_this){
 
    fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
-  p_fsm->p_edge_ticks++;
-  p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 1;
+  p_fsm->frame_ticks = 0;
+  _jump_to_next_delta(p_fsm);
   p_fsm->code = 0;
 
+  /*The silence of the prologue gives the time scale of the pulse that follows*/
+  if(p_fsm->rescale){
+    _scale_windows(p_fsm, NEC_WINDOW_PROLOGUE_PULSE, NEC_WINDOW_REPETITION_PULSE, (p_fsm->frame_ticks * NEC_RX_SCALE_ONE) / NEC_PROLOGUE_SILENCE_TICKS);
+  }
+
 }
 
-static void do_reset_and_jump_two_edges	(fsm_t *p_this){
+/*The frame is abandoned at an interval that is not a symbol. It may be the prologue of the next frame, so it is parsed again.*/
+static void do_symbol_error(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  p_fsm->error = NEC_RX_ERROR_SYMBOL;
+}
 
-  p_fsm->p_edge_ticks++;
-  p_fsm->p_edge_ticks++;
+static void do_symbol_error_and_jump_to_next_edge(fsm_t *p_this){
 
-   if(p_fsm->num_edges_to_read > 1){
-    p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 2;
-   }
-   else{
-    p_fsm->num_edges_to_read = 0;
-   }
+  do_symbol_error(p_this);
+  do_jump_to_next_edge(p_this);
+}
+
+static void do_reset_and_jump_two_edges	(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+
+  _jump_to_next_delta(p_fsm);
+  if(p_fsm->num_deltas_to_read > 0){
+    _jump_to_next_delta(p_fsm);
+  }
 }	
 
 static void do_store_bit_0	(fsm_t *p_this){
@@ -232,8 +402,7 @@ static void do_store_bit_0	(fsm_t *p_this){
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
 
   p_fsm->code = p_fsm->code << 1;
-  p_fsm->p_edge_ticks++;
-  p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 1;
+  _jump_to_next_delta(p_fsm);
   p_fsm->bits_remaining_to_read = p_fsm->bits_remaining_to_read - 1;
 
 }
@@ -244,31 +413,56 @@ static void do_store_bit_1	(fsm_t *p_this){
 
   p_fsm->code = p_fsm->code << 1;
   p_fsm->code = p_fsm->code + 1;
-  p_fsm->p_edge_ticks++;
-  p_fsm->num_edges_to_read = p_fsm->num_edges_to_read - 1;
+  _jump_to_next_delta(p_fsm);
   p_fsm->bits_remaining_to_read = p_fsm->bits_remaining_to_read - 1;
 
 }	
 
+/*Classify the command against the drift learnt for the address, more accurate than the estimate of the prologue.*/
+static void do_rescale_to_address(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  p_fsm->address_rescaled = true;
+  _scale_windows(p_fsm, NEC_WINDOW_SYMBOL_SILENCE, NEC_WINDOW_SYMBOL_1_PULSE, _find_drift(p_fsm, (uint16_t)p_fsm->code)->scale);
+}
+
+/*Skip the rest of a frame for another device.*/
+static void do_discard_frame(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  p_fsm->code = 0;
+  p_fsm->num_deltas_to_read = 0;
+  p_fsm->is_filtered = true;
+  p_fsm->error = NEC_RX_ERROR_NONE;
+}
+
 static void do_set_end	(fsm_t *p_this){
 
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
-  p_fsm->num_edges_to_read = 0;
+
+  if(p_fsm->adaptive && !p_fsm->is_repetition){
+    p_fsm->frame_ticks += p_fsm->delta_ticks;
+    _learn_drift(p_fsm);
+  }
+  p_fsm->num_deltas_to_read = 0;
+  p_fsm->error = NEC_RX_ERROR_NONE;
 }
 
-static fsm_trans_t fsm_trans_rx_nec[] = {
+static const fsm_trans_t fsm_trans_rx_nec[] = {
 
   {NEC_IDLE, check_is_init_noise, NEC_IDLE, do_reset_and_jump_two_edges},
   {NEC_IDLE, check_is_init_silence, NEC_INIT, do_reset_and_jump_to_next_edge},
   {NEC_INIT, check_is_init_pulse_noise, NEC_IDLE, do_jump_to_next_edge},
   {NEC_INIT, check_is_repetition_pulse, NEC_SYMBOL_SILENCE, do_repetition_starts},
   {NEC_INIT, check_is_prologue_pulse, NEC_SYMBOL_SILENCE, do_command_starts},
+  {NEC_SYMBOL_SILENCE, check_is_foreign_address, NEC_IDLE, do_discard_frame},
+  {NEC_SYMBOL_SILENCE, check_is_known_address, NEC_SYMBOL_SILENCE, do_rescale_to_address},
   {NEC_SYMBOL_SILENCE, check_is_last_symbol, NEC_IDLE, do_set_end},
-  {NEC_SYMBOL_SILENCE, check_is_symbol_silence_noise, NEC_IDLE, NULL},
+  {NEC_SYMBOL_SILENCE, check_is_symbol_silence_noise, NEC_IDLE, do_symbol_error},
   {NEC_SYMBOL_SILENCE, check_is_symbol_silence, NEC_SYMBOL_PULSE, do_jump_to_next_edge},
   {NEC_SYMBOL_PULSE, check_is_symbol_0_pulse, NEC_SYMBOL_SILENCE, do_store_bit_0},
   {NEC_SYMBOL_PULSE, check_is_symbol_1_pulse, NEC_SYMBOL_SILENCE, do_store_bit_1},
-  {NEC_SYMBOL_PULSE, check_is_symbol_pulse_noise, NEC_IDLE, do_jump_to_next_edge},
+  {NEC_SYMBOL_PULSE, check_is_symbol_pulse_noise, NEC_IDLE, do_symbol_error_and_jump_to_next_edge},
   { -1 , NULL , -1, NULL },
 };
 
@@ -280,30 +474,170 @@ void fsm_rx_NEC_init(fsm_t *p_this)
   fsm_init(p_this, fsm_trans_rx_nec);
 
   p_fsm->code = 0;
-  p_fsm->num_edges_to_read = 0;
-  p_fsm->p_edge_ticks = NULL;
+  p_fsm->num_deltas_to_read = 0;
+  p_fsm->p_next_delta = NULL;
+  p_fsm->delta_ticks = 0;
   p_fsm->is_repetition = false;
+  p_fsm->p_filter_addresses = NULL;
+  p_fsm->num_filter_addresses = 0;
+  p_fsm->filter_mask = 0xFFFF;
+  p_fsm->is_filtered = false;
+  p_fsm->error = NEC_RX_ERROR_NONE;
+  p_fsm->frame_ticks = 0;
+  p_fsm->address_rescaled = false;
+  p_fsm->num_drifts = 0;
+  p_fsm->next_drift = 0;
+  fsm_rx_NEC_set_adaptive(p_this, true);
 }
 
-bool fsm_rx_NEC_parse_code	(	fsm_t *p_this, uint16_t *p_edge_ticks, uint32_t num_edges, uint32_t *p_code){
-
+void fsm_rx_NEC_reset(fsm_t *p_this)
+{
   fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+
   p_fsm->f.current_state = NEC_IDLE;
   p_fsm->code = 0;
+  p_fsm->num_deltas_to_read = 0;
+  p_fsm->p_next_delta = NULL;
+  p_fsm->delta_ticks = 0;
   p_fsm->is_repetition = false;
-  p_fsm->num_edges_to_read = num_edges;
-  p_fsm->p_edge_ticks = p_edge_ticks;
+  p_fsm->is_filtered = false;
+  p_fsm->error = NEC_RX_ERROR_NONE;
+  p_fsm->frame_ticks = 0;
+  p_fsm->address_rescaled = false;
+}
 
-  while(p_fsm->num_edges_to_read > 1){
+/**
+ * @brief Auxiliary function to parse the intervals of a frame once.
+ *
+ * @param p_fsm Pointer to the NEC FSM
+ * @param p_deltas Intervals between the edges, as stored by the receiver
+ * @param num_deltas Number of intervals
+ * @param rescale `true` to rescale the windows to the clock of the remote, `false` to use the fixed windows of the protocol
+ */
+static void _parse(fsm_rx_nec_t *p_fsm, const rx_delta_t *p_deltas, uint32_t num_deltas, bool rescale)
+{
+  p_fsm->f.current_state = NEC_IDLE;
+  p_fsm->rescale = rescale;
+  p_fsm->code = 0;
+  p_fsm->is_repetition = false;
+  p_fsm->is_filtered = false;
+  p_fsm->error = NEC_RX_ERROR_PROLOGUE;
+  p_fsm->num_deltas_to_read = num_deltas;
+  p_fsm->p_next_delta = p_deltas;
+  if(num_deltas > 0){
+    p_fsm->delta_ticks = rx_delta_read(&p_fsm->p_next_delta);
+  }
+
+  while(p_fsm->num_deltas_to_read > 0){
 
     fsm_fire(&(p_fsm->f));
 
   }
+}
+
+/*The fixed windows are tried first: the jitter of the prologue misplaces the rescaled windows, and it loses frames of remotes with a nominal clock that the fixed windows decode. The rescaled windows are only tried on a frame with an interval out of the fixed ones; a frame cut short stays cut with any windows.*/
+bool fsm_rx_NEC_parse_code	(	fsm_t *p_this, const rx_delta_t *p_deltas, uint32_t num_deltas, uint32_t *p_code){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+
+  _parse(p_fsm, p_deltas, num_deltas, false);
+  if(p_fsm->adaptive && (p_fsm->error == NEC_RX_ERROR_PROLOGUE || p_fsm->error == NEC_RX_ERROR_SYMBOL)){
+    _parse(p_fsm, p_deltas, num_deltas, true);
+    _scale_windows(p_fsm, 0, NEC_WINDOWS - 1, NEC_RX_SCALE_ONE);
+  }
 
+  /*The bits of a frame abandoned or cut are not a code*/
+  if(p_fsm->error != NEC_RX_ERROR_NONE){
+    p_fsm->code = 0;
+    p_fsm->is_repetition = false;
+  }
   *p_code = p_fsm->code;
   return p_fsm->is_repetition;
 }
 
+/**
+ * @brief Auxiliary function to check the three intervals of a repetition code once.
+ *
+ * @param p_fsm Pointer to the NEC FSM
+ * @param p_deltas Intervals between the edges, as stored by the receiver
+ * @param rescale `true` to rescale the windows to the clock of the remote, `false` to use the fixed windows of the protocol
+ * @return `true` if the intervals are a repetition code
+ */
+static bool _check_repetition(fsm_rx_nec_t *p_fsm, const rx_delta_t *p_deltas, bool rescale)
+{
+  const rx_delta_t *p_delta = p_deltas;
+
+  p_fsm->rescale = rescale;
+  p_fsm->delta_ticks = rx_delta_read(&p_delta);
+  if(!check_is_init_silence(&p_fsm->f)){
+    return false;
+  }
+  if(rescale){
+    _scale_windows(p_fsm, NEC_WINDOW_REPETITION_PULSE, NEC_WINDOW_SYMBOL_SILENCE, (p_fsm->delta_ticks * NEC_RX_SCALE_ONE) / NEC_PROLOGUE_SILENCE_TICKS);
+  }
+  p_fsm->delta_ticks = rx_delta_read(&p_delta);
+  if(!check_is_repetition_pulse(&p_fsm->f)){
+    return false;
+  }
+  p_fsm->delta_ticks = rx_delta_read(&p_delta);
+  return _value_in_range(p_fsm->delta_ticks, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_SILENCE].min, p_fsm->windows_arr[NEC_WINDOW_SYMBOL_SILENCE].max);
+}
+
+/*Check the three intervals of a repetition code at once, without the FSM. The trailing burst is checked too, so that the first edges of a longer frame are not taken for a repetition. As with the frames, the fixed windows are tried before the rescaled ones.*/
+bool fsm_rx_NEC_check_repetition(fsm_t *p_this, const rx_delta_t *p_deltas, uint32_t num_deltas){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  bool is_repetition;
+
+  if(num_deltas != NEC_REPETITION_EDGES - 1){
+    return false;
+  }
+  if(_check_repetition(p_fsm, p_deltas, false)){
+    return true;
+  }
+  if(!p_fsm->adaptive){
+    return false;
+  }
+  is_repetition = _check_repetition(p_fsm, p_deltas, true);
+  _scale_windows(p_fsm, 0, NEC_WINDOWS - 1, NEC_RX_SCALE_ONE);
+  return is_repetition;
+}
+
+void fsm_rx_NEC_set_address_filter(fsm_t *p_this, const uint16_t *p_addresses, uint8_t num_addresses, uint16_t mask){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  p_fsm->p_filter_addresses = p_addresses;
+  p_fsm->num_filter_addresses = (p_addresses == NULL) ? 0 : num_addresses;
+  p_fsm->filter_mask = mask;
+}
+
+void fsm_rx_NEC_set_adaptive(fsm_t *p_this, bool enable){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  p_fsm->adaptive = enable;
+  p_fsm->rescale = false;
+  _scale_windows(p_fsm, 0, NEC_WINDOWS - 1, NEC_RX_SCALE_ONE);
+}
+
+uint16_t fsm_rx_NEC_get_drift(fsm_t *p_this, uint16_t address){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  nec_drift_t *p_drift = _find_drift(p_fsm, address);
+  return (p_drift == NULL) ? 0 : p_drift->scale;
+}
+
+bool fsm_rx_NEC_get_filtered(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  return p_fsm->is_filtered;
+}
+
+uint8_t fsm_rx_NEC_get_error(fsm_t *p_this){
+
+  fsm_rx_nec_t *p_fsm = (fsm_rx_nec_t *)(p_this);
+  return p_fsm->error;
+}
+
 fsm_t *fsm_rx_NEC_new()
 {
   fsm_t *p_fsm = malloc(sizeof(fsm_rx_nec_t));
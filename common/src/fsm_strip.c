@@ -0,0 +1,301 @@
+/**
+ * @file fsm_strip.c
+ * @brief Strip FSM main file. It renders the effects of an LED strip into the pixel array, and hands the frames encoded to the DMA of the port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsm_strip.h"
+#include "ws2812.h"
+#include "commands.h"
+#include "idle_governor.h"
+#include "port_rgb.h"
+#include "port_system.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_STRIP_NUM_COLORS 8U /*Codes of the remote with an effect on the strip*/
+
+_Static_assert(WS2812_STREAM_HALFWORDS(PORT_RGB_STRIP_MAX_PIXELS) * 16ULL * FSM_STRIP_FPS < WS2812_BIT_RATE_HZ, "The stream of the longest strip does not fit in a frame period");
+
+/* Enums */
+enum FSM_STRIP{
+    IDLE_STRIP = 0, /*The frame sent is up to date until the effect changes*/
+    ANIMATE_STRIP   /*Rendering the frames of an animated effect*/
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/*Colour of the strip for a code of the remote.*/
+typedef struct
+{
+    uint32_t code; /*NEC code*/
+    ws2812_pixel_t color; /*Colour at FSM_STRIP_COLOR_LEVEL, or off*/
+}fsm_strip_color_t;
+
+typedef struct
+{
+    fsm_t f; /*Strip FSM*/
+    uint8_t strip_id; /*LED strip ID*/
+    uint16_t num_pixels; /*Number of pixels of the strip*/
+    ws2812_pixel_t pixels[PORT_RGB_STRIP_MAX_PIXELS]; /*Colours of the frame being rendered*/
+    uint8_t effect; /*Current effect, one of FSM_STRIP_EFFECT*/
+    ws2812_pixel_t color; /*Colour of the effect*/
+    uint32_t last_code; /*Last code of the remote that triggered an effect*/
+    bool enabled; /*Flag to indicate that the strip is on*/
+    bool dirty; /*Flag to indicate that the effect has changed since the last frame*/
+    uint32_t position; /*Pixel of the head of the segment of the chase*/
+    uint32_t anim_start_ms; /*System time of the first frame of the animation, that the frames are scheduled from*/
+    uint32_t anim_frames; /*Frames of the animation since anim_start_ms*/
+    uint32_t next_frame_ms; /*Scheduled system time of the next frame of the animation*/
+    uint32_t num_frames; /*Frames sent to the strip*/
+}fsm_strip_t;
+
+/* Global variables ------------------------------------------------------------*/
+/*Colours of the codes of the remote, as those of the RGB LED.*/
+static const fsm_strip_color_t strip_colors[FSM_STRIP_NUM_COLORS] = {
+    {.code = LIL_RED_BUTTON, .color = {FSM_STRIP_COLOR_LEVEL, 0, 0}},
+    {.code = LIL_GREEN_BUTTON, .color = {0, FSM_STRIP_COLOR_LEVEL, 0}},
+    {.code = LIL_BLUE_BUTTON, .color = {0, 0, FSM_STRIP_COLOR_LEVEL}},
+    {.code = LIL_CYAN_BUTTON, .color = {0, FSM_STRIP_COLOR_LEVEL, FSM_STRIP_COLOR_LEVEL}},
+    {.code = LIL_MAGENTA_BUTTON, .color = {FSM_STRIP_COLOR_LEVEL, 0, FSM_STRIP_COLOR_LEVEL}},
+    {.code = LIL_YELLOW_BUTTON, .color = {FSM_STRIP_COLOR_LEVEL, FSM_STRIP_COLOR_LEVEL, 0}},
+    {.code = LIL_WHITE_BUTTON, .color = {FSM_STRIP_COLOR_LEVEL, FSM_STRIP_COLOR_LEVEL, FSM_STRIP_COLOR_LEVEL}},
+    {.code = LIL_OFF_BUTTON, .color = {0, 0, 0}},
+};
+
+/* Private functions -----------------------------------------------------------*/
+
+/*Check if the strip shows an animated effect.*/
+static bool _is_animated(fsm_strip_t *p_fsm){
+
+    return p_fsm->enabled && p_fsm->effect == FSM_STRIP_EFFECT_CHASE;
+}
+
+/*Interpolate a channel between two levels, at step i of n.*/
+static uint8_t _lerp(uint8_t from, uint8_t to, uint32_t i, uint32_t n){
+
+    return (uint8_t)((int32_t)from + ((int32_t)to - (int32_t)from) * (int32_t)i / (int32_t)n);
+}
+
+/*Render the current effect into the pixel array.*/
+static void _render(fsm_strip_t *p_fsm){
+
+    ws2812_pixel_t color = p_fsm->color;
+    uint32_t n = p_fsm->num_pixels;
+    uint32_t last = (n > 1) ? (n - 1) : 1;
+    /*The complement is taken against the brightest channel, so that it keeps the brightness of the colour*/
+    uint8_t level = (color.r > color.g) ? ((color.r > color.b) ? color.r : color.b) : ((color.g > color.b) ? color.g : color.b);
+    ws2812_pixel_t complement = {(uint8_t)(level - color.r), (uint8_t)(level - color.g), (uint8_t)(level - color.b)};
+
+    if(!p_fsm->enabled || n == 0){
+        memset(p_fsm->pixels, 0, n * sizeof(ws2812_pixel_t));
+        return;
+    }
+    switch(p_fsm->effect){
+    case FSM_STRIP_EFFECT_GRADIENT:
+        for(uint32_t i = 0; i < n; i++){
+            p_fsm->pixels[i].r = _lerp(color.r, complement.r, i, last);
+            p_fsm->pixels[i].g = _lerp(color.g, complement.g, i, last);
+            p_fsm->pixels[i].b = _lerp(color.b, complement.b, i, last);
+        }
+        break;
+    case FSM_STRIP_EFFECT_CHASE:
+        /*The segment fades from its head, wrapping around the end of the strip*/
+        memset(p_fsm->pixels, 0, n * sizeof(ws2812_pixel_t));
+        for(uint32_t k = 0; k < FSM_STRIP_CHASE_LENGTH && k < n; k++){
+            uint32_t i = (p_fsm->position + n - k) % n;
+            p_fsm->pixels[i].r = _lerp(color.r, 0, k, FSM_STRIP_CHASE_LENGTH);
+            p_fsm->pixels[i].g = _lerp(color.g, 0, k, FSM_STRIP_CHASE_LENGTH);
+            p_fsm->pixels[i].b = _lerp(color.b, 0, k, FSM_STRIP_CHASE_LENGTH);
+        }
+        p_fsm->position = (p_fsm->position + 1) % n;
+        break;
+    default:
+        for(uint32_t i = 0; i < n; i++){
+            p_fsm->pixels[i] = color;
+        }
+        break;
+    }
+}
+
+/* State machine input or transition functions */
+
+/*Check if a frame is due: the effect has changed or it is time for the next frame of the animation. The port must have sent the previous frame.*/
+static bool _check_frame_due(fsm_strip_t *p_fsm){
+
+    if(port_rgb_strip_is_busy(p_fsm->strip_id)){
+        return false;
+    }
+    return p_fsm->dirty || (_is_animated(p_fsm) && (int32_t)(port_system_get_millis() - p_fsm->next_frame_ms) >= 0);
+}
+
+/*Check if the next frame is of a static effect.*/
+static bool check_static_frame(fsm_t *p_this){
+
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+    return _check_frame_due(p_fsm) && !_is_animated(p_fsm);
+}
+
+/*Check if the next frame is of an animated effect.*/
+static bool check_animated_frame(fsm_t *p_this){
+
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+    return _check_frame_due(p_fsm) && _is_animated(p_fsm);
+}
+
+/* State machine output or action functions */
+
+/*Render a frame, encode it into the back buffer of the port and send it. An animation is scheduled from its first frame, and restarted if a frame is late by a whole period, so that the frames never come in a burst.*/
+static void do_send_frame(fsm_t *p_this){
+
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+    uint32_t now = port_system_get_millis();
+    uint32_t num_halfwords;
+
+    if(p_fsm->dirty || (now - p_fsm->next_frame_ms) >= 1000U / FSM_STRIP_FPS){
+        p_fsm->anim_start_ms = now;
+        p_fsm->anim_frames = 0;
+    }
+    p_fsm->dirty = false;
+    p_fsm->anim_frames++;
+    p_fsm->next_frame_ms = p_fsm->anim_start_ms + p_fsm->anim_frames * 1000U / FSM_STRIP_FPS;
+
+    _render(p_fsm);
+    num_halfwords = ws2812_encode(p_fsm->pixels, p_fsm->num_pixels, port_rgb_strip_get_back_buffer(p_fsm->strip_id));
+    port_rgb_strip_swap(p_fsm->strip_id, num_halfwords);
+    p_fsm->num_frames++;
+}
+
+/*Array representing the transitions table of the strip FSM.*/
+static const fsm_trans_t fsm_trans_strip[] = {
+
+    {IDLE_STRIP, check_animated_frame, ANIMATE_STRIP, do_send_frame},
+    {IDLE_STRIP, check_static_frame, IDLE_STRIP, do_send_frame},
+    {ANIMATE_STRIP, check_animated_frame, ANIMATE_STRIP, do_send_frame},
+    {ANIMATE_STRIP, check_static_frame, IDLE_STRIP, do_send_frame},
+    { -1 , NULL , -1, NULL },
+
+};
+
+/* Other auxiliary functions */
+
+/*Set the effect of the strip.*/
+void fsm_strip_set_effect(fsm_t *p_this, uint8_t effect, uint8_t r, uint8_t g, uint8_t b)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+
+    p_fsm->effect = (effect < FSM_STRIP_NUM_EFFECTS) ? effect : FSM_STRIP_EFFECT_FILL;
+    p_fsm->color.r = r;
+    p_fsm->color.g = g;
+    p_fsm->color.b = b;
+    p_fsm->position = 0;
+    p_fsm->dirty = true;
+}
+
+/*Trigger the effect of a code received from the remote.*/
+bool fsm_strip_process_code(fsm_t *p_this, uint32_t code)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+
+    for(uint32_t i = 0; i < FSM_STRIP_NUM_COLORS; i++){
+        if(strip_colors[i].code == code){
+            /*The same colour again moves to the next effect. The OFF button always fills with black*/
+            uint8_t effect = (code == p_fsm->last_code && code != LIL_OFF_BUTTON) ? (uint8_t)((p_fsm->effect + 1U) % FSM_STRIP_NUM_EFFECTS) : (uint8_t)FSM_STRIP_EFFECT_FILL;
+
+            fsm_strip_set_effect(p_this, effect, strip_colors[i].color.r, strip_colors[i].color.g, strip_colors[i].color.b);
+            p_fsm->last_code = code;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*Switch the strip on or off.*/
+void fsm_strip_set_enabled(fsm_t *p_this, bool enabled)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+
+    if(p_fsm->enabled != enabled){
+        p_fsm->enabled = enabled;
+        p_fsm->dirty = true;
+    }
+}
+
+/*Get the state that selects what the strip shows.*/
+void fsm_strip_get_state(fsm_t *p_this, fsm_strip_state_t *p_state)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+
+    p_state->last_code = p_fsm->last_code;
+    p_state->effect = p_fsm->effect;
+    p_state->r = p_fsm->color.r;
+    p_state->g = p_fsm->color.g;
+    p_state->b = p_fsm->color.b;
+}
+
+/*Restore the state that selects what the strip shows.*/
+void fsm_strip_set_state(fsm_t *p_this, const fsm_strip_state_t *p_state)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+
+    fsm_strip_set_effect(p_this, p_state->effect, p_state->r, p_state->g, p_state->b);
+    p_fsm->last_code = p_state->last_code;
+}
+
+/*Check if a frame has to be rendered now.*/
+bool fsm_strip_check_activity(fsm_t *p_this)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+    return _check_frame_due(p_fsm);
+}
+
+/*Get the system time by which the system has to be awake for the strip.*/
+uint32_t fsm_strip_get_deadline(fsm_t *p_this)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+
+    if(p_fsm->dirty || port_rgb_strip_is_busy(p_fsm->strip_id)){
+        return port_system_get_millis();
+    }
+    if(_is_animated(p_fsm)){
+        return p_fsm->next_frame_ms;
+    }
+    return IDLE_GOVERNOR_NO_DEADLINE;
+}
+
+/*Return the number of frames sent to the strip.*/
+uint32_t fsm_strip_get_num_frames(fsm_t *p_this)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+    return p_fsm->num_frames;
+}
+
+/*Create a new strip FSM.*/
+fsm_t *fsm_strip_new(uint8_t strip_id, uint16_t num_pixels)
+{
+    fsm_t *p_fsm = malloc(sizeof(fsm_strip_t)); /* Do malloc to reserve memory of all other FSM elements, although it is interpreted as fsm_t (the first element of the structure) */
+    fsm_strip_init(p_fsm, strip_id, num_pixels);
+    return p_fsm;
+}
+
+/*Initialize a strip FSM. A first frame switches off the LEDs, that may show anything after power-up.*/
+void fsm_strip_init(fsm_t *p_this, uint8_t strip_id, uint16_t num_pixels)
+{
+    fsm_strip_t *p_fsm = (fsm_strip_t *)(p_this);
+    fsm_init(p_this, fsm_trans_strip);
+
+    p_fsm->strip_id = strip_id;
+    p_fsm->num_pixels = (num_pixels <= PORT_RGB_STRIP_MAX_PIXELS) ? num_pixels : PORT_RGB_STRIP_MAX_PIXELS;
+    p_fsm->last_code = 0x00;
+    p_fsm->enabled = true;
+    p_fsm->anim_start_ms = 0;
+    p_fsm->anim_frames = 0;
+    p_fsm->next_frame_ms = 0;
+    p_fsm->num_frames = 0;
+    fsm_strip_set_effect(p_this, FSM_STRIP_EFFECT_FILL, 0, 0, 0);
+    port_rgb_strip_init(strip_id);
+}
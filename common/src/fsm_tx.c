@@ -9,6 +9,8 @@
 /* Includes ------------------------------------------------------------------*/
 #include "fsm_tx.h"
 #include "port_tx.h"
+#include "port_system.h"
+#include "telemetry.h"
 #include <stdlib.h>
 
 /* Typedefs --------------------------------------------------------------------*/
@@ -16,9 +18,24 @@ typedef struct
 {
     fsm_t f; /*Infrared transmitter FSM*/
     uint32_t code; /*NEC code to be sent*/
+    bool repeat; /*Flag to indicate that a repeat code has to be sent*/
+    uint8_t raw_ticks[NEC_TX_SCHEDULE_SIZE]; /*Symbol ticks of the bursts and silences of the raw waveform to be sent*/
+    uint8_t raw_num_steps; /*Number of bursts and silences of the raw waveform to be sent. 0 if there is none*/
+    uint32_t last_frame_ms; /*System time when the last frame started*/
+    uint32_t tx_mask; /*Transmitters that send the frames at once. The bit of tx_id by default*/
     uint8_t tx_id; /*Transmitter ID. Must be unique.*/
 }fsm_tx_t;
 
+typedef struct
+{
+    uint32_t tx_mask; /*Transmitters switched by the schedule*/
+    uint8_t ticks[NEC_TX_SCHEDULE_SIZE]; /*Symbol ticks of each burst and the silence after it, alternately*/
+    uint8_t num_steps; /*Number of bursts and silences*/
+    bool is_repeat; /*Flag to indicate that the schedule is a NEC repeat code, for the telemetry*/
+    uint8_t step; /*Burst or silence being sent*/
+    uint32_t next_tick; /*Symbol tick of the end of the step being sent*/
+}fsm_tx_schedule_t;
+
 
 
 /* Defines and enums ----------------------------------------------------------*/
@@ -30,38 +47,117 @@ enum FSM_TX{
 
 /* NEC private functions */
 
-/*	Wait for some ticks. Each tick if the symbol timer lasts for NEC_TX_TIMER_TICK_BASE_US microseconds.*/
-static void _wait_for_tx_ticks (uint32_t ticks){
+/*Switch the PWM of several transmitters.*/
+static void _set_pwm_mask(uint32_t tx_mask, bool status){
+
+    for(uint8_t tx_id = 0; tx_mask != 0; tx_id++, tx_mask >>= 1){
+        if(tx_mask & 1U){
+            port_tx_pwm_timer_set(tx_id, status);
+        }
+    }
+}
+
+/*Append a PWM burst and the silence after it to a schedule*/
+static void _schedule_NEC_burst(fsm_tx_schedule_t *p_sched, uint8_t ticks_ON, uint8_t ticks_OFF){
+
+    p_sched->ticks[p_sched->num_steps++] = ticks_ON;
+    p_sched->ticks[p_sched->num_steps++] = ticks_OFF;
+}
+
+/*Build the schedule of a NEC frame. The silence after the epilogue is not part of it: the next frame is delayed by check_tx_start()*/
+static void _schedule_NEC_code(fsm_tx_schedule_t *p_sched, uint32_t tx_mask, uint32_t code){
+
+    p_sched->tx_mask = tx_mask;
+    p_sched->num_steps = 0;
+    p_sched->is_repeat = false;
+    _schedule_NEC_burst(p_sched, NEC_TX_PROLOGUE_TICKS_ON, NEC_TX_PROLOGUE_TICKS_OFF);
+    for(uint32_t bit_mask = 0x80000000; bit_mask > 0; bit_mask >>= 1){
+        if(code & bit_mask){
+            _schedule_NEC_burst(p_sched, NEC_TX_SYM_1_TICKS_ON, NEC_TX_SYM_1_TICKS_OFF);
+        }
+        else{
+            _schedule_NEC_burst(p_sched, NEC_TX_SYM_0_TICKS_ON, NEC_TX_SYM_0_TICKS_OFF);
+        }
+    }
+    _schedule_NEC_burst(p_sched, NEC_TX_EPILOGUE_TICKS_ON, 0);
+}
+
+/*Build the schedule of a NEC repeat code: a burst, a short silence and the epilogue.*/
+static void _schedule_NEC_repeat(fsm_tx_schedule_t *p_sched, uint32_t tx_mask){
 
-    uint32_t initial_tick = port_tx_tmr_get_tick();
+    p_sched->tx_mask = tx_mask;
+    p_sched->num_steps = 0;
+    p_sched->is_repeat = true;
+    _schedule_NEC_burst(p_sched, NEC_TX_REPEAT_TICKS_ON, NEC_TX_REPEAT_TICKS_OFF);
+    _schedule_NEC_burst(p_sched, NEC_TX_EPILOGUE_TICKS_ON, 0);
+}
 
-    while ((port_tx_tmr_get_tick() - initial_tick) < ticks)
-  {
-  }
+/*Build the schedule of a raw waveform. A waveform that ends with a burst gets a silence of 0 ticks, so that the PWM is switched off at its end.*/
+static void _schedule_raw(fsm_tx_schedule_t *p_sched, uint32_t tx_mask, const uint8_t *p_ticks, uint8_t num_steps){
 
+    p_sched->tx_mask = tx_mask;
+    p_sched->num_steps = 0;
+    p_sched->is_repeat = false;
+    for(uint8_t i = 0; i + 1U < num_steps; i += 2){
+        _schedule_NEC_burst(p_sched, p_ticks[i], p_ticks[i + 1U]);
+    }
+    if(num_steps % 2){
+        _schedule_NEC_burst(p_sched, p_ticks[num_steps - 1U], 0);
+    }
 }
 
-/*Send a PWM burst and wait for a silence*/
-static void _send_NEC_burst	(uint8_t tx_id, uint32_t ticks_ON, uint32_t ticks_OFF){
+/*Send several schedules at once on the shared symbol timer. All of them start with a burst at tick 0 and the end of each step is an absolute tick, so concurrent frames last as long as the longest one and the polling delays do not add up.*/
+static void _send_schedules(fsm_tx_schedule_t *p_scheds, uint8_t num_scheds){
+
+    uint8_t num_active = num_scheds;
+    uint32_t tick = 0;
+
+    port_tx_symbol_tmr_start();
+    for(uint8_t i = 0; i < num_scheds; i++){
+        p_scheds[i].step = 0;
+        p_scheds[i].next_tick = p_scheds[i].ticks[0];
+        _set_pwm_mask(p_scheds[i].tx_mask, true);
+    }
+
+    while(num_active > 0){
+
+        tick = port_tx_tmr_get_tick();
 
-    port_tx_pwm_timer_set(tx_id, true);
-    _wait_for_tx_ticks (ticks_ON);
-    port_tx_pwm_timer_set(tx_id, false);
-    _wait_for_tx_ticks (ticks_OFF);
+        for(uint8_t i = 0; i < num_scheds; i++){
+            fsm_tx_schedule_t *p_sched = &p_scheds[i];
 
-}	
+            /* Steps of 0 ticks end at once */
+            while(p_sched->step < p_sched->num_steps && (int32_t)(tick - p_sched->next_tick) >= 0){
+                p_sched->step++;
+                if(p_sched->step == p_sched->num_steps){
+                    num_active--;
+                    break;
+                }
+                /* Even steps are bursts, odd steps are silences */
+                _set_pwm_mask(p_sched->tx_mask, (p_sched->step % 2) == 0);
+                p_sched->next_tick += p_sched->ticks[p_sched->step];
+            }
+        }
+    }
+    port_tx_symbol_tmr_stop();
 
+    /* The symbol timer starts at 0, so the last tick read is the time spent modulating */
+    telemetry_add(TELEMETRY_TX_BUSY_US, (uint32_t)(((uint64_t)tick * NEC_TX_TIMER_TICK_BASE_NS) / 1000U));
+    for(uint8_t i = 0; i < num_scheds; i++){
+        telemetry_add(p_scheds[i].is_repeat ? TELEMETRY_TX_REPETITIONS : TELEMETRY_TX_FRAMES, 1);
+    }
+}
 
 /* State machine input or transition functions */
 
-/*	Check if it has been received a code other than '0x00'.*/
+/*	Check if it has been received a code other than '0x00', a repeat code or a raw waveform, and the previous frame period has elapsed.*/
 static bool check_tx_start (fsm_t *p_this){
 
 
     fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
     uint32_t code0 = p_fsm->code;
 
-    if(code0 != 0x00){
+    if((code0 != 0x00 || p_fsm->repeat || p_fsm->raw_num_steps > 0) && (port_system_get_millis() - p_fsm->last_frame_ms) >= NEC_TX_FRAME_PERIOD_MS){
         return true;
     }
     else{
@@ -77,12 +173,30 @@ static bool check_tx_start (fsm_t *p_this){
 static void do_tx_start	(fsm_t *p_this){
 
     fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
-    fsm_send_NEC_code(p_fsm->tx_id, p_fsm->code);
-    p_fsm->code = 0x00;
+    p_fsm->last_frame_ms = port_system_get_millis();
+
+    /*A code takes precedence over a raw waveform, that is sent in the next frame period*/
+    if(p_fsm->code != 0x00){
+        fsm_send_NEC_code_fanout(p_fsm->tx_mask, p_fsm->code);
+        p_fsm->code = 0x00;
+        p_fsm->repeat = false;
+    }
+    else if(p_fsm->repeat){
+        fsm_tx_schedule_t sched;
+        _schedule_NEC_repeat(&sched, p_fsm->tx_mask);
+        _send_schedules(&sched, 1);
+        p_fsm->repeat = false;
+    }
+    else{
+        fsm_tx_schedule_t sched;
+        _schedule_raw(&sched, p_fsm->tx_mask, p_fsm->raw_ticks, p_fsm->raw_num_steps);
+        _send_schedules(&sched, 1);
+        p_fsm->raw_num_steps = 0;
+    }
 }
 
 /*	Array representing the transitions table of the FSM infrared transmitter.*/
-static fsm_trans_t fsm_trans_tx[] = {
+static const fsm_trans_t fsm_trans_tx[] = {
 
     {WAIT_TX, check_tx_start, WAIT_TX, do_tx_start},
     { -1 , NULL , -1, NULL },
@@ -102,37 +216,94 @@ void fsm_tx_set_code(fsm_t *p_this, uint32_t code)
     }
 }
 
+/*	Request a NEC repeat code*/
+void fsm_tx_set_repeat(fsm_t *p_this)
+{
+    fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
+    p_fsm->repeat = true;
+}
+
+/*	Set a raw waveform*/
+void fsm_tx_set_raw(fsm_t *p_this, const uint8_t *p_ticks, uint8_t num_steps)
+{
+    fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
+
+    if(num_steps > NEC_TX_SCHEDULE_SIZE){
+        num_steps = NEC_TX_SCHEDULE_SIZE;
+    }
+    for(uint8_t i = 0; i < num_steps; i++){
+        p_fsm->raw_ticks[i] = p_ticks[i];
+    }
+    p_fsm->raw_num_steps = num_steps;
+}
+
+/*	Check if a new code or repeat code can be set*/
+bool fsm_tx_is_ready(fsm_t *p_this)
+{
+    fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
+    return p_fsm->code == 0x00 && !p_fsm->repeat && p_fsm->raw_num_steps == 0 && (port_system_get_millis() - p_fsm->last_frame_ms) >= NEC_TX_FRAME_PERIOD_MS;
+}
+
+/*	Set the transmitters that send the frames of the FSM at once*/
+void fsm_tx_set_fanout(fsm_t *p_this, uint32_t tx_mask)
+{
+    fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
+
+    p_fsm->tx_mask = tx_mask | (1U << p_fsm->tx_id);
+    for(uint8_t tx_id = 0; tx_id < PORT_TX_NUM_TRANSMITTERS; tx_id++){
+        if((tx_mask & (1U << tx_id)) && tx_id != p_fsm->tx_id){
+            port_tx_init(tx_id, false);
+        }
+    }
+}
+
 /*	Start the process to transmit the code stored.*/
 void fsm_send_NEC_code(uint8_t tx_id, uint32_t code)
 {
-    uint32_t bit_mask = 0x80000000;
-    port_tx_symbol_tmr_start();
-    _send_NEC_burst(tx_id, NEC_TX_PROLOGUE_TICKS_ON, NEC_TX_PROLOGUE_TICKS_OFF);
+    fsm_send_NEC_code_fanout(1U << tx_id, code);
+}
 
-    while(bit_mask > 0){
+/*	Transmit the same NEC code on several transmitters, switched by one schedule.*/
+void fsm_send_NEC_code_fanout(uint32_t tx_mask, uint32_t code)
+{
+    fsm_tx_schedule_t sched;
 
-        if(code & bit_mask){
+    _schedule_NEC_code(&sched, tx_mask, code);
+    _send_schedules(&sched, 1);
+}
 
-             _send_NEC_burst(tx_id, NEC_TX_SYM_1_TICKS_ON, NEC_TX_SYM_1_TICKS_OFF);
-        }
+/*	Transmit a different NEC code on each transmitter at once, each with its own schedule.*/
+void fsm_send_NEC_codes(const uint8_t *p_tx_ids, const uint32_t *p_codes, uint8_t num_tx)
+{
+    fsm_tx_schedule_t scheds[PORT_TX_NUM_TRANSMITTERS];
 
+    if(num_tx > PORT_TX_NUM_TRANSMITTERS){
+        num_tx = PORT_TX_NUM_TRANSMITTERS;
+    }
+    for(uint8_t i = 0; i < num_tx; i++){
+        if(p_codes[i] != 0x00){
+            _schedule_NEC_code(&scheds[i], 1U << p_tx_ids[i], p_codes[i]);
+        }
         else{
-            
-            _send_NEC_burst(tx_id, NEC_TX_SYM_0_TICKS_ON, NEC_TX_SYM_0_TICKS_OFF);
+            _schedule_NEC_repeat(&scheds[i], 1U << p_tx_ids[i]);
         }
-
-        bit_mask >>= 1;
     }
+    _send_schedules(scheds, num_tx);
+}
 
-     _send_NEC_burst(tx_id, NEC_TX_EPILOGUE_TICKS_ON, NEC_TX_EPILOGUE_TICKS_OFF);
-     port_tx_symbol_tmr_stop();
+/*	Transmit a NEC repeat code: a burst, a short silence and the epilogue.*/
+void fsm_send_NEC_repeat(uint8_t tx_id)
+{
+    fsm_tx_schedule_t sched;
 
+    _schedule_NEC_repeat(&sched, 1U << tx_id);
+    _send_schedules(&sched, 1);
 }
 
 bool fsm_tx_check_activity(fsm_t *p_this){
 
     fsm_tx_t *p_fsm = (fsm_tx_t *)(p_this);
-    return p_fsm->f.current_state != WAIT_TX;
+    return p_fsm->code != 0x00 || p_fsm->repeat || p_fsm->raw_num_steps > 0;
 }
 
 
@@ -151,6 +322,10 @@ void fsm_tx_init(fsm_t *p_this, uint8_t tx_id)
     fsm_init(p_this, fsm_trans_tx);
 
     p_fsm->tx_id = tx_id;
+    p_fsm->tx_mask = 1U << tx_id;
     p_fsm->code = 0x00;
+    p_fsm->repeat = false;
+    p_fsm->raw_num_steps = 0;
+    p_fsm->last_frame_ms = port_system_get_millis() - NEC_TX_FRAME_PERIOD_MS;
     port_tx_init(tx_id, false);
 }
@@ -0,0 +1,106 @@
+/**
+ * @file idle_governor.c
+ * @brief Idle governor to select the low-power mode of the system.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+
+/* Other includes */
+#include "idle_governor.h"
+#include "telemetry.h"
+
+/* Public functions */
+
+/*Initialize the idle governor.*/
+void idle_governor_init(idle_governor_t *p_gov)
+{
+  memset(p_gov, 0, sizeof(idle_governor_t));
+  p_gov->predicted_idle_ms = IDLE_GOVERNOR_INITIAL_IDLE_MS;
+  p_gov->last_mode = PORT_SYSTEM_SLEEP_STOP;
+}
+
+/*Select the low-power mode for the predicted idle time.*/
+uint8_t idle_governor_select(idle_governor_t *p_gov, uint32_t now_ms, uint32_t deadline_ms, bool rx_armed)
+{
+  uint32_t idle_ms = p_gov->predicted_idle_ms;
+
+  if (deadline_ms != IDLE_GOVERNOR_NO_DEADLINE)
+  {
+    uint32_t to_deadline_ms = ((int32_t)(deadline_ms - now_ms) > 0) ? (deadline_ms - now_ms) : 0;
+    if (to_deadline_ms < idle_ms)
+    {
+      idle_ms = to_deadline_ms;
+    }
+  }
+
+  if (((now_ms - p_gov->last_activity_ms) < IDLE_GOVERNOR_RECENT_ACTIVITY_MS) || (idle_ms < IDLE_GOVERNOR_STOP_MIN_IDLE_MS))
+  {
+    return PORT_SYSTEM_SLEEP_WFI;
+  }
+  if (rx_armed)
+  {
+    return PORT_SYSTEM_SLEEP_STOP_FAST;
+  }
+  return PORT_SYSTEM_SLEEP_STOP;
+}
+
+/*Select a low-power mode and sleep until an interrupt wakes the system up.*/
+void idle_governor_sleep(idle_governor_t *p_gov, uint32_t deadline_ms, bool rx_armed)
+{
+  uint32_t now_ms = port_system_get_millis();
+
+  if (!p_gov->is_idle)
+  {
+    p_gov->is_idle = true;
+    p_gov->idle_start_ms = now_ms;
+  }
+
+  p_gov->last_mode = idle_governor_select(p_gov, now_ms, deadline_ms, rx_armed);
+  port_system_sleep_mode(p_gov->last_mode);
+}
+
+/*Finish the current idle period because there is activity in the system.*/
+void idle_governor_wake(idle_governor_t *p_gov)
+{
+  uint32_t now_ms = port_system_get_millis();
+
+  if (p_gov->is_idle)
+  {
+    /* Moving average with weight 1/4 for the last idle period */
+    p_gov->predicted_idle_ms = (3 * p_gov->predicted_idle_ms + (now_ms - p_gov->idle_start_ms)) / 4;
+    p_gov->is_idle = false;
+    p_gov->first_frame_pending = true;
+  }
+  p_gov->last_activity_ms = now_ms;
+}
+
+/*Report the result of the reception of a frame.*/
+void idle_governor_report_frame(idle_governor_t *p_gov, bool ok, uint32_t first_edge_ms)
+{
+  if (!p_gov->first_frame_pending)
+  {
+    return;
+  }
+  p_gov->first_frame_pending = false;
+
+  /* A frame that started once the system was awake, after a wake-up by another source, says nothing of the latency */
+  if ((int32_t)(first_edge_ms - p_gov->idle_start_ms) < 0 || (int32_t)(first_edge_ms - p_gov->last_activity_ms) > 0)
+  {
+    return;
+  }
+  if (ok)
+  {
+    p_gov->first_frame_ok[p_gov->last_mode]++;
+    telemetry_add(TELEMETRY_WAKE_FRAME_OK_WFI + p_gov->last_mode, 1);
+  }
+  else
+  {
+    p_gov->first_frame_err[p_gov->last_mode]++;
+    telemetry_add(TELEMETRY_WAKE_FRAME_ERR_WFI + p_gov->last_mode, 1);
+  }
+}
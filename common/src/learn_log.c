@@ -0,0 +1,407 @@
+/**
+ * @file learn_log.c
+ * @brief Append-only log of learned codes in flash, with an index in RAM.
+ *
+ * Layout of a sector: a header with #SECTOR_MAGIC and the sequence number, followed by the records. Each record is a header word (magic, type and length of the payload in words) followed by its payload. The first erased word after the last record marks the end of the log.
+ *
+ * The records are buffered in RAM and programmed in batches. The first header of a batch is programmed last, so a batch interrupted by a reset is not taken as valid; the next boot covers the partially programmed words with a padding record.
+ *
+ * When the sector or the index fills up, the newest records are copied to the other sector, without the padding, and the oldest ones are dropped. The header of the new sector is programmed last, so a compaction interrupted by a reset leaves the old sector active.
+ *
+ * The NEC codes of the index are also kept in a hash table, so that the check for duplicates of an append does not walk the whole log.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+
+/* Other includes */
+#include "learn_log.h"
+#include "port_flash.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define SECTOR_MAGIC 0x4C524E47U /*!< Magic number of a sector of the log ("LRNG") */
+#define SECTOR_HEADER_WORDS 2    /*!< Words of the header of a sector: magic and sequence number */
+#define RECORD_MAGIC 0xA5U       /*!< Magic number in the most significant byte of the header of a record */
+#define ERASED_WORD 0xFFFFFFFFU  /*!< Value of an erased word of flash */
+
+#define RECORD_HEADER(type, len) ((RECORD_MAGIC << 24) | ((uint32_t)(type) << 16) | (uint32_t)(len)) /*!< Header of a record */
+#define RECORD_IS_VALID(header) (((header) >> 24) == RECORD_MAGIC)                                  /*!< Check the magic number of the header of a record */
+#define RECORD_TYPE(header) (((header) >> 16) & 0xFFU)                                             /*!< Type of a record */
+#define RECORD_LEN(header) ((header) & 0xFFFFU)                                                    /*!< Length of the payload of a record in words */
+
+#define RAW_PAYLOAD_WORDS (1 + (LEARN_LOG_MAX_RAW_EDGES + 1) / 2) /*!< Maximum payload of a raw record: number of intervals and 2 intervals per word */
+
+#define CODE_HASH_BITS 12                                         /*!< Bits of the hash of a NEC code */
+#define CODE_HASH_SIZE (1U << CODE_HASH_BITS)                     /*!< Slots of the hash table of the NEC codes */
+#define CODE_HASH(code) (((uint32_t)(code) * 2654435761U) >> (32 - CODE_HASH_BITS)) /*!< Multiplicative hash of a NEC code */
+
+_Static_assert(CODE_HASH_SIZE >= 2 * LEARN_LOG_MAX_ENTRIES, "The hash table of the codes must be at most half full, so that the probes stay short");
+
+/* Global variables ------------------------------------------------------------*/
+static uint8_t active_sector = 0;                      /*!< Sector where the records are appended */
+static uint32_t sequence = 0;                          /*!< Sequence number of the active sector */
+static uint32_t flash_end = SECTOR_HEADER_WORDS;       /*!< Offset of the first word of the active sector not programmed */
+static uint32_t buffer[LEARN_LOG_BUFFER_WORDS];        /*!< Records waiting to be programmed. They follow the words in flash */
+static uint32_t buffered_words = 0;                    /*!< Number of words in the buffer */
+static uint32_t buffered_entries = 0;                  /*!< Number of records in the buffer */
+static uint32_t first_buffered_ms = 0;                 /*!< System time when the oldest buffered record was appended */
+static uint16_t index_arr[LEARN_LOG_MAX_ENTRIES];      /*!< Offset in words of each record in the active sector */
+static uint32_t num_entries = 0;                       /*!< Number of records in the index */
+static uint32_t num_codes = 0;                         /*!< Number of NEC records in the index */
+static bool compact_failed = false;                    /*!< Flag to indicate that the last compaction could not program the other sector, so that learn_log_idle() does not erase it again and again */
+static uint16_t code_hash_arr[CODE_HASH_SIZE];         /*!< Entry plus 1 of each NEC record of the index, by hash of its code, with linear probing. 0 for a free slot */
+
+/* Private functions */
+
+/*Read a word of the log, either from the flash or from the buffer.*/
+static uint32_t _read_word(uint32_t offset)
+{
+  if (offset < flash_end)
+  {
+    return port_flash_get_log_sector(active_sector)[offset];
+  }
+  return buffer[offset - flash_end];
+}
+
+/*Empty the index.*/
+static void _clear_index(void)
+{
+  num_entries = 0;
+  num_codes = 0;
+  memset(code_hash_arr, 0, sizeof(code_hash_arr));
+}
+
+/*Add a record to the index. The code is only read for NEC records.*/
+static void _add_to_index(uint32_t offset, uint32_t type, uint32_t code)
+{
+  if (type == LEARN_LOG_NEC)
+  {
+    uint32_t slot = CODE_HASH(code);
+    while (code_hash_arr[slot] != 0)
+    {
+      slot = (slot + 1) & (CODE_HASH_SIZE - 1);
+    }
+    code_hash_arr[slot] = (uint16_t)(num_entries + 1);
+    num_codes++;
+  }
+  index_arr[num_entries++] = (uint16_t)offset;
+}
+
+/*Check if a NEC code is in the index.*/
+static bool _find_code(uint32_t code)
+{
+  for (uint32_t slot = CODE_HASH(code); code_hash_arr[slot] != 0; slot = (slot + 1) & (CODE_HASH_SIZE - 1))
+  {
+    if (_read_word(index_arr[code_hash_arr[slot] - 1] + 1) == code)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*Erase a sector and make it the active one with an empty log.*/
+static void _start_sector(uint8_t sector, uint32_t seq)
+{
+  uint32_t header[SECTOR_HEADER_WORDS] = {SECTOR_MAGIC, seq};
+
+  port_flash_erase_log_sector(sector);
+  port_flash_program_log(sector, 0, header, SECTOR_HEADER_WORDS);
+  active_sector = sector;
+  sequence = seq;
+  flash_end = SECTOR_HEADER_WORDS;
+  buffered_words = 0;
+  buffered_entries = 0;
+  _clear_index();
+}
+
+/*Walk the records of the active sector to rebuild the index and find the end of the log.*/
+static void _scan_sector(void)
+{
+  const uint32_t *p_sector = port_flash_get_log_sector(active_sector);
+  uint32_t offset = SECTOR_HEADER_WORDS;
+  uint32_t dirty = 0;
+
+  _clear_index();
+  buffered_words = 0;
+  buffered_entries = 0;
+
+  while (offset < FLASH_LOG_SECTOR_WORDS)
+  {
+    uint32_t header = p_sector[offset];
+    if (!RECORD_IS_VALID(header) || (offset + 1 + RECORD_LEN(header) > FLASH_LOG_SECTOR_WORDS))
+    {
+      break;
+    }
+    if ((RECORD_TYPE(header) != LEARN_LOG_PAD) && (num_entries < LEARN_LOG_MAX_ENTRIES))
+    {
+      _add_to_index(offset, RECORD_TYPE(header), (RECORD_LEN(header) > 0) ? p_sector[offset + 1] : 0);
+    }
+    offset += 1 + RECORD_LEN(header);
+  }
+  flash_end = offset;
+
+  if (offset >= FLASH_LOG_SECTOR_WORDS)
+  {
+    return;
+  }
+  if (p_sector[offset] != ERASED_WORD)
+  {
+    /* Corrupted header: nothing can be appended until the log is compacted into the other sector */
+    flash_end = FLASH_LOG_SECTOR_WORDS;
+    return;
+  }
+
+  /* An interrupted batch leaves programmed words after the end of the log. They can only be after the first header of the batch and within the size of the buffer */
+  for (uint32_t i = 1; (i < LEARN_LOG_BUFFER_WORDS) && (offset + i < FLASH_LOG_SECTOR_WORDS); i++)
+  {
+    if (p_sector[offset + i] != ERASED_WORD)
+    {
+      dirty = i;
+    }
+  }
+  if (dirty > 0)
+  {
+    uint32_t pad = RECORD_HEADER(LEARN_LOG_PAD, dirty);
+    port_flash_program_log(active_sector, offset, &pad, 1);
+    flash_end = offset + 1 + dirty;
+  }
+}
+
+/*Check if a record of some words fits in the sector and in the index.*/
+static bool _fits(uint32_t total)
+{
+  return (num_entries < LEARN_LOG_MAX_ENTRIES) && (flash_end + buffered_words + total <= FLASH_LOG_SECTOR_WORDS);
+}
+
+/*Copy the newest records to the other sector, up to #LEARN_LOG_COMPACT_KEEP_PCT of the sector and of the index, and make it the active one. The old sector is kept active if the new one cannot be programmed.*/
+static void _compact(void)
+{
+  uint8_t sector = (active_sector + 1) % FLASH_LOG_SECTORS;
+  uint32_t header[SECTOR_HEADER_WORDS] = {SECTOR_MAGIC, sequence + 1};
+  uint32_t max_words = (FLASH_LOG_SECTOR_WORDS - SECTOR_HEADER_WORDS) * LEARN_LOG_COMPACT_KEEP_PCT / 100;
+  uint32_t max_entries = LEARN_LOG_MAX_ENTRIES * LEARN_LOG_COMPACT_KEEP_PCT / 100;
+  uint32_t offset = SECTOR_HEADER_WORDS;
+  uint32_t words = 0;
+  uint32_t first;
+  const uint32_t *p_old;
+  bool ok;
+
+  learn_log_flush();
+  p_old = port_flash_get_log_sector(active_sector);
+  for (first = num_entries; (first > 0) && (num_entries - first < max_entries); first--)
+  {
+    uint32_t len = 1 + RECORD_LEN(p_old[index_arr[first - 1]]);
+    if (words + len > max_words)
+    {
+      break;
+    }
+    words += len;
+  }
+
+  ok = port_flash_erase_log_sector(sector);
+  for (uint32_t i = first; ok && (i < num_entries); i++)
+  {
+    uint32_t len = 1 + RECORD_LEN(p_old[index_arr[i]]);
+    ok = port_flash_program_log(sector, offset, &p_old[index_arr[i]], len);
+    offset += len;
+  }
+  /* The magic number goes last: until it is programmed the old sector is the active one */
+  ok = ok && port_flash_program_log(sector, 1, &header[1], 1);
+  ok = ok && port_flash_program_log(sector, 0, &header[0], 1);
+  compact_failed = !ok;
+  if (!ok)
+  {
+    return;
+  }
+  active_sector = sector;
+  sequence = header[1];
+  _scan_sector();
+}
+
+/*Append a record to the buffer and the index. A full log is compacted first.*/
+static bool _append(uint8_t type, const uint32_t *p_payload, uint32_t len, uint32_t now_ms)
+{
+  uint32_t total = 1 + len;
+
+  if (!_fits(total))
+  {
+    _compact();
+  }
+  if (!_fits(total))
+  {
+    return false;
+  }
+  if (buffered_words + total > LEARN_LOG_BUFFER_WORDS)
+  {
+    learn_log_flush();
+  }
+  if (buffered_words == 0)
+  {
+    first_buffered_ms = now_ms;
+  }
+
+  _add_to_index(flash_end + buffered_words, type, p_payload[0]);
+  buffer[buffered_words] = RECORD_HEADER(type, len);
+  memcpy(&buffer[buffered_words + 1], p_payload, len * sizeof(uint32_t));
+  buffered_words += total;
+  buffered_entries++;
+
+  return true;
+}
+
+/* Public functions */
+
+/*Find the active sector of the log and rebuild the RAM index from it.*/
+void learn_log_init(void)
+{
+  bool found = false;
+
+  compact_failed = false;
+  for (uint8_t i = 0; i < FLASH_LOG_SECTORS; i++)
+  {
+    const uint32_t *p_sector = port_flash_get_log_sector(i);
+    if ((p_sector[0] == SECTOR_MAGIC) && (!found || (p_sector[1] > sequence)))
+    {
+      active_sector = i;
+      sequence = p_sector[1];
+      found = true;
+    }
+  }
+
+  if (found)
+  {
+    _scan_sector();
+  }
+  else
+  {
+    _start_sector(0, 0);
+  }
+}
+
+/*Append a NEC code to the log, unless it is already there.*/
+bool learn_log_append_code(uint32_t code, uint32_t now_ms)
+{
+  if (_find_code(code))
+  {
+    return false;
+  }
+  return _append(LEARN_LOG_NEC, &code, 1, now_ms);
+}
+
+/*Append a raw frame to the log.*/
+bool learn_log_append_raw(const uint16_t *p_deltas, uint32_t num_deltas, uint32_t now_ms)
+{
+  uint32_t payload[RAW_PAYLOAD_WORDS] = {0};
+
+  if ((num_deltas == 0) || (num_deltas > LEARN_LOG_MAX_RAW_EDGES))
+  {
+    return false;
+  }
+  payload[0] = num_deltas;
+  for (uint32_t i = 0; i < num_deltas; i++)
+  {
+    payload[1 + i / 2] |= (uint32_t)p_deltas[i] << ((i & 1) * 16);
+  }
+  return _append(LEARN_LOG_RAW, payload, 1 + (num_deltas + 1) / 2, now_ms);
+}
+
+/*Program the buffered records in the flash.*/
+void learn_log_flush(void)
+{
+  bool ok;
+
+  if (buffered_words == 0)
+  {
+    return;
+  }
+  /* The first header goes last: until it is programmed the whole batch is beyond the end of the log */
+  ok = port_flash_program_log(active_sector, flash_end + 1, &buffer[1], buffered_words - 1);
+  ok = ok && port_flash_program_log(active_sector, flash_end, &buffer[0], 1);
+
+  if (ok)
+  {
+    flash_end += buffered_words;
+  }
+  else
+  {
+    /* Rebuild the index from what the flash holds: the batch is dropped or covered with padding */
+    _scan_sector();
+  }
+  buffered_words = 0;
+  buffered_entries = 0;
+}
+
+/*Program the buffered records if they have waited long enough, and compact the log if it is nearly full.*/
+void learn_log_idle(uint32_t now_ms)
+{
+  if ((buffered_words > 0) && (now_ms - first_buffered_ms >= LEARN_LOG_FLUSH_DELAY_MS))
+  {
+    learn_log_flush();
+  }
+  if (!compact_failed && ((num_entries > LEARN_LOG_MAX_ENTRIES * LEARN_LOG_COMPACT_HIGH_PCT / 100) || (flash_end + buffered_words > FLASH_LOG_SECTOR_WORDS * LEARN_LOG_COMPACT_HIGH_PCT / 100)))
+  {
+    _compact();
+  }
+}
+
+/*Erase the log.*/
+void learn_log_clear(void)
+{
+  _start_sector((active_sector + 1) % FLASH_LOG_SECTORS, sequence + 1);
+}
+
+/*Return the number of entries of the log.*/
+uint32_t learn_log_get_num_entries(void)
+{
+  return num_entries;
+}
+
+/*Return the number of NEC codes of the log.*/
+uint32_t learn_log_get_num_codes(void)
+{
+  return num_codes;
+}
+
+/*Return the type of an entry.*/
+uint8_t learn_log_get_type(uint32_t idx)
+{
+  return (uint8_t)RECORD_TYPE(_read_word(index_arr[idx]));
+}
+
+/*Return the code of a NEC entry.*/
+uint32_t learn_log_get_code(uint32_t idx)
+{
+  if (learn_log_get_type(idx) != LEARN_LOG_NEC)
+  {
+    return 0x00;
+  }
+  return _read_word(index_arr[idx] + 1);
+}
+
+/*Copy the intervals of a raw entry.*/
+uint32_t learn_log_get_raw(uint32_t idx, uint16_t *p_deltas, uint32_t max_deltas)
+{
+  uint32_t offset = index_arr[idx];
+  uint32_t num_deltas;
+
+  if (learn_log_get_type(idx) != LEARN_LOG_RAW)
+  {
+    return 0;
+  }
+  num_deltas = _read_word(offset + 1);
+  if (num_deltas > max_deltas)
+  {
+    num_deltas = max_deltas;
+  }
+  for (uint32_t i = 0; i < num_deltas; i++)
+  {
+    p_deltas[i] = (uint16_t)(_read_word(offset + 2 + i / 2) >> ((i & 1) * 16));
+  }
+  return num_deltas;
+}
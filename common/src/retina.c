@@ -11,15 +11,22 @@
 #include "port_button.h"
 #include "fsm_retina.h"
 #include "fsm_tx.h"
+#include "fsm_macro.h"
 #include "port_tx.h"
 #include "fsm_rx.h"
 #include "port_rx.h"
 #include "port_rgb.h"
+#include "fsm_bridge.h"
+#include "port_uart.h"
+#include "fsm_strip.h"
+#include "port_system.h"
+#include "energy.h"
 
 /* Defines */
 #define LD2_PORT GPIOA
 #define LD2_PIN 5
 #define CHANGE_MODE_BUTTON_TIME 3000
+#define STRIP_NUM_PIXELS 300
 
 /* Variable initialization functions */
 
@@ -42,9 +49,20 @@ int main(void)
 
     fsm_t *p_fsm_tx = fsm_tx_new(IR_TX_0_ID);
 
+    fsm_t *p_fsm_macro = fsm_macro_new(p_fsm_tx);
+
     fsm_t *p_fsm_rx = fsm_rx_new(IR_RX_0_ID);
 
-    fsm_t *p_fsm_retina = fsm_retina_new(p_fsm_user_button, CHANGE_MODE_BUTTON_TIME, p_fsm_tx, p_fsm_rx, RGB_0_ID);
+    fsm_t *p_fsm_retina = fsm_retina_new(p_fsm_user_button, CHANGE_MODE_BUTTON_TIME, p_fsm_tx, p_fsm_macro, p_fsm_rx, RGB_0_ID);
+
+    fsm_t *p_fsm_bridge = fsm_bridge_new(UART_0_ID, p_fsm_tx, p_fsm_macro);
+    fsm_retina_set_bridge(p_fsm_retina, p_fsm_bridge);
+
+    fsm_t *p_fsm_strip = fsm_strip_new(RGB_STRIP_0_ID, STRIP_NUM_PIXELS);
+    fsm_retina_set_strip(p_fsm_retina, p_fsm_strip);
+
+    /* The consumption is accounted from the main loop, not from the initialization */
+    energy_reset(port_system_get_millis());
 
   /*  #if VERSION == VERSION_1
     port_system_gpio_config(LD2_PORT, LD2_PIN, GPIO_MODE_OUT, GPIO_PUPDR_NOPULL);
@@ -59,9 +77,12 @@ int main(void)
     {
 
        fsm_fire(p_fsm_user_button);
+       fsm_fire(p_fsm_bridge);
+       fsm_fire(p_fsm_macro);
        fsm_fire(p_fsm_tx);
         fsm_fire(p_fsm_rx);
        fsm_fire(p_fsm_retina);
+       fsm_fire(p_fsm_strip);
        
 
 /*#if VERSION == VERSION_1
@@ -77,7 +98,10 @@ int main(void)
 
     fsm_destroy(p_fsm_user_button);
     fsm_destroy(p_fsm_tx);
+    fsm_destroy(p_fsm_macro);
     fsm_destroy(p_fsm_rx);
     fsm_destroy(p_fsm_retina); 
+    fsm_destroy(p_fsm_bridge);
+    fsm_destroy(p_fsm_strip);
    
 }
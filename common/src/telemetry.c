@@ -0,0 +1,86 @@
+/**
+ * @file telemetry.c
+ * @brief Telemetry block of the infrared pipeline and its snapshots.
+ *
+ * The counters are incremented by the modules that own the events. The wake-ups and the sleep residency are already accounted by the energy module and the port, so they are only sampled when a snapshot is taken.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "telemetry.h"
+#include "energy.h"
+#include "port_system.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define TELEMETRY_SNAPSHOT_WORDS (sizeof(telemetry_snapshot_t) / sizeof(uint32_t)) /*!< Words of a snapshot, checksum included */
+
+_Static_assert(sizeof(telemetry_snapshot_t) == (5U + TELEMETRY_COUNTERS) * sizeof(uint32_t), "The snapshot must be made of words without padding");
+_Static_assert(PORT_SYSTEM_SLEEP_MODES == 3, "A counter of residency is needed for every low-power mode");
+_Static_assert(TELEMETRY_WAKE_FRAME_OK_STOP - TELEMETRY_WAKE_FRAME_OK_WFI == PORT_SYSTEM_SLEEP_STOP - PORT_SYSTEM_SLEEP_WFI, "The counters of the frames that woke the system up are indexed by the low-power mode");
+
+/* Global variables ------------------------------------------------------------*/
+volatile uint32_t telemetry_counters_arr[TELEMETRY_COUNTERS]; /*!< Telemetry block */
+static uint32_t sequence = 0;                                /*!< Snapshots taken */
+static uint32_t last_sent_ms = 0;                            /*!< System time of the last snapshot sent by telemetry_idle() */
+
+/* Public functions */
+
+/*Clear the counters.*/
+void telemetry_reset(void)
+{
+  for (uint8_t i = 0; i < TELEMETRY_COUNTERS; i++)
+  {
+    telemetry_counters_arr[i] = 0;
+  }
+  sequence = 0;
+}
+
+/*Take a snapshot of the telemetry block.*/
+void telemetry_get_snapshot(telemetry_snapshot_t *p_snapshot, uint32_t now_ms)
+{
+  const uint32_t *p_word = (const uint32_t *)p_snapshot;
+  uint32_t checksum = 0;
+
+  telemetry_counters_arr[TELEMETRY_WAKEUPS] = energy_get_wakeups();
+  telemetry_counters_arr[TELEMETRY_SLEEP_WFI_MS] = port_system_get_sleep_stats(PORT_SYSTEM_SLEEP_WFI)->residency_ms;
+  telemetry_counters_arr[TELEMETRY_SLEEP_STOP_FAST_MS] = port_system_get_sleep_stats(PORT_SYSTEM_SLEEP_STOP_FAST)->residency_ms;
+  telemetry_counters_arr[TELEMETRY_SLEEP_STOP_MS] = port_system_get_sleep_stats(PORT_SYSTEM_SLEEP_STOP)->residency_ms;
+
+  p_snapshot->magic = TELEMETRY_MAGIC;
+  p_snapshot->version = TELEMETRY_VERSION;
+  p_snapshot->num_counters = TELEMETRY_COUNTERS;
+  p_snapshot->sequence = sequence++;
+  p_snapshot->uptime_ms = now_ms;
+  /* Each counter is a single word, so it is not torn by an ISR, although the block is not read at one instant */
+  for (uint8_t i = 0; i < TELEMETRY_COUNTERS; i++)
+  {
+    p_snapshot->counters[i] = telemetry_counters_arr[i];
+  }
+  for (uint32_t i = 0; i < TELEMETRY_SNAPSHOT_WORDS - 1U; i++)
+  {
+    checksum += p_word[i];
+  }
+  p_snapshot->checksum = checksum;
+}
+
+/*Take a snapshot and send it over the debug link.*/
+void telemetry_send(uint32_t now_ms)
+{
+  telemetry_snapshot_t snapshot;
+
+  telemetry_get_snapshot(&snapshot, now_ms);
+  port_system_debug_write(PORT_SYSTEM_DEBUG_TELEMETRY, (const uint8_t *)&snapshot, sizeof(snapshot));
+}
+
+/*Send a snapshot if the period has passed.*/
+void telemetry_idle(uint32_t now_ms)
+{
+  if (now_ms - last_sent_ms >= TELEMETRY_PERIOD_MS)
+  {
+    last_sent_ms = now_ms;
+    telemetry_send(now_ms);
+  }
+}
@@ -0,0 +1,145 @@
+/**
+ * @file warm_state.c
+ * @brief State of the system kept in the backup SRAM through the system resets.
+ *
+ * Layout of a slot: #WARM_STATE_MAGIC, a sequence number, the state and a CRC-32 of the previous words. A state is written in the slot that does not hold the newest one, and its CRC last, so a write interrupted by a reset leaves a slot that is not valid next to the previous state. The newest valid slot is the one loaded.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stddef.h>
+#include <string.h>
+
+/* Other includes */
+#include "warm_state.h"
+#include "port_backup.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define NUM_SLOTS 2                /*!< Slots of the backup SRAM used alternately */
+#define CRC32_POLY 0xEDB88320U     /*!< Reflected polynomial of the CRC-32 of Ethernet and zlib */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Slot of the backup SRAM.
+ */
+typedef struct
+{
+  uint32_t magic;       /*!< #WARM_STATE_MAGIC */
+  uint32_t sequence;    /*!< Number of the write, to find the newest slot */
+  warm_state_t state;   /*!< State */
+  uint32_t crc;         /*!< CRC-32 of the previous fields */
+} slot_t;
+
+_Static_assert(sizeof(warm_state_t) == 5U * sizeof(uint32_t), "The state must have no padding, as it is compared and checked byte by byte");
+_Static_assert(NUM_SLOTS * sizeof(slot_t) <= PORT_BACKUP_SIZE, "The slots do not fit in the backup SRAM");
+
+/* Global variables ------------------------------------------------------------*/
+/**
+ * @brief CRC-32 with #CRC32_POLY of each nibble. A table of 16 words processes a byte in two lookups.
+ */
+static const uint32_t crc_nibble_arr[16] = {
+    0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU, 0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+    0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU, 0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU,
+};
+static warm_state_t last_state;   /*!< Last state saved or loaded */
+static bool has_last_state = false; /*!< Flag to indicate that last_state is valid */
+static uint32_t sequence = 0;       /*!< Sequence number of the next write */
+static uint8_t next_slot = 0;       /*!< Slot of the next write */
+static uint32_t num_saves = 0;      /*!< Writes since warm_state_load() */
+
+/* Private functions */
+
+/*Compute the CRC-32 of a buffer.*/
+static uint32_t _crc32(const void *p_data, uint32_t len)
+{
+  const uint8_t *p_byte = (const uint8_t *)p_data;
+  uint32_t crc = 0xFFFFFFFFU;
+
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= p_byte[i];
+    crc = (crc >> 4) ^ crc_nibble_arr[crc & 0x0FU];
+    crc = (crc >> 4) ^ crc_nibble_arr[crc & 0x0FU];
+  }
+  return ~crc;
+}
+
+/*Check the magic number and the CRC of a slot.*/
+static bool _slot_is_valid(const volatile slot_t *p_slot)
+{
+  return p_slot->magic == WARM_STATE_MAGIC && p_slot->crc == _crc32((const void *)p_slot, offsetof(slot_t, crc));
+}
+
+/* Public functions */
+
+/*Load the newest valid slot of the backup SRAM.*/
+bool warm_state_load(warm_state_t *p_state)
+{
+  port_backup_init();
+  volatile slot_t *p_slots = (volatile slot_t *)port_backup_get_sram();
+  int8_t newest = -1;
+
+  for (uint8_t i = 0; i < NUM_SLOTS; i++)
+  {
+    if (_slot_is_valid(&p_slots[i]) && (newest < 0 || (int32_t)(p_slots[i].sequence - p_slots[newest].sequence) > 0))
+    {
+      newest = (int8_t)i;
+    }
+  }
+
+  has_last_state = false;
+  sequence = 0;
+  next_slot = 0;
+  num_saves = 0;
+  if (newest < 0)
+  {
+    return false;
+  }
+
+  memcpy(&last_state, (const void *)&p_slots[newest].state, sizeof(last_state));
+  has_last_state = true;
+  sequence = p_slots[newest].sequence + 1U;
+  next_slot = (uint8_t)((newest + 1) % NUM_SLOTS);
+  *p_state = last_state;
+  return true;
+}
+
+/*Save a state in the slot that does not hold the newest one.*/
+void warm_state_save(const warm_state_t *p_state)
+{
+  if (has_last_state && memcmp(&last_state, p_state, sizeof(last_state)) == 0)
+  {
+    return;
+  }
+
+  slot_t slot = {.magic = WARM_STATE_MAGIC, .sequence = sequence, .state = *p_state};
+  slot.crc = _crc32(&slot, offsetof(slot_t, crc));
+
+  /* The CRC of the slot is spoilt first and written last, so the slot is only valid once complete */
+  volatile slot_t *p_slot = &((volatile slot_t *)port_backup_get_sram())[next_slot];
+  volatile uint32_t *p_dst = (volatile uint32_t *)p_slot;
+  const uint32_t *p_src = (const uint32_t *)&slot;
+
+  p_slot->crc = ~slot.crc;
+  for (uint32_t i = 0; i < offsetof(slot_t, crc) / sizeof(uint32_t); i++)
+  {
+    p_dst[i] = p_src[i];
+  }
+  p_slot->crc = slot.crc;
+
+  last_state = *p_state;
+  has_last_state = true;
+  sequence++;
+  next_slot = (uint8_t)((next_slot + 1U) % NUM_SLOTS);
+  num_saves++;
+}
+
+/*Return the number of states written since warm_state_load().*/
+uint32_t warm_state_get_num_saves(void)
+{
+  return num_saves;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file ws2812.c
+ * @brief Encoder of the frames of the addressable LEDs into the bitstream of a serial peripheral.
+ *
+ * A byte of a colour becomes 24 bits of the stream, built from the 12-bit codes of its two nibbles. The codes are packed into halfwords through a 32-bit accumulator, so that a pixel costs a few table lookups and shifts.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "ws2812.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define WS2812_BIT(nibble, n) (((nibble) >> (n) & 1U) ? 6U : 4U) /*!< Code of a bit of the LEDs: 110 for a 1, 100 for a 0 */
+#define WS2812_NIBBLE(nibble) ((WS2812_BIT(nibble, 3) << 9) | (WS2812_BIT(nibble, 2) << 6) | (WS2812_BIT(nibble, 1) << 3) | WS2812_BIT(nibble, 0)) /*!< Code of a nibble, most significant bit first */
+
+/* Global variables ------------------------------------------------------------*/
+/**
+ * @brief 12-bit code of each nibble.
+ */
+static const uint16_t nibble_codes[16] = {
+    WS2812_NIBBLE(0), WS2812_NIBBLE(1), WS2812_NIBBLE(2), WS2812_NIBBLE(3),
+    WS2812_NIBBLE(4), WS2812_NIBBLE(5), WS2812_NIBBLE(6), WS2812_NIBBLE(7),
+    WS2812_NIBBLE(8), WS2812_NIBBLE(9), WS2812_NIBBLE(10), WS2812_NIBBLE(11),
+    WS2812_NIBBLE(12), WS2812_NIBBLE(13), WS2812_NIBBLE(14), WS2812_NIBBLE(15),
+};
+
+/* Private functions -----------------------------------------------------------*/
+
+/*Return the 24-bit code of a byte.*/
+static inline uint32_t _encode_byte(uint8_t byte)
+{
+  return ((uint32_t)nibble_codes[byte >> 4] << 12) | nibble_codes[byte & 0x0FU];
+}
+
+/* Public functions */
+
+/*Encode a frame into the stream of the serial peripheral.*/
+uint32_t ws2812_encode(const ws2812_pixel_t *p_pixels, uint32_t num_pixels, uint16_t *p_stream)
+{
+  uint16_t *p_out = p_stream;
+  uint32_t acc = 0; /* Bits not written yet, in the least significant bits */
+  uint32_t num_bits = 0;
+
+  for (uint32_t i = 0; i < num_pixels; i++)
+  {
+    /* The LEDs take green first */
+    const uint8_t bytes[3] = {p_pixels[i].g, p_pixels[i].r, p_pixels[i].b};
+
+    for (uint32_t j = 0; j < 3U; j++)
+    {
+      /* A code of 24 bits leaves 0 or 8 bits behind, so the accumulator never holds more than 32 */
+      acc = (acc << 24) | _encode_byte(bytes[j]);
+      num_bits += 24U;
+      while (num_bits >= 16U)
+      {
+        num_bits -= 16U;
+        *p_out++ = (uint16_t)(acc >> num_bits);
+      }
+    }
+  }
+  /* The last bits are padded with 0, that is part of the reset */
+  if (num_bits > 0)
+  {
+    *p_out++ = (uint16_t)(acc << (16U - num_bits));
+  }
+  for (uint32_t i = 0; i < WS2812_RESET_HALFWORDS; i++)
+  {
+    *p_out++ = 0;
+  }
+  return (uint32_t)(p_out - p_stream);
+}
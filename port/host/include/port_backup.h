@@ -0,0 +1,40 @@
+/**
+ * @file port_backup.h
+ * @brief Header for port_backup.c file of the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_BACKUP_H_
+#define PORT_BACKUP_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define PORT_BACKUP_SIZE 4096U /*!< Bytes of the backup SRAM */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize the backup SRAM. The host port keeps it in RAM, where it survives port_system_init(), as the board's survives a system reset.
+ */
+void port_backup_init(void);
+
+/**
+ * @brief Get the address of the backup SRAM.
+ *
+ * @return Pointer to the first word of the #PORT_BACKUP_SIZE bytes of the backup SRAM
+ */
+uint32_t *port_backup_get_sram(void);
+
+/**
+ * @brief Fill the simulated backup SRAM with garbage, as after the loss of the supply and VBAT.
+ *
+ * @param seed Seed of the garbage
+ */
+void port_backup_host_power_loss(uint32_t seed);
+
+#endif /* PORT_BACKUP_H_ */
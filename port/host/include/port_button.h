@@ -0,0 +1,39 @@
+/**
+ * @file port_button.h
+ * @brief Header for port_button.c file of the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_BUTTON_H_
+#define PORT_BUTTON_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+#include "port_system.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define BUTTON_0_ID 0 /*Button identifier*/
+#define BUTTON_0_DEBOUNCE_TIME_MS 150 /*Button debounce time*/
+
+#define BUTTON_EDGES_QUEUE_SIZE 16 /*Number of raw edges that can be queued per button. Must be a power of 2*/
+
+/* Function prototypes and explanation -------------------------------------------------*/
+
+void port_button_init (uint32_t button_id); /*Reset the simulated button.*/
+bool port_button_is_pressed (uint32_t button_id); /*Return the status of the button (pressed or not)*/
+uint32_t port_button_get_tick(); /*Return the count of the System tick in milliseconds.*/
+
+/*Pop the oldest raw edge timestamped by the simulated ISR of a given button. Return false if there are no edges queued.*/
+bool port_button_pop_edge (uint32_t button_id, uint32_t *p_tick, bool *p_pressed);
+
+/*Return the number of edges lost because the queue of a given button was full.*/
+uint32_t port_button_get_dropped_edges (uint32_t button_id);
+
+/*Simulate an edge of a given button at the current system time, as the EXTI ISR does.*/
+void port_button_host_edge (uint32_t button_id, bool pressed);
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file port_flash.h
+ * @brief Header for port_flash.c file of the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_FLASH_H_
+#define PORT_FLASH_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FLASH_LOG_SECTORS 2                      /*!< Number of flash sectors used by the log */
+#define FLASH_LOG_SECTOR_SIZE (128U * 1024U)     /*!< Size in bytes of each sector of the log */
+#define FLASH_LOG_SECTOR_WORDS (FLASH_LOG_SECTOR_SIZE / sizeof(uint32_t)) /*!< Size in 32-bit words of each sector of the log */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Get the address of a sector of the log. The host port keeps the sectors in RAM.
+ *
+ * @param sector Index of the sector of the log, from 0 to #FLASH_LOG_SECTORS - 1
+ *
+ * @return Pointer to the first word of the sector
+ */
+const uint32_t *port_flash_get_log_sector(uint8_t sector);
+
+/**
+ * @brief Erase a sector of the log. All its words read 0xFFFFFFFF afterwards.
+ *
+ * @param sector Index of the sector of the log
+ *
+ * @return `true`
+ */
+bool port_flash_erase_log_sector(uint8_t sector);
+
+/**
+ * @brief Program 32-bit words in a sector of the log. As in a real flash, programming can only clear bits.
+ *
+ * @param sector Index of the sector of the log
+ * @param offset Offset of the first word in the sector, in words
+ * @param p_words Pointer to the words to program
+ * @param num_words Number of words to program
+ *
+ * @return `true` if the words read back as programmed
+ */
+bool port_flash_program_log(uint8_t sector, uint32_t offset, const uint32_t *p_words, uint32_t num_words);
+
+#endif /* PORT_FLASH_H_ */
@@ -0,0 +1,38 @@
+#ifndef PORT_RGB_H_
+#define PORT_RGB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RGB_0_ID 0
+#define RGB_STRIP_0_ID 0                 /*Simulated LED strip identifier*/
+#define PORT_RGB_STRIP_MAX_PIXELS 300U   /*Maximum number of pixels of a strip, that sizes its two stream buffers*/
+
+void port_rgb_init(uint8_t rgb_id);
+void port_rgb_set_color(uint8_t rgb_id, uint8_t r, uint8_t g, uint8_t b);
+
+/*Configure a simulated LED strip of the WS2812 class.*/
+void port_rgb_strip_init(uint8_t strip_id);
+
+/*Get the buffer of the stream that is not being sent, of WS2812_STREAM_HALFWORDS(PORT_RGB_STRIP_MAX_PIXELS) halfwords. It is valid until the next swap.*/
+uint16_t *port_rgb_strip_get_back_buffer(uint8_t strip_id);
+
+/*Send the stream written in the back buffer, that becomes the front buffer. Returns false, and sends nothing, if the previous stream is still being sent.*/
+bool port_rgb_strip_swap(uint8_t strip_id, uint32_t num_halfwords);
+
+/*Check if a stream is being sent: for the time it takes at WS2812_BIT_RATE_HZ, in simulated time.*/
+bool port_rgb_strip_is_busy(uint8_t strip_id);
+
+/*Get the colour of a pixel of a simulated LED strip, as 0x00RRGGBB, decoded bit by bit from the last stream sent as the LEDs would.*/
+uint32_t port_rgb_host_get_strip_pixel(uint8_t strip_id, uint32_t index);
+
+/*Get the number of pixels decoded from the last stream sent.*/
+uint32_t port_rgb_host_get_strip_num_pixels(uint8_t strip_id);
+
+/*Check if the LEDs would take the last stream sent as sent: every bit is 100 or 110, the frame is a whole number of pixels and the reset is not shorter than WS2812_RESET_US.*/
+bool port_rgb_host_check_strip_stream(uint8_t strip_id);
+
+/*Get the colour set in a simulated RGB LED, as 0x00RRGGBB with 0xFF for the channels on.*/
+uint32_t port_rgb_host_get_color(uint8_t rgb_id);
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * @file port_system.h
+ * @brief Header for port_system.c file of the host port.
+ *
+ * The host port runs the common code natively on a PC. There is no HW: the time is a simulated millisecond counter that only advances when the system sleeps or when it is advanced explicitly, so that the runs are reproducible.
+ *
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_SYSTEM_H_
+#define PORT_SYSTEM_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define BIT_POS_TO_MASK(x) (0x01 << (x))  /*!< Convert the index of a bit into a mask by left shifting */
+
+/* Low-power modes */
+#define PORT_SYSTEM_SLEEP_WFI 0       /*!< Sleep mode: only the core clock is stopped */
+#define PORT_SYSTEM_SLEEP_STOP_FAST 1 /*!< Stop mode with fast wake-up */
+#define PORT_SYSTEM_SLEEP_STOP 2      /*!< Stop mode with slow wake-up */
+#define PORT_SYSTEM_SLEEP_MODES 3     /*!< Number of low-power modes */
+
+/* Clock profiles. The host does not change its clock: the profile is only accounted in the energy model and notified to the listeners */
+#define PORT_SYSTEM_CLOCK_HSI_16MHZ 0  /*!< Core clocked by the HSI at 16 MHz */
+#define PORT_SYSTEM_CLOCK_PLL_180MHZ 1 /*!< Core clocked by the PLL at 180 MHz */
+#define PORT_SYSTEM_CLOCK_PROFILES 2   /*!< Number of clock profiles */
+#define PORT_SYSTEM_CLOCK_LOW PORT_SYSTEM_CLOCK_HSI_16MHZ    /*!< Profile to wait for events */
+#define PORT_SYSTEM_CLOCK_BOOST PORT_SYSTEM_CLOCK_PLL_180MHZ /*!< Profile to decode and modulate frames */
+#define PORT_SYSTEM_CLOCK_MAX_LISTENERS 4                    /*!< Maximum number of functions notified of the changes of clock */
+#define PORT_SYSTEM_CLOCK_BOOST_SETTLE_US 200                /*!< Typical time to lock the PLL and enable the over-drive of the STM32F446RE before switching to the boost profile, in microseconds */
+#define PORT_SYSTEM_DEFERRED_MAX_HANDLERS 4                  /*!< Maximum number of functions run by the deferred software interrupt */
+#define PORT_SYSTEM_DEBUG_TELEMETRY 0                        /*!< Channel of the debug link of the telemetry snapshots */
+#define PORT_SYSTEM_DEBUG_LOG 1                              /*!< Channel of the debug link of the records of the deferred log */
+#define PORT_SYSTEM_HOST_DEBUG_CHANNELS 2                    /*!< Number of channels of the simulated debug link */
+#define PORT_SYSTEM_HOST_DEBUG_SIZE 4096                     /*!< Bytes of each channel of the simulated debug link kept until they are read */
+
+/* GPIOs */
+#define HIGH true /*!< Logic 1 */
+#define LOW false /*!< Logic 0 */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Statistics of the time spent in a low-power mode.
+ */
+typedef struct
+{
+  uint32_t entries;                  /*!< Number of times the mode has been entered */
+  uint32_t residency_ms;             /*!< Total time spent in the mode in milliseconds */
+  uint32_t residency_rem_ticks;      /*!< Remainder of the residency below 1 ms. Always 0 in the host port */
+  uint32_t button_wakeups;           /*!< Number of wake-ups by the user button whose latency was measured. Always 0 in the host port */
+  uint32_t button_latency_us;        /*!< Wake-up latency from the user button in microseconds. Always 0 in the host port */
+  uint32_t button_latency_max_us;    /*!< Worst wake-up latency from the user button in microseconds. Always 0 in the host port */
+} port_system_sleep_stats_t;
+
+/**
+ * @brief Function notified after every change of clock profile.
+ *
+ * @param profile New clock profile
+ */
+typedef void (*port_system_clock_listener_t)(uint8_t profile);
+
+/**
+ * @brief Function run by the deferred software interrupt. It must check by itself whether it has work pending.
+ */
+typedef void (*port_system_deferred_handler_t)(void);
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Reset the simulated time.
+ *
+ * @retval Init status
+ */
+size_t port_system_init(void);
+
+/**
+ * @brief Get the simulated system time in milliseconds.
+ *
+ * @return uint32_t
+ */
+uint32_t port_system_get_millis(void);
+
+/**
+ * @brief Wait for some milliseconds. The simulated time is advanced without waiting.
+ *
+ * @param ms Number of milliseconds to wait
+ */
+void port_system_delay_ms(uint32_t ms);
+
+/**
+ * @brief Wait for some milliseconds from a time reference.
+ *
+ * @param p_t Pointer to the time reference. It is updated to the system time at return
+ * @param ms Number of milliseconds to wait
+ */
+void port_system_delay_until_ms(uint32_t *p_t, uint32_t ms);
+
+/**
+ * @brief Enter a low-power mode. In the host port the system sleeps until the next millisecond, as if woken up by the SysTick.
+ *
+ * @param mode One of #PORT_SYSTEM_SLEEP_WFI, #PORT_SYSTEM_SLEEP_STOP_FAST or #PORT_SYSTEM_SLEEP_STOP
+ */
+void port_system_sleep_mode(uint8_t mode);
+
+/**
+ * @brief Enter the deepest low-power mode.
+ */
+void port_system_sleep(void);
+
+/**
+ * @brief Bookkeeping of a wake-up by an ISR. The simulated ISRs of the host port call it.
+ */
+void port_system_isr_wakeup(void);
+
+/**
+ * @brief Get the residency and wake-up statistics of a low-power mode.
+ *
+ * @param mode One of #PORT_SYSTEM_SLEEP_WFI, #PORT_SYSTEM_SLEEP_STOP_FAST or #PORT_SYSTEM_SLEEP_STOP
+ *
+ * @return Pointer to the statistics of the mode
+ */
+const port_system_sleep_stats_t *port_system_get_sleep_stats(uint8_t mode);
+
+/**
+ * @brief Switch the simulated system clock to a profile and notify the listeners. Switching to the current profile does nothing.
+ *
+ * @param profile #PORT_SYSTEM_CLOCK_LOW or #PORT_SYSTEM_CLOCK_BOOST
+ */
+void port_system_clock_set(uint8_t profile);
+
+/**
+ * @brief Get the current clock profile.
+ *
+ * @return #PORT_SYSTEM_CLOCK_LOW or #PORT_SYSTEM_CLOCK_BOOST
+ */
+uint8_t port_system_clock_get(void);
+
+/**
+ * @brief Get the frequency of the core in a profile.
+ *
+ * @param profile Clock profile
+ *
+ * @return Frequency in Hz
+ */
+uint32_t port_system_clock_get_hz(uint8_t profile);
+
+/**
+ * @brief Register a function to be notified of the changes of clock profile. Registering the same function twice has no effect.
+ *
+ * @param listener Function to notify
+ */
+void port_system_clock_add_listener(port_system_clock_listener_t listener);
+
+/**
+ * @brief Register a function to be run by the simulated deferred software interrupt. Registering the same function twice has no effect.
+ *
+ * @param handler Function to run
+ */
+void port_system_deferred_add_handler(port_system_deferred_handler_t handler);
+
+/**
+ * @brief Request the simulated deferred software interrupt. The handlers are run at once, as if they preempted the caller.
+ */
+void port_system_deferred_pend(void);
+
+/**
+ * @brief Hold the simulated deferred software interrupt off, as the BASEPRI of the STM32F446RE port: the requests made meanwhile are run by port_system_deferred_unmask().
+ *
+ * @return State to give to port_system_deferred_unmask()
+ */
+uint32_t port_system_deferred_mask(void);
+
+/**
+ * @brief Restore the state saved by port_system_deferred_mask(). The handlers run at once if the deferred interrupt was requested meanwhile and it is no longer held off.
+ *
+ * @param state Value returned by port_system_deferred_mask()
+ */
+void port_system_deferred_unmask(uint32_t state);
+
+/**
+ * @brief Get a cycle count of the host to measure short intervals.
+ *
+ * @return Nanoseconds of the monotonic clock of the host, as the cycles of a 1 GHz counter. The counter wraps every 2^32 cycles
+ */
+uint32_t port_system_get_cycles(void);
+
+/**
+ * @brief Get the time since port_system_init(), to time the initialization.
+ *
+ * @return Microseconds of the monotonic clock of the host since port_system_init()
+ */
+uint32_t port_system_get_boot_us(void);
+
+/**
+ * @brief Write binary data on a channel of the simulated debug link. The data are kept until they are read with port_system_host_get_debug(); the bytes that do not fit are dropped.
+ *
+ * @param channel Channel, #PORT_SYSTEM_DEBUG_TELEMETRY or #PORT_SYSTEM_DEBUG_LOG
+ * @param p_data Pointer to the data
+ * @param len Number of bytes
+ */
+void port_system_debug_write(uint8_t channel, const uint8_t *p_data, uint32_t len);
+
+/**
+ * @brief Read and clear the data written on a channel of the simulated debug link.
+ *
+ * @param channel Channel
+ * @param p_len Pointer where the number of bytes is returned
+ *
+ * @return Pointer to the data, valid until the next write
+ */
+const uint8_t *port_system_host_get_debug(uint8_t channel, uint32_t *p_len);
+
+/**
+ * @brief Advance the simulated time.
+ *
+ * @param ms Number of milliseconds
+ */
+void port_system_host_advance_ms(uint32_t ms);
+
+#endif /* PORT_SYSTEM_H_ */
@@ -0,0 +1,45 @@
+/**
+ * @file port_tx.h
+ * @brief Header for port_tx.c file of the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_TX_H_
+#define PORT_TX_H_
+
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define IR_TX_0_ID 0 /*Infrared transmitter identifier*/
+#define IR_TX_1_ID 1 /*Second infrared transmitter identifier*/
+#define IR_TX_2_ID 2 /*Third infrared transmitter identifier*/
+#define IR_TX_3_ID 3 /*Fourth infrared transmitter identifier*/
+#define PORT_TX_NUM_TRANSMITTERS 4 /*Number of infrared transmitters, with consecutive identifiers from 0, as in the STM32F446RE port*/
+#define PORT_TX_HOST_TRACE_SIZE 256 /*Number of PWM changes recorded per transmitter*/
+
+/* Function prototypes and explanation -------------------------------------------------*/
+
+/*Reset a simulated infrared transmitter.*/
+void port_tx_init (uint8_t tx_id, bool status);
+/*Set the PWM ON or OFF. The change is recorded in the trace of the transmitter.*/
+void port_tx_pwm_timer_set (uint8_t tx_id, bool status);
+/*Start the symbol timer and reset the count of ticks.*/
+void port_tx_symbol_tmr_start ();
+/*Stop the symbol timer.*/
+void port_tx_symbol_tmr_stop ();
+/*Get the count of the symbol ticks. The simulated timer advances one tick at each read, as if each poll lasted a tick.*/
+uint32_t port_tx_tmr_get_tick ();
+
+/*Get the symbol ticks of the PWM changes recorded since the last clear. Even positions are PWM ON, odd positions PWM OFF.*/
+const uint32_t *port_tx_host_get_trace (uint8_t tx_id, uint32_t *p_num_changes);
+/*Clear the trace of a transmitter.*/
+void port_tx_host_clear_trace (uint8_t tx_id);
+
+#endif
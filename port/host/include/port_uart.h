@@ -0,0 +1,105 @@
+/**
+ * @file port_uart.h
+ * @brief Header for port_uart.c file of the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_UART_H_
+#define PORT_UART_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define UART_0_ID 0                    /*!< Serial link identifier */
+#define PORT_UART_RX_BUFFER_SIZE 1024U /*!< Bytes read from the pseudo-terminal at most at once, as the buffer of the reception of the STM32F446RE port */
+#define PORT_UART_TX_BUFFER_SIZE 512U  /*!< Bytes of the ring of the transmission, as in the STM32F446RE port */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Open the pseudo-terminal that stands in for a serial link. The host programs open its slave side, whose name is given by port_uart_host_get_name(), as they would open the virtual COM port of the board.
+ *
+ * @param uart_id Serial link ID
+ */
+void port_uart_init(uint8_t uart_id);
+
+/**
+ * @brief Read the bytes received and not read yet. It does not block.
+ *
+ * @param uart_id Serial link ID
+ * @param p_data Pointer where the bytes are copied
+ * @param max_len Maximum number of bytes read
+ *
+ * @return Number of bytes read
+ */
+uint32_t port_uart_read(uint8_t uart_id, uint8_t *p_data, uint32_t max_len);
+
+/**
+ * @brief Return the number of bytes received and not read yet.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return Number of bytes
+ */
+uint32_t port_uart_get_rx_count(uint8_t uart_id);
+
+/**
+ * @brief Queue bytes to send. They are copied into the ring of the transmission, that is drained into the pseudo-terminal as it accepts them. It does not block.
+ *
+ * @param uart_id Serial link ID
+ * @param p_data Pointer to the bytes
+ * @param len Number of bytes
+ *
+ * @return `true` if the bytes were queued, `false` if there was no room for all of them, so that none was queued
+ */
+bool port_uart_write(uint8_t uart_id, const uint8_t *p_data, uint32_t len);
+
+/**
+ * @brief Arm the RX line as a wake-up source of the STOP modes. The host port does not enter them, so it does nothing.
+ *
+ * @param uart_id Serial link ID
+ */
+void port_uart_arm_wakeup(uint8_t uart_id);
+
+/**
+ * @brief Check if the RX line has woken the system up since the last call. The host port is never woken by the line.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return `true` if the line has woken the system up
+ */
+bool port_uart_check_wakeup(uint8_t uart_id);
+
+/**
+ * @brief Return the room in the ring of the transmission.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return Number of bytes that can be queued
+ */
+uint32_t port_uart_get_tx_free(uint8_t uart_id);
+
+/**
+ * @brief Return the path of the slave side of the pseudo-terminal of a serial link.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return Path, as /dev/pts/N. An empty string if the link could not be opened
+ */
+const char *port_uart_host_get_name(uint8_t uart_id);
+
+/**
+ * @brief Return the file descriptor of the master side of the pseudo-terminal, to wait for bytes with poll().
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return File descriptor, or -1 if the link could not be opened
+ */
+int port_uart_host_get_fd(uint8_t uart_id);
+
+#endif /* PORT_UART_H_ */
@@ -0,0 +1,40 @@
+/**
+ * @file port_backup.c
+ * @brief Backup SRAM simulated in RAM for the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "port_backup.h"
+
+/* Global variables ------------------------------------------------------------*/
+static uint32_t sram_arr[PORT_BACKUP_SIZE / sizeof(uint32_t)]; /*!< Simulated backup SRAM. It starts zeroed, which no checksum matches */
+
+/* Public functions */
+
+/*Initialize the backup SRAM.*/
+void port_backup_init(void)
+{
+}
+
+/*Get the address of the backup SRAM.*/
+uint32_t *port_backup_get_sram(void)
+{
+  return sram_arr;
+}
+
+/*Fill the simulated backup SRAM with garbage from a xorshift generator.*/
+void port_backup_host_power_loss(uint32_t seed)
+{
+  uint32_t x = seed | 1U;
+
+  for (uint32_t i = 0; i < sizeof(sram_arr) / sizeof(sram_arr[0]); i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sram_arr[i] = x;
+  }
+}
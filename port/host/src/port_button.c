@@ -0,0 +1,91 @@
+/**
+ * @file port_button.c
+ * @brief Simulated buttons of the host port. The edges are injected with port_button_host_edge() and queued as the EXTI ISR does.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+
+/* Other includes */
+#include "port_button.h"
+
+/* Typedefs --------------------------------------------------------------------*/
+typedef struct
+{
+    bool flag_pressed; /*Flag to indicate that the button is pressed*/
+    uint32_t edge_ticks[BUTTON_EDGES_QUEUE_SIZE]; /*System tick of the raw edges not yet processed*/
+    bool edge_pressed[BUTTON_EDGES_QUEUE_SIZE]; /*Level of the button after each raw edge*/
+    uint8_t edge_head; /*Index where the simulated ISR writes the next edge*/
+    uint8_t edge_tail; /*Index where the FSM reads the next edge*/
+    uint32_t dropped_edges; /*Number of edges lost because the queue was full*/
+} port_button_hw_t;
+
+/* Global variables ------------------------------------------------------------*/
+
+/*Array of elements that represents the simulated buttons.*/
+static port_button_hw_t buttons_arr[] = {
+     [BUTTON_0_ID] = {.flag_pressed = false},
+};
+
+/*Reset the simulated button.*/
+void port_button_init(uint32_t button_id)
+{
+    memset(&buttons_arr[button_id], 0, sizeof(port_button_hw_t));
+}
+
+/*Return the status of the button (pressed or not)*/
+bool port_button_is_pressed(uint32_t button_id)
+{
+    return buttons_arr[button_id].flag_pressed;
+}
+
+/*Return the count of the System tick in milliseconds*/
+uint32_t port_button_get_tick()
+{
+    return port_system_get_millis();
+}
+
+/*Pop the oldest raw edge of a given button.*/
+bool port_button_pop_edge(uint32_t button_id, uint32_t *p_tick, bool *p_pressed)
+{
+    port_button_hw_t *p_button = &buttons_arr[button_id];
+    uint8_t tail = p_button->edge_tail;
+
+    if (tail == p_button->edge_head)
+    {
+        return false;
+    }
+    *p_tick = p_button->edge_ticks[tail];
+    *p_pressed = p_button->edge_pressed[tail];
+    p_button->edge_tail = (tail + 1) & (BUTTON_EDGES_QUEUE_SIZE - 1);
+    return true;
+}
+
+/*Return the number of edges lost because the queue of a given button was full.*/
+uint32_t port_button_get_dropped_edges(uint32_t button_id)
+{
+    return buttons_arr[button_id].dropped_edges;
+}
+
+/*Simulate an edge of a given button at the current system time.*/
+void port_button_host_edge(uint32_t button_id, bool pressed)
+{
+    port_button_hw_t *p_button = &buttons_arr[button_id];
+    uint8_t head = p_button->edge_head;
+    uint8_t next = (head + 1) & (BUTTON_EDGES_QUEUE_SIZE - 1);
+
+    port_system_isr_wakeup();
+    p_button->flag_pressed = pressed;
+    if (next == p_button->edge_tail)
+    {
+        p_button->dropped_edges++;
+        return;
+    }
+    p_button->edge_ticks[head] = port_system_get_millis();
+    p_button->edge_pressed[head] = pressed;
+    p_button->edge_head = next;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file port_flash.c
+ * @brief Flash sectors of the log simulated in RAM for the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+
+/* Other includes */
+#include "port_flash.h"
+
+/* Global variables ------------------------------------------------------------*/
+static uint32_t sectors_arr[FLASH_LOG_SECTORS][FLASH_LOG_SECTOR_WORDS]; /*!< Simulated sectors. They start zeroed, which is not a valid log */
+
+/* Public functions */
+
+/*Get the address of a sector of the log.*/
+const uint32_t *port_flash_get_log_sector(uint8_t sector)
+{
+  return sectors_arr[sector];
+}
+
+/*Erase a sector of the log.*/
+bool port_flash_erase_log_sector(uint8_t sector)
+{
+  memset(sectors_arr[sector], 0xFF, sizeof(sectors_arr[sector]));
+  return true;
+}
+
+/*Program 32-bit words in a sector of the log.*/
+bool port_flash_program_log(uint8_t sector, uint32_t offset, const uint32_t *p_words, uint32_t num_words)
+{
+  bool ok = true;
+
+  for (uint32_t i = 0; i < num_words; i++)
+  {
+    sectors_arr[sector][offset + i] &= p_words[i];
+    ok = ok && (sectors_arr[sector][offset + i] == p_words[i]);
+  }
+  return ok;
+}
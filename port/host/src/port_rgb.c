@@ -0,0 +1,162 @@
+#include "port_rgb.h"
+#include "port_system.h"
+#include "energy.h"
+#include "ws2812.h"
+
+#define STRIP_STREAM_HALFWORDS WS2812_STREAM_HALFWORDS(PORT_RGB_STRIP_MAX_PIXELS)
+
+typedef struct
+{
+uint32_t color;
+} port_rgb_hw_t;
+
+typedef struct
+{
+uint16_t stream_arr[2][STRIP_STREAM_HALFWORDS]; /*Buffers of the stream: one is sent while the other is filled*/
+uint8_t back; /*Index of the buffer that is not being sent*/
+uint32_t busy_until_ms; /*System time when the stream being sent ends*/
+uint32_t front_halfwords; /*Halfwords of the last stream sent*/
+bool decoded; /*Flag to indicate that the last stream sent has been decoded*/
+bool well_formed; /*Flag to indicate that the LEDs would take the last stream sent as sent*/
+uint32_t pixels[PORT_RGB_STRIP_MAX_PIXELS]; /*Colours decoded from the last stream, as 0x00RRGGBB*/
+uint32_t num_pixels; /*Number of pixels decoded from the last stream*/
+} port_rgb_strip_hw_t;
+
+static  port_rgb_hw_t rgb_arr[] = {
+    [RGB_0_ID] = {.color = 0},
+};
+
+static port_rgb_strip_hw_t strips_arr[] = {
+    [RGB_STRIP_0_ID] = {.back = 0},
+};
+
+/*Get a bit of a stream, most significant bit of each halfword first.*/
+static uint32_t _stream_bit(const uint16_t *p_stream, uint32_t bit){
+
+    return (p_stream[bit / 16U] >> (15U - bit % 16U)) & 1U;
+}
+
+/*Decode a stream as the LEDs would: each group of 3 bits that starts high is a bit of a pixel, 110 for a 1 and 100 for a 0, until the line stays low for the reset. Returns false if the stream is not well formed.*/
+static bool _decode_stream(port_rgb_strip_hw_t *p_strip, const uint16_t *p_stream, uint32_t num_halfwords){
+
+    uint32_t num_bits = num_halfwords * 16U;
+    uint32_t bit = 0;
+    uint32_t value = 0;
+    uint32_t num_values = 0;
+
+    p_strip->num_pixels = 0;
+    while(bit + WS2812_SUBBITS_PER_BIT <= num_bits && _stream_bit(p_stream, bit) == 1U){
+        uint32_t code = (1U << 2) | (_stream_bit(p_stream, bit + 1U) << 1) | _stream_bit(p_stream, bit + 2U);
+
+        if(code != 6U && code != 4U){
+            return false;
+        }
+        value = (value << 1) | (code == 6U);
+        bit += WS2812_SUBBITS_PER_BIT;
+        if(++num_values % WS2812_BITS_PER_PIXEL == 0 && p_strip->num_pixels < PORT_RGB_STRIP_MAX_PIXELS){
+            /*The LEDs take green, red and blue*/
+            p_strip->pixels[p_strip->num_pixels++] = ((value & 0x00FF00U) << 8) | ((value & 0xFF0000U) >> 8) | (value & 0x0000FFU);
+            value = 0;
+        }
+    }
+    if(num_values % WS2812_BITS_PER_PIXEL != 0){
+        return false;
+    }
+    /*The rest of the stream is the reset*/
+    if(num_bits - bit < WS2812_RESET_US * (WS2812_BIT_RATE_HZ / 1000000U)){
+        return false;
+    }
+    for(; bit < num_bits; bit++){
+        if(_stream_bit(p_stream, bit) != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+/*Decode the last stream sent, the first time it is looked at, so that the simulation does not slow down the frames that are not checked.*/
+static port_rgb_strip_hw_t *_decoded_strip(uint8_t strip_id){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+
+    if(!p_strip->decoded){
+        p_strip->well_formed = _decode_stream(p_strip, p_strip->stream_arr[p_strip->back ^ 1U], p_strip->front_halfwords);
+        p_strip->decoded = true;
+    }
+    return p_strip;
+}
+
+
+void port_rgb_init(uint8_t rgb_id){
+
+    port_rgb_set_color(rgb_id, 0, 0, 0);
+}
+
+void port_rgb_set_color(uint8_t rgb_id, uint8_t r, uint8_t g, uint8_t b){
+
+    rgb_arr[rgb_id].color = (r ? 0xFF0000U : 0) | (g ? 0x00FF00U : 0) | (b ? 0x0000FFU : 0);
+
+    uint32_t now = port_system_get_millis();
+    energy_set_periph(ENERGY_PERIPH_RGB_R, (bool )r, now);
+    energy_set_periph(ENERGY_PERIPH_RGB_G, (bool )g, now);
+    energy_set_periph(ENERGY_PERIPH_RGB_B, (bool )b, now);
+}
+
+void port_rgb_strip_init(uint8_t strip_id){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+
+    p_strip->back = 0;
+    p_strip->busy_until_ms = port_system_get_millis();
+    p_strip->front_halfwords = 0;
+    p_strip->decoded = true;
+    p_strip->well_formed = true;
+    p_strip->num_pixels = 0;
+}
+
+uint16_t *port_rgb_strip_get_back_buffer(uint8_t strip_id){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+    return p_strip->stream_arr[p_strip->back];
+}
+
+bool port_rgb_strip_swap(uint8_t strip_id, uint32_t num_halfwords){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+    uint32_t now = port_system_get_millis();
+
+    if(port_rgb_strip_is_busy(strip_id)){
+        return false;
+    }
+    p_strip->front_halfwords = num_halfwords;
+    p_strip->decoded = false;
+    /*The stream takes 16 bits per halfword at the bit rate, rounded up to the next millisecond*/
+    p_strip->busy_until_ms = now + (uint32_t)(((uint64_t)num_halfwords * 16U * 1000U + WS2812_BIT_RATE_HZ - 1U) / WS2812_BIT_RATE_HZ);
+    p_strip->back ^= 1U;
+    return true;
+}
+
+bool port_rgb_strip_is_busy(uint8_t strip_id){
+
+    return (int32_t)(port_system_get_millis() - strips_arr[strip_id].busy_until_ms) < 0;
+}
+
+uint32_t port_rgb_host_get_strip_pixel(uint8_t strip_id, uint32_t index){
+
+    return _decoded_strip(strip_id)->pixels[index];
+}
+
+uint32_t port_rgb_host_get_strip_num_pixels(uint8_t strip_id){
+
+    return _decoded_strip(strip_id)->num_pixels;
+}
+
+bool port_rgb_host_check_strip_stream(uint8_t strip_id){
+
+    return _decoded_strip(strip_id)->well_formed;
+}
+
+uint32_t port_rgb_host_get_color(uint8_t rgb_id){
+
+    return rgb_arr[rgb_id].color;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file port_rx.c
+ * @brief Simulated infrared receivers of the host port. The edges are injected with port_rx_host_edges().
+ * @author alumno1
+ * @author alumno2
+ * @date fecha
+ * */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h> /* To use memset */
+
+/* Other includes */
+#include "port_rx.h"
+#include "port_system.h"
+#include "fsm_rx_nec.h"
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Structure to define a simulated infrared receiver.
+ */
+typedef struct
+{
+bool enabled;
+rx_delta_t deltas[RX_DELTA_BUFFER_SIZE]; /*!< Intervals between the edges stored */
+rx_delta_capture_t capture; /*!< Edges of the frame being captured */
+uint16_t notify_edges; /*!< Number of edges stored at which the deferred interrupt is requested before the end of the frame. 0 to request it only at the end */
+uint32_t gap_us; /*!< Time without edges that ends a frame */
+uint32_t last_edge_ms; /*!< Simulated system time of the last edges */
+bool armed; /*!< Flag to indicate that the simulated compare waits for the gap */
+bool end_of_frame; /*!< Flag set when the gap passes after the last edges */
+uint32_t end_of_frame_cycles; /*!< Cycle count when end_of_frame was set */
+} port_rx_hw_t;
+
+/* Global variables ------------------------------------------------------------*/
+/**
+ * @brief Array of elements that represents the simulated infrared receivers.
+ */
+static port_rx_hw_t receivers_arr[] = {
+    [IR_RX_0_ID] = {.enabled = false},
+};
+
+/* Infrared receiver private functions */
+static void _reset_edge_ticks_idx(uint8_t rx_id)
+{
+  memset(receivers_arr[rx_id].deltas, 0, sizeof(receivers_arr[rx_id].deltas));
+  rx_delta_capture_reset(&receivers_arr[rx_id].capture);
+  receivers_arr[rx_id].armed = false;
+  receivers_arr[rx_id].end_of_frame = false;
+}
+
+void port_rx_init(uint8_t rx_id)
+{
+  receivers_arr[rx_id].gap_us = NEC_RX_END_OF_FRAME_GAP_US;
+  receivers_arr[rx_id].capture.glitch_ticks = NEC_RX_GLITCH_MIN_PULSE_US / NEC_RX_TIMER_TICK_BASE_US;
+  receivers_arr[rx_id].capture.num_glitches = 0;
+  receivers_arr[rx_id].notify_edges = 0;
+  _reset_edge_ticks_idx(rx_id);
+}
+
+void port_rx_en(uint8_t rx_id, bool interr_en)
+{
+  _reset_edge_ticks_idx(rx_id);
+  receivers_arr[rx_id].enabled = interr_en;
+}
+
+void port_rx_tmr_start()
+{
+}
+
+void port_rx_tmr_stop()
+{
+}
+
+uint32_t port_rx_get_num_edges(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].capture.edge_idx;
+}
+
+const rx_delta_t *port_rx_get_buffer_deltas(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].deltas;
+}
+
+uint16_t port_rx_get_duration_ticks(uint8_t rx_id)
+{
+  return rx_delta_capture_duration(&receivers_arr[rx_id].capture);
+}
+
+void port_rx_clean_buffer(uint8_t rx_id)
+{
+  _reset_edge_ticks_idx(rx_id);
+}
+
+void port_rx_set_end_of_frame_gap(uint8_t rx_id, uint32_t gap_us)
+{
+  receivers_arr[rx_id].gap_us = gap_us;
+}
+
+void port_rx_set_glitch_filter(uint8_t rx_id, uint32_t min_pulse_us)
+{
+  uint32_t glitch_ticks = min_pulse_us / NEC_RX_TIMER_TICK_BASE_US;
+
+  receivers_arr[rx_id].capture.glitch_ticks = (glitch_ticks > 0xFFFFU) ? 0xFFFFU : (uint16_t)glitch_ticks;
+}
+
+uint32_t port_rx_get_num_glitches(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].capture.num_glitches;
+}
+
+void port_rx_set_edge_notify(uint8_t rx_id, uint16_t num_edges)
+{
+  receivers_arr[rx_id].notify_edges = num_edges;
+}
+
+bool port_rx_get_end_of_frame(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].end_of_frame;
+}
+
+uint32_t port_rx_get_end_of_frame_cycles(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].end_of_frame_cycles;
+}
+
+void port_rx_host_edges(uint8_t rx_id, const uint16_t *p_ticks, uint32_t num_edges)
+{
+  port_rx_hw_t *p_rx = &receivers_arr[rx_id];
+
+  if (!p_rx->enabled)
+  {
+    return;
+  }
+  port_system_isr_wakeup();
+  /* The edges are stored as by the EXTI ISR of the STM32F446RE port, which reads its timer instead */
+  for (uint32_t i = 0; i < num_edges; i++)
+  {
+    bool stored = rx_delta_store_edge(&p_rx->capture, p_rx->deltas, RX_DELTA_BUFFER_SIZE, p_ticks[i]);
+
+    if (stored && p_rx->capture.edge_idx == p_rx->notify_edges)
+    {
+      port_system_deferred_pend();
+    }
+  }
+  p_rx->last_edge_ms = port_system_get_millis();
+  /* The decoder may have emptied the buffer at a short frame, so there is no gap to wait for */
+  p_rx->armed = (p_rx->capture.edge_idx > 0);
+}
+
+/*The compare fires once the simulated time reaches the gap after the last edges.*/
+void port_rx_host_timers(void)
+{
+  for (uint8_t rx_id = 0; rx_id < sizeof(receivers_arr) / sizeof(receivers_arr[0]); rx_id++)
+  {
+    port_rx_hw_t *p_rx = &receivers_arr[rx_id];
+
+    if (p_rx->armed && ((port_system_get_millis() - p_rx->last_edge_ms) * 1000U >= p_rx->gap_us))
+    {
+      p_rx->armed = false;
+      p_rx->end_of_frame = true;
+      p_rx->end_of_frame_cycles = port_system_get_cycles();
+      port_system_isr_wakeup();
+      port_system_deferred_pend();
+    }
+  }
+}
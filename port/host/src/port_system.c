@@ -0,0 +1,262 @@
+/**
+ * @file port_system.c
+ * @brief Simulated time base and low-power modes of the host port.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <string.h>
+#include <time.h>
+
+/* Other includes */
+#include "port_system.h"
+#include "port_rx.h"
+#include "energy.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define US_PER_MS 1000U /*!< Microseconds in a millisecond */
+
+/* Global variables ------------------------------------------------------------*/
+static uint32_t msTicks = 0;                                                 /*!< Simulated system time in milliseconds */
+static uint64_t init_ns = 0;                                                 /*!< Monotonic clock of the host in nanoseconds when port_system_init() was called */
+static port_system_sleep_stats_t sleep_stats_arr[PORT_SYSTEM_SLEEP_MODES]; /*!< Statistics of each low-power mode */
+static uint8_t clock_profile = PORT_SYSTEM_CLOCK_LOW;                        /*!< Current simulated clock profile */
+static port_system_clock_listener_t clock_listeners_arr[PORT_SYSTEM_CLOCK_MAX_LISTENERS]; /*!< Functions notified of the changes of clock */
+static uint8_t num_clock_listeners = 0;                                      /*!< Number of functions registered in clock_listeners_arr */
+static port_system_deferred_handler_t deferred_handlers_arr[PORT_SYSTEM_DEFERRED_MAX_HANDLERS]; /*!< Functions run by the deferred software interrupt */
+static uint8_t num_deferred_handlers = 0;                                    /*!< Number of functions registered in deferred_handlers_arr */
+static uint32_t deferred_masked = 0;                                         /*!< Flag to indicate that the deferred software interrupt is held off, as by BASEPRI */
+static bool deferred_pending = false;                                        /*!< Flag to indicate that the deferred software interrupt was requested while held off */
+static uint8_t debug_arr[PORT_SYSTEM_HOST_DEBUG_CHANNELS][PORT_SYSTEM_HOST_DEBUG_SIZE]; /*!< Data written on each channel of the simulated debug link */
+static uint32_t debug_len_arr[PORT_SYSTEM_HOST_DEBUG_CHANNELS];              /*!< Number of bytes in each row of debug_arr */
+static const uint32_t clock_hz_arr[] = {                                     /*!< Frequency of the core in each profile, as in the STM32F446RE port */
+    [PORT_SYSTEM_CLOCK_HSI_16MHZ] = 16000000U,
+    [PORT_SYSTEM_CLOCK_PLL_180MHZ] = 180000000U,
+};
+
+/* Private functions */
+
+/*Get the monotonic clock of the host in nanoseconds.*/
+static uint64_t _host_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/*Advance the simulated time and fire the simulated timers of the peripherals that are due.*/
+static void _advance_ms(uint32_t ms)
+{
+  msTicks += ms;
+  port_rx_host_timers();
+}
+
+/* Public functions */
+
+/*Reset the simulated time.*/
+size_t port_system_init(void)
+{
+  init_ns = _host_ns();
+  port_system_clock_set(PORT_SYSTEM_CLOCK_LOW);
+  msTicks = 0;
+  memset(sleep_stats_arr, 0, sizeof(sleep_stats_arr));
+  clock_profile = PORT_SYSTEM_CLOCK_LOW;
+  num_clock_listeners = 0;
+  num_deferred_handlers = 0;
+  deferred_masked = 0;
+  deferred_pending = false;
+  memset(debug_len_arr, 0, sizeof(debug_len_arr));
+  return 0;
+}
+
+/*Get the simulated system time in milliseconds.*/
+uint32_t port_system_get_millis(void)
+{
+  return msTicks;
+}
+
+/*Wait for some milliseconds.*/
+void port_system_delay_ms(uint32_t ms)
+{
+  _advance_ms(ms);
+}
+
+/*Wait for some milliseconds from a time reference.*/
+void port_system_delay_until_ms(uint32_t *p_t, uint32_t ms)
+{
+  uint32_t until = *p_t + ms;
+
+  if ((int32_t)(until - msTicks) > 0)
+  {
+    _advance_ms(until - msTicks);
+  }
+  *p_t = msTicks;
+}
+
+/*Enter a low-power mode until the next millisecond.*/
+void port_system_sleep_mode(uint8_t mode)
+{
+  /* As in the STM32F446RE port, the system wakes up from STOP clocked by the HSI */
+  if (mode != PORT_SYSTEM_SLEEP_WFI)
+  {
+    port_system_clock_set(PORT_SYSTEM_CLOCK_LOW);
+  }
+  sleep_stats_arr[mode].entries++;
+  sleep_stats_arr[mode].residency_ms++;
+  energy_add_state_time(mode, US_PER_MS);
+  _advance_ms(1);
+}
+
+/*Enter the deepest low-power mode.*/
+void port_system_sleep(void)
+{
+  port_system_sleep_mode(PORT_SYSTEM_SLEEP_STOP);
+}
+
+/*Bookkeeping of a wake-up by an ISR.*/
+void port_system_isr_wakeup(void)
+{
+  energy_count_wakeup();
+}
+
+/*Get the residency and wake-up statistics of a low-power mode.*/
+const port_system_sleep_stats_t *port_system_get_sleep_stats(uint8_t mode)
+{
+  return &sleep_stats_arr[mode];
+}
+
+/*Switch the simulated system clock to a profile.*/
+void port_system_clock_set(uint8_t profile)
+{
+  if (profile == clock_profile)
+  {
+    return;
+  }
+  clock_profile = profile;
+  energy_set_periph(ENERGY_PERIPH_CLOCK_BOOST, profile == PORT_SYSTEM_CLOCK_BOOST, msTicks);
+  for (uint8_t i = 0; i < num_clock_listeners; i++)
+  {
+    clock_listeners_arr[i](profile);
+  }
+}
+
+/*Get the current clock profile.*/
+uint8_t port_system_clock_get(void)
+{
+  return clock_profile;
+}
+
+/*Get the frequency of the core in a profile.*/
+uint32_t port_system_clock_get_hz(uint8_t profile)
+{
+  return clock_hz_arr[profile];
+}
+
+/*Register a function to be notified of the changes of clock profile.*/
+void port_system_clock_add_listener(port_system_clock_listener_t listener)
+{
+  for (uint8_t i = 0; i < num_clock_listeners; i++)
+  {
+    if (clock_listeners_arr[i] == listener)
+    {
+      return;
+    }
+  }
+  if (num_clock_listeners < PORT_SYSTEM_CLOCK_MAX_LISTENERS)
+  {
+    clock_listeners_arr[num_clock_listeners++] = listener;
+  }
+}
+
+/*Register a function to be run by the simulated deferred software interrupt.*/
+void port_system_deferred_add_handler(port_system_deferred_handler_t handler)
+{
+  for (uint8_t i = 0; i < num_deferred_handlers; i++)
+  {
+    if (deferred_handlers_arr[i] == handler)
+    {
+      return;
+    }
+  }
+  if (num_deferred_handlers < PORT_SYSTEM_DEFERRED_MAX_HANDLERS)
+  {
+    deferred_handlers_arr[num_deferred_handlers++] = handler;
+  }
+}
+
+/*Run the handlers at once, as the PendSV exception would preempt the caller, unless it is held off.*/
+void port_system_deferred_pend(void)
+{
+  if (deferred_masked)
+  {
+    deferred_pending = true;
+    return;
+  }
+  for (uint8_t i = 0; i < num_deferred_handlers; i++)
+  {
+    deferred_handlers_arr[i]();
+  }
+}
+
+/*Hold the handlers off.*/
+uint32_t port_system_deferred_mask(void)
+{
+  uint32_t state = deferred_masked;
+
+  deferred_masked = 1;
+  return state;
+}
+
+/*Run the handlers requested while they were held off, once they are no longer.*/
+void port_system_deferred_unmask(uint32_t state)
+{
+  deferred_masked = state;
+  if (!deferred_masked && deferred_pending)
+  {
+    deferred_pending = false;
+    port_system_deferred_pend();
+  }
+}
+
+/*Get the nanoseconds of the host as a cycle count.*/
+uint32_t port_system_get_cycles(void)
+{
+  return (uint32_t)_host_ns();
+}
+
+/*Get the microseconds of the host since port_system_init().*/
+uint32_t port_system_get_boot_us(void)
+{
+  return (uint32_t)((_host_ns() - init_ns) / 1000U);
+}
+
+/*Keep the data written on a channel of the simulated debug link.*/
+void port_system_debug_write(uint8_t channel, const uint8_t *p_data, uint32_t len)
+{
+  uint32_t *p_debug_len = &debug_len_arr[channel];
+
+  if (len > PORT_SYSTEM_HOST_DEBUG_SIZE - *p_debug_len)
+  {
+    len = PORT_SYSTEM_HOST_DEBUG_SIZE - *p_debug_len;
+  }
+  memcpy(&debug_arr[channel][*p_debug_len], p_data, len);
+  *p_debug_len += len;
+}
+
+/*Read and clear the data written on a channel of the simulated debug link.*/
+const uint8_t *port_system_host_get_debug(uint8_t channel, uint32_t *p_len)
+{
+  *p_len = debug_len_arr[channel];
+  debug_len_arr[channel] = 0;
+  return debug_arr[channel];
+}
+
+/*Advance the simulated time.*/
+void port_system_host_advance_ms(uint32_t ms)
+{
+  _advance_ms(ms);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file port_tx.c
+ * @brief Simulated infrared transmitters of the host port. The PWM changes are recorded in a trace instead of driving a pin.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "port_tx.h"
+#include "fsm_tx.h"
+#include "energy.h"
+
+/* Typedefs --------------------------------------------------------------------*/
+typedef struct 
+{
+    bool pwm_on; /*Flag to indicate that the PWM is on*/
+    uint32_t pwm_on_tick; /*Symbol tick when the PWM was switched on, to account its on-time*/
+    uint32_t trace[PORT_TX_HOST_TRACE_SIZE]; /*Symbol ticks of the PWM changes*/
+    uint32_t num_changes; /*Number of PWM changes recorded*/
+}port_tx_hw_t;
+
+/* Global variables ------------------------------------------------------------*/
+static uint32_t symbol_tick; /*Simulated count of ticks of the symbol timer*/
+static port_tx_hw_t transmitters_arr[] = { /*Array of elements that represents the simulated infrared transmitters.*/
+     [IR_TX_0_ID] = {.pwm_on = false},
+     [IR_TX_1_ID] = {.pwm_on = false},
+     [IR_TX_2_ID] = {.pwm_on = false},
+     [IR_TX_3_ID] = {.pwm_on = false},
+};
+
+/* Public functions */
+
+/*	Reset a simulated infrared transmitter. */
+void port_tx_init(uint8_t tx_id, bool status)
+{
+  transmitters_arr[tx_id].num_changes = 0;
+  port_tx_pwm_timer_set(tx_id, status);
+}
+
+/*	Set the PWM ON or OFF*/
+void port_tx_pwm_timer_set(uint8_t tx_id, bool status)
+{
+  port_tx_hw_t *p_tx = &transmitters_arr[tx_id];
+
+  if(status == p_tx->pwm_on){
+    return;
+  }
+  if(status == true){
+    p_tx->pwm_on_tick = symbol_tick;
+  }
+  else{
+    energy_add_periph_time(ENERGY_PERIPH_TX_PWM, (uint32_t)(((uint64_t)(symbol_tick - p_tx->pwm_on_tick) * NEC_TX_TIMER_TICK_BASE_NS) / 1000U));
+  }
+  p_tx->pwm_on = status;
+
+  if(p_tx->num_changes < PORT_TX_HOST_TRACE_SIZE){
+    p_tx->trace[p_tx->num_changes++] = symbol_tick;
+  }
+}
+
+/*	Start the symbol timer and reset the count of ticks.*/
+void port_tx_symbol_tmr_start()
+{
+  symbol_tick = 0;
+}
+
+/*Stop the symbol timer.*/
+void port_tx_symbol_tmr_stop()
+{
+}
+
+/*	Get the count of the symbol ticks.*/
+uint32_t port_tx_tmr_get_tick()
+{
+  return symbol_tick++;
+}
+
+/*Get the symbol ticks of the PWM changes recorded since the last clear.*/
+const uint32_t *port_tx_host_get_trace(uint8_t tx_id, uint32_t *p_num_changes)
+{
+  *p_num_changes = transmitters_arr[tx_id].num_changes;
+  return transmitters_arr[tx_id].trace;
+}
+
+/*Clear the trace of a transmitter.*/
+void port_tx_host_clear_trace(uint8_t tx_id)
+{
+  transmitters_arr[tx_id].num_changes = 0;
+}
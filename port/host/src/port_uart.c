@@ -0,0 +1,170 @@
+/**
+ * @file port_uart.c
+ * @brief Serial links of the host port, stood in for by pseudo-terminals. The bytes sent are kept in a ring and drained into the pseudo-terminal as it accepts them, as the DMA of the STM32F446RE port does.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#define _GNU_SOURCE /* To use posix_openpt() and cfmakeraw() */
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+/* Other includes */
+#include "port_uart.h"
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Structure to define a simulated serial link.
+ */
+typedef struct
+{
+  int master_fd;   /*!< Master side of the pseudo-terminal. -1 if it is not open */
+  int slave_fd;    /*!< Slave side, kept open so that the link survives the hosts that close it */
+  uint8_t tx_buffer[PORT_UART_TX_BUFFER_SIZE]; /*!< Ring of the bytes to send */
+  uint16_t tx_head; /*!< Index of the next byte queued in tx_buffer */
+  uint16_t tx_tail; /*!< Index of the first byte not sent yet */
+} port_uart_hw_t;
+
+/* Global variables ------------------------------------------------------------*/
+static port_uart_hw_t uarts_arr[] = { /*!< Array of elements that represents the simulated serial links */
+    [UART_0_ID] = {.master_fd = -1, .slave_fd = -1},
+};
+
+/* Private functions */
+
+/*Write into the pseudo-terminal the bytes of the ring that it accepts.*/
+static void _tx_drain(port_uart_hw_t *p_uart)
+{
+  while (p_uart->master_fd >= 0 && p_uart->tx_head != p_uart->tx_tail)
+  {
+    uint16_t len = (p_uart->tx_head > p_uart->tx_tail) ? (uint16_t)(p_uart->tx_head - p_uart->tx_tail) : (uint16_t)(PORT_UART_TX_BUFFER_SIZE - p_uart->tx_tail);
+    ssize_t written = write(p_uart->master_fd, &p_uart->tx_buffer[p_uart->tx_tail], len);
+
+    if (written <= 0)
+    {
+      return;
+    }
+    p_uart->tx_tail = (p_uart->tx_tail + written) % PORT_UART_TX_BUFFER_SIZE;
+  }
+}
+
+/* Public functions */
+
+/*Open the pseudo-terminal of a serial link.*/
+void port_uart_init(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  struct termios tio;
+
+  p_uart->tx_head = 0;
+  p_uart->tx_tail = 0;
+  if (p_uart->master_fd >= 0)
+  {
+    return;
+  }
+
+  p_uart->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (p_uart->master_fd < 0 || grantpt(p_uart->master_fd) != 0 || unlockpt(p_uart->master_fd) != 0)
+  {
+    return;
+  }
+  p_uart->slave_fd = open(ptsname(p_uart->master_fd), O_RDWR | O_NOCTTY);
+
+  /* Raw bytes, without echo nor line editing, as the binary protocol on the link needs */
+  if (p_uart->slave_fd >= 0 && tcgetattr(p_uart->slave_fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(p_uart->slave_fd, TCSANOW, &tio);
+  }
+  fcntl(p_uart->master_fd, F_SETFL, fcntl(p_uart->master_fd, F_GETFL) | O_NONBLOCK);
+}
+
+/*Arm the RX line as a wake-up source. The host port does not enter the STOP modes.*/
+void port_uart_arm_wakeup(uint8_t uart_id)
+{
+  (void)uart_id;
+}
+
+/*Check if the RX line has woken the system up. Never in the host port.*/
+bool port_uart_check_wakeup(uint8_t uart_id)
+{
+  (void)uart_id;
+  return false;
+}
+
+/*Read the bytes received and not read yet.*/
+uint32_t port_uart_read(uint8_t uart_id, uint8_t *p_data, uint32_t max_len)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  ssize_t len;
+
+  _tx_drain(p_uart);
+  if (p_uart->master_fd < 0 || max_len == 0)
+  {
+    return 0;
+  }
+  len = read(p_uart->master_fd, p_data, max_len > PORT_UART_RX_BUFFER_SIZE ? PORT_UART_RX_BUFFER_SIZE : max_len);
+  return (len > 0) ? (uint32_t)len : 0;
+}
+
+/*Return the number of bytes received and not read yet.*/
+uint32_t port_uart_get_rx_count(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  int count = 0;
+
+  _tx_drain(p_uart);
+  if (p_uart->master_fd < 0 || ioctl(p_uart->master_fd, FIONREAD, &count) != 0)
+  {
+    return 0;
+  }
+  return (uint32_t)count;
+}
+
+/*Queue bytes to send.*/
+bool port_uart_write(uint8_t uart_id, const uint8_t *p_data, uint32_t len)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+
+  if (len > port_uart_get_tx_free(uart_id))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    p_uart->tx_buffer[p_uart->tx_head] = p_data[i];
+    p_uart->tx_head = (p_uart->tx_head + 1U) % PORT_UART_TX_BUFFER_SIZE;
+  }
+  _tx_drain(p_uart);
+  return true;
+}
+
+/*Return the room in the ring of the transmission. One byte is kept free to tell a full ring from an empty one.*/
+uint32_t port_uart_get_tx_free(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+
+  _tx_drain(p_uart);
+  return PORT_UART_TX_BUFFER_SIZE - 1U - (p_uart->tx_head + PORT_UART_TX_BUFFER_SIZE - p_uart->tx_tail) % PORT_UART_TX_BUFFER_SIZE;
+}
+
+/*Return the path of the slave side of the pseudo-terminal.*/
+const char *port_uart_host_get_name(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  const char *p_name = (p_uart->master_fd >= 0) ? ptsname(p_uart->master_fd) : NULL;
+
+  return (p_name != NULL) ? p_name : "";
+}
+
+/*Return the file descriptor of the master side of the pseudo-terminal.*/
+int port_uart_host_get_fd(uint8_t uart_id)
+{
+  return uarts_arr[uart_id].master_fd;
+}
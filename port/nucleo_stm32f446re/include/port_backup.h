@@ -0,0 +1,35 @@
+/**
+ * @file port_backup.h
+ * @brief Header for port_backup.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_BACKUP_H_
+#define PORT_BACKUP_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define PORT_BACKUP_SIZE 4096U /*!< Bytes of the backup SRAM */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Enable the clock of the backup SRAM and the write access to the backup domain.
+ *
+ * The backup SRAM keeps its contents through every system reset: the pin, the watchdogs, the brown-out and the software resets. It is lost when the supply and VBAT are both removed, and it powers up with random contents, so its users protect what they store with a checksum.
+ */
+void port_backup_init(void);
+
+/**
+ * @brief Get the address of the backup SRAM. It is memory-mapped, so it is read and written directly.
+ *
+ * @return Pointer to the first word of the #PORT_BACKUP_SIZE bytes of the backup SRAM
+ */
+uint32_t *port_backup_get_sram(void);
+
+#endif /* PORT_BACKUP_H_ */
@@ -0,0 +1,60 @@
+/**
+ * @file port_flash.h
+ * @brief Header for port_flash.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_FLASH_H_
+#define PORT_FLASH_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FLASH_LOG_SECTORS 2                      /*!< Number of flash sectors used by the log. They are used alternately to level the wear */
+#define FLASH_LOG_SECTOR_0 6                     /*!< First flash sector of the log */
+#define FLASH_LOG_SECTOR_0_ADDR 0x08040000U      /*!< Address of the first flash sector of the log */
+#define FLASH_LOG_SECTOR_SIZE (128U * 1024U)     /*!< Size in bytes of each sector of the log. The linker script must leave these sectors out of the FLASH region */
+#define FLASH_LOG_SECTOR_WORDS (FLASH_LOG_SECTOR_SIZE / sizeof(uint32_t)) /*!< Size in 32-bit words of each sector of the log */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Get the address of a sector of the log. The flash is memory-mapped, so it is read directly.
+ *
+ * @param sector Index of the sector of the log, from 0 to #FLASH_LOG_SECTORS - 1
+ *
+ * @return Pointer to the first word of the sector
+ */
+const uint32_t *port_flash_get_log_sector(uint8_t sector);
+
+/**
+ * @brief Erase a sector of the log. All its words read 0xFFFFFFFF afterwards: the caches of the ART accelerator are flushed, so that no line keeps the old contents.
+ *
+ * @note The CPU stalls while the flash is busy (up to 2 s for a 128 KB sector), as the code runs from the same bank.
+ *
+ * @param sector Index of the sector of the log, from 0 to #FLASH_LOG_SECTORS - 1
+ *
+ * @return `true` if the sector was erased without errors
+ */
+bool port_flash_erase_log_sector(uint8_t sector);
+
+/**
+ * @brief Program 32-bit words in an erased area of a sector of the log.
+ *
+ * @note The CPU stalls while each word is programmed (about 16 us), so the words should be written in batches when the system is not receiving.
+ *
+ * @param sector Index of the sector of the log
+ * @param offset Offset of the first word in the sector, in words
+ * @param p_words Pointer to the words to program
+ * @param num_words Number of words to program
+ *
+ * @return `true` if all the words were programmed without errors
+ */
+bool port_flash_program_log(uint8_t sector, uint32_t offset, const uint32_t *p_words, uint32_t num_words);
+
+#endif /* PORT_FLASH_H_ */
@@ -2,6 +2,7 @@
 #define PORT_RGB_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define RGB_0_ID 0
 #define RGB_R_0_GPIO GPIOB
@@ -11,7 +12,24 @@
 #define RGB_B_0_GPIO GPIOB
 #define RGB_B_0_PIN 5
 
+#define RGB_STRIP_0_ID 0                 /*LED strip identifier: SPI2 in I2S mode, fed by DMA1 stream 4*/
+#define RGB_STRIP_0_GPIO GPIOB           /*GPIO port of the data line of the LED strip*/
+#define RGB_STRIP_0_PIN 15               /*Data line of the LED strip. I2S2 SD*/
+#define PORT_RGB_STRIP_MAX_PIXELS 300U   /*Maximum number of pixels of a strip, that sizes its two stream buffers*/
+
 void port_rgb_init(uint8_t rgb_id);
 void port_rgb_set_color(uint8_t rgb_id, uint8_t r, uint8_t g, uint8_t b);
 
+/*Configure an LED strip of the WS2812 class. The stream of ws2812.h is shifted out at WS2812_BIT_RATE_HZ by the I2S, clocked by the PLLI2S whatever the clock profile, and fed by DMA from one of two buffers while the other one is filled.*/
+void port_rgb_strip_init(uint8_t strip_id);
+
+/*Get the buffer of the stream that is not being sent, of WS2812_STREAM_HALFWORDS(PORT_RGB_STRIP_MAX_PIXELS) halfwords. It is valid until the next swap.*/
+uint16_t *port_rgb_strip_get_back_buffer(uint8_t strip_id);
+
+/*Send the stream written in the back buffer, that becomes the front buffer. It does not block. Returns false, and sends nothing, if the previous stream is still being sent.*/
+bool port_rgb_strip_swap(uint8_t strip_id, uint32_t num_halfwords);
+
+/*Check if a stream is being sent. The DMA and the I2S are stopped in the STOP modes: the caller keeps the system in sleep mode until it ends.*/
+bool port_rgb_strip_is_busy(uint8_t strip_id);
+
 #endif
\ No newline at end of file
@@ -13,6 +13,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/* Other includes */
+#include "rx_delta.h"
+
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
 #define IR_RX_0_ID 0 
@@ -22,12 +25,22 @@
 /* Function prototypes and explanation -------------------------------------------------*/
 
 /**
- * @brief Return a pointer to de memory address of the array that stores the time ticks of the edges detected by the infrared receiver.
+ * @brief Return a pointer to de memory address of the array that stores the intervals between the edges detected by the infrared receiver.
+ *
+ * The buffer has #RX_DELTA_BUFFER_SIZE entries in the format of `rx_delta.h`. It holds one interval less than port_rx_get_num_edges().
  *
  * @param rx_id Receiver ID. This index is used to select the element of the `receivers_arr[]` array.
- * @return uint16_t Pointer to the memory address of the array of time ticks.
+ * @return Pointer to the memory address of the array of intervals.
+ */
+const rx_delta_t *port_rx_get_buffer_deltas(uint8_t rx_id);
+
+/**
+ * @brief Return the time from the first to the last edge stored, exact whatever the format of the intervals.
+ *
+ * @param rx_id Receiver ID
+ * @return Time in ticks of #NEC_RX_TIMER_TICK_BASE_US
  */
-uint16_t *port_rx_get_buffer_edges(uint8_t rx_id);
+uint16_t port_rx_get_duration_ticks(uint8_t rx_id);
 void port_rx_init(uint8_t rx_id);
 void port_rx_en(uint8_t rx_id, bool interr_en);
 void port_rx_tmr_start();
@@ -35,4 +48,56 @@ void port_rx_tmr_stop();
 uint32_t port_rx_get_num_edges(uint8_t rx_id);
 void port_rx_clean_buffer(uint8_t rx_id);
 
+/**
+ * @brief Set the time without edges that ends a frame.
+ *
+ * Every edge arms a one-shot compare of TIM3 this time later. If it fires before the next edge, the end of the frame is flagged, the system is woken up and the deferred interrupt is requested to decode the frame.
+ *
+ * @param rx_id Receiver ID
+ * @param gap_us Time in microseconds. It is rounded down to ticks of #NEC_RX_TIMER_TICK_BASE_US, up to the period of TIM3
+ */
+void port_rx_set_end_of_frame_gap(uint8_t rx_id, uint32_t gap_us);
+
+/**
+ * @brief Set the glitch filter of the receiver. By default, #NEC_RX_GLITCH_MIN_PULSE_US.
+ *
+ * Two edges closer than the threshold bound a glitch: both are dropped and counted, so that a spike of ambient light within a pulse or a silence is merged into it. The edge closer than the threshold is stored until the next one: if that one is close too, the pair of the shortest interval is dropped, so that the edge of the frame is kept. It is checked by the EXTI ISR, so the glitch never reaches the buffer nor the decoder.
+ *
+ * @param rx_id Receiver ID
+ * @param min_pulse_us Shortest pulse or silence kept, in microseconds. It is rounded down to ticks of #NEC_RX_TIMER_TICK_BASE_US. 0 to store every edge
+ */
+void port_rx_set_glitch_filter(uint8_t rx_id, uint32_t min_pulse_us);
+
+/**
+ * @brief Return the number of edges dropped by the glitch filter since the receiver was initialised.
+ *
+ * @param rx_id Receiver ID
+ * @return Number of edges dropped
+ */
+uint32_t port_rx_get_num_glitches(uint8_t rx_id);
+
+/**
+ * @brief Request the deferred interrupt as soon as a number of edges has been stored, before the gap that ends the frame. It is requested by the capture ISR again every time the count is reached.
+ *
+ * @param rx_id Receiver ID
+ * @param num_edges Number of edges of the shortest frame that the decoder recognises at its last edge. 0 to request the deferred interrupt only at the end of the frames
+ */
+void port_rx_set_edge_notify(uint8_t rx_id, uint16_t num_edges);
+
+/**
+ * @brief Return whether the compare of the receiver has detected the end of a frame. The flag is cleared with the edges by port_rx_clean_buffer().
+ *
+ * @param rx_id Receiver ID
+ * @return `true` if the gap passed after the last edge
+ */
+bool port_rx_get_end_of_frame(uint8_t rx_id);
+
+/**
+ * @brief Return the cycle count when the end of the last frame was flagged, to measure the latency of its decoding.
+ *
+ * @param rx_id Receiver ID
+ * @return Value of port_system_get_cycles() in the compare ISR
+ */
+uint32_t port_rx_get_end_of_frame_cycles(uint8_t rx_id);
+
 #endif
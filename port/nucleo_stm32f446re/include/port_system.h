@@ -33,8 +33,64 @@
                                                          0 bit  for subpriority */
 
 /* Power */
+#define POWER_REGULATOR_VOLTAGE_SCALE1 0x03 /*!< Scale 1 mode: the maximum value of fHCLK is 168 MHz, 180 MHz with over-drive. */
 #define POWER_REGULATOR_VOLTAGE_SCALE3 0x01 /*!< Scale 3 mode: the maximum value of fHCLK is 120 MHz. */
 
+/* Clock profiles. The system starts with the one selected with `make CLOCK_PROFILE=...` and can switch between them at run time */
+#define HSI_VALUE_HZ 16000000U         /*!< Frequency of the High Speed Internal oscillator */
+#define PORT_SYSTEM_CLOCK_HSI_16MHZ 0  /*!< Core clocked by the HSI at 16 MHz, voltage scale 3: lowest consumption */
+#define PORT_SYSTEM_CLOCK_PLL_180MHZ 1 /*!< Core clocked by the PLL from the HSI at 180 MHz, voltage scale 1 with over-drive: full speed */
+#define PORT_SYSTEM_CLOCK_PROFILES 2   /*!< Number of clock profiles */
+#define PORT_SYSTEM_CLOCK_LOW PORT_SYSTEM_CLOCK_HSI_16MHZ    /*!< Profile to wait for events */
+#define PORT_SYSTEM_CLOCK_BOOST PORT_SYSTEM_CLOCK_PLL_180MHZ /*!< Profile to decode and modulate frames */
+#define PORT_SYSTEM_CLOCK_MAX_LISTENERS 4                    /*!< Maximum number of functions notified of the changes of clock */
+#define PORT_SYSTEM_CLOCK_BOOST_SETTLE_US 200                /*!< Typical time to lock the PLL and enable the over-drive before switching to the boost profile, in microseconds */
+#define PORT_SYSTEM_DEFERRED_MAX_HANDLERS 4                  /*!< Maximum number of functions run by the deferred software interrupt */
+#define PORT_SYSTEM_DEBUG_TELEMETRY 1                        /*!< Channel of the debug link of the telemetry snapshots: stimulus port 1 of the ITM. Port 0 carries printf() */
+#define PORT_SYSTEM_DEBUG_LOG 2                              /*!< Channel of the debug link of the records of the deferred log: stimulus port 2 of the ITM */
+
+#ifndef PORT_SYSTEM_CLOCK_PROFILE
+#define PORT_SYSTEM_CLOCK_PROFILE PORT_SYSTEM_CLOCK_HSI_16MHZ /*!< Clock profile of the system after the initialization */
+#endif
+
+#define PORT_SYSTEM_HSI_HCLK_HZ HSI_VALUE_HZ                                  /*!< HSI profile: frequency of the core and the AHB bus */
+#define PORT_SYSTEM_HSI_APB1_DIV 1U                                           /*!< HSI profile: APB1 prescaler */
+#define PORT_SYSTEM_HSI_APB2_DIV 1U                                           /*!< HSI profile: APB2 prescaler */
+#define PORT_SYSTEM_HSI_CFGR_PPRE (RCC_CFGR_PPRE1_DIV1 | RCC_CFGR_PPRE2_DIV1) /*!< HSI profile: value of the APB prescalers in the RCC_CFGR register */
+
+#define PORT_SYSTEM_PLLM 8U                                                   /*!< PLL input divider: 16 MHz / 8 = 2 MHz at the VCO input */
+#define PORT_SYSTEM_PLLN 180U                                                 /*!< PLL multiplier: 2 MHz * 180 = 360 MHz at the VCO output */
+#define PORT_SYSTEM_PLLP 2U                                                   /*!< PLL output divider of the system clock: 360 MHz / 2 = 180 MHz */
+#define PORT_SYSTEM_PLL_HCLK_HZ (HSI_VALUE_HZ / PORT_SYSTEM_PLLM * PORT_SYSTEM_PLLN / PORT_SYSTEM_PLLP) /*!< PLL profile: frequency of the core and the AHB bus */
+#define PORT_SYSTEM_PLL_APB1_DIV 4U                                           /*!< PLL profile: APB1 prescaler, 45 MHz, the maximum */
+#define PORT_SYSTEM_PLL_APB2_DIV 2U                                           /*!< PLL profile: APB2 prescaler, 90 MHz, the maximum */
+#define PORT_SYSTEM_PLL_CFGR_PPRE (RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2) /*!< PLL profile: value of the APB prescalers in the RCC_CFGR register */
+
+#define PORT_SYSTEM_TIMER_CLOCK_HZ(hclk_hz, apb_div) ((hclk_hz) / (apb_div) * ((apb_div) == 1U ? 1U : 2U)) /*!< Clock of the timers of an APB bus: twice the bus clock if it is prescaled */
+#define PORT_SYSTEM_HSI_APB1_TIMER_HZ PORT_SYSTEM_TIMER_CLOCK_HZ(PORT_SYSTEM_HSI_HCLK_HZ, PORT_SYSTEM_HSI_APB1_DIV) /*!< HSI profile: clock of TIM2-TIM7 and TIM12-TIM14 */
+#define PORT_SYSTEM_HSI_APB2_TIMER_HZ PORT_SYSTEM_TIMER_CLOCK_HZ(PORT_SYSTEM_HSI_HCLK_HZ, PORT_SYSTEM_HSI_APB2_DIV) /*!< HSI profile: clock of TIM1 and TIM8-TIM11 */
+#define PORT_SYSTEM_PLL_APB1_TIMER_HZ PORT_SYSTEM_TIMER_CLOCK_HZ(PORT_SYSTEM_PLL_HCLK_HZ, PORT_SYSTEM_PLL_APB1_DIV) /*!< PLL profile: clock of TIM2-TIM7 and TIM12-TIM14 */
+#define PORT_SYSTEM_PLL_APB2_TIMER_HZ PORT_SYSTEM_TIMER_CLOCK_HZ(PORT_SYSTEM_PLL_HCLK_HZ, PORT_SYSTEM_PLL_APB2_DIV) /*!< PLL profile: clock of TIM1 and TIM8-TIM11 */
+#define PORT_SYSTEM_FLASH_LATENCY(hclk_hz) (((hclk_hz) - 1U) / 30000000U) /*!< Flash wait states at 2.7-3.6 V: one more every 30 MHz */
+
+/* Timer values computed at compile time. The timer counts are rounded to the nearest integer */
+#define PORT_SYSTEM_TIMER_MAX_ERROR_PPM 1000U /*!< Maximum error allowed between the period of a timer and its nominal value, in parts per million */
+#define PORT_SYSTEM_ABS_DIFF(a, b) ((a) > (b) ? (a) - (b) : (b) - (a)) /*!< Absolute difference of two unsigned values */
+#define PORT_SYSTEM_TIMER_COUNTS_NS(clk_hz, ns) ((uint32_t)(((uint64_t)(clk_hz) * (ns) + 500000000ULL) / 1000000000ULL)) /*!< Counts of a timer clocked at clk_hz in a period of ns nanoseconds */
+#define PORT_SYSTEM_TIMER_COUNTS_HZ(clk_hz, hz) ((uint32_t)(((clk_hz) + (hz) / 2U) / (hz)))                              /*!< Counts of a timer clocked at clk_hz in a period of a frequency of hz */
+#define PORT_SYSTEM_TIMER_ERROR_PPM_NS(clk_hz, ns) (PORT_SYSTEM_ABS_DIFF((uint64_t)PORT_SYSTEM_TIMER_COUNTS_NS(clk_hz, ns) * 1000000000ULL, (uint64_t)(clk_hz) * (ns)) * 1000000ULL / ((uint64_t)(clk_hz) * (ns))) /*!< Error in ppm of #PORT_SYSTEM_TIMER_COUNTS_NS */
+#define PORT_SYSTEM_TIMER_ERROR_PPM_HZ(clk_hz, hz) (PORT_SYSTEM_ABS_DIFF((uint64_t)PORT_SYSTEM_TIMER_COUNTS_HZ(clk_hz, hz) * (hz), (uint64_t)(clk_hz)) * 1000000ULL / (clk_hz)) /*!< Error in ppm of #PORT_SYSTEM_TIMER_COUNTS_HZ */
+
+/* Low-power modes */
+#define PORT_SYSTEM_SLEEP_WFI 0       /*!< Sleep mode: only the core clock is stopped. SysTick keeps running and wakes the core every millisecond */
+#define PORT_SYSTEM_SLEEP_STOP_FAST 1 /*!< Stop mode with the main regulator and the flash on: higher consumption but fast wake-up */
+#define PORT_SYSTEM_SLEEP_STOP 2      /*!< Stop mode with the regulator in low-power mode: lowest consumption but slow wake-up */
+#define PORT_SYSTEM_SLEEP_MODES 3     /*!< Number of low-power modes */
+
+#define LSI_VALUE_HZ 32000U                          /*!< Nominal frequency of the Low Speed Internal oscillator that clocks the RTC */
+#define RTC_PREDIV_S (LSI_VALUE_HZ - 1)              /*!< RTC synchronous prescaler to get a 1 Hz calendar from the LSI. The sub-seconds count LSI periods */
+#define RTC_TICKS_PER_DAY (86400U * LSI_VALUE_HZ)    /*!< RTC ticks in a day, the period of the RTC time register */
+
 /* GPIOs */
 #define HIGH true /*!< Logic 1 */
 #define LOW false /*!< Logic 0 */
@@ -54,6 +110,36 @@
 #define TRIGGER_ENABLE_EVENT_REQ 0x04
 #define TRIGGER_ENABLE_INTERR_REQ 0x08
 
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Statistics of the time spent in a low-power mode.
+ *
+ * Whether the receiver survives the wake-up from a mode is measured by the idle governor: the frames whose first edge woke the system up, and whether they were decoded, are counted per mode in the telemetry next to the residency. The RTC time-stamp input is only on PC13, so no edge of the receiver can be timestamped in hardware.
+ *
+ * The wake-up latency of the user button is a coarse figure of the exit from the mode: it runs from the press, timestamped in hardware by the RTC on PC13, to the first ISR after the sleep. The RTC keeps running in STOP mode, so the latency includes the restart of the regulator, the flash and the HSI, which the cycle counter of the core misses. Its resolution is one LSI period, 1/#LSI_VALUE_HZ s.
+ */
+typedef struct
+{
+  uint32_t entries;                  /*!< Number of times the mode has been entered */
+  uint32_t residency_ms;             /*!< Total time spent in the mode in milliseconds */
+  uint32_t residency_rem_ticks;      /*!< Remainder of the residency below 1 ms, in RTC ticks */
+  uint32_t button_wakeups;           /*!< Number of wake-ups by the user button, whose latency was measured */
+  uint32_t button_latency_us;        /*!< Wake-up latency of the last wake-up by the user button, in microseconds */
+  uint32_t button_latency_max_us;    /*!< Worst wake-up latency from the user button observed in microseconds */
+} port_system_sleep_stats_t;
+
+/**
+ * @brief Function notified after every change of clock profile, with the interrupts disabled, to re-derive the registers that depend on the clock.
+ *
+ * @param profile New clock profile
+ */
+typedef void (*port_system_clock_listener_t)(uint8_t profile);
+
+/**
+ * @brief Function run by the deferred software interrupt. It must check by itself whether it has work pending.
+ */
+typedef void (*port_system_deferred_handler_t)(void);
+
 /* Function prototypes and explanation -------------------------------------------------*/
 
 /**
@@ -65,7 +151,7 @@
  *           - Set NVIC Group Priority to 4.
  *             NVIC_PRIORITYGROUP_4: 4 bits for preemption priority
  *                                    0 bits for subpriority
- *           - Configure the system clock
+ *           - Configure the system clock according to #PORT_SYSTEM_CLOCK_PROFILE
  *
  * @note   SysTick is used as time base for the delay functions. When using the HAL, the application
  *         needs to ensure that the SysTick time base is always set to 1 millisecond
@@ -293,6 +379,118 @@ void port_system_systick_resume(void);
 void port_system_systick_suspend(void);
 void port_system_power_stop();	
 
+/**
+ * @brief Enter the given low-power mode and return once an interrupt wakes the system up.
+ *
+ * The residency in each mode is measured with the RTC, which keeps running (clocked by the LSI) when the rest of the clocks are stopped. After a STOP mode the millisecond counter is advanced by the measured residency so that `port_system_get_millis()` keeps counting wall-clock time.
+ *
+ * @param mode One of #PORT_SYSTEM_SLEEP_WFI, #PORT_SYSTEM_SLEEP_STOP_FAST or #PORT_SYSTEM_SLEEP_STOP
+ *
+ * @retval None
+ */
+void port_system_sleep_mode(uint8_t mode);
+
+/**
+ * @brief Bookkeeping to be done at the beginning of every ISR that may wake the system up.
+ *
+ * It resumes the SysTick and, if the system was sleeping, catches up with the time slept and measures the wake-up latency from the time-stamp of the RTC, if the user button woke the system up.
+ *
+ * @retval None
+ */
+void port_system_isr_wakeup(void);
+
+/**
+ * @brief Get the residency and wake-up statistics of a low-power mode.
+ *
+ * @param mode One of #PORT_SYSTEM_SLEEP_WFI, #PORT_SYSTEM_SLEEP_STOP_FAST or #PORT_SYSTEM_SLEEP_STOP
+ *
+ * @return Pointer to the statistics of the mode
+ */
+const port_system_sleep_stats_t *port_system_get_sleep_stats(uint8_t mode);
+
+/**
+ * @brief Switch the system clock to a profile. The PLL, the over-drive, the voltage scale, the flash latency and the APB prescalers are changed in the safe order, the SysTick is re-derived so that it keeps ticking every millisecond, and the listeners are notified with the interrupts disabled. Switching to the current profile does nothing.
+ *
+ * @param profile #PORT_SYSTEM_CLOCK_LOW or #PORT_SYSTEM_CLOCK_BOOST
+ */
+void port_system_clock_set(uint8_t profile);
+
+/**
+ * @brief Get the current clock profile.
+ *
+ * @return #PORT_SYSTEM_CLOCK_LOW or #PORT_SYSTEM_CLOCK_BOOST
+ */
+uint8_t port_system_clock_get(void);
+
+/**
+ * @brief Get the frequency of the core in a profile.
+ *
+ * @param profile Clock profile
+ *
+ * @return Frequency in Hz
+ */
+uint32_t port_system_clock_get_hz(uint8_t profile);
+
+/**
+ * @brief Register a function to be notified of the changes of clock profile. Registering the same function twice has no effect.
+ *
+ * @param listener Function to notify
+ */
+void port_system_clock_add_listener(port_system_clock_listener_t listener);
+
+/**
+ * @brief Register a function to be run by the deferred software interrupt. Registering the same function twice has no effect.
+ *
+ * The deferred interrupt is the PendSV exception with the lowest priority: it preempts the main loop, but never the capture and timing ISRs, that preempt it instead.
+ *
+ * @param handler Function to run
+ */
+void port_system_deferred_add_handler(port_system_deferred_handler_t handler);
+
+/**
+ * @brief Request the deferred software interrupt. It runs every registered handler once the ISRs in progress return.
+ */
+void port_system_deferred_pend(void);
+
+/**
+ * @brief Hold the deferred software interrupt off with BASEPRI, so that the main loop can update the data read by its handlers. The ISRs keep running.
+ *
+ * @return Previous value of BASEPRI, to give to port_system_deferred_unmask()
+ */
+uint32_t port_system_deferred_mask(void);
+
+/**
+ * @brief Restore the BASEPRI saved by port_system_deferred_mask(). A deferred interrupt requested meanwhile runs at once.
+ *
+ * @param state Value returned by port_system_deferred_mask()
+ */
+void port_system_deferred_unmask(uint32_t state);
+
+/**
+ * @brief Get the count of the cycle counter of the core, to measure short intervals.
+ *
+ * @return CPU cycles. The counter wraps every 2^32 cycles
+ */
+uint32_t port_system_get_cycles(void);
+
+/**
+ * @brief Get the time since the start of port_system_init(), measured by the cycle counter across the changes of clock, to time the initialization. The counter stops in the STOP modes and wraps after 23 s at 180 MHz, so the time is only meaningful until the main loop.
+ *
+ * @return Microseconds since port_system_init()
+ */
+uint32_t port_system_get_boot_us(void);
+
+/**
+ * @brief Write binary data on a channel of the debug link: a stimulus port of the ITM, traced through SWO along with the messages of printf() on port 0.
+ *
+ * Nothing is written if no debugger has enabled the trace or the port, so the system does not block without a probe.
+ *
+ * @param channel Channel, #PORT_SYSTEM_DEBUG_TELEMETRY or #PORT_SYSTEM_DEBUG_LOG. It is the number of the stimulus port
+ * @param p_data Pointer to the data
+ * @param len Number of bytes
+ */
+void port_system_debug_write(uint8_t channel, const uint8_t *p_data, uint32_t len);
+
 
 
 
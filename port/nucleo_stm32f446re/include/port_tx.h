@@ -21,7 +21,17 @@
 /* Defines */
 #define IR_TX_0_ID 0 /*Infrared transmitter identifier*/
 #define IR_TX_0_GPIO GPIOB /*Infrared transmitter GPIO port*/
-#define IR_TX_0_PIN 10 /*Infrared transmitter GPIO pin*/
+#define IR_TX_0_PIN 10 /*Infrared transmitter GPIO pin. TIM2 CH3*/
+#define IR_TX_1_ID 1 /*Second infrared transmitter identifier*/
+#define IR_TX_1_GPIO GPIOA /*Second infrared transmitter GPIO port*/
+#define IR_TX_1_PIN 0 /*Second infrared transmitter GPIO pin. TIM2 CH1*/
+#define IR_TX_2_ID 2 /*Third infrared transmitter identifier*/
+#define IR_TX_2_GPIO GPIOA /*Third infrared transmitter GPIO port*/
+#define IR_TX_2_PIN 1 /*Third infrared transmitter GPIO pin. TIM2 CH2*/
+#define IR_TX_3_ID 3 /*Fourth infrared transmitter identifier*/
+#define IR_TX_3_GPIO GPIOB /*Fourth infrared transmitter GPIO port*/
+#define IR_TX_3_PIN 8 /*Fourth infrared transmitter GPIO pin. TIM4 CH3, as TIM2 CH4 is on the pin of the virtual COM port*/
+#define PORT_TX_NUM_TRANSMITTERS 4 /*Number of infrared transmitters, with consecutive identifiers from 0*/
 
 /* Function prototypes and explanation -------------------------------------------------*/
 
@@ -0,0 +1,95 @@
+/**
+ * @file port_uart.h
+ * @brief Header for port_uart.c file.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+#ifndef PORT_UART_H_
+#define PORT_UART_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define UART_0_ID 0                    /*!< Serial link identifier: USART2, on the virtual COM port of the ST-LINK */
+#define UART_0_GPIO GPIOA              /*!< GPIO port of the pins of the serial link */
+#define UART_0_TX_PIN 2                /*!< TX pin of the serial link. USART2 TX */
+#define UART_0_RX_PIN 3                /*!< RX pin of the serial link. USART2 RX. Its EXTI line, 3, wakes the system up from STOP */
+#define PORT_UART_BAUD_RATE 115200U    /*!< Baud rate of the serial links, 8N1 */
+#define PORT_UART_RX_BUFFER_SIZE 1024U /*!< Bytes of the circular buffer written by the DMA of reception. It holds 89 ms at the baud rate, longer than the frame modulated by the transmitter while the main loop is blocked */
+#define PORT_UART_TX_BUFFER_SIZE 512U  /*!< Bytes of the ring drained by the DMA of transmission */
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Configure a serial link and start the reception.
+ *
+ * The reception is a circular DMA transfer into a buffer of #PORT_UART_RX_BUFFER_SIZE bytes, that runs without the CPU: the bytes are not lost while the main loop is blocked modulating a frame. The interrupt of the idle line at the end of a burst of bytes wakes the system up. The transmission drains a ring of #PORT_UART_TX_BUFFER_SIZE bytes with DMA transfers chained by their interrupt. The baud rate is re-derived when the clock profile changes.
+ *
+ * The USART is stopped in the STOP modes: the caller keeps the system in sleep mode while a host is connected, and arms the falling edge of the RX pin with port_uart_arm_wakeup() so that the next byte wakes it up.
+ *
+ * @param uart_id Serial link ID. This index is used to select the element of the `uarts_arr[]` array
+ */
+void port_uart_init(uint8_t uart_id);
+
+/**
+ * @brief Read the bytes received and not read yet. It does not block.
+ *
+ * @param uart_id Serial link ID
+ * @param p_data Pointer where the bytes are copied
+ * @param max_len Maximum number of bytes read
+ *
+ * @return Number of bytes read
+ */
+uint32_t port_uart_read(uint8_t uart_id, uint8_t *p_data, uint32_t max_len);
+
+/**
+ * @brief Return the number of bytes received and not read yet.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return Number of bytes
+ */
+uint32_t port_uart_get_rx_count(uint8_t uart_id);
+
+/**
+ * @brief Queue bytes to send. They are copied into the ring of the transmission, that is drained by DMA. It does not block.
+ *
+ * @param uart_id Serial link ID
+ * @param p_data Pointer to the bytes
+ * @param len Number of bytes
+ *
+ * @return `true` if the bytes were queued, `false` if there was no room for all of them, so that none was queued
+ */
+bool port_uart_write(uint8_t uart_id, const uint8_t *p_data, uint32_t len);
+
+/**
+ * @brief Arm the falling edge of the RX pin as a wake-up source of the STOP modes, in which the USART has no clock. The EXTI is disarmed by the first edge, the start bit of the first byte of the host.
+ *
+ * @param uart_id Serial link ID
+ */
+void port_uart_arm_wakeup(uint8_t uart_id);
+
+/**
+ * @brief Check if the RX pin has woken the system up since the last call. The flag is cleared.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return `true` if the line has woken the system up
+ */
+bool port_uart_check_wakeup(uint8_t uart_id);
+
+/**
+ * @brief Return the room in the ring of the transmission.
+ *
+ * @param uart_id Serial link ID
+ *
+ * @return Number of bytes that can be queued
+ */
+uint32_t port_uart_get_tx_free(uint8_t uart_id);
+
+#endif /* PORT_UART_H_ */
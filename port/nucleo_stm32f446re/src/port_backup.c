@@ -0,0 +1,27 @@
+/**
+ * @file port_backup.c
+ * @brief Portable functions of the backup SRAM.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "port_backup.h"
+#include "port_system.h"
+
+/* Public functions */
+
+/*Enable the clock of the backup SRAM and the write access to the backup domain. The backup regulator is not needed: it only keeps the SRAM in standby and on VBAT.*/
+void port_backup_init(void)
+{
+  RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+  PWR->CR |= PWR_CR_DBP;
+  RCC->AHB1ENR |= RCC_AHB1ENR_BKPSRAMEN;
+}
+
+/*Get the address of the backup SRAM.*/
+uint32_t *port_backup_get_sram(void)
+{
+  return (uint32_t *)BKPSRAM_BASE;
+}
@@ -18,6 +18,11 @@ typedef struct
     GPIO_TypeDef *p_port; /*GPIO where the button is connected*/
     uint8_t pin; /*Pin/line where the button is connected*/
     bool flag_pressed; /*Flag to indicate that the button has been pressed. If it occurs in a rising or falling edge depends on how the function port_button_is_pressed implements it.*/
+    uint32_t edge_ticks[BUTTON_EDGES_QUEUE_SIZE]; /*System tick of the raw edges not yet processed*/
+    bool edge_pressed[BUTTON_EDGES_QUEUE_SIZE]; /*Level of the button after each raw edge*/
+    volatile uint8_t edge_head; /*Index where the ISR writes the next edge*/
+    volatile uint8_t edge_tail; /*Index where the FSM reads the next edge*/
+    uint32_t dropped_edges; /*Number of edges lost because the queue was full*/
 } port_button_hw_t;
 
 /* Global variables ------------------------------------------------------------*/
@@ -50,6 +55,48 @@ uint32_t port_button_get_tick()
     return port_system_get_millis();
 }	
 
+/*Pop the oldest raw edge timestamped by the ISR of a given button.
+
+Only the ISR writes the head and only this function writes the tail, so no critical section is needed.*/
+bool port_button_pop_edge(uint32_t button_id, uint32_t *p_tick, bool *p_pressed)
+{
+    port_button_hw_t *p_button = &buttons_arr[button_id];
+    uint8_t tail = p_button->edge_tail;
+
+    if (tail == p_button->edge_head)
+    {
+        return false;
+    }
+    *p_tick = p_button->edge_ticks[tail];
+    *p_pressed = p_button->edge_pressed[tail];
+    p_button->edge_tail = (tail + 1) & (BUTTON_EDGES_QUEUE_SIZE - 1);
+    return true;
+}
+
+/*Return the number of edges lost because the queue of a given button was full.*/
+uint32_t port_button_get_dropped_edges(uint32_t button_id)
+{
+    return buttons_arr[button_id].dropped_edges;
+}
+
+/*Timestamp a raw edge of a given button and queue it. Called from the ISR.*/
+static void _store_edge(uint32_t button_id, bool pressed)
+{
+    port_button_hw_t *p_button = &buttons_arr[button_id];
+    uint8_t head = p_button->edge_head;
+    uint8_t next = (head + 1) & (BUTTON_EDGES_QUEUE_SIZE - 1);
+
+    p_button->flag_pressed = pressed;
+    if (next == p_button->edge_tail)
+    {
+        p_button->dropped_edges++;
+        return;
+    }
+    p_button->edge_ticks[head] = port_system_get_millis();
+    p_button->edge_pressed[head] = pressed;
+    p_button->edge_head = next;
+}
+
 //------------------------------------------------------
 // INTERRUPT SERVICE ROUTINES
 //------------------------------------------------------
@@ -70,23 +117,21 @@ uint32_t port_button_get_tick()
  * 
  */
 
-/*This function handles Px10-Px15 global interrupts*/
+/*This function handles Px10-Px15 global interrupts. Every button on these lines timestamps its raw edges into its queue; the debounce is done later by the FSM on the timestamps.*/
 void EXTI15_10_IRQHandler(void)
 {
 
-    port_system_systick_resume();
-    /* ISR user button in PC13 */
-    if (EXTI->PR & BIT_POS_TO_MASK(buttons_arr[BUTTON_0_ID].pin))
+    port_system_isr_wakeup();
+    for (uint32_t button_id = 0; button_id < sizeof(buttons_arr) / sizeof(buttons_arr[0]); button_id++)
     {
-    bool value = port_system_gpio_read(buttons_arr[BUTTON_0_ID].p_port, buttons_arr[BUTTON_0_ID].pin);
-    if (value == HIGH){
-        buttons_arr[BUTTON_0_ID].flag_pressed = false;
-            
-    }
-    else{
-        buttons_arr[BUTTON_0_ID].flag_pressed = true;
-    }
-     EXTI -> PR |= BIT_POS_TO_MASK(buttons_arr[BUTTON_0_ID].pin);
+        uint8_t pin = buttons_arr[button_id].pin;
+        if ((pin >= 10) && (EXTI->PR & BIT_POS_TO_MASK(pin)))
+        {
+            EXTI -> PR = BIT_POS_TO_MASK(pin);
+            /* The buttons are active low: LOW means that the button has been pressed */
+            bool value = port_system_gpio_read(buttons_arr[button_id].p_port, pin);
+            _store_edge(button_id, value == LOW);
+        }
     }
 
 }
@@ -0,0 +1,112 @@
+/**
+ * @file port_flash.c
+ * @brief Portable functions to erase and program the flash sectors reserved for the log.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "port_flash.h"
+#include "port_system.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define FLASH_KEY1 0x45670123U /*!< First key to unlock the flash control register */
+#define FLASH_KEY2 0xCDEF89ABU /*!< Second key to unlock the flash control register */
+#define FLASH_SR_ERRORS (FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR) /*!< Error flags of the flash status register */
+
+/* Private functions */
+
+/*Wait until the flash is not busy and return true if the last operation had no errors. The error flags are cleared.*/
+static bool _wait_and_check(void)
+{
+  while (FLASH->SR & FLASH_SR_BSY)
+  {
+  }
+  uint32_t errors = FLASH->SR & FLASH_SR_ERRORS;
+  FLASH->SR = errors | FLASH_SR_EOP; /* Flags are cleared by writing 1 */
+  return errors == 0;
+}
+
+/*Unlock the flash control register.*/
+static void _unlock(void)
+{
+  if (FLASH->CR & FLASH_CR_LOCK)
+  {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+  }
+}
+
+/*Lock the flash control register.*/
+static void _lock(void)
+{
+  FLASH->CR |= FLASH_CR_LOCK;
+}
+
+/*Flush the instruction and data caches of the ART accelerator, as FLASH_FlushCaches() of the HAL does. An erase does not invalidate the lines that hold the old contents of the sector, so they would be read instead of the erased words. A cache can only be reset while it is disabled.*/
+static void _flush_caches(void)
+{
+  if (FLASH->ACR & FLASH_ACR_ICEN)
+  {
+    FLASH->ACR &= ~FLASH_ACR_ICEN;
+    FLASH->ACR |= FLASH_ACR_ICRST;
+    FLASH->ACR &= ~FLASH_ACR_ICRST;
+    FLASH->ACR |= FLASH_ACR_ICEN;
+  }
+  if (FLASH->ACR & FLASH_ACR_DCEN)
+  {
+    FLASH->ACR &= ~FLASH_ACR_DCEN;
+    FLASH->ACR |= FLASH_ACR_DCRST;
+    FLASH->ACR &= ~FLASH_ACR_DCRST;
+    FLASH->ACR |= FLASH_ACR_DCEN;
+  }
+}
+
+/* Public functions */
+
+/*Get the address of a sector of the log.*/
+const uint32_t *port_flash_get_log_sector(uint8_t sector)
+{
+  return (const uint32_t *)(uintptr_t)(FLASH_LOG_SECTOR_0_ADDR + sector * FLASH_LOG_SECTOR_SIZE);
+}
+
+/*Erase a sector of the log.*/
+bool port_flash_erase_log_sector(uint8_t sector)
+{
+  bool ok;
+
+  _unlock();
+  _wait_and_check();
+  /* Parallelism x32 (2.7 V - 3.6 V) */
+  FLASH->CR &= ~(FLASH_CR_PSIZE | FLASH_CR_SNB);
+  FLASH->CR |= FLASH_CR_PSIZE_1 | FLASH_CR_SER | ((FLASH_LOG_SECTOR_0 + sector) << FLASH_CR_SNB_Pos);
+  FLASH->CR |= FLASH_CR_STRT;
+  ok = _wait_and_check();
+  FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+  _lock();
+  _flush_caches();
+
+  return ok;
+}
+
+/*Program 32-bit words in an erased area of a sector of the log.*/
+bool port_flash_program_log(uint8_t sector, uint32_t offset, const uint32_t *p_words, uint32_t num_words)
+{
+  volatile uint32_t *p_dest = (volatile uint32_t *)port_flash_get_log_sector(sector) + offset;
+  bool ok = true;
+
+  _unlock();
+  _wait_and_check();
+  FLASH->CR &= ~FLASH_CR_PSIZE;
+  FLASH->CR |= FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+  for (uint32_t i = 0; (i < num_words) && ok; i++)
+  {
+    p_dest[i] = p_words[i];
+    ok = _wait_and_check();
+  }
+  FLASH->CR &= ~FLASH_CR_PG;
+  _lock();
+
+  return ok;
+}
@@ -1,5 +1,19 @@
 #include "port_rgb.h"
 #include "port_system.h"
+#include "energy.h"
+#include "ws2812.h"
+
+#define ALT_FUNC5_SPI2 0x05U       /*SPI1-SPI4 Alternate Function mapping*/
+#define DMA_CHANNEL_SPI2_TX 0U     /*Channel of DMA1 of the requests of the transmission of SPI2, in stream 4*/
+#define PLLI2SM 8U                 /*PLLI2S input divider: 16 MHz / 8 = 2 MHz at the VCO input, as the main PLL*/
+#define PLLI2SN 96U                /*PLLI2S multiplier: 192 MHz at the VCO output*/
+#define PLLI2SR 2U                 /*PLLI2S divider of the I2S clock: 96 MHz*/
+#define I2S_CLOCK_HZ (HSI_VALUE_HZ / PLLI2SM * PLLI2SN / PLLI2SR)
+#define I2S_DIV (I2S_CLOCK_HZ / WS2812_BIT_RATE_HZ) /*Divider of the bit clock without master clock: I2S_CLOCK_HZ / (2 * I2SDIV + ODD)*/
+#define STRIP_STREAM_HALFWORDS WS2812_STREAM_HALFWORDS(PORT_RGB_STRIP_MAX_PIXELS)
+
+_Static_assert(I2S_CLOCK_HZ % WS2812_BIT_RATE_HZ == 0 && I2S_DIV / 2U >= 2U, "The bit rate of the LED strip is not reachable from the PLLI2S");
+_Static_assert(STRIP_STREAM_HALFWORDS <= 0xFFFFU, "The stream does not fit in the 16-bit counter of a DMA transfer");
 
 typedef struct
 {
@@ -11,10 +25,34 @@ GPIO_TypeDef *p_port_blue;
 uint8_t pin_blue;
 } port_rgb_hw_t;
 
+typedef struct
+{
+SPI_TypeDef *p_spi; /*SPI of the strip, in I2S mode, on APB1*/
+DMA_Stream_TypeDef *p_dma; /*Stream of DMA1 that feeds the I2S*/
+uint16_t stream_arr[2][STRIP_STREAM_HALFWORDS]; /*Buffers of the stream: one is sent while the other is filled*/
+uint8_t back; /*Index of the buffer that is not being sent*/
+volatile bool busy; /*Flag to indicate that a stream is being sent. Cleared by the ISR of the DMA*/
+} port_rgb_strip_hw_t;
+
 static  port_rgb_hw_t rgb_arr[] = {
     [RGB_0_ID] = {.p_port_red = RGB_R_0_GPIO, .pin_red = RGB_R_0_PIN, .p_port_green = RGB_G_0_GPIO, .pin_green = RGB_G_0_PIN, .p_port_blue = RGB_B_0_GPIO, .pin_blue = RGB_B_0_PIN},
 };
 
+static port_rgb_strip_hw_t strips_arr[] = {
+    [RGB_STRIP_0_ID] = {.p_spi = SPI2, .p_dma = DMA1_Stream4},
+};
+
+/*Start the PLLI2S, that is stopped in the STOP modes, and wait for its lock. The source of the PLLs is the HSI, as selected by port_system.*/
+static void _plli2s_start(void){
+
+    if(RCC->CR & RCC_CR_PLLI2SRDY){
+        return;
+    }
+    RCC->CR |= RCC_CR_PLLI2SON;
+    while(!(RCC->CR & RCC_CR_PLLI2SRDY)){
+    }
+}
+
 
 void port_rgb_init(uint8_t rgb_id){
 
@@ -30,4 +68,86 @@ void port_rgb_set_color(uint8_t rgb_id, uint8_t r, uint8_t g, uint8_t b){
     port_system_gpio_write(rgb_arr[rgb_id].p_port_red, rgb_arr[rgb_id].pin_red, (bool )r);
     port_system_gpio_write(rgb_arr[rgb_id].p_port_green, rgb_arr[rgb_id].pin_green, (bool )g);
     port_system_gpio_write(rgb_arr[rgb_id].p_port_blue, rgb_arr[rgb_id].pin_blue, (bool )b);
+
+    uint32_t now = port_system_get_millis();
+    energy_set_periph(ENERGY_PERIPH_RGB_R, (bool )r, now);
+    energy_set_periph(ENERGY_PERIPH_RGB_G, (bool )g, now);
+    energy_set_periph(ENERGY_PERIPH_RGB_B, (bool )b, now);
 }	
+
+
+void port_rgb_strip_init(uint8_t strip_id){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+
+    RCC->APB1ENR |= RCC_APB1ENR_SPI2EN;
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    /*The line is held low by the pull-down while the I2S is disabled, as in the reset of the LEDs*/
+    port_system_gpio_config(RGB_STRIP_0_GPIO, RGB_STRIP_0_PIN, GPIO_MODE_ALTERNATE, GPIO_PUPDR_PDOWN);
+    port_system_gpio_config_alternate(RGB_STRIP_0_GPIO, RGB_STRIP_0_PIN, ALT_FUNC5_SPI2);
+
+    /*The PLLI2S can only be configured while it is off. The I2S of APB1 takes its R output*/
+    RCC->CR &= ~RCC_CR_PLLI2SON;
+    RCC->PLLI2SCFGR = (RCC->PLLI2SCFGR & ~(RCC_PLLI2SCFGR_PLLI2SM | RCC_PLLI2SCFGR_PLLI2SN | RCC_PLLI2SCFGR_PLLI2SR)) | (PLLI2SM << RCC_PLLI2SCFGR_PLLI2SM_Pos) | (PLLI2SN << RCC_PLLI2SCFGR_PLLI2SN_Pos) | (PLLI2SR << RCC_PLLI2SCFGR_PLLI2SR_Pos);
+    RCC->DCKCFGR &= ~RCC_DCKCFGR_I2S1SRC;
+
+    /*Master transmitter, MSB justified, 16-bit data in 16-bit channels: the halfwords are shifted out back to back*/
+    p_strip->p_spi->I2SCFGR = 0;
+    p_strip->p_spi->I2SPR = ((I2S_DIV / 2U) << SPI_I2SPR_I2SDIV_Pos) | ((I2S_DIV % 2U) ? SPI_I2SPR_ODD : 0);
+    p_strip->p_spi->I2SCFGR = SPI_I2SCFGR_I2SMOD | SPI_I2SCFGR_I2SCFG_1 | SPI_I2SCFGR_I2SSTD_0;
+    p_strip->p_spi->CR2 = SPI_CR2_TXDMAEN;
+
+    p_strip->p_dma->CR = 0;
+    p_strip->p_dma->PAR = (uint32_t)(uintptr_t)&p_strip->p_spi->DR;
+    p_strip->back = 0;
+    p_strip->busy = false;
+
+    NVIC_SetPriority(DMA1_Stream4_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 3, 0));
+    NVIC_EnableIRQ(DMA1_Stream4_IRQn);
+}
+
+uint16_t *port_rgb_strip_get_back_buffer(uint8_t strip_id){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+    return p_strip->stream_arr[p_strip->back];
+}
+
+bool port_rgb_strip_swap(uint8_t strip_id, uint32_t num_halfwords){
+
+    port_rgb_strip_hw_t *p_strip = &strips_arr[strip_id];
+
+    if(p_strip->busy){
+        return false;
+    }
+    _plli2s_start();
+    p_strip->busy = true;
+    DMA1->HIFCR = DMA_HIFCR_CTCIF4 | DMA_HIFCR_CHTIF4 | DMA_HIFCR_CTEIF4 | DMA_HIFCR_CDMEIF4 | DMA_HIFCR_CFEIF4;
+    p_strip->p_dma->M0AR = (uint32_t)(uintptr_t)p_strip->stream_arr[p_strip->back];
+    p_strip->p_dma->NDTR = num_halfwords;
+    p_strip->p_dma->CR = (DMA_CHANNEL_SPI2_TX << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_EN;
+    p_strip->p_spi->I2SCFGR |= SPI_I2SCFGR_I2SE;
+    p_strip->back ^= 1U;
+    return true;
+}
+
+bool port_rgb_strip_is_busy(uint8_t strip_id){
+
+    return strips_arr[strip_id].busy;
+}
+
+//------------------------------------------------------
+// INTERRUPT SERVICE ROUTINES
+//------------------------------------------------------
+
+/*The DMA has written the last halfword of the stream. The I2S is stopped right away: the halfwords cut are 0, in the reset that latches the frame.*/
+void DMA1_Stream4_IRQHandler(void)
+{
+    port_rgb_strip_hw_t *p_strip = &strips_arr[RGB_STRIP_0_ID];
+
+    if(DMA1->HISR & DMA_HISR_TCIF4){
+        DMA1->HIFCR = DMA_HIFCR_CTCIF4;
+        p_strip->p_spi->I2SCFGR &= ~SPI_I2SCFGR_I2SE;
+        p_strip->busy = false;
+        port_system_isr_wakeup();
+    }
+}
@@ -15,6 +15,13 @@
 #include "port_system.h"
 #include "fsm_rx_nec.h"
 
+/* Defines --------------------------------------------------------------------*/
+#define RX_TIMER_COUNTS(apb1_timer_hz) PORT_SYSTEM_TIMER_COUNTS_NS(apb1_timer_hz, NEC_RX_TIMER_TICK_BASE_NS) /*!< Counts of the clock of TIM3 in a tick of the receiver: the prescaler */
+
+_Static_assert(RX_TIMER_COUNTS(PORT_SYSTEM_PLL_APB1_TIMER_HZ) - 1U <= 0xFFFFU, "The tick of the receiver does not fit in the 16-bit prescaler of TIM3");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_NS(PORT_SYSTEM_HSI_APB1_TIMER_HZ, NEC_RX_TIMER_TICK_BASE_NS) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The tick of the receiver is not accurate with the HSI profile");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_NS(PORT_SYSTEM_PLL_APB1_TIMER_HZ, NEC_RX_TIMER_TICK_BASE_NS) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The tick of the receiver is not accurate with the PLL profile");
+
 /* Typedefs --------------------------------------------------------------------*/
 /**
  * @brief Structure to define the HW dependencies of an infrared receiver. 
@@ -23,8 +30,12 @@ typedef struct
 {
 GPIO_TypeDef *p_port;
 uint8_t pin;
-uint16_t edge_ticks[NEC_FRAME_EDGES];
-uint16_t edge_idx;
+rx_delta_t deltas[RX_DELTA_BUFFER_SIZE]; /*!< Intervals between the edges stored */
+rx_delta_capture_t capture; /*!< Edges of the frame being captured, in ticks of TIM3 */
+uint16_t notify_edges; /*!< Number of edges stored at which the deferred interrupt is requested before the end of the frame. 0 to request it only at the end */
+uint16_t gap_ticks; /*!< Ticks of TIM3 without edges that end a frame */
+volatile bool end_of_frame; /*!< Flag set by the compare of TIM3 when the gap passes after the last edge */
+volatile uint32_t end_of_frame_cycles; /*!< Cycle count when end_of_frame was set */
 } port_rx_hw_t;
 
 /* Global variables ------------------------------------------------------------*/
@@ -35,9 +46,17 @@ static port_rx_hw_t receivers_arr[] = {
     [IR_RX_0_ID] = {.p_port = IR_RX_0_GPIO, .pin = IR_RX_0_PIN},
 };
 
+/**
+ * @brief Prescaler of TIM3 in each clock profile, derived at compile time.
+ */
+static const uint16_t rx_prescaler_arr[] = {
+    [PORT_SYSTEM_CLOCK_HSI_16MHZ] = RX_TIMER_COUNTS(PORT_SYSTEM_HSI_APB1_TIMER_HZ) - 1U,
+    [PORT_SYSTEM_CLOCK_PLL_180MHZ] = RX_TIMER_COUNTS(PORT_SYSTEM_PLL_APB1_TIMER_HZ) - 1U,
+};
+
 /* Infrared receiver private functions */
 /**
- * @brief Set the elements of the array of time ticks to '0' and init the index to '0' as well.
+ * @brief Set the elements of the array of intervals to '0' and init the indexes to '0' as well.
  *
  * > &nbsp;&nbsp;&nbsp;&nbsp;💡 To set all the elements of an array to one value, you can use function `memset`. You need a pointer to the array (its name), the value you want to set, and the length (in bytes) of the array (so you need to multiply the number of elements by the size of the type of the elements of the array). To use this function you need to include the <string.h> library.
  *
@@ -45,21 +64,40 @@ static port_rx_hw_t receivers_arr[] = {
  */
 static void _reset_edge_ticks_idx(uint8_t rx_id)
 {
-  memset(receivers_arr[rx_id].edge_ticks, 0, sizeof(uint16_t) * NEC_FRAME_EDGES);
-  receivers_arr[rx_id].edge_idx = 0;
+  /* The compare is disarmed first, so that it cannot flag the end of the frame being cleared */
+  TIM3 -> DIER &= ~TIM_DIER_CC1IE;
+  memset(receivers_arr[rx_id].deltas, 0, sizeof(receivers_arr[rx_id].deltas));
+  rx_delta_capture_reset(&receivers_arr[rx_id].capture);
+  receivers_arr[rx_id].end_of_frame = false;
+}
+
+/**
+ * @brief Arm the one-shot compare of TIM3 the gap that ends a frame after now. The counter wraps, so does the compare value.
+ *
+ * @param rx_id Receiver ID. This index is used to select the element of the `receivers_arr[]` array.
+ */
+static void _arm_end_of_frame(uint8_t rx_id)
+{
+  TIM3 -> CCR1 = (uint16_t)(TIM3 -> CNT + receivers_arr[rx_id].gap_ticks);
+  TIM3 -> SR &= ~TIM_SR_CC1IF;
+  TIM3 -> DIER |= TIM_DIER_CC1IE;
 }
 
 static void _store_edge_tick(uint8_t rx_id)
 {
-  uint16_t value = receivers_arr[rx_id].edge_idx;
+  port_rx_hw_t *p_rx = &receivers_arr[rx_id];
+  uint16_t value = p_rx->capture.edge_idx;
   
-  if((port_system_gpio_read(receivers_arr[rx_id].p_port, receivers_arr[rx_id].pin) == false && value%2 == 0) || (port_system_gpio_read(receivers_arr[rx_id].p_port, receivers_arr[rx_id].pin) == true && value%2 != 0)){
+  if((port_system_gpio_read(p_rx->p_port, p_rx->pin) == false && value%2 == 0) || (port_system_gpio_read(p_rx->p_port, p_rx->pin) == true && value%2 != 0)){
 
-     if(receivers_arr[rx_id].edge_idx < NEC_FRAME_EDGES){
+    bool stored = rx_delta_store_edge(&p_rx->capture, p_rx->deltas, RX_DELTA_BUFFER_SIZE, TIM3->CNT);
 
-     receivers_arr[rx_id].edge_ticks[receivers_arr[rx_id].edge_idx] = TIM3->CNT;
-     receivers_arr[rx_id].edge_idx++;
-    }  
+    _arm_end_of_frame(rx_id);
+
+    /* A short frame, as a repetition code, is decoded at its last edge instead of the gap after it */
+    if(stored && p_rx->capture.edge_idx == p_rx->notify_edges){
+      port_system_deferred_pend();
+    }
   }
 }
 
@@ -68,13 +106,39 @@ void _timer_rx_setup()
   RCC -> APB1ENR |= RCC_APB1ENR_TIM3EN;
   TIM3 -> CNT = 0;
   TIM3 -> ARR = 65535;
-  TIM3 -> PSC = 159; /*(SystemCoreClock * NEC_RX_TIMER_TICK_BASE_US * pow(10, -6)) - 1;*/
+  TIM3 -> PSC = rx_prescaler_arr[port_system_clock_get()];
   TIM3 -> EGR = TIM_EGR_UG;
+  TIM3 -> SR &= ~TIM_SR_CC1IF;
+
+  /* The compare of the end of frame has the priority of the EXTI of the receiver, so that they do not preempt each other */
+  NVIC_SetPriority(TIM3_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 2, 0));
+  NVIC_EnableIRQ(TIM3_IRQn);
+}
+
+/**
+ * @brief Re-derive the prescaler of TIM3 after a change of the system clock, so that the ticks of a frame being captured keep their length.
+ *
+ * The prescaler is only loaded by an update event, that also clears the count, so the count is restored afterwards. At most the fraction of a tick in progress is lost.
+ *
+ * @param profile New clock profile
+ */
+static void _timer_rx_clock_changed(uint8_t profile)
+{
+  uint32_t cnt = TIM3->CNT;
+
+  TIM3 -> PSC = rx_prescaler_arr[profile];
+  TIM3 -> EGR = TIM_EGR_UG;
+  TIM3 -> CNT = cnt;
 }
 
 void port_rx_init(uint8_t rx_id)
 {
+  receivers_arr[rx_id].gap_ticks = NEC_RX_END_OF_FRAME_GAP_US / NEC_RX_TIMER_TICK_BASE_US;
+  receivers_arr[rx_id].capture.glitch_ticks = NEC_RX_GLITCH_MIN_PULSE_US / NEC_RX_TIMER_TICK_BASE_US;
+  receivers_arr[rx_id].capture.num_glitches = 0;
+  receivers_arr[rx_id].notify_edges = 0;
   _timer_rx_setup();
+  port_system_clock_add_listener(_timer_rx_clock_changed);
   port_system_gpio_config(receivers_arr[rx_id].p_port, receivers_arr[rx_id].pin, GPIO_MODE_IN, GPIO_PUPDR_NOPULL);
   port_system_gpio_config_exti(receivers_arr[rx_id].p_port, receivers_arr[rx_id].pin, TRIGGER_BOTH_EDGE);
   port_system_gpio_config_exti(receivers_arr[rx_id].p_port, receivers_arr[rx_id].pin, TRIGGER_ENABLE_INTERR_REQ);
@@ -101,17 +165,23 @@ void port_rx_tmr_start()
 
 void port_rx_tmr_stop()
 {
+  TIM3 -> DIER &= ~TIM_DIER_CC1IE;
   TIM3 -> CR1 &= ~TIM_CR1_CEN;
 }
 
 uint32_t port_rx_get_num_edges(uint8_t rx_id)
 {
-  return receivers_arr[rx_id].edge_idx;
+  return receivers_arr[rx_id].capture.edge_idx;
+}
+
+const rx_delta_t *port_rx_get_buffer_deltas(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].deltas;
 }
 
-uint16_t *port_rx_get_buffer_edges(uint8_t rx_id)
+uint16_t port_rx_get_duration_ticks(uint8_t rx_id)
 {
-  return (uint16_t *)(&(receivers_arr[rx_id].edge_ticks));
+  return rx_delta_capture_duration(&receivers_arr[rx_id].capture);
 }
 
 void port_rx_clean_buffer(uint8_t rx_id)
@@ -119,12 +189,59 @@ void port_rx_clean_buffer(uint8_t rx_id)
   _reset_edge_ticks_idx(rx_id);
 }
 
+void port_rx_set_end_of_frame_gap(uint8_t rx_id, uint32_t gap_us)
+{
+  uint32_t gap_ticks = gap_us / NEC_RX_TIMER_TICK_BASE_US;
+
+  receivers_arr[rx_id].gap_ticks = (gap_ticks > 0xFFFFU) ? 0xFFFFU : (uint16_t)gap_ticks;
+}
+
+void port_rx_set_glitch_filter(uint8_t rx_id, uint32_t min_pulse_us)
+{
+  uint32_t glitch_ticks = min_pulse_us / NEC_RX_TIMER_TICK_BASE_US;
+
+  receivers_arr[rx_id].capture.glitch_ticks = (glitch_ticks > 0xFFFFU) ? 0xFFFFU : (uint16_t)glitch_ticks;
+}
+
+uint32_t port_rx_get_num_glitches(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].capture.num_glitches;
+}
+
+void port_rx_set_edge_notify(uint8_t rx_id, uint16_t num_edges)
+{
+  receivers_arr[rx_id].notify_edges = num_edges;
+}
+
+bool port_rx_get_end_of_frame(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].end_of_frame;
+}
+
+uint32_t port_rx_get_end_of_frame_cycles(uint8_t rx_id)
+{
+  return receivers_arr[rx_id].end_of_frame_cycles;
+}
+
 void EXTI9_5_IRQHandler(void)
 {
-  port_system_systick_resume();
+  port_system_isr_wakeup();
   if (EXTI->PR & BIT_POS_TO_MASK(receivers_arr[IR_RX_0_ID].pin))
   {
     EXTI -> PR |= BIT_POS_TO_MASK(receivers_arr[IR_RX_0_ID].pin);
     _store_edge_tick(IR_RX_0_ID);
   }
 }
+
+void TIM3_IRQHandler(void)
+{
+  port_system_isr_wakeup();
+  if ((TIM3->SR & TIM_SR_CC1IF) && (TIM3->DIER & TIM_DIER_CC1IE))
+  {
+    TIM3 -> SR &= ~TIM_SR_CC1IF;
+    TIM3 -> DIER &= ~TIM_DIER_CC1IE;
+    receivers_arr[IR_RX_0_ID].end_of_frame_cycles = port_system_get_cycles();
+    receivers_arr[IR_RX_0_ID].end_of_frame = true;
+    port_system_deferred_pend();
+  }
+}
@@ -7,9 +7,9 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "port_system.h"
+#include "energy.h"
 
 /* Defines -------------------------------------------------------------------*/
-#define HSI_VALUE ((uint32_t)16000000) /*!< Value of the Internal oscillator in Hz */
 
 
 #define BASE_MODER_MASK 0x03UL
@@ -25,11 +25,56 @@
 #define EXTI_EMR_MASK (0x01 << pin)
 #define EXTI_IMR_MASK (0x01 << pin)
 
+#define RTC_WPR_KEY1 0xCAU    /*!< First key to unlock the write protection of the RTC registers */
+#define RTC_WPR_KEY2 0x53U    /*!< Second key to unlock the write protection of the RTC registers */
+#define RTC_WPR_LOCK 0xFFU    /*!< Any wrong key locks again the write protection of the RTC registers */
+#define RTC_TICKS_PER_MS (LSI_VALUE_HZ / 1000U) /*!< RTC ticks in a millisecond */
+#define US_PER_S 1000000ULL                     /*!< Microseconds in a second */
+#define DEFERRED_IRQ_PRIORITY 15U               /*!< Priority of the PendSV exception: the lowest, so that every ISR preempts the deferred work */
+
+_Static_assert(PORT_SYSTEM_TIMER_COUNTS_HZ(PORT_SYSTEM_PLL_HCLK_HZ, 1000U * TICK_FREQ_1KHZ) <= 0x1000000U, "The SysTick period does not fit in its 24-bit counter");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_HZ(PORT_SYSTEM_HSI_HCLK_HZ, 1000U * TICK_FREQ_1KHZ) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The SysTick period is not accurate with the HSI profile");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_HZ(PORT_SYSTEM_PLL_HCLK_HZ, 1000U * TICK_FREQ_1KHZ) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The SysTick period is not accurate with the PLL profile");
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Settings of a clock profile.
+ */
+typedef struct
+{
+  uint32_t hclk_hz;       /*!< Frequency of the core and the AHB bus */
+  uint32_t cfgr_ppre;     /*!< APB prescalers in the RCC_CFGR register */
+  uint32_t cfgr_sw;       /*!< Clock source in the RCC_CFGR register */
+  uint32_t cfgr_sws;      /*!< Clock source status in the RCC_CFGR register once switched */
+  uint8_t voltage_scale;  /*!< Output voltage of the main regulator */
+  uint8_t flash_latency;  /*!< Flash wait states */
+} port_system_clock_profile_t;
+
 /* GLOBAL VARIABLES */
 static volatile uint32_t msTicks = 0; /*!< Variable to store millisecond ticks. @warning **It must be declared volatile!** Just because it is modified in an ISR. **Add it to the definition** after *static*. */
+static volatile bool sleeping = false;        /*!< Flag to indicate that the system is in a low-power mode, set until the first ISR after the sleep */
+static volatile uint8_t sleep_mode = PORT_SYSTEM_SLEEP_WFI; /*!< Low-power mode of the last sleep */
+static volatile uint32_t sleep_start_ticks = 0; /*!< RTC ticks when the last sleep started */
+static volatile uint32_t slept_ticks = 0;     /*!< RTC ticks spent in the last sleep */
+static volatile bool wakeup_timestamped = false; /*!< Flag to indicate that the user button was pressed during the last sleep, so that its wake-up latency was measured */
+static volatile uint32_t wakeup_latency_ticks = 0; /*!< RTC ticks from the press of the user button to the first ISR after the last sleep */
+static uint32_t boot_us = 0;                  /*!< Microseconds since port_system_init() at the last change of clock */
+static uint32_t boot_cycles = 0;              /*!< Value of the cycle counter at the last change of clock */
+static uint32_t stop_rem_ticks = 0;           /*!< RTC ticks slept in STOP mode not yet added to the millisecond counter */
+static port_system_sleep_stats_t sleep_stats_arr[PORT_SYSTEM_SLEEP_MODES]; /*!< Residency and wake-up statistics of each low-power mode */
+static volatile uint8_t clock_profile = PORT_SYSTEM_CLOCK_HSI_16MHZ; /*!< Current clock profile. The system starts with the HSI */
+static port_system_clock_listener_t clock_listeners_arr[PORT_SYSTEM_CLOCK_MAX_LISTENERS]; /*!< Functions notified of the changes of clock */
+static uint8_t num_clock_listeners = 0; /*!< Number of functions registered in clock_listeners_arr */
+static port_system_deferred_handler_t deferred_handlers_arr[PORT_SYSTEM_DEFERRED_MAX_HANDLERS]; /*!< Functions run by the PendSV exception */
+static uint8_t num_deferred_handlers = 0; /*!< Number of functions registered in deferred_handlers_arr */
+
+static const port_system_clock_profile_t clock_profiles_arr[] = { /*!< Settings of each clock profile */
+    [PORT_SYSTEM_CLOCK_HSI_16MHZ] = {.hclk_hz = PORT_SYSTEM_HSI_HCLK_HZ, .cfgr_ppre = PORT_SYSTEM_HSI_CFGR_PPRE, .cfgr_sw = RCC_CFGR_SW_HSI, .cfgr_sws = RCC_CFGR_SWS_HSI, .voltage_scale = POWER_REGULATOR_VOLTAGE_SCALE3, .flash_latency = PORT_SYSTEM_FLASH_LATENCY(PORT_SYSTEM_HSI_HCLK_HZ)},
+    [PORT_SYSTEM_CLOCK_PLL_180MHZ] = {.hclk_hz = PORT_SYSTEM_PLL_HCLK_HZ, .cfgr_ppre = PORT_SYSTEM_PLL_CFGR_PPRE, .cfgr_sw = RCC_CFGR_SW_PLL, .cfgr_sws = RCC_CFGR_SWS_PLL, .voltage_scale = POWER_REGULATOR_VOLTAGE_SCALE1, .flash_latency = PORT_SYSTEM_FLASH_LATENCY(PORT_SYSTEM_PLL_HCLK_HZ)},
+};
 
 /* These variables are declared extern in CMSIS (system_stm32f4xx.h) */
-uint32_t SystemCoreClock = HSI_VALUE; /*!< Frequency of the System clock */
+uint32_t SystemCoreClock = HSI_VALUE_HZ; /*!< Frequency of the System clock */
 const uint8_t AHBPrescTable[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9}; /*!< Prescaler values for AHB bus */
 const uint8_t APBPrescTable[8] = {0, 0, 0, 0, 1, 2, 3, 4}; /*!< Prescaler values for APB bus */
 
@@ -62,9 +107,117 @@ void SystemInit(void)
 #endif                                                 /* USER_VECT_TAB_ADDRESS */
 }
 
+/**
+ * @brief Set the output voltage of the main regulator. It can only be changed while the PLL is off.
+ *
+ * @param voltage_scale #POWER_REGULATOR_VOLTAGE_SCALE1 or #POWER_REGULATOR_VOLTAGE_SCALE3
+ */
+static void _system_voltage_scale_set(uint8_t voltage_scale)
+{
+  PWR->CR &= ~PWR_CR_VOS; // Clean and set value
+  PWR->CR |= (PWR_CR_VOS & ((uint32_t)voltage_scale << PWR_CR_VOS_Pos));
+}
+
+/**
+ * @brief Lock the PLL from the HSI and enable the over-drive, while the system is still clocked by the HSI.
+ *
+ * The regulator output is raised first, since it cannot be changed with the PLL on. The flash latency is raised before the switch.
+ */
+static void _system_clock_pll_start(void)
+{
+  const port_system_clock_profile_t *p_profile = &clock_profiles_arr[PORT_SYSTEM_CLOCK_PLL_180MHZ];
+
+  _system_voltage_scale_set(p_profile->voltage_scale);
+  FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | p_profile->flash_latency;
+
+  RCC->PLLCFGR &= ~(RCC_PLLCFGR_PLLM | RCC_PLLCFGR_PLLN | RCC_PLLCFGR_PLLP | RCC_PLLCFGR_PLLSRC); /* PLLSRC = 0: HSI */
+  RCC->PLLCFGR |= (PORT_SYSTEM_PLLM << RCC_PLLCFGR_PLLM_Pos) | (PORT_SYSTEM_PLLN << RCC_PLLCFGR_PLLN_Pos) | (((PORT_SYSTEM_PLLP / 2U) - 1U) << RCC_PLLCFGR_PLLP_Pos);
+  RCC->CR |= RCC_CR_PLLON;
+
+  /* The over-drive is needed above 168 MHz. It is enabled while the PLL locks */
+  PWR->CR |= PWR_CR_ODEN;
+  while (!(PWR->CSR & PWR_CSR_ODRDY))
+  {
+  }
+  PWR->CR |= PWR_CR_ODSWEN;
+  while (!(PWR->CSR & PWR_CSR_ODSWRDY))
+  {
+  }
+  while (!(RCC->CR & RCC_CR_PLLRDY))
+  {
+  }
+  while (!(PWR->CSR & PWR_CSR_VOSRDY))
+  {
+  }
+}
+
+/**
+ * @brief Stop the PLL and the over-drive once the system is clocked by the HSI, and lower the regulator output and the flash latency.
+ */
+static void _system_clock_pll_stop(void)
+{
+  const port_system_clock_profile_t *p_profile = &clock_profiles_arr[PORT_SYSTEM_CLOCK_HSI_16MHZ];
+
+  PWR->CR &= ~(PWR_CR_ODSWEN | PWR_CR_ODEN);
+  RCC->CR &= ~RCC_CR_PLLON;
+  while (RCC->CR & RCC_CR_PLLRDY)
+  {
+  }
+  _system_voltage_scale_set(p_profile->voltage_scale);
+  FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | p_profile->flash_latency;
+}
+
+/**
+ * @brief Switch the clock source of the system and re-derive everything that depends on it. It must be called with the interrupts disabled.
+ *
+ * The APB prescalers are changed on the side of the switch where the buses never exceed their maximum. The SysTick cannot be loaded with the part of the millisecond already elapsed, so the current millisecond is rounded: the error is half a millisecond at most per switch.
+ *
+ * @param profile New clock profile
+ */
+static void _system_clock_switch(uint8_t profile)
+{
+  const port_system_clock_profile_t *p_profile = &clock_profiles_arr[profile];
+  uint32_t load = SysTick->LOAD;
+  uint32_t elapsed = load - SysTick->VAL;
+  uint32_t cycles = DWT->CYCCNT;
+
+  /* The time since the initialization is accumulated at the frequency of the clock it was spent at */
+  boot_us += (cycles - boot_cycles) / (SystemCoreClock / 1000000U);
+  boot_cycles = cycles;
+
+  if (p_profile->hclk_hz > SystemCoreClock)
+  {
+    RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | p_profile->cfgr_ppre;
+  }
+  RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | p_profile->cfgr_sw;
+  while ((RCC->CFGR & RCC_CFGR_SWS) != p_profile->cfgr_sws)
+  {
+  }
+  RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | p_profile->cfgr_ppre;
+
+  /* Update the SystemCoreClock global variable */
+  SystemCoreClock = p_profile->hclk_hz >> AHBPrescTable[(RCC->CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+  clock_profile = profile;
+
+  /* Keep the SysTick at 1 ms. Writing VAL restarts the count */
+  SysTick->LOAD = (SystemCoreClock / (1000U / TICK_FREQ_1KHZ)) - 1U;
+  SysTick->VAL = 0;
+  if (elapsed > load / 2U)
+  {
+    msTicks++;
+  }
+
+  for (uint8_t i = 0; i < num_clock_listeners; i++)
+  {
+    clock_listeners_arr[i](profile);
+  }
+}
+
 /**
  * @brief System Clock Configuration
  *
+ * The system is first clocked by the HSI at 16 MHz and then switched to #PORT_SYSTEM_CLOCK_PROFILE. The clock can be changed later with port_system_clock_set().
+ *
  * @attention This function should NOT be accesible from the outside to avoid configuration problems.
  * @note This function starts a system timer that generates a SysTick every 1 ms.
  * @retval None
@@ -73,11 +226,12 @@ void SystemInit(void)
 /*	System Clock Configuration. */
 static void system_clock_config(void)
 {
+  const port_system_clock_profile_t *p_profile = &clock_profiles_arr[PORT_SYSTEM_CLOCK_HSI_16MHZ];
+
   /** Configure the main internal regulator output voltage */
   /* Power controller (PWR) */
   /* Control the main internal voltage regulator output voltage to achieve a trade-off between performance and power consumption when the device does not operate at the maximum frequency */
-  PWR->CR &= ~PWR_CR_VOS; // Clean and set value
-  PWR->CR |= (PWR_CR_VOS & (POWER_REGULATOR_VOLTAGE_SCALE3 << PWR_CR_VOS_Pos));
+  _system_voltage_scale_set(p_profile->voltage_scale);
 
   /* Initializes the RCC Oscillators. */
   /* Adjusts the Internal High Speed oscillator (HSI) calibration value.*/
@@ -90,23 +244,264 @@ static void system_clock_config(void)
       must be correctly programmed according to the frequency of the CPU clock
       (HCLK) and the supply voltage of the device. */
 
-  /* Increasing the number of wait states because of higher CPU frequency */
-  FLASH->ACR = FLASH_ACR_LATENCY_2WS; /* Program the new number of wait states to the LATENCY bits in the FLASH_ACR register */
+  /* Program the new number of wait states to the LATENCY bits in the FLASH_ACR register. The caches and the prefetch are kept */
+  FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | p_profile->flash_latency;
 
   /* Change in clock source is performed in 16 clock cycles after writing to CFGR */
+  RCC->CFGR &= ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2);
+  RCC->CFGR |= p_profile->cfgr_ppre;
   RCC->CFGR &= ~RCC_CFGR_SW; // Clean and set value
-  RCC->CFGR |= (RCC_CFGR_SW & (RCC_CFGR_SW_HSI << RCC_CFGR_SW_Pos));
+  RCC->CFGR |= p_profile->cfgr_sw;
 
   /* Update the SystemCoreClock global variable */
-  SystemCoreClock = HSI_VALUE >> AHBPrescTable[(RCC->CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+  SystemCoreClock = p_profile->hclk_hz >> AHBPrescTable[(RCC->CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
+  clock_profile = PORT_SYSTEM_CLOCK_HSI_16MHZ;
 
   /* Configure the source of time base considering new system clocks settings */
   SysTick_Config(SystemCoreClock / (1000U / TICK_FREQ_1KHZ)); /* Set Systick to 1 ms */
+
+  port_system_clock_set(PORT_SYSTEM_CLOCK_PROFILE);
+}
+
+/*Switch the system clock to a profile.*/
+void port_system_clock_set(uint8_t profile)
+{
+  /* The deferred work may switch the clock too, so it is held off until the switch is complete */
+  uint32_t basepri = port_system_deferred_mask();
+
+  if (profile == clock_profile)
+  {
+    port_system_deferred_unmask(basepri);
+    return;
+  }
+
+  /* The PLL locks while the system keeps running from the HSI */
+  if (profile == PORT_SYSTEM_CLOCK_PLL_180MHZ)
+  {
+    _system_clock_pll_start();
+  }
+
+  __disable_irq();
+  _system_clock_switch(profile);
+  __enable_irq();
+
+  if (profile == PORT_SYSTEM_CLOCK_HSI_16MHZ)
+  {
+    _system_clock_pll_stop();
+  }
+  energy_set_periph(ENERGY_PERIPH_CLOCK_BOOST, profile == PORT_SYSTEM_CLOCK_BOOST, msTicks);
+  port_system_deferred_unmask(basepri);
+}
+
+/*Get the current clock profile.*/
+uint8_t port_system_clock_get(void)
+{
+  return clock_profile;
+}
+
+/*Get the frequency of the core in a profile.*/
+uint32_t port_system_clock_get_hz(uint8_t profile)
+{
+  return clock_profiles_arr[profile].hclk_hz;
+}
+
+/*Register a function to be notified of the changes of clock profile.*/
+void port_system_clock_add_listener(port_system_clock_listener_t listener)
+{
+  for (uint8_t i = 0; i < num_clock_listeners; i++)
+  {
+    if (clock_listeners_arr[i] == listener)
+    {
+      return;
+    }
+  }
+  if (num_clock_listeners < PORT_SYSTEM_CLOCK_MAX_LISTENERS)
+  {
+    clock_listeners_arr[num_clock_listeners++] = listener;
+  }
+}
+
+/*Register a function to be run by the PendSV exception.*/
+void port_system_deferred_add_handler(port_system_deferred_handler_t handler)
+{
+  for (uint8_t i = 0; i < num_deferred_handlers; i++)
+  {
+    if (deferred_handlers_arr[i] == handler)
+    {
+      return;
+    }
+  }
+  if (num_deferred_handlers < PORT_SYSTEM_DEFERRED_MAX_HANDLERS)
+  {
+    deferred_handlers_arr[num_deferred_handlers++] = handler;
+  }
+}
+
+/*Pend the PendSV exception. Pending it again before it runs has no further effect.*/
+void port_system_deferred_pend(void)
+{
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/*Mask the PendSV exception, the only one with the lowest priority, with BASEPRI.*/
+uint32_t port_system_deferred_mask(void)
+{
+  uint32_t basepri = __get_BASEPRI();
+
+  __set_BASEPRI(DEFERRED_IRQ_PRIORITY << (8U - __NVIC_PRIO_BITS));
+  return basepri;
+}
+
+/*Restore BASEPRI: a pending PendSV exception is taken as soon as it is unmasked.*/
+void port_system_deferred_unmask(uint32_t state)
+{
+  __set_BASEPRI(state);
+}
+
+/*Get the count of the cycle counter of the DWT.*/
+uint32_t port_system_get_cycles(void)
+{
+  return DWT->CYCCNT;
+}
+
+/*Get the microseconds since port_system_init(): the ones accumulated until the last change of clock, plus the cycles at the current clock.*/
+uint32_t port_system_get_boot_us(void)
+{
+  return boot_us + (DWT->CYCCNT - boot_cycles) / (SystemCoreClock / 1000000U);
+}
+
+/*Write binary data on a stimulus port of the ITM, as ITM_SendChar() does on port 0.*/
+void port_system_debug_write(uint8_t channel, const uint8_t *p_data, uint32_t len)
+{
+  if (!(CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) || !(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & BIT_POS_TO_MASK(channel)))
+  {
+    return;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    /* The FIFO of the port is full while it reads 0 */
+    while (ITM->PORT[channel].u32 == 0U)
+    {
+    }
+    ITM->PORT[channel].u8 = p_data[i];
+  }
+}
+
+/**
+ * @brief Configure the RTC as a low-power time base.
+ *
+ * The RTC is clocked by the LSI, that keeps running in STOP mode, so it is used to measure how long the system sleeps. The calendar counts seconds and the sub-seconds register counts LSI periods.
+ */
+static void _rtc_timebase_config(void)
+{
+  /* Enable the access to the backup domain and the LSI */
+  PWR->CR |= PWR_CR_DBP;
+  RCC->CSR |= RCC_CSR_LSION;
+  while (!(RCC->CSR & RCC_CSR_LSIRDY))
+  {
+  }
+
+  /* The clock source of the RTC can only be selected once after a backup domain reset */
+  if (!(RCC->BDCR & RCC_BDCR_RTCEN))
+  {
+    RCC->BDCR &= ~RCC_BDCR_RTCSEL;
+    RCC->BDCR |= RCC_BDCR_RTCSEL_1; /* LSI */
+    RCC->BDCR |= RCC_BDCR_RTCEN;
+  }
+
+  RTC->WPR = RTC_WPR_KEY1;
+  RTC->WPR = RTC_WPR_KEY2;
+  /* The time base only measures intervals, so the calendar of the backup domain is never set: it keeps the time across resets. The init mode, that stops it, is only entered to set the prescalers and the 24-hour format after a backup domain reset */
+  if ((RTC->PRER != RTC_PREDIV_S) || (RTC->CR & RTC_CR_FMT))
+  {
+    RTC->ISR |= RTC_ISR_INIT;
+    while (!(RTC->ISR & RTC_ISR_INITF))
+    {
+    }
+    RTC->PRER = RTC_PREDIV_S;                    /* Synchronous prescaler must be written first */
+    RTC->PRER |= (0U << RTC_PRER_PREDIV_A_Pos);  /* No asynchronous prescaler: one sub-second per LSI period */
+    RTC->CR &= ~RTC_CR_FMT;                      /* The ticks of a day wrap at 24 h */
+    RTC->ISR &= ~RTC_ISR_INIT;
+  }
+  RTC->CR |= RTC_CR_BYPSHAD; /* Read the counters directly, the shadow registers are not updated in STOP mode */
+  /* The user button is on PC13, the time-stamp input of the RTC: its press is timestamped even in STOP mode, to measure its wake-up latency. The pin is still read by the GPIO and the EXTI */
+  RTC->CR &= ~RTC_CR_TSE;
+  RTC->CR |= RTC_CR_TSEDGE; /* Falling edge: the button is active low. The edge must be selected with the time-stamp disabled */
+  RTC->CR |= RTC_CR_TSE;
+  RTC->WPR = RTC_WPR_LOCK;
+}
+
+/**
+ * @brief Convert the time and sub-second registers of the RTC to RTC ticks.
+ *
+ * @param tr Time register, in BCD
+ * @param ssr Sub-second register, counting down from #RTC_PREDIV_S
+ *
+ * @return Ticks since midnight, from 0 to #RTC_TICKS_PER_DAY - 1
+ */
+static uint32_t _rtc_ticks(uint32_t tr, uint32_t ssr)
+{
+  uint32_t seconds = ((tr >> RTC_TR_SU_Pos) & 0x0F) + 10 * ((tr >> RTC_TR_ST_Pos) & 0x07);
+  seconds += 60 * (((tr >> RTC_TR_MNU_Pos) & 0x0F) + 10 * ((tr >> RTC_TR_MNT_Pos) & 0x07));
+  seconds += 3600 * (((tr >> RTC_TR_HU_Pos) & 0x0F) + 10 * ((tr >> RTC_TR_HT_Pos) & 0x03));
+
+  return seconds * LSI_VALUE_HZ + (RTC_PREDIV_S - ssr);
+}
+
+/**
+ * @brief Read the time of the day from the RTC in RTC ticks.
+ *
+ * As the shadow registers are bypassed, the sub-seconds are read twice to ensure the time register has not changed in between.
+ *
+ * @return Ticks since midnight, from 0 to #RTC_TICKS_PER_DAY - 1
+ */
+static uint32_t _rtc_get_ticks(void)
+{
+  uint32_t ssr;
+  uint32_t tr;
+  do
+  {
+    ssr = RTC->SSR & RTC_SSR_SS;
+    tr = RTC->TR;
+  } while (ssr != (RTC->SSR & RTC_SSR_SS));
+
+  return _rtc_ticks(tr, ssr);
+}
+
+/**
+ * @brief Clear the time-stamp of the RTC, so that the next one is from the next press of the user button. The flags are not write protected.
+ */
+static void _rtc_timestamp_clear(void)
+{
+  RTC->ISR = ~(RTC_ISR_TSF | RTC_ISR_TSOVF | RTC_ISR_INIT) | (RTC->ISR & RTC_ISR_INIT);
+}
+
+/**
+ * @brief Read the time of the day from the RTC in RTC ticks, as #_rtc_get_ticks, at the last press of the user button. The time-stamp registers have the layout of the time and sub-second registers.
+ *
+ * @return Ticks since midnight, from 0 to #RTC_TICKS_PER_DAY - 1
+ */
+static uint32_t _rtc_get_timestamp_ticks(void)
+{
+  return _rtc_ticks(RTC->TSTR, RTC->TSSSR & RTC_TSSSR_SS);
+}
+
+/**
+ * @brief Enable the cycle counter of the DWT to measure short intervals. It stops in STOP mode, so the wake-up latency is measured with the RTC.
+ */
+static void _cycle_counter_config(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 /*	This function is based on the initialization of the HAL Library; it must be the first thing to be executed in the main program (before to call any other functions)*/
 size_t port_system_init()
 {
+  /* The cycle counter times the initialization from its start */
+  _cycle_counter_config();
+
   /* Reset of all peripherals, Initializes the Flash interface and the Systick. */
   /* Configure Flash prefetch, Instruction cache, Data cache */
   /* Instruction cache enable */
@@ -124,6 +519,7 @@ size_t port_system_init()
   /* Use systick as time base source and configure 1ms tick (default clock after Reset is HSI) */
   /* Configure the SysTick IRQ priority. It must be the highest (lower number: 0)*/
   NVIC_SetPriority(SysTick_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0U, 0U)); /* Tick interrupt priority */
+  NVIC_SetPriority(PendSV_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), DEFERRED_IRQ_PRIORITY, 0U)); /* Deferred work below every ISR */
 
   /* Init the low level hardware */
   /* Reset and clock control (RCC) */
@@ -135,6 +531,9 @@ size_t port_system_init()
   /* Configure the system clock */
   system_clock_config();
 
+  /* Time bases to measure the low-power modes */
+  _rtc_timebase_config();
+
   return 0;
 }
 
@@ -146,12 +545,126 @@ void port_system_power_stop()
  SCB->SCR &= ~((uint32_t)SCB_SCR_SLEEPDEEP_Msk); // Reset SLEEPDEEP bit of Cortex System Control Register
 }
 
+/**
+ * @brief Bookkeeping of the end of a sleep, done as soon as possible after the wake-up.
+ *
+ * The SysTick does not count in STOP mode, so the millisecond counter catches up with the time slept here, before the ISR that woke the system up timestamps anything.
+ *
+ * The cycle counter of the core stops in STOP mode too, so the wake-up latency is measured with the RTC: if the user button was pressed during the sleep, the RTC timestamped the press in hardware, and the latency runs from it to here. It includes the restart of the regulator, the flash and the HSI, and the entry to the ISR.
+ */
+static void _wakeup(void)
+{
+  uint32_t now_ticks = _rtc_get_ticks();
+
+  slept_ticks = (now_ticks + RTC_TICKS_PER_DAY - sleep_start_ticks) % RTC_TICKS_PER_DAY;
+  wakeup_timestamped = false;
+  if (RTC->ISR & RTC_ISR_TSF)
+  {
+    uint32_t press_ticks = (_rtc_get_timestamp_ticks() + RTC_TICKS_PER_DAY - sleep_start_ticks) % RTC_TICKS_PER_DAY;
+    if (press_ticks <= slept_ticks)
+    {
+      wakeup_latency_ticks = slept_ticks - press_ticks;
+      wakeup_timestamped = true;
+    }
+    _rtc_timestamp_clear();
+  }
+  if (sleep_mode != PORT_SYSTEM_SLEEP_WFI)
+  {
+    stop_rem_ticks += slept_ticks;
+    msTicks += stop_rem_ticks / RTC_TICKS_PER_MS;
+    stop_rem_ticks %= RTC_TICKS_PER_MS;
+  }
+  sleeping = false;
+}
+
+/*Enter STOP mode keeping the main regulator and the flash on. It consumes more than port_system_power_stop() but the wake-up is faster.*/
+static void _power_stop_fast(void)
+{
+  MODIFY_REG(PWR->CR, (PWR_CR_PDDS | PWR_CR_LPDS | PWR_CR_FPDS), 0);
+  SCB->SCR |= ((uint32_t)SCB_SCR_SLEEPDEEP_Msk);
+  __WFI();
+  SCB->SCR &= ~((uint32_t)SCB_SCR_SLEEPDEEP_Msk);
+}
+
 void port_system_sleep(void){
 
-  port_system_systick_suspend();
-  port_system_power_stop();
+  port_system_sleep_mode(PORT_SYSTEM_SLEEP_STOP);
 }	
 
+/*Enter the given low-power mode and measure how long the system stays there.*/
+void port_system_sleep_mode(uint8_t mode)
+{
+  port_system_sleep_stats_t *p_stats = &sleep_stats_arr[mode];
+
+  sleep_mode = mode;
+  _rtc_timestamp_clear();
+  sleep_start_ticks = _rtc_get_ticks();
+  sleeping = true;
+  if (mode == PORT_SYSTEM_SLEEP_WFI)
+  {
+    __WFI(); /* SysTick keeps running and wakes the core up in 1 ms at most */
+  }
+  else
+  {
+    /* The system wakes up from STOP clocked by the HSI, so it sleeps with the HSI profile and the timers already derived from it */
+    port_system_clock_set(PORT_SYSTEM_CLOCK_LOW);
+    port_system_systick_suspend();
+    if (mode == PORT_SYSTEM_SLEEP_STOP_FAST)
+    {
+      _power_stop_fast();
+    }
+    else
+    {
+      port_system_power_stop();
+    }
+    port_system_systick_resume();
+  }
+
+  /* The wake-up source may not be an ISR calling port_system_isr_wakeup(). The clock is not boosted again here: the caller does it if there is an event to process */
+  __disable_irq();
+  if (sleeping)
+  {
+    _wakeup();
+    energy_count_wakeup();
+  }
+  __enable_irq();
+
+  /* The energy states of the low-power modes have the same index as the modes */
+  energy_add_state_time(mode, (uint32_t)((slept_ticks * US_PER_S) / LSI_VALUE_HZ));
+
+  p_stats->entries++;
+  p_stats->residency_rem_ticks += slept_ticks;
+  p_stats->residency_ms += p_stats->residency_rem_ticks / RTC_TICKS_PER_MS;
+  p_stats->residency_rem_ticks %= RTC_TICKS_PER_MS;
+  if (wakeup_timestamped)
+  {
+    uint32_t latency_us = (uint32_t)((wakeup_latency_ticks * US_PER_S) / LSI_VALUE_HZ);
+    p_stats->button_wakeups++;
+    p_stats->button_latency_us = latency_us;
+    if (latency_us > p_stats->button_latency_max_us)
+    {
+      p_stats->button_latency_max_us = latency_us;
+    }
+  }
+}
+
+/*Resume the SysTick and timestamp the wake-up if the system was sleeping.*/
+void port_system_isr_wakeup(void)
+{
+  if (sleeping)
+  {
+    _wakeup();
+    energy_count_wakeup();
+  }
+  port_system_systick_resume();
+}
+
+/*Get the residency and wake-up statistics of a low-power mode.*/
+const port_system_sleep_stats_t *port_system_get_sleep_stats(uint8_t mode)
+{
+  return &sleep_stats_arr[mode];
+}
+
 
 
 
@@ -431,3 +944,12 @@ void SysTick_Handler(void)
 {
   msTicks ++; 
 }
+
+/*This function handles the PendSV exception, that runs the deferred work with the lowest priority.*/
+void PendSV_Handler(void)
+{
+  for (uint8_t i = 0; i < num_deferred_handlers; i++)
+  {
+    deferred_handlers_arr[i]();
+  }
+}
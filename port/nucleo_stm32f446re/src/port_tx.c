@@ -10,26 +10,63 @@
 #include "port_tx.h"
 #include "fsm_tx.h"
 #include "port_system.h"
+#include "energy.h"
 
 /* Defines --------------------------------------------------------------------*/
 #define ALT_FUNC1_TIM2  0x01U /*!< TIM2 Alternate Function mapping */ 
+#define ALT_FUNC2_TIM4  0x02U /*!< TIM4 Alternate Function mapping */
+#define TIM_CCER_CCXE_ALL (TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC3E | TIM_CCER_CC4E) /*!< Outputs of the four channels of a timer */
+#define SYMBOL_TIMER_COUNTS(apb2_timer_hz) PORT_SYSTEM_TIMER_COUNTS_NS(apb2_timer_hz, NEC_TX_TIMER_TICK_BASE_NS) /*!< Counts of TIM1 in a symbol tick, with no prescaler */
+#define PWM_TIMER_COUNTS(apb1_timer_hz) PORT_SYSTEM_TIMER_COUNTS_HZ(apb1_timer_hz, NEC_PWM_FREQ_HZ)                /*!< Counts of TIM2 in a period of the carrier, with no prescaler */
+#define PWM_TIMER_PULSE_COUNTS(apb1_timer_hz) ((PWM_TIMER_COUNTS(apb1_timer_hz) * NEC_PWM_DC_PERCENT + 50U) / 100U) /*!< Counts of TIM2 with the carrier on */
+
+_Static_assert(SYMBOL_TIMER_COUNTS(PORT_SYSTEM_PLL_APB2_TIMER_HZ) - 1U <= 0xFFFFU, "The symbol tick does not fit in the 16-bit TIM1 without prescaler");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_NS(PORT_SYSTEM_HSI_APB2_TIMER_HZ, NEC_TX_TIMER_TICK_BASE_NS) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The symbol tick is not accurate with the HSI profile");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_NS(PORT_SYSTEM_PLL_APB2_TIMER_HZ, NEC_TX_TIMER_TICK_BASE_NS) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The symbol tick is not accurate with the PLL profile");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_HZ(PORT_SYSTEM_HSI_APB1_TIMER_HZ, NEC_PWM_FREQ_HZ) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The carrier frequency is not accurate with the HSI profile");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_HZ(PORT_SYSTEM_PLL_APB1_TIMER_HZ, NEC_PWM_FREQ_HZ) <= PORT_SYSTEM_TIMER_MAX_ERROR_PPM, "The carrier frequency is not accurate with the PLL profile");
+_Static_assert(PWM_TIMER_PULSE_COUNTS(PORT_SYSTEM_HSI_APB1_TIMER_HZ) > 0U, "The duty cycle of the carrier cannot be represented with the HSI profile");
 
 /* IMPORTANT
 The timer symbol is the same for all the TX, so it is not in the structure of TX. It has been decided to be the TIM1. It is like a systick but faster.
+Each TX has its own channel of a PWM timer of APB1. The transmitters on the same timer share its carrier, and only the output of their channel is switched, so the counter runs while any of them is on.
 */
 
 /* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Values of the timers of the transmitters in a clock profile.
+ */
+typedef struct
+{
+    uint16_t symbol_counts; /*!< Counts of TIM1 in a symbol tick */
+    uint16_t pwm_counts;    /*!< Counts of TIM2 in a period of the carrier */
+    uint16_t pulse_counts;  /*!< Counts of TIM2 with the carrier on */
+} port_tx_timer_values_t;
+
+
 typedef struct 
 {
     GPIO_TypeDef *p_port; /*GPIO where the infrared transmitter is connected*/
     uint8_t pin; /*Pin/line where the infrared transmitter is connected*/
     uint8_t alt_func; /*Alternate function value according to the Alternate function table of the datasheet*/
+    TIM_TypeDef *p_timer; /*PWM timer of the carrier, on APB1*/
+    uint32_t timer_en; /*Bit of the PWM timer in RCC->APB1ENR*/
+    uint8_t channel; /*Channel of the PWM timer, 1 to 4*/
+    bool pwm_on; /*Flag to indicate that the PWM is on*/
+    uint32_t pwm_on_tick; /*Symbol tick when the PWM was switched on, to account its on-time*/
 }port_tx_hw_t;
 
 /* Global variables ------------------------------------------------------------*/
 static volatile uint32_t symbol_tick; /*Variable to store the count of ticks of the symbol timer*/
 static port_tx_hw_t transmitters_arr[] = { /*Array of elements that represents the HW characteristics of the infrared transmitters.*/
-     [IR_TX_0_ID] = {.p_port = IR_TX_0_GPIO, .pin = IR_TX_0_PIN, .alt_func = ALT_FUNC1_TIM2},
+     [IR_TX_0_ID] = {.p_port = IR_TX_0_GPIO, .pin = IR_TX_0_PIN, .alt_func = ALT_FUNC1_TIM2, .p_timer = TIM2, .timer_en = RCC_APB1ENR_TIM2EN, .channel = 3},
+     [IR_TX_1_ID] = {.p_port = IR_TX_1_GPIO, .pin = IR_TX_1_PIN, .alt_func = ALT_FUNC1_TIM2, .p_timer = TIM2, .timer_en = RCC_APB1ENR_TIM2EN, .channel = 1},
+     [IR_TX_2_ID] = {.p_port = IR_TX_2_GPIO, .pin = IR_TX_2_PIN, .alt_func = ALT_FUNC1_TIM2, .p_timer = TIM2, .timer_en = RCC_APB1ENR_TIM2EN, .channel = 2},
+     [IR_TX_3_ID] = {.p_port = IR_TX_3_GPIO, .pin = IR_TX_3_PIN, .alt_func = ALT_FUNC2_TIM4, .p_timer = TIM4, .timer_en = RCC_APB1ENR_TIM4EN, .channel = 3},
+};
+static const port_tx_timer_values_t timer_values_arr[] = { /*Values of the timers in each clock profile, derived at compile time*/
+     [PORT_SYSTEM_CLOCK_HSI_16MHZ] = {.symbol_counts = SYMBOL_TIMER_COUNTS(PORT_SYSTEM_HSI_APB2_TIMER_HZ), .pwm_counts = PWM_TIMER_COUNTS(PORT_SYSTEM_HSI_APB1_TIMER_HZ), .pulse_counts = PWM_TIMER_PULSE_COUNTS(PORT_SYSTEM_HSI_APB1_TIMER_HZ)},
+     [PORT_SYSTEM_CLOCK_PLL_180MHZ] = {.symbol_counts = SYMBOL_TIMER_COUNTS(PORT_SYSTEM_PLL_APB2_TIMER_HZ), .pwm_counts = PWM_TIMER_COUNTS(PORT_SYSTEM_PLL_APB1_TIMER_HZ), .pulse_counts = PWM_TIMER_PULSE_COUNTS(PORT_SYSTEM_PLL_APB1_TIMER_HZ)},
 };
 /* Infrared transmitter private functions */
 
@@ -39,7 +76,7 @@ static void _timer_symbol_setup()
 
   RCC->APB2ENR |= RCC_APB2ENR_TIM1EN;
   TIM1 -> CNT = 0;
-  TIM1 -> ARR = 899;   /*  (16*NEC_TX_TIMER_TICK_BASE_US) - 1  */
+  TIM1 -> ARR = timer_values_arr[port_system_clock_get()].symbol_counts - 1U;
   TIM1 -> PSC = 0;
   TIM1 -> EGR = TIM_EGR_UG;
   TIM1 -> SR &= ~TIM_SR_UIF;
@@ -50,24 +87,58 @@ static void _timer_symbol_setup()
   NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);                                                          /* Enable interrupt */
 }
 
-/*Configure the PWM timer. This timer configures the PWM for the NEC protocol.*/
+/*Capture/compare register of the channel of a transmitter.*/
+static volatile uint32_t *_timer_pwm_ccr(uint8_t tx_id)
+{
+  return &transmitters_arr[tx_id].p_timer->CCR1 + (transmitters_arr[tx_id].channel - 1U);
+}
+
+/*Output enable bit of the channel of a transmitter in the CCER register.*/
+static uint32_t _timer_pwm_ccer(uint8_t tx_id)
+{
+  return TIM_CCER_CC1E << (4U * (transmitters_arr[tx_id].channel - 1U));
+}
+
+/*Configure the PWM timer. This timer configures the PWM for the NEC protocol. The channel of the transmitter is set in PWM mode 1 with preload, but its output is left disabled.*/
 static void _timer_pwm_setup(uint32_t tx_id)
 {
+  TIM_TypeDef *p_timer = transmitters_arr[tx_id].p_timer;
+  uint8_t channel = transmitters_arr[tx_id].channel;
+  volatile uint32_t *p_ccmr = (channel <= 2U) ? &p_timer->CCMR1 : &p_timer->CCMR2;
+  uint32_t shift = 8U * ((channel - 1U) % 2U);
+
+  RCC->APB1ENR |= transmitters_arr[tx_id].timer_en;
+
+  /* The carrier of a timer shared with a transmitter that is on is not restarted */
+  if((p_timer->CCER & TIM_CCER_CCXE_ALL) == 0U){
+    p_timer -> CNT = 0;
+    p_timer -> ARR = timer_values_arr[port_system_clock_get()].pwm_counts - 1U;
+    p_timer -> PSC = 0;
+    p_timer -> EGR = TIM_EGR_UG;
+  }
+  p_timer -> CCER &= ~_timer_pwm_ccer(tx_id);
+  *p_ccmr |= (0x0060U | TIM_CCMR1_OC1PE) << shift;
+  *_timer_pwm_ccr(tx_id) = timer_values_arr[port_system_clock_get()].pulse_counts;
+}
 
-  if(tx_id == IR_TX_0_ID){
+/*Re-derive the timers after a change of the system clock. The count of the symbol timer is scaled so that the current symbol keeps its length. The new duty cycle of the carrier is loaded at the next period*/
+static void _timer_clock_changed(uint8_t profile)
+{
+  const port_tx_timer_values_t *p_values = &timer_values_arr[profile];
+  uint32_t old_counts = TIM1->ARR + 1U;
 
-   RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+  TIM1 -> ARR = p_values->symbol_counts - 1U;
+  TIM1 -> CNT = (TIM1->CNT * p_values->symbol_counts) / old_counts;
 
-   TIM2 -> CNT = 0;
-   TIM2 -> ARR = 420;  /*    (16000000 Hz/NEC_PWM_FREQ_HZ)-1     */
-   TIM2 -> PSC = 0;
-   TIM2 -> EGR = TIM_EGR_UG;
-   TIM2 -> CCER &= ~TIM_CCER_CC3E;
-   TIM2 -> CCMR2 |= 0x0060;
-   TIM2 -> CCMR2 |= TIM_CCMR2_OC3PE ;
-   TIM2 -> CCR3 = 147; /*  (ARR + 1)*NEC_PWM_DC    */
-  } 
+  for(uint8_t tx_id = 0; tx_id < sizeof(transmitters_arr) / sizeof(transmitters_arr[0]); tx_id++){
+    TIM_TypeDef *p_timer = transmitters_arr[tx_id].p_timer;
 
+    p_timer -> ARR = p_values->pwm_counts - 1U;
+    *_timer_pwm_ccr(tx_id) = p_values->pulse_counts;
+    if(p_timer -> CNT >= p_values->pwm_counts){
+      p_timer -> CNT = 0;
+    }
+  }
 }
 
 /* Public functions */
@@ -79,25 +150,33 @@ void port_tx_init(uint8_t tx_id, bool status)
   port_system_gpio_config_alternate(transmitters_arr[tx_id].p_port, transmitters_arr[tx_id].pin, transmitters_arr[tx_id].alt_func);
   _timer_symbol_setup();
   _timer_pwm_setup(tx_id);
+  port_system_clock_add_listener(_timer_clock_changed);
   port_tx_pwm_timer_set(tx_id, status);	
 }
 
-/* In order to make the academic effort of configuring the PWM, the values: timer, channel and masks are hardcoded and this function is not generic for any timer/channel. It is not the best way, but it is as it. */
-
 /*	Set the PWM ON or OFF*/
 void port_tx_pwm_timer_set(uint8_t tx_id, bool status)
 {
- if(tx_id == IR_TX_0_ID){
-  if(status == true){
-    TIM2 -> CCER |= TIM_CCER_CC3E;
-    TIM2 -> CR1 |= TIM_CR1_CEN;
-  }
-
-  else{
-    TIM2 -> CCER &= ~TIM_CCER_CC3E;
-    TIM2 -> CR1 &= ~TIM_CR1_CEN;
-  }
-  }
+ if(status == true && transmitters_arr[tx_id].pwm_on == false){
+  transmitters_arr[tx_id].pwm_on_tick = symbol_tick;
+ }
+ else if(status == false && transmitters_arr[tx_id].pwm_on == true){
+  energy_add_periph_time(ENERGY_PERIPH_TX_PWM, (uint32_t)(((uint64_t)(symbol_tick - transmitters_arr[tx_id].pwm_on_tick) * NEC_TX_TIMER_TICK_BASE_NS) / 1000U));
+ }
+ transmitters_arr[tx_id].pwm_on = status;
+
+ TIM_TypeDef *p_timer = transmitters_arr[tx_id].p_timer;
+ if(status == true){
+   p_timer -> CCER |= _timer_pwm_ccer(tx_id);
+   p_timer -> CR1 |= TIM_CR1_CEN;
+ }
+ else{
+   p_timer -> CCER &= ~_timer_pwm_ccer(tx_id);
+   /* The carrier is stopped with the last transmitter of the timer */
+   if((p_timer -> CCER & TIM_CCER_CCXE_ALL) == 0U){
+     p_timer -> CR1 &= ~TIM_CR1_CEN;
+   }
+ }
 }
 
 /*	Start the symbol timer and reset the count of ticks.*/
@@ -0,0 +1,270 @@
+/**
+ * @file port_uart.c
+ * @brief Portable functions of the serial links to a host, driven by DMA.
+ * @author Alvaro Rodriguez Gabaldon
+ * @author Miguel Lobo Benito
+ * @date fecha
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "port_uart.h"
+#include "port_system.h"
+
+/* Defines --------------------------------------------------------------------*/
+#define ALT_FUNC7_USART2 0x07U /*!< USART1-USART3 Alternate Function mapping */
+#define DMA_CHANNEL_USART2 4U  /*!< Channel of DMA1 of the requests of USART2, in streams 5 (RX) and 6 (TX) */
+#define PORT_UART_MAX_ERROR_PPM 10000U /*!< Maximum error of the baud rate. Both ends of an 8N1 link tolerate about 2 % */
+#define HSI_PCLK1_HZ (PORT_SYSTEM_HSI_HCLK_HZ / PORT_SYSTEM_HSI_APB1_DIV) /*!< HSI profile: clock of USART2 */
+#define PLL_PCLK1_HZ (PORT_SYSTEM_PLL_HCLK_HZ / PORT_SYSTEM_PLL_APB1_DIV) /*!< PLL profile: clock of USART2 */
+#define UART_BRR(pclk_hz) PORT_SYSTEM_TIMER_COUNTS_HZ(pclk_hz, PORT_UART_BAUD_RATE) /*!< Value of USART_BRR with oversampling by 16: the mantissa and the fraction are one fixed-point divider */
+
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_HZ(HSI_PCLK1_HZ, PORT_UART_BAUD_RATE) <= PORT_UART_MAX_ERROR_PPM, "The baud rate is not accurate with the HSI profile");
+_Static_assert(PORT_SYSTEM_TIMER_ERROR_PPM_HZ(PLL_PCLK1_HZ, PORT_UART_BAUD_RATE) <= PORT_UART_MAX_ERROR_PPM, "The baud rate is not accurate with the PLL profile");
+_Static_assert(PORT_UART_RX_BUFFER_SIZE <= 0xFFFFU && PORT_UART_TX_BUFFER_SIZE <= 0xFFFFU, "The buffers do not fit in the 16-bit counter of a DMA transfer");
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Structure to define the HW dependencies of a serial link.
+ */
+typedef struct
+{
+  USART_TypeDef *p_usart;         /*!< USART of the link, on APB1 */
+  DMA_Stream_TypeDef *p_rx_dma;   /*!< Stream of DMA1 of the reception */
+  DMA_Stream_TypeDef *p_tx_dma;   /*!< Stream of DMA1 of the transmission */
+  uint8_t rx_buffer[PORT_UART_RX_BUFFER_SIZE]; /*!< Circular buffer written by the DMA of reception */
+  uint16_t rx_read_idx;           /*!< Index of the next byte to read in rx_buffer */
+  uint8_t tx_buffer[PORT_UART_TX_BUFFER_SIZE]; /*!< Ring of the bytes to send */
+  volatile uint16_t tx_head;      /*!< Index of the next byte queued in tx_buffer. Only written by the main loop */
+  volatile uint16_t tx_tail;      /*!< Index of the first byte not sent yet. Only written by the ISR of the DMA of transmission */
+  volatile uint16_t tx_dma_len;   /*!< Bytes of the DMA transfer in progress. 0 if there is none */
+  volatile bool woken;            /*!< Flag to indicate that the falling edge of the RX pin has woken the system up */
+} port_uart_hw_t;
+
+/* Global variables ------------------------------------------------------------*/
+/**
+ * @brief Array of elements that represents the HW characteristics of the serial links.
+ */
+static port_uart_hw_t uarts_arr[] = {
+    [UART_0_ID] = {.p_usart = USART2, .p_rx_dma = DMA1_Stream5, .p_tx_dma = DMA1_Stream6},
+};
+
+/**
+ * @brief Value of USART_BRR in each clock profile, derived at compile time.
+ */
+static const uint16_t uart_brr_arr[] = {
+    [PORT_SYSTEM_CLOCK_HSI_16MHZ] = UART_BRR(HSI_PCLK1_HZ),
+    [PORT_SYSTEM_CLOCK_PLL_180MHZ] = UART_BRR(PLL_PCLK1_HZ),
+};
+
+/* Serial link private functions */
+
+/*Start the DMA transfer of the bytes of the ring up to its end or its head, if there is none in progress. Called by the main loop with the interrupt of the stream masked, or by the ISR.*/
+static void _tx_kick(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  uint16_t head = p_uart->tx_head;
+  uint16_t tail = p_uart->tx_tail;
+
+  if (p_uart->tx_dma_len != 0 || head == tail)
+  {
+    return;
+  }
+  /* The ring is sent in two transfers when it wraps */
+  p_uart->tx_dma_len = (head > tail) ? (uint16_t)(head - tail) : (uint16_t)(PORT_UART_TX_BUFFER_SIZE - tail);
+  DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+  p_uart->p_tx_dma->M0AR = (uint32_t)(uintptr_t)&p_uart->tx_buffer[tail];
+  p_uart->p_tx_dma->NDTR = p_uart->tx_dma_len;
+  p_uart->p_tx_dma->CR = (DMA_CHANNEL_USART2 << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_EN;
+}
+
+/*Re-derive the baud rate after a change of the system clock. A byte being shifted at that moment may be corrupted: the checksums of the protocol on top of the link detect it.*/
+static void _uart_clock_changed(uint8_t profile)
+{
+  for (uint8_t uart_id = 0; uart_id < sizeof(uarts_arr) / sizeof(uarts_arr[0]); uart_id++)
+  {
+    uarts_arr[uart_id].p_usart->BRR = uart_brr_arr[profile];
+  }
+}
+
+/* Public functions */
+
+/*Configure a serial link and start the reception.*/
+void port_uart_init(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+
+  RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+  RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+  port_system_gpio_config(UART_0_GPIO, UART_0_TX_PIN, GPIO_MODE_ALTERNATE, GPIO_PUPDR_NOPULL);
+  port_system_gpio_config_alternate(UART_0_GPIO, UART_0_TX_PIN, ALT_FUNC7_USART2);
+  port_system_gpio_config(UART_0_GPIO, UART_0_RX_PIN, GPIO_MODE_ALTERNATE, GPIO_PUPDR_PUP);
+  port_system_gpio_config_alternate(UART_0_GPIO, UART_0_RX_PIN, ALT_FUNC7_USART2);
+
+  p_uart->rx_read_idx = 0;
+  p_uart->tx_head = 0;
+  p_uart->tx_tail = 0;
+  p_uart->tx_dma_len = 0;
+  p_uart->woken = false;
+
+  /* Wake-up from STOP: the start bit of a byte is a falling edge on the RX pin, seen by the EXTI in the alternate mode too. It is only unmasked by port_uart_arm_wakeup() */
+  port_system_gpio_config_exti(UART_0_GPIO, UART_0_RX_PIN, TRIGGER_FALLING_EDGE);
+  EXTI->IMR &= ~BIT_POS_TO_MASK(UART_0_RX_PIN);
+  EXTI->PR = BIT_POS_TO_MASK(UART_0_RX_PIN);
+  port_system_gpio_exti_enable(UART_0_RX_PIN, 3, 0);
+
+  /* Reception: circular transfer from the data register, that never stops */
+  p_uart->p_rx_dma->CR = 0;
+  DMA1->HIFCR = DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5;
+  p_uart->p_rx_dma->PAR = (uint32_t)(uintptr_t)&p_uart->p_usart->DR;
+  p_uart->p_rx_dma->M0AR = (uint32_t)(uintptr_t)p_uart->rx_buffer;
+  p_uart->p_rx_dma->NDTR = PORT_UART_RX_BUFFER_SIZE;
+  p_uart->p_rx_dma->CR = (DMA_CHANNEL_USART2 << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_EN;
+
+  /* Transmission: the transfers are started by _tx_kick() */
+  p_uart->p_tx_dma->CR = 0;
+  p_uart->p_tx_dma->PAR = (uint32_t)(uintptr_t)&p_uart->p_usart->DR;
+
+  p_uart->p_usart->BRR = uart_brr_arr[port_system_clock_get()];
+  p_uart->p_usart->CR3 = USART_CR3_DMAR | USART_CR3_DMAT;
+  p_uart->p_usart->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
+  port_system_clock_add_listener(_uart_clock_changed);
+
+  /* The link has the lowest priority: the DMA does not need the CPU to keep up */
+  NVIC_SetPriority(USART2_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 3, 0));
+  NVIC_SetPriority(DMA1_Stream5_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 3, 0));
+  NVIC_SetPriority(DMA1_Stream6_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 3, 0));
+  NVIC_EnableIRQ(USART2_IRQn);
+  NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+  NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+}
+
+/*Arm the falling edge of the RX pin as a wake-up source.*/
+void port_uart_arm_wakeup(uint8_t uart_id)
+{
+  (void)uart_id;
+  EXTI->PR = BIT_POS_TO_MASK(UART_0_RX_PIN);
+  EXTI->IMR |= BIT_POS_TO_MASK(UART_0_RX_PIN);
+}
+
+/*Check if the RX pin has woken the system up since the last call.*/
+bool port_uart_check_wakeup(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  bool woken = p_uart->woken;
+
+  p_uart->woken = false;
+  return woken;
+}
+
+/*Read the bytes received and not read yet.*/
+uint32_t port_uart_read(uint8_t uart_id, uint8_t *p_data, uint32_t max_len)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  /* The DMA counts down the bytes left to the end of the buffer */
+  uint16_t write_idx = PORT_UART_RX_BUFFER_SIZE - p_uart->p_rx_dma->NDTR;
+  uint32_t len = 0;
+
+  if (write_idx == PORT_UART_RX_BUFFER_SIZE)
+  {
+    write_idx = 0;
+  }
+  while (p_uart->rx_read_idx != write_idx && len < max_len)
+  {
+    p_data[len++] = p_uart->rx_buffer[p_uart->rx_read_idx++];
+    if (p_uart->rx_read_idx == PORT_UART_RX_BUFFER_SIZE)
+    {
+      p_uart->rx_read_idx = 0;
+    }
+  }
+  return len;
+}
+
+/*Return the number of bytes received and not read yet.*/
+uint32_t port_uart_get_rx_count(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  uint16_t write_idx = (PORT_UART_RX_BUFFER_SIZE - p_uart->p_rx_dma->NDTR) % PORT_UART_RX_BUFFER_SIZE;
+
+  return (write_idx + PORT_UART_RX_BUFFER_SIZE - p_uart->rx_read_idx) % PORT_UART_RX_BUFFER_SIZE;
+}
+
+/*Queue bytes to send.*/
+bool port_uart_write(uint8_t uart_id, const uint8_t *p_data, uint32_t len)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  uint16_t head = p_uart->tx_head;
+
+  if (len > port_uart_get_tx_free(uart_id))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    p_uart->tx_buffer[head++] = p_data[i];
+    if (head == PORT_UART_TX_BUFFER_SIZE)
+    {
+      head = 0;
+    }
+  }
+  p_uart->tx_head = head;
+
+  /* The ISR of the stream may start the next transfer at the same time */
+  NVIC_DisableIRQ(DMA1_Stream6_IRQn);
+  _tx_kick(uart_id);
+  NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+  return true;
+}
+
+/*Return the room in the ring of the transmission. One byte is kept free to tell a full ring from an empty one.*/
+uint32_t port_uart_get_tx_free(uint8_t uart_id)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[uart_id];
+  uint16_t used = (p_uart->tx_head + PORT_UART_TX_BUFFER_SIZE - p_uart->tx_tail) % PORT_UART_TX_BUFFER_SIZE;
+
+  return PORT_UART_TX_BUFFER_SIZE - 1U - used;
+}
+
+//------------------------------------------------------
+// INTERRUPT SERVICE ROUTINES
+//------------------------------------------------------
+
+/*A byte of the host starts on the RX pin: the system wakes up and the EXTI is disarmed, so that the rest of the bytes are not interrupted.*/
+void EXTI3_IRQHandler(void)
+{
+  port_system_isr_wakeup();
+  EXTI->IMR &= ~BIT_POS_TO_MASK(UART_0_RX_PIN);
+  EXTI->PR = BIT_POS_TO_MASK(UART_0_RX_PIN);
+  uarts_arr[UART_0_ID].woken = true;
+}
+
+/*The line is idle after a burst of bytes: wake the system up to read them.*/
+void USART2_IRQHandler(void)
+{
+  port_system_isr_wakeup();
+  if (USART2->SR & USART_SR_IDLE)
+  {
+    /* The flag is cleared by reading the status and then the data register. The byte read was already taken by the DMA */
+    (void)USART2->DR;
+  }
+}
+
+/*Half or all the buffer of the reception has been written: wake the system up, so that a long burst is read before it wraps.*/
+void DMA1_Stream5_IRQHandler(void)
+{
+  port_system_isr_wakeup();
+  DMA1->HIFCR = DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5;
+}
+
+/*A transfer of the transmission has ended: release its bytes and start the next one.*/
+void DMA1_Stream6_IRQHandler(void)
+{
+  port_uart_hw_t *p_uart = &uarts_arr[UART_0_ID];
+
+  if (DMA1->HISR & DMA_HISR_TCIF6)
+  {
+    DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+    p_uart->tx_tail = (p_uart->tx_tail + p_uart->tx_dma_len) % PORT_UART_TX_BUFFER_SIZE;
+    p_uart->tx_dma_len = 0;
+    _tx_kick(UART_0_ID);
+  }
+}
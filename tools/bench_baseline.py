@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Baseline of the benchmarks of the host port, from several runs of `bench`.
+
+A single run is not a baseline: the time of a benchmark moves from one run to
+the next with the load of the machine and the placement of the process, by
+more than the samples of a run spread. Each benchmark of the baseline takes
+the median of its time in all the runs, and as noise the largest of the
+median noise of the runs and the median absolute deviation of the runs, in
+percent. `bench` adds that noise to the threshold of the benchmark.
+
+The baseline is written to the standard output, one benchmark per line, in
+the format of `bench`. Usage:
+
+    bench_baseline.py RESULT.json...
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+
+def merge(runs):
+    """Median time, noise and allocations of every benchmark of the runs."""
+    merged = []
+    for first in runs[0]['benchmarks']:
+        name = first['name']
+        results = [b for run in runs for b in run['benchmarks'] if b['name'] == name]
+        times = [b['ns_per_op'] for b in results]
+        median = statistics.median(times)
+        spread = statistics.median(abs(t - median) for t in times)
+        noise = max(statistics.median(b['noise_pct'] for b in results), 100.0 * spread / median)
+        merged.append({'name': name,
+                       'ns_per_op': median,
+                       'noise_pct': noise,
+                       'allocs_per_op': max(b['allocs_per_op'] for b in results),
+                       'runs': len(results)})
+    return merged
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('results', nargs='+', help='output of a run of bench')
+    args = parser.parse_args()
+
+    runs = []
+    for path in args.results:
+        with open(path, encoding='utf-8') as f:
+            runs.append(json.load(f))
+    merged = merge(runs)
+
+    out = sys.stdout
+    out.write('{\n  "version": 1,\n  "runs": %d,\n  "benchmarks": [\n' % len(runs))
+    for i, b in enumerate(merged):
+        out.write('    {"name": "%s", "ns_per_op": %.2f, "noise_pct": %.1f, "allocs_per_op": %.3f, "runs": %d}%s\n'
+                  % (b['name'], b['ns_per_op'], b['noise_pct'], b['allocs_per_op'], b['runs'],
+                     '' if i == len(merged) - 1 else ','))
+    out.write('  ]\n}\n')
+
+
+if __name__ == '__main__':
+    main()
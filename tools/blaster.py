@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+"""Client of the infrared blaster bridge of `fsm_bridge.h`.
+
+The board is driven over the virtual COM port of the ST-LINK, or over the
+pseudo-terminal of the stand-in of the host port (`make blaster`). Every
+packet, in both directions, is:
+
+    SYNC 0xA5, type (u8), sequence (u8), length of the payload (u8), payload, checksum (u8)
+
+where the checksum makes the sum of the bytes from the type on 0 modulo 256.
+Every packet is sent after a preamble of 0xFF bytes that wakes the board up
+from STOP, and a command whose response does not arrive is sent again with
+the same sequence, which the board answers without executing it twice.
+Commands are answered with the type 0x80 | command and the same sequence;
+the events (frames received and commands started) are printed as they come.
+Only the standard library is used, so the link is set up with termios. Usage:
+
+    blaster.py PORT send [--mask M] CODE...
+    blaster.py PORT raw [--mask M] US...
+    blaster.py PORT hold [--mask M] [--ms MS] CODE
+    blaster.py PORT stop
+    blaster.py PORT macro [--mask M] CODE:DELAY_MS[:REPEATS]...
+    blaster.py PORT telemetry
+    blaster.py PORT listen [--seconds S]
+    blaster.py --selftest BLASTER
+
+The self-test starts the stand-in BLASTER of the host port and checks the
+protocol end to end, through the loopback of the transmitter to the receiver.
+"""
+
+import argparse
+import os
+import random
+import select
+import struct
+import subprocess
+import sys
+import termios
+import time
+import tty
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import telemetry  # noqa: E402
+
+SYNC = 0xA5
+WAKE = 0xFF             # FSM_BRIDGE_WAKE
+WAKE_BYTES = 8          # FSM_BRIDGE_WAKE_BYTES
+RETRIES = 3             # Times a command is sent again, within FSM_BRIDGE_RETRY_WINDOW_MS
+RESPONSE = 0x80
+CMD_SEND_CODE = 0x01
+CMD_SEND_RAW = 0x02
+CMD_HOLD_START = 0x03
+CMD_HOLD_STOP = 0x04
+CMD_QUEUE_MACRO = 0x05
+CMD_QUERY_TELEMETRY = 0x06
+EVT_FRAME = 0x40
+EVT_TX_START = 0x41
+STATUS = ['ok', 'bad length', 'bad argument', 'busy', 'unknown']
+STATUS_OK, STATUS_BAD_LENGTH, STATUS_BAD_ARGUMENT, STATUS_BUSY, STATUS_UNKNOWN = range(5)
+
+FRAME = struct.Struct('<IIIHHBBB')
+TX_START = struct.Struct('<BI')
+FRAME_PERIOD_MS = 108   # NEC_TX_FRAME_PERIOD_MS
+QUEUE_SIZE = 16         # FSM_BRIDGE_QUEUE_SIZE
+BAUD_RATE = termios.B115200
+
+
+def checksum(data):
+    return (0x100 - sum(data)) & 0xFF
+
+
+def nec_waveform_us(code):
+    """Bursts and silences of a NEC frame in microseconds, most significant bit first as fsm_tx."""
+    steps = [9000, 4500]
+    for bit in range(31, -1, -1):
+        steps += [562, 1687 if code >> bit & 1 else 562]
+    return steps + [562]
+
+
+class Bridge:
+    """Packets to and from the bridge over a serial link."""
+
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = BAUD_RATE
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.buffer = bytearray()
+        # A new client does not take up the sequence of the last command of the previous one
+        self.seq = random.randrange(256)
+        self.events = []
+
+    def close(self):
+        os.close(self.fd)
+
+    def send(self, cmd, payload=b'', seq=None, corrupt=False):
+        """Send a command and return its sequence."""
+        seq = self.seq if seq is None else seq
+        self.seq = (seq + 1) & 0xFF
+        body = bytes([cmd, seq, len(payload)]) + payload
+        os.write(self.fd, bytes([WAKE] * WAKE_BYTES + [SYNC]) + body + bytes([checksum(body) ^ (0xFF if corrupt else 0)]))
+        return seq
+
+    def _parse(self):
+        """Next packet of the buffer, as (type, sequence, payload), or None."""
+        while self.buffer:
+            if self.buffer[0] != SYNC:
+                del self.buffer[0]
+                continue
+            if len(self.buffer) < 4 or len(self.buffer) < 5 + self.buffer[3]:
+                return None
+            size = 5 + self.buffer[3]
+            packet = bytes(self.buffer[:size])
+            if sum(packet[1:]) & 0xFF:
+                del self.buffer[0]
+                continue
+            del self.buffer[:size]
+            return packet[1], packet[2], packet[4:-1]
+        return None
+
+    def receive(self, timeout):
+        """Next packet received within a timeout in seconds, or None."""
+        deadline = time.monotonic() + timeout
+        while True:
+            packet = self._parse()
+            if packet is not None:
+                return packet
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                return None
+            self.buffer += os.read(self.fd, 4096)
+
+    def response(self, seq, timeout=1.0):
+        """Status and data of the response to a command. The events received meanwhile are kept."""
+        deadline = time.monotonic() + timeout
+        while True:
+            packet = self.receive(max(0.0, deadline - time.monotonic()))
+            if packet is None:
+                return None, b''
+            ptype, pseq, payload = packet
+            if ptype & RESPONSE and pseq == seq:
+                return payload[0], payload[1:]
+            if not ptype & RESPONSE:
+                self.events.append(decode_event(ptype, payload))
+
+    def collect(self, seconds):
+        """Events received in a time, the ones kept included."""
+        deadline = time.monotonic() + seconds
+        while True:
+            packet = self.receive(max(0.0, deadline - time.monotonic()))
+            if packet is None:
+                break
+            if not packet[0] & RESPONSE:
+                self.events.append(decode_event(packet[0], packet[2]))
+        events, self.events = self.events, []
+        return events
+
+    def command(self, cmd, payload=b''):
+        """Send a command until it is answered, and return its status and data."""
+        seq = self.send(cmd, payload)
+        for _ in range(RETRIES):
+            status, data = self.response(seq)
+            if status is not None:
+                return status, data
+            self.send(cmd, payload, seq)
+        return self.response(seq)
+
+
+def decode_event(ptype, payload):
+    if ptype == EVT_FRAME and len(payload) == FRAME.size:
+        code, first_edge_ms, held_ms, repeats, num_edges, protocol, error, flags = FRAME.unpack(payload)
+        return {'event': 'frame', 'code': code, 'first_edge_ms': first_edge_ms, 'held_ms': held_ms,
+                'repeats': repeats, 'num_edges': num_edges, 'protocol': protocol, 'error': error,
+                'repetition': bool(flags & 1), 'is_error': bool(flags & 2)}
+    if ptype == EVT_TX_START and len(payload) == TX_START.size:
+        seq, ms = TX_START.unpack(payload)
+        return {'event': 'tx_start', 'seq': seq, 'ms': ms}
+    return {'event': 'unknown', 'type': ptype, 'payload': payload.hex()}
+
+
+def print_event(event):
+    if event['event'] == 'frame':
+        kind = 'error %d' % event['error'] if event['is_error'] else ('repetition' if event['repetition'] else 'code')
+        print('frame 0x%08X %s at %d ms, held %d ms, %d repeats'
+              % (event['code'], kind, event['first_edge_ms'], event['held_ms'], event['repeats']))
+    elif event['event'] == 'tx_start':
+        print('started command %d at %d ms' % (event['seq'], event['ms']))
+    else:
+        print('event 0x%02X %s' % (event['type'], event['payload']))
+
+
+def macro_payload(mask, steps):
+    return bytes([mask]) + b''.join(struct.pack('<IHBB', code, delay_ms, 0, repeats) for code, delay_ms, repeats in steps)
+
+
+def check_status(status, what):
+    if status != STATUS_OK:
+        sys.exit('blaster: %s: %s' % (what, 'no response' if status is None else STATUS[status]))
+
+
+def run_client(args):
+    bridge = Bridge(args.port)
+    if args.action == 'send':
+        for code in args.codes:
+            check_status(bridge.command(CMD_SEND_CODE, struct.pack('<BI', args.mask, int(code, 0)))[0], 'send')
+    elif args.action == 'raw':
+        durations = [int(us, 0) for us in args.durations]
+        check_status(bridge.command(CMD_SEND_RAW, bytes([args.mask]) + struct.pack('<%dH' % len(durations), *durations))[0], 'raw')
+    elif args.action == 'hold':
+        check_status(bridge.command(CMD_HOLD_START, struct.pack('<BIH', args.mask, int(args.code, 0), args.ms))[0], 'hold')
+    elif args.action == 'stop':
+        check_status(bridge.command(CMD_HOLD_STOP)[0], 'stop')
+    elif args.action == 'macro':
+        steps = []
+        for step in args.steps:
+            fields = [int(f, 0) for f in step.split(':')]
+            steps.append((fields[0], fields[1], fields[2] if len(fields) > 2 else 0))
+        check_status(bridge.command(CMD_QUEUE_MACRO, macro_payload(args.mask, steps))[0], 'macro')
+    elif args.action == 'telemetry':
+        status, data = bridge.command(CMD_QUERY_TELEMETRY)
+        check_status(status, 'telemetry')
+        snapshots, _ = telemetry.parse(data)
+        if not snapshots:
+            sys.exit('blaster: invalid telemetry snapshot')
+        telemetry.report(snapshots[0], None)
+    for event in bridge.collect(args.seconds if args.action == 'listen' else 0.5):
+        print_event(event)
+    bridge.close()
+
+
+class SelfTest:
+    """Checks of the protocol against the stand-in of the host port."""
+
+    def __init__(self, bridge):
+        self.bridge = bridge
+        self.failures = 0
+
+    def expect(self, condition, what):
+        print('%s %s' % ('ok  ' if condition else 'FAIL', what))
+        self.failures += not condition
+
+    def frames(self, events):
+        return [e for e in events if e['event'] == 'frame']
+
+    def run(self):
+        b = self.bridge
+
+        status, data = b.command(CMD_QUERY_TELEMETRY)
+        snapshots = telemetry.parse(data)[0] if status == STATUS_OK else []
+        self.expect(len(snapshots) == 1, 'telemetry snapshot is valid')
+
+        codes = [0x00FF0000 | (i << 8) | (0xFF - i) for i in range(1, 11)]
+        seqs = [b.send(CMD_SEND_CODE, struct.pack('<BI', 1, code)) for code in codes]
+        statuses = [b.response(seq)[0] for seq in seqs]
+        self.expect(statuses == [STATUS_OK] * len(codes), '%d pipelined codes acknowledged' % len(codes))
+        events = b.collect(FRAME_PERIOD_MS * len(codes) / 1000.0 + 0.5)
+        starts = [e for e in events if e['event'] == 'tx_start']
+        gaps = [y['ms'] - x['ms'] for x, y in zip(starts, starts[1:])]
+        self.expect([e['seq'] for e in starts] == seqs, 'every code started in order')
+        self.expect(gaps and all(gap == FRAME_PERIOD_MS for gap in gaps), 'codes started every %d ms: %s' % (FRAME_PERIOD_MS, gaps))
+        self.expect([e['code'] for e in self.frames(events)] == codes, 'codes received as sent')
+
+        status, _ = b.command(CMD_SEND_RAW, bytes([1]) + struct.pack('<67H', *nec_waveform_us(0x20DF10EF)))
+        frames = self.frames(b.collect(0.4))
+        self.expect(status == STATUS_OK and [f['code'] for f in frames] == [0x20DF10EF], 'raw waveform decoded as NEC')
+
+        status, _ = b.command(CMD_HOLD_START, struct.pack('<BIH', 1, 0x20DF40BF, 0))
+        time.sleep(0.6)
+        stop_status, _ = b.command(CMD_HOLD_STOP)
+        frames = self.frames(b.collect(0.4))
+        repetitions = [f for f in frames if f['repetition']]
+        self.expect(status == STATUS_OK and stop_status == STATUS_OK and frames and frames[0]['code'] == 0x20DF40BF
+                    and len(repetitions) >= 3, 'hold sends repeat codes: %d' % len(repetitions))
+        self.expect(not self.frames(b.collect(0.3)), 'stop ends the hold')
+
+        steps = [(0x20DF8877, 150, 0), (0x20DF48B7, 150, 1), (0x20DFC837, 150, 0)]
+        status, _ = b.command(CMD_QUEUE_MACRO, macro_payload(1, steps))
+        frames = [f for f in self.frames(b.collect(0.9)) if not f['repetition']]
+        self.expect(status == STATUS_OK and [f['code'] for f in frames] == [s[0] for s in steps], 'macro played in order')
+
+        seq = b.send(CMD_SEND_CODE, struct.pack('<BI', 1, 0x20DF00FF), corrupt=True)
+        self.expect(b.response(seq, 0.3)[0] is None, 'packet with a bad checksum ignored')
+        self.expect(b.command(0x7F)[0] == STATUS_UNKNOWN, 'unknown command rejected')
+        self.expect(b.command(CMD_SEND_CODE, b'\x01')[0] == STATUS_BAD_LENGTH, 'short payload rejected')
+        self.expect(b.command(CMD_SEND_CODE, struct.pack('<BI', 0x80, 0x20DF00FF))[0] == STATUS_BAD_ARGUMENT, 'mask out of range rejected')
+
+        payload = struct.pack('<BI', 1, 0x20DF30CF)
+        seq = b.send(CMD_SEND_CODE, payload)
+        first = b.response(seq)[0]
+        b.send(CMD_SEND_CODE, payload, seq)
+        again = b.response(seq)[0]
+        starts = [e for e in b.collect(0.4) if e['event'] == 'tx_start' and e['seq'] == seq]
+        self.expect(first == STATUS_OK and again == STATUS_OK and len(starts) == 1, 'command sent again answered once executed')
+
+        seqs = [b.send(CMD_SEND_CODE, struct.pack('<BI', 1, 0x20DF00FF)) for _ in range(QUEUE_SIZE + 4)]
+        statuses = [b.response(seq)[0] for seq in seqs]
+        self.expect(STATUS_BUSY in statuses and statuses.index(STATUS_BUSY) >= QUEUE_SIZE, 'full queue answered busy')
+        b.collect(FRAME_PERIOD_MS * (QUEUE_SIZE + 1) / 1000.0 + 0.3)
+        return self.failures == 0
+
+
+def run_selftest(path):
+    process = subprocess.Popen([path], stdout=subprocess.PIPE, text=True)
+    try:
+        bridge = Bridge(process.stdout.readline().strip())
+        passed = SelfTest(bridge).run()
+        bridge.close()
+    finally:
+        process.terminate()
+        process.wait()
+    if not passed:
+        sys.exit('blaster: self-test failed')
+    print('blaster: self-test passed')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--selftest', metavar='BLASTER', help='check the stand-in of the host port')
+    parser.add_argument('port', nargs='?', help='serial port of the board or pseudo-terminal of the stand-in')
+    actions = parser.add_subparsers(dest='action')
+    for name in ('send', 'raw', 'hold', 'macro'):
+        sub = actions.add_parser(name)
+        sub.add_argument('--mask', type=lambda s: int(s, 0), default=1, help='transmitters, bit n for the ID n')
+        if name == 'send':
+            sub.add_argument('codes', nargs='+')
+        elif name == 'raw':
+            sub.add_argument('durations', nargs='+', help='bursts and silences in microseconds, starting with a burst')
+        elif name == 'hold':
+            sub.add_argument('--ms', type=int, default=0, help='time to hold, 0 until stop')
+            sub.add_argument('code')
+        else:
+            sub.add_argument('steps', nargs='+', help='CODE:DELAY_MS[:REPEATS]')
+    actions.add_parser('stop')
+    actions.add_parser('telemetry')
+    listen = actions.add_parser('listen')
+    listen.add_argument('--seconds', type=float, default=10.0)
+    args = parser.parse_args()
+
+    if args.selftest:
+        run_selftest(args.selftest)
+    elif args.port and args.action:
+        run_client(args)
+    else:
+        parser.error('a port and an action, or --selftest, are needed')
+
+
+if __name__ == '__main__':
+    main()
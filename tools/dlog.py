@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Decoder of the deferred log of `dlog.h`.
+
+The firmware does not format the messages of DLOG(): it sends records with
+the ID of the format string and the raw arguments on the stimulus port 2 of
+the ITM, in idle time. The stream of that port, as demultiplexed by the SWO
+viewer of the debugger, is a sequence of records of little-endian words:
+
+    header: sync 0xD1 (bits 31-24), number of arguments (bits 23-20), ID (bits 19-0)
+    system time in ms (u32), arguments (u32 each)
+
+The ID is the offset of the format string in the section `dlog_fmt` of the
+ELF file of the firmware, that is not loaded in the flash. The messages are
+rendered here with the format strings read from that section. The stream is
+scanned for the sync byte, so the bytes lost by the link are skipped. Usage:
+
+    dlog.py [--json] ELF FILE|-
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+SYNC = 0xD1
+ID_BITS = 20
+ID_DROPPED = (1 << ID_BITS) - 1
+MAX_ARGS = 4
+SECTION = b'dlog_fmt'
+WORD = struct.Struct('<I')
+# Conversion of printf(): flags, width, precision, length and specifier
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|j|z|t)?([diouxXcp%])')
+
+
+def read_section(path, name):
+    """Contents of a section of an ELF file, 32 or 64-bit little endian."""
+    with open(path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF' or elf[5] != 1:
+        sys.exit('dlog: %s is not a little-endian ELF file' % path)
+    if elf[4] == 1:
+        shoff, = struct.unpack_from('<I', elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2E)
+        header = struct.Struct('<IIIIIIIIII')
+    else:
+        shoff, = struct.unpack_from('<Q', elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x3A)
+        header = struct.Struct('<IIQQQQIIQQ')
+    sections = [header.unpack_from(elf, shoff + i * shentsize) for i in range(shnum)]
+    names = sections[shstrndx]
+    for sh_name, _, _, _, offset, size, _, _, _, _ in sections:
+        start = names[4] + sh_name
+        if elf[start:elf.index(b'\0', start)] == name:
+            return elf[offset:offset + size]
+    sys.exit('dlog: no section %s in %s' % (name.decode(), path))
+
+
+def format_string(table, fmt_id):
+    """Format string of an ID, or None if the ID is not the start of a string."""
+    if fmt_id >= len(table) or (fmt_id > 0 and table[fmt_id - 1] != 0):
+        return None
+    end = table.find(b'\0', fmt_id)
+    return table[fmt_id:end].decode('utf-8', 'replace') if end > fmt_id else None
+
+
+def render(fmt, args):
+    """Render a format string of printf() with 32-bit arguments."""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, spec = match.groups()
+        if spec == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        if spec in 'di':
+            value = value - (1 << 32) if value & 0x80000000 else value
+            spec = 'd'
+        elif spec == 'u':
+            spec = 'd'
+        elif spec == 'c':
+            value = chr(value & 0xFF)
+        elif spec == 'p':
+            return '0x%08x' % value
+        return ('%' + flags + width + ('.' + precision if precision else '') + spec) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def parse(table, data):
+    """Messages of a stream, and the number of bytes skipped."""
+    messages = []
+    skipped = 0
+    pos = 0
+    while pos + 2 * WORD.size <= len(data):
+        header, ms = struct.unpack_from('<II', data, pos)
+        num_args = (header >> ID_BITS) & 0x0F
+        fmt_id = header & ID_DROPPED
+        size = (2 + num_args) * WORD.size
+        fmt = 'dropped %u messages' if fmt_id == ID_DROPPED else format_string(table, fmt_id)
+        if header >> 24 != SYNC or num_args > MAX_ARGS or fmt is None or pos + size > len(data):
+            pos += 1
+            skipped += 1
+            continue
+        args = struct.unpack_from('<%dI' % num_args, data, pos + 2 * WORD.size)
+        messages.append({'ms': ms, 'id': fmt_id, 'args': list(args), 'text': render(fmt, args),
+                         'dropped': fmt_id == ID_DROPPED})
+        pos += size
+    return messages, skipped
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--json', action='store_true', help='print the messages as JSON')
+    parser.add_argument('elf', help='ELF file of the firmware that sent the log')
+    parser.add_argument('file', help='stream of the ITM stimulus port 2, or - for the standard input')
+    args = parser.parse_args()
+
+    table = read_section(args.elf, SECTION)
+    if args.file == '-':
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    messages, skipped = parse(table, data)
+
+    if args.json:
+        json.dump(messages, sys.stdout, indent=1)
+        sys.stdout.write('\n')
+        return
+    for message in messages:
+        print('[%10.3f] %s' % (message['ms'] / 1000.0, message['text']))
+    if skipped:
+        print('%d bytes skipped: lost by the link or not a record' % skipped)
+
+
+if __name__ == '__main__':
+    main()
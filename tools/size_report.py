@@ -0,0 +1,461 @@
+#!/usr/bin/env python3
+"""Flash, RAM and stack budget of the builds made by `make size-report`.
+
+For every variant directory given, the map file of the linker gives the flash
+and RAM taken by each module (object file or library), and the call graphs
+written by `-fcallgraph-info=su` give the worst-case stack depth of `main()`
+and of every interrupt handler. The worst case of the whole system assumes
+that every handler may preempt the others, so it is an upper bound.
+
+Calls through a function pointer are resolved by the pointer called, read
+from the source at the call site: `in` and `out` of `fsm_fire()` call the
+`check_*` and `do_*` columns of the `fsm_trans_t` tables, and the clock
+listeners, the deferred handlers and the capture hook call the functions
+registered for them in the sources of the variant. Any other pointer is
+reported as an unknown indirect call, counted as 0 bytes.
+
+With LTO the compiler merges the modules into a partition, `(lto)` in the
+map. Its symbols are given back to their modules with the symbol table of
+the ELF and the compile unit of their debug information; what has no
+symbol, as literals, unwind tables and padding, stays in `(lto)`.
+Library functions are not compiled with the call graph and count as 0 bytes:
+they are listed so that their stack can be checked by hand.
+
+The results are written as JSON and compared with a baseline in the same
+format, if any. Usage:
+
+    size_report.py [--baseline FILE] [--json FILE] [--isr-frame BYTES] [--objdump TOOL] DIR...
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import subprocess
+import sys
+
+# Output sections loaded in flash, copied from flash to RAM, and only in RAM
+FLASH_SECTIONS = {'.isr_vector', '.text', '.rodata', '.ARM.extab', '.ARM',
+                  '.ARM.exidx', '.preinit_array', '.init_array',
+                  '.fini_array', '.init', '.fini', '.eh_frame',
+                  '.eh_frame_hdr', '.gcc_except_table', '.data.rel.ro'}
+DATA_SECTIONS = {'.data', '.tdata'}
+RAM_SECTIONS = {'.bss', '.tbss', '.noinit', '._user_heap_stack'}
+
+# Pointers called through: column of the transition tables, or argument of the function that registers them
+TABLE_COLUMNS = {'in': ('fsm_trans_t', 1), 'out': ('fsm_trans_t', 3)}
+REGISTRATIONS = {'clock_listeners_arr': ('port_system_clock_add_listener', 0),
+                 'deferred_handlers_arr': ('port_system_deferred_add_handler', 0),
+                 'capture_hook': ('fsm_rx_set_capture_hook', 1)}
+ISR = re.compile(r'_(IRQ)?Handler$')
+ROOT = 'main'
+INDIRECT = '__indirect_call'
+
+
+def _module(path):
+    """Name of the module of an input file of the map."""
+    name = os.path.basename(path)
+    archive = re.match(r'(.*\.a)\(.*\)$', name)
+    if archive:
+        return archive.group(1)
+    if '.ltrans' in name:
+        return '(lto)'
+    return re.sub(r'\.o(bj)?$', '', name)
+
+
+def _add(modules, section, name, size):
+    if section in FLASH_SECTIONS or section in DATA_SECTIONS:
+        modules.setdefault(name, [0, 0])[0] += size
+    if section in RAM_SECTIONS or section in DATA_SECTIONS:
+        modules.setdefault(name, [0, 0])[1] += size
+
+
+def parse_map(path):
+    """Flash and RAM in bytes of every module, the reserves of the linker script, and the input sections of the LTO partitions."""
+    modules = {}
+    symbols = {}
+    lto = []
+    section = None
+    out_size = {}
+    pending_in = None
+    pending_out = None
+    in_map = False
+
+    def add(name, size, address=0):
+        _add(modules, section, name, size)
+        out_size[section] = out_size.get(section, 0) - size
+        if name == '(lto)' and size:
+            lto.append((section, address, address + size))
+
+    with open(path, encoding='utf-8', errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if not in_map:
+                in_map = line.startswith('Linker script and memory map')
+                continue
+            sym = re.match(r'^\s+0x([0-9a-f]+)\s+(_Min_\w+)\s*=', line)
+            if sym:
+                symbols[sym.group(2)] = int(sym.group(1), 16)
+                continue
+            out = re.match(r'^(\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+))?', line)
+            if out:
+                section = out.group(1)
+                pending_in = None
+                pending_out = None
+                if out.group(3):
+                    out_size[section] = out_size.get(section, 0) + int(out.group(3), 16)
+                else:
+                    pending_out = section
+                continue
+            sizes = re.match(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s*(\S.*)?$', line)
+            if sizes and pending_out:
+                out_size[section] = out_size.get(section, 0) + int(sizes.group(2), 16)
+                pending_out = None
+                continue
+            if sizes and pending_in and sizes.group(3):
+                add(_module(sizes.group(3)), int(sizes.group(2), 16), int(sizes.group(1), 16))
+                pending_in = None
+                continue
+            inp = re.match(r'^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?$', line)
+            if inp:
+                pending_in = None
+                if inp.group(1) == '*fill*':
+                    add('(fill)', int(inp.group(3), 16))
+                elif inp.group(4):
+                    add(_module(inp.group(4)), int(inp.group(3), 16), int(inp.group(2), 16))
+                continue
+            name = re.match(r'^ (\S+)\s*$', line)
+            pending_in = name.group(1) if name and not name.group(1).startswith('*') else None
+
+    # Whatever is not in an input section is reserved by the linker script: heap, stack, alignment
+    for sect, size in out_size.items():
+        if size > 0:
+            section = sect
+            add('(linker)', size)
+    return modules, symbols, lto
+
+
+def _run(command):
+    """Output of a tool of the toolchain, or None if it cannot be run."""
+    try:
+        return subprocess.run(command, check=True, capture_output=True, text=True, errors='replace').stdout
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def split_lto(modules, lto, elf, objdump):
+    """Give the symbols of the LTO partitions back to their modules, by the compile unit of their debug information."""
+    table = _run([objdump, '-t', elf])
+    info = _run([objdump, '--dwarf=info', elf])
+    if table is None or info is None:
+        print('   %s cannot read %s: the LTO partitions are not split by module' % (objdump, elf))
+        return
+
+    # Compile units by offset. The DIEs of a partition point to the DIE of their source, directly or through another one
+    units = []
+    origins = {}
+    addresses = {}
+    die = None
+    for line in info.splitlines():
+        entry = re.match(r'\s*<\d+><([0-9a-f]+)>: Abbrev Number: \d+ \((\w+)\)', line)
+        if entry:
+            die = int(entry.group(1), 16)
+            if entry.group(2) == 'DW_TAG_compile_unit':
+                units.append([die, None])
+            continue
+        name = re.search(r'DW_AT_name\s*:.*?([^\s:]+\.c)\s*$', line)
+        if name and units and units[-1][0] == die:
+            units[-1][1] = name.group(1)
+            continue
+        origin = re.search(r'DW_AT_(?:abstract_origin|specification)\s*: <0x([0-9a-f]+)>', line)
+        if origin:
+            origins[die] = int(origin.group(1), 16)
+            continue
+        address = re.search(r'DW_AT_low_pc\s*: (?:\(addr\) )?0x([0-9a-f]+)|DW_AT_location\s*:.*\(DW_OP_addr: ([0-9a-f]+)\)$', line)
+        if address:
+            addresses.setdefault(int(address.group(1) or address.group(2), 16), die)
+
+    def unit(offset):
+        for _ in range(8):
+            found = None
+            for start, name in units:
+                if start <= offset:
+                    found = name
+            if found or offset not in origins:
+                return found
+            offset = origins[offset]
+        return None
+
+    seen = set()
+    for line in table.splitlines():
+        sym = re.match(r'^([0-9a-f]+)\s.{7}\s(\S+)\s+([0-9a-f]+)\s', line)
+        if not sym or not int(sym.group(3), 16) or sym.group(1) in seen:
+            continue
+        seen.add(sym.group(1))
+        address, size = int(sym.group(1), 16), int(sym.group(3), 16)
+        section = next((sect for sect, start, end in lto if start <= address < end), None)
+        source = unit(addresses[address]) if section and address in addresses else None
+        if source:
+            name = os.path.splitext(os.path.basename(source))[0]
+            _add(modules, section, name, size)
+            _add(modules, section, '(lto)', -size)
+
+
+def parse_callgraphs(directory):
+    """Stack frame, dynamic flag, source file and callees of every function of the call graphs. An indirect call is a callee named after its call site."""
+    nodes = {}
+    edges = {}
+    for path in sorted(glob.glob(os.path.join(directory, '*.ci'))):
+        with open(path, encoding='utf-8', errors='replace') as f:
+            for line in f:
+                node = re.match(r'node: \{ title: "(.*?)" label: "(.*?)"', line)
+                if node:
+                    label = node.group(2).split('\\n')
+                    source = label[1].rsplit(':', 2)[0] if len(label) > 1 else None
+                    frame = re.search(r'(\d+) bytes \(([\w,]+)\)', node.group(2))
+                    if frame:
+                        nodes[node.group(1)] = (label[0], int(frame.group(1)), frame.group(2) != 'static', source)
+                    else:
+                        nodes.setdefault(node.group(1), (label[0], None, False, source))
+                    continue
+                edge = re.match(r'edge: \{ sourcename: "(.*?)" targetname: "(.*?)"(?: label: "(.*?)")?', line)
+                if edge:
+                    callee = edge.group(2)
+                    if callee == INDIRECT:
+                        callee = '%s@%s' % (INDIRECT, edge.group(3))
+                    callees = edges.setdefault(edge.group(1), [])
+                    if callee not in callees:
+                        callees.append(callee)
+    return nodes, edges
+
+
+def _sources(directory):
+    """Text of the C sources of a variant, without comments, from the first prerequisite of every dependency file."""
+    sources = {}
+    for path in sorted(glob.glob(os.path.join(directory, '*.d'))):
+        with open(path, encoding='utf-8', errors='replace') as f:
+            prerequisites = f.read().split(':', 1)[-1].split()
+        if prerequisites and os.path.exists(prerequisites[0]):
+            with open(prerequisites[0], encoding='utf-8', errors='replace') as f:
+                text = re.sub(r'/\*.*?\*/|//[^\n]*', ' ', f.read(), flags=re.S)
+            sources[prerequisites[0]] = text
+    return sources
+
+
+class IndirectCalls:
+    """Functions that the pointer called at each call site may point to."""
+
+    def __init__(self, directory, nodes):
+        self.sources = _sources(directory)
+        self.defined = {}
+        for title, node in nodes.items():
+            if node[1] is not None:
+                self.defined.setdefault(node[0], []).append(title)
+        self.nodes = nodes
+
+    @staticmethod
+    def pointer(site):
+        """Name of the pointer called at a call site `file:line:column`."""
+        try:
+            path, line, column = site.rsplit(':', 2)
+            with open(path, encoding='utf-8', errors='replace') as f:
+                text = f.read().splitlines()[int(line) - 1]
+        except (OSError, ValueError, IndexError):
+            return None
+        paren = text.find('(', int(column) - 1)
+        expression = re.sub(r'\s*\[[^\]]*\]\s*$', '', text[:paren] if paren >= 0 else text)
+        name = re.search(r'(\w+)\s*$', expression)
+        return name.group(1) if name else None
+
+    def _titles(self, name, source):
+        titles = self.defined.get(name, [])
+        local = [t for t in titles if self.nodes[t][3] == source]
+        return local or titles
+
+    def targets(self, site):
+        """Titles of the functions reached by an indirect call, or None if its pointer is not known."""
+        pointer = self.pointer(site)
+        found = []
+        if pointer in TABLE_COLUMNS:
+            kind, column = TABLE_COLUMNS[pointer]
+            pattern = re.compile(r'\b%s\s+\w+\s*\[\s*\w*\s*\]\s*=\s*\{(.*?)\}\s*;' % kind, re.S)
+        elif pointer in REGISTRATIONS:
+            kind, column = REGISTRATIONS[pointer]
+            pattern = re.compile(r'\b%s\s*\(([^;{}]*)\)\s*;' % kind)
+        else:
+            return None
+        for source, text in self.sources.items():
+            for match in pattern.finditer(text):
+                rows = re.findall(r'\{([^{}]*)\}', match.group(1)) if pointer in TABLE_COLUMNS else [match.group(1)]
+                for row in rows:
+                    cells = [c.strip().lstrip('&').strip() for c in row.split(',')]
+                    if column < len(cells):
+                        for title in self._titles(cells[column], source):
+                            if title not in found:
+                                found.append(title)
+        return found
+
+
+class StackAnalysis:
+    """Worst-case depth of the call chains of a call graph."""
+
+    def __init__(self, nodes, edges, indirect):
+        self.nodes = nodes
+        self.edges = edges
+        self.indirect = indirect
+        self.memo = {}
+        self.unknown = set()
+        self.dynamic = set()
+        self.recursive = set()
+
+    def _callees(self, title):
+        for callee in self.edges.get(title, []):
+            if callee.startswith(INDIRECT + '@'):
+                site = callee[len(INDIRECT) + 1:]
+                targets = self.indirect.targets(site)
+                if targets is None:
+                    self.unknown.add('indirect call at ' + site)
+                else:
+                    yield from targets
+            else:
+                yield callee
+
+    def depth(self, title, path=()):
+        """Depth in bytes and worst chain from a function. Cycles are cut and reported: through fsm_fire() they are usually an FSM firing another one, not recursion."""
+        if title in self.memo:
+            return self.memo[title]
+        name, frame, dynamic, _ = self.nodes.get(title, (title, None, False, None))
+        if frame is None:
+            self.unknown.add(name)
+            frame = 0
+        if dynamic:
+            self.dynamic.add(name)
+        path = path + (title,)
+        best, chain, cut = 0, [], False
+        for callee in self._callees(title):
+            if callee in path:
+                self.recursive.add(self.nodes.get(callee, (callee,))[0])
+                cut = True
+                continue
+            sub, sub_chain, sub_cut = self.depth(callee, path)
+            cut = cut or sub_cut
+            if sub > best:
+                best, chain = sub, sub_chain
+        result = (frame + best, [name] + chain, cut)
+        # A depth computed with a recursion cut depends on the path, so it is not reused
+        if not cut:
+            self.memo[title] = result
+        return result
+
+
+def analyse(directory, isr_frame, objdump):
+    """Budget of a variant directory."""
+    maps = glob.glob(os.path.join(directory, '*.map'))
+    if not maps:
+        sys.exit('size_report: no map file in ' + directory)
+    modules, symbols, lto = parse_map(maps[0])
+    if lto:
+        elf = os.path.splitext(maps[0])[0]
+        split_lto(modules, lto, elf if os.path.exists(elf) else elf + '.elf', objdump)
+
+    nodes, edges = parse_callgraphs(directory)
+    analysis = StackAnalysis(nodes, edges, IndirectCalls(directory, nodes))
+    roots = [t for t, n in nodes.items() if n[0] == ROOT and n[1] is not None]
+    isrs = sorted(t for t, n in nodes.items() if n[1] is not None and ISR.search(n[0]))
+    stack = {}
+    chains = {}
+    for title in roots + isrs:
+        depth, chain, _ = analysis.depth(title)
+        name = nodes[title][0]
+        stack[name] = depth + (isr_frame if title in isrs else 0)
+        chains[name] = chain
+    worst = sum(stack.values())
+
+    return {
+        'modules': modules,
+        'flash': sum(m[0] for m in modules.values()),
+        'ram': sum(m[1] for m in modules.values()),
+        'stack': stack,
+        'stack_worst': worst,
+        'stack_reserved': symbols.get('_Min_Stack_Size'),
+        'heap_reserved': symbols.get('_Min_Heap_Size'),
+        'chains': chains,
+        'unknown': sorted(analysis.unknown),
+        'dynamic': sorted(analysis.dynamic),
+        'recursive': sorted(analysis.recursive),
+    }
+
+
+def _delta(value, base):
+    if base is None:
+        return ''
+    diff = value - base
+    return '%+d' % diff if diff else '='
+
+
+def report(variant, result, base):
+    """Print the budget of a variant and its difference with the baseline."""
+    base_modules = base.get('modules', {}) if base else {}
+    print('== %s: flash %d B, RAM %d B' % (variant, result['flash'], result['ram'])
+          + (' (%s, %s)' % (_delta(result['flash'], base['flash']), _delta(result['ram'], base['ram'])) if base else ''))
+    print('   %-28s %8s %8s %8s %8s' % ('module', 'flash', 'diff', 'RAM', 'diff'))
+    names = sorted(set(result['modules']) | set(base_modules),
+                   key=lambda n: -sum(result['modules'].get(n, [0, 0])))
+    for name in names:
+        flash, ram = result['modules'].get(name, [0, 0])
+        bflash, bram = base_modules.get(name, [0, 0]) if base else (None, None)
+        print('   %-28s %8d %8s %8d %8s' % (name, flash, _delta(flash, bflash), ram, _delta(ram, bram)))
+
+    base_stack = base.get('stack', {}) if base else {}
+    print('   %-28s %8s %8s   %s' % ('stack', 'bytes', 'diff', 'worst chain'))
+    for name, depth in result['stack'].items():
+        print('   %-28s %8d %8s   %s' % (name, depth, _delta(depth, base_stack.get(name)) if base else '',
+                                        ' > '.join(result['chains'][name])))
+    reserved = result['stack_reserved']
+    print('   %-28s %8d %8s   %s' % ('worst case (nested ISRs)', result['stack_worst'],
+                                     _delta(result['stack_worst'], base and base['stack_worst']),
+                                     'reserved %d B' % reserved if reserved is not None else ''))
+    if reserved is not None and result['stack_worst'] > reserved:
+        print('   WARNING: the worst-case stack exceeds _Min_Stack_Size')
+    if result['dynamic']:
+        print('   dynamic stack: ' + ', '.join(result['dynamic']))
+    if result['recursive']:
+        print('   call cycles cut at: ' + ', '.join(result['recursive']))
+    if result['unknown']:
+        print('   no stack information (counted as 0): ' + ', '.join(result['unknown']))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--baseline', help='JSON of a previous report to compare with')
+    parser.add_argument('--json', help='JSON file where the results are written')
+    parser.add_argument('--isr-frame', type=int, default=0,
+                        help='bytes stacked by the hardware when an ISR is entered')
+    parser.add_argument('--objdump', default='objdump',
+                        help='objdump of the toolchain, to split the LTO partitions by module')
+    parser.add_argument('dirs', nargs='+', help='output directory of each variant')
+    args = parser.parse_args()
+
+    baseline = {}
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline, encoding='utf-8') as f:
+            baseline = json.load(f)
+    elif args.baseline:
+        print('No baseline %s: save one with `make size-baseline`\n' % args.baseline)
+
+    results = {}
+    for directory in args.dirs:
+        variant = os.path.basename(os.path.normpath(directory))
+        results[variant] = analyse(directory, args.isr_frame, args.objdump)
+        report(variant, results[variant], baseline.get(variant))
+
+    if args.json:
+        with open(args.json, 'w', encoding='utf-8') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+            f.write('\n')
+
+
+if __name__ == '__main__':
+    main()
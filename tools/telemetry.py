@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Pretty-printer of the telemetry snapshots sent over the debug link.
+
+The firmware sends a snapshot of the counters of `telemetry.h` on the stimulus
+port 1 of the ITM every TELEMETRY_PERIOD_MS while it is idle. The stream of
+that port, as demultiplexed by the SWO viewer of the debugger, is a sequence
+of snapshots:
+
+    magic 'TELM' (u32), version (u16), number of counters (u16),
+    sequence (u32), uptime in ms (u32), counters (u32 each), checksum (u32)
+
+All the fields are little endian, and the checksum is the sum of the previous
+words. The stream is scanned for the magic, so the bytes lost by the link are
+skipped. For every valid snapshot the counters are printed with their
+increase since the previous snapshot, and the decode quality of the
+receiver is summarised, with the frames whose first edge woke the system up
+next to the residency of each low-power mode. Usage:
+
+    telemetry.py [--json] [--last] FILE|-
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = 0x4D4C4554
+HEADER = struct.Struct('<IHHII')
+WORD = struct.Struct('<I')
+
+# Names of the counters of each version of the layout, in the order of enum TELEMETRY_COUNTER
+COUNTERS = {
+    1: ['rx_edges', 'rx_edges_overflow', 'rx_edges_glitch', 'rx_frames',
+        'rx_repetitions', 'rx_error_prologue', 'rx_error_symbol',
+        'rx_error_truncated', 'rx_inverse_mismatch', 'rx_filtered',
+        'rx_fifo_dropped', 'tx_frames', 'tx_repetitions', 'tx_busy_us',
+        'wakeups', 'sleep_wfi_ms', 'sleep_stop_fast_ms', 'sleep_stop_ms'],
+}
+COUNTERS[2] = COUNTERS[1] + [
+    'wake_frame_ok_wfi', 'wake_frame_ok_stop_fast', 'wake_frame_ok_stop',
+    'wake_frame_err_wfi', 'wake_frame_err_stop_fast', 'wake_frame_err_stop']
+# Counters that are not events: their increase is not shown as a rate
+SAMPLED = {'tx_busy_us', 'sleep_wfi_ms', 'sleep_stop_fast_ms', 'sleep_stop_ms'}
+ERRORS = ('rx_error_prologue', 'rx_error_symbol', 'rx_error_truncated')
+# Low-power modes of the residency and wake-up frame counters
+MODES = ('wfi', 'stop_fast', 'stop')
+
+
+def parse(data):
+    """Valid snapshots of a stream, and the number of bytes skipped."""
+    snapshots = []
+    skipped = 0
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        magic, version, num_counters, sequence, uptime_ms = HEADER.unpack_from(data, pos)
+        size = HEADER.size + (num_counters + 1) * WORD.size
+        if magic != MAGIC or pos + size > len(data):
+            pos += 1
+            skipped += 1
+            continue
+        words = struct.unpack_from('<%dI' % (size // WORD.size), data, pos)
+        if sum(words[:-1]) & 0xFFFFFFFF != words[-1]:
+            pos += 1
+            skipped += 1
+            continue
+        counters = words[HEADER.size // WORD.size:-1]
+        # A newer layout only appends counters, so the names of the last known one still apply
+        known = [v for v in COUNTERS if v <= version]
+        names = COUNTERS[max(known)][:num_counters] if known else []
+        names = names + ['counter_%d' % i for i in range(len(names), num_counters)]
+        snapshots.append({'version': version, 'sequence': sequence, 'uptime_ms': uptime_ms,
+                          'counters': dict(zip(names, counters))})
+        pos += size
+    return snapshots, skipped
+
+
+def report(snapshot, previous):
+    """Print a snapshot and its increase since the previous one."""
+    counters = snapshot['counters']
+    base = previous['counters'] if previous else {}
+    elapsed_s = (snapshot['uptime_ms'] - previous['uptime_ms']) / 1000.0 if previous else 0.0
+    print('== snapshot %d (v%d) at %.3f s' % (snapshot['sequence'], snapshot['version'],
+                                              snapshot['uptime_ms'] / 1000.0))
+    print('   %-24s %12s %12s %10s' % ('counter', 'value', 'increase', 'per s'))
+    for name, value in counters.items():
+        diff = (value - base[name]) & 0xFFFFFFFF if name in base else None
+        rate = '%.2f' % (diff / elapsed_s) if diff is not None and elapsed_s > 0 and name not in SAMPLED else ''
+        print('   %-24s %12d %12s %10s' % (name, value, '' if diff is None else '+%d' % diff, rate))
+
+    frames = counters.get('rx_frames', 0) + counters.get('rx_repetitions', 0)
+    errors = sum(counters.get(name, 0) for name in ERRORS)
+    if frames + errors:
+        print('   decode quality: %.2f %% of %d captures decoded, %d errors (%s)'
+              % (100.0 * frames / (frames + errors), frames + errors, errors,
+                 ', '.join('%s %d' % (name[len('rx_error_'):], counters.get(name, 0)) for name in ERRORS)))
+    for mode in MODES:
+        ok = counters.get('wake_frame_ok_' + mode, 0)
+        err = counters.get('wake_frame_err_' + mode, 0)
+        if ok + err:
+            print('   woken from %-9s: %.2f %% of %d first frames decoded, %d ms slept'
+                  % (mode, 100.0 * ok / (ok + err), ok + err, counters.get('sleep_%s_ms' % mode, 0)))
+    if counters.get('rx_edges'):
+        print('   edges dropped: %.2f %% by overflow, %.2f %% by the glitch filter'
+              % (100.0 * counters.get('rx_edges_overflow', 0) / counters['rx_edges'],
+                 100.0 * counters.get('rx_edges_glitch', 0) / counters['rx_edges']))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--json', action='store_true', help='print the snapshots as JSON')
+    parser.add_argument('--last', action='store_true', help='print only the last snapshot')
+    parser.add_argument('file', help='stream of the ITM stimulus port 1, or - for the standard input')
+    args = parser.parse_args()
+
+    if args.file == '-':
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    snapshots, skipped = parse(data)
+    if not snapshots:
+        sys.exit('telemetry: no valid snapshot in %s' % args.file)
+
+    first = len(snapshots) - 1 if args.last else 0
+    if args.json:
+        json.dump(snapshots[first:], sys.stdout, indent=1)
+        sys.stdout.write('\n')
+        return
+    for i in range(first, len(snapshots)):
+        report(snapshots[i], snapshots[i - 1] if i > 0 else None)
+    if skipped:
+        print('%d bytes skipped: lost by the link or not a snapshot' % skipped)
+
+
+if __name__ == '__main__':
+    main()